@@ -0,0 +1,131 @@
+#pragma once
+
+C_HEADER_START
+// The implementation shared by the memory and string functions of the kernel
+// (memory.c, string.c) and of the native library (cl_memory.c, cl_string.c).
+// The functions don't validate their parameters, that is done by the callers.
+
+#define MEM_FEATURE_DETECTED                    (1UL<<0)
+
+// AVX2 is supported and the OS enabled the YMM state in XCR0
+#define MEM_FEATURE_AVX2                        (1UL<<1)
+
+// Enhanced REP MOVSB/STOSB
+#define MEM_FEATURE_ERMS                        (1UL<<2)
+
+// Copies and fills at least this large bypass the caches, they would evict
+// most of the data cached anyway
+#define MEM_NON_TEMPORAL_THRESHOLD              (512*KB_SIZE)
+
+//******************************************************************************
+// Function:     MemGetCpuFeatures
+// Description:  Returns the MEM_FEATURE_* flags of the CPU, detected on the
+//               first call.
+// Returns:      DWORD
+// Parameter:    void
+//******************************************************************************
+DWORD
+MemGetCpuFeatures(
+    void
+    );
+
+//******************************************************************************
+// Function:     MemCopyForward
+// Description:  Copies Count bytes. Each byte of Destination is written only
+//               after the bytes of Source found after it were read, so the
+//               buffers may overlap if Destination is below Source.
+// Returns:      void
+// Parameter:    OUT PBYTE Destination
+// Parameter:    IN const BYTE* Source
+// Parameter:    IN QWORD Count
+// Parameter:    IN BOOLEAN NonTemporal - if TRUE the data written is not
+//               brought in the caches regardless of its size
+//******************************************************************************
+void
+MemCopyForward(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN_READS_BYTES(Count)       const BYTE* Source,
+    IN                          QWORD       Count,
+    IN                          BOOLEAN     NonTemporal
+    );
+
+//******************************************************************************
+// Function:     MemCopyBackward
+// Description:  Copies Count bytes starting with the last ones, the buffers
+//               may overlap if Destination is above Source.
+// Returns:      void
+// Parameter:    OUT PBYTE Destination
+// Parameter:    IN const BYTE* Source
+// Parameter:    IN QWORD Count
+//******************************************************************************
+void
+MemCopyBackward(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN_READS_BYTES(Count)       const BYTE* Source,
+    IN                          QWORD       Count
+    );
+
+//******************************************************************************
+// Function:     MemFill
+// Description:  Sets Count bytes to Value.
+// Returns:      void
+// Parameter:    OUT PBYTE Destination
+// Parameter:    IN BYTE Value
+// Parameter:    IN QWORD Count
+// Parameter:    IN BOOLEAN NonTemporal - see MemCopyForward
+//******************************************************************************
+void
+MemFill(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN                          BYTE        Value,
+    IN                          QWORD       Count,
+    IN                          BOOLEAN     NonTemporal
+    );
+
+//******************************************************************************
+// Function:     MemFindDifference
+// Description:  Compares two buffers.
+// Returns:      QWORD - Index of the first byte which differs, Count if the
+//               buffers are equal
+// Parameter:    IN const BYTE* First
+// Parameter:    IN const BYTE* Second
+// Parameter:    IN QWORD Count
+//******************************************************************************
+QWORD
+MemFindDifference(
+    IN_READS_BYTES(Count)       const BYTE* First,
+    IN_READS_BYTES(Count)       const BYTE* Second,
+    IN                          QWORD       Count
+    );
+
+//******************************************************************************
+// Function:     MemFindNotEqual
+// Description:  Searches for the first byte different from Value.
+// Returns:      QWORD - Its index, Count if all the bytes are equal to Value
+// Parameter:    IN const BYTE* Buffer
+// Parameter:    IN BYTE Value
+// Parameter:    IN QWORD Count
+//******************************************************************************
+QWORD
+MemFindNotEqual(
+    IN_READS_BYTES(Count)       const BYTE* Buffer,
+    IN                          BYTE        Value,
+    IN                          QWORD       Count
+    );
+
+//******************************************************************************
+// Function:     MemStringLength
+// Description:  Returns the length of a NULL terminated string.
+// Returns:      DWORD - The length, at most MaxLength
+// Parameter:    IN const char* String
+// Parameter:    IN DWORD MaxLength
+// NOTE:         The string is read 16 aligned bytes at a time, the bytes after
+//               the terminator or MaxLength up to the next 16 byte boundary
+//               are read as well. They are always on the same page.
+//******************************************************************************
+DWORD
+MemStringLength(
+    IN_Z                        const char* String,
+    IN                          DWORD       MaxLength
+    );
+C_HEADER_END
\ No newline at end of file
@@ -56,6 +56,11 @@
 // Because we only have x64 configuration => always 0x10
 #define NATURAL_ALIGNMENT                   0x10
 
+// Data written independently by different CPUs must not share a cache line,
+// else each write invalidates the line in the caches of the other CPUs
+// (false sharing)
+#define CACHE_LINE_SIZE                     64
+
 // These asserts can be very useful when working with hardware defined
 // registers/structures to validate if the size of the defined C structure
 // matches the hardware specification.
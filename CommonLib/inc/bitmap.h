@@ -8,6 +8,9 @@ typedef struct _BITMAP
 
     DWORD                   BufferSize;
     DWORD                   BitCount;
+
+    // index following the last run found by BitmapScanNextFitAndFlip
+    DWORD                   NextFitHint;
 } BITMAP, *PBITMAP;
 #pragma pack(pop)
 
@@ -123,4 +126,32 @@ BitmapScanFromToAndFlip(
     IN          DWORD       FirstInvalidBitIndex,
     IN          DWORD       ConsecutiveBits,
     IN          BOOLEAN     Set
-);
\ No newline at end of file
+);
+
+//******************************************************************************
+// Function:     BitmapScanNextFitAndFlip
+// Description:  Same as BitmapScanFromAndFlip, but the scan starts where the
+//               previous one ended and wraps around to Index. Repeated
+//               allocations do not walk over the runs already taken at the
+//               beginning of the bitmap each time.
+// Returns:      DWORD - index of the first bit of the run, MAX_DWORD if none
+//               was found
+// Parameter:    INOUT PBITMAP Bitmap
+// Parameter:    IN DWORD Index - no bit before this index is returned
+// Parameter:    IN DWORD ConsecutiveBits
+// Parameter:    IN BOOLEAN Set
+//******************************************************************************
+SIZE_SUCCESS
+DWORD
+BitmapScanNextFitAndFlip(
+    INOUT       PBITMAP     Bitmap,
+    IN          DWORD       Index,
+    IN          DWORD       ConsecutiveBits,
+    IN          BOOLEAN     Set
+    );
+
+// Returns the number of bits set in the bitmap
+DWORD
+BitmapCountSetBits(
+    IN          PBITMAP     Bitmap
+    );
\ No newline at end of file
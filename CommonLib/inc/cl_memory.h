@@ -19,6 +19,24 @@ cl_memset(
 
 #define cl_memzero(addr,size)      cl_memset((addr),0,(size))
 
+//******************************************************************************
+// Function:     memsetnt
+// Description:  Same as memset, however the data written bypasses the caches.
+// Returns:      void
+// Parameter:    OUT PVOID address
+// Parameter:    IN BYTE value
+// Parameter:    IN DWORD size
+//******************************************************************************
+_At_buffer_( address, i, size, _Post_satisfies_( ((PBYTE)address)[i] == value ))
+void
+cl_memsetnt(
+    OUT_WRITES_BYTES_ALL(size)  PVOID address,
+    IN                          BYTE value,
+    IN                          DWORD size
+    );
+
+#define cl_memzeront(addr,size)    cl_memsetnt((addr),0,(size))
+
 //******************************************************************************
 // Function:     memcpy
 // Description:  This function does not guarantee proper handling of overlapped
@@ -37,10 +55,26 @@ cl_memcpy(
     IN                          QWORD   Count
     );
 
+//******************************************************************************
+// Function:     memcpynt
+// Description:  Same as memcpy, however the data written bypasses the caches.
+// Returns:      void
+// Parameter:    OUT PVOID Destination
+// Parameter:    IN PVOID Source
+// Parameter:    IN QWORD Count
+//******************************************************************************
+_At_buffer_(Destination,i, Count,
+            _Post_satisfies_(((PBYTE)Destination)[i] == ((PBYTE)Source)[i]))
+void
+cl_memcpynt(
+    OUT_WRITES_BYTES_ALL(Count) PVOID   Destination,
+    IN_READS(Count)             void*   Source,
+    IN                          QWORD   Count
+    );
+
 //******************************************************************************
 // Function:     memmove
-// Description:  Executes slower than memcpy but it can be used for overlapped
-//               memory regions.
+// Description:  Can be used for overlapped memory regions.
 // Returns:      void
 // Parameter:    OUT PVOID Destination
 // Parameter:    IN PVOID Source
@@ -135,6 +135,17 @@ cl_vsnprintf(
     INOUT                   va_list     argptr
     );
 
+// Same as vsnprintf, also returns the number of characters written to
+// outputBuffer without the NULL terminator, even if the buffer was too small.
+STATUS
+cl_vsnprintfex(
+    OUT_WRITES(buffSize)    char*       outputBuffer,
+    IN                      DWORD       buffSize,
+    IN_Z                    char*       inputBuffer,
+    INOUT                   va_list     argptr,
+    OUT_OPT                 DWORD*      length
+    );
+
 const
 char*
 cl_strtok_s(
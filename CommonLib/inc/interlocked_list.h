@@ -0,0 +1,164 @@
+#pragma once
+
+#include "slist.h"
+
+C_HEADER_START
+#pragma warning(push)
+
+// warning C4324: structure was padded due to alignment specifier
+#pragma warning(disable:4324)
+
+// The first entry, the number of entries and a sequence number are replaced
+// together by CMPXCHG16B. The sequence number changes on each pop and flush so
+// a pop which read an entry that was meanwhile popped and pushed back (ABA)
+// fails and retries.
+typedef struct __declspec(align(16)) _CL_INTERLOCKED_SLIST_HEADER
+{
+    PCL_SLIST_ENTRY volatile            First;
+    volatile DWORD                      Depth;
+    volatile DWORD                      Sequence;
+} CL_INTERLOCKED_SLIST_HEADER, *PCL_INTERLOCKED_SLIST_HEADER;
+STATIC_ASSERT(sizeof(CL_INTERLOCKED_SLIST_HEADER) == 2 * sizeof(QWORD));
+
+// Intrusive queue which may be appended to by any number of CPUs without a
+// lock while a single consumer removes the entries in the order in which
+// they were appended.
+typedef struct _CL_MPSC_QUEUE
+{
+    // Last entry appended, producers exchange themselves in
+    PCL_SLIST_ENTRY volatile            Tail;
+
+    // Oldest entry, only the consumer touches it
+    PCL_SLIST_ENTRY                     Head;
+
+    // Keeps the queue non-empty so producers never have to update Head
+    CL_SLIST_ENTRY                      Stub;
+} CL_MPSC_QUEUE, *PCL_MPSC_QUEUE;
+#pragma warning(pop)
+
+//******************************************************************************
+// Function:     ClInitializeInterlockedSListHead
+// Description:  Initializes an empty interlocked SLIST.
+// Returns:      void
+// Parameter:    OUT PCL_INTERLOCKED_SLIST_HEADER ListHead - must be 16 byte
+//               aligned
+//******************************************************************************
+void
+ClInitializeInterlockedSListHead(
+    OUT     PCL_INTERLOCKED_SLIST_HEADER    ListHead
+    );
+
+//******************************************************************************
+// Function:     ClInterlockedPushEntrySList
+// Description:  Inserts an entry at the front of the list.
+// Returns:      PCL_SLIST_ENTRY - The previous first entry, NULL if the list
+//               was empty
+// Parameter:    INOUT PCL_INTERLOCKED_SLIST_HEADER ListHead
+// Parameter:    INOUT PCL_SLIST_ENTRY Entry
+//******************************************************************************
+PCL_SLIST_ENTRY
+ClInterlockedPushEntrySList(
+    INOUT   PCL_INTERLOCKED_SLIST_HEADER    ListHead,
+    INOUT   PCL_SLIST_ENTRY                 Entry
+    );
+
+//******************************************************************************
+// Function:     ClInterlockedPopEntrySList
+// Description:  Removes the first entry of the list.
+// Returns:      PCL_SLIST_ENTRY - The entry removed, NULL if the list is empty
+// Parameter:    INOUT PCL_INTERLOCKED_SLIST_HEADER ListHead
+// NOTE:         The Next field of the first entry is read before the entry is
+//               removed, by then another CPU may have popped and freed it.
+//               If any CPU may pop, the entries must be type-stable: their
+//               memory must not be returned to the heap or unmapped for as
+//               long as the list is used, only reused as entries of the same
+//               list (e.g. a free list of preallocated descriptors). Lists
+//               whose entries are freed once removed must only use Push and
+//               Flush.
+//******************************************************************************
+PTR_SUCCESS
+PCL_SLIST_ENTRY
+ClInterlockedPopEntrySList(
+    INOUT   PCL_INTERLOCKED_SLIST_HEADER    ListHead
+    );
+
+//******************************************************************************
+// Function:     ClInterlockedFlushSList
+// Description:  Removes all the entries of the list.
+// Returns:      PCL_SLIST_ENTRY - The first of the entries removed, they are
+//               still linked through their Next fields, NULL if the list was
+//               empty
+// Parameter:    INOUT PCL_INTERLOCKED_SLIST_HEADER ListHead
+//******************************************************************************
+PTR_SUCCESS
+PCL_SLIST_ENTRY
+ClInterlockedFlushSList(
+    INOUT   PCL_INTERLOCKED_SLIST_HEADER    ListHead
+    );
+
+//******************************************************************************
+// Function:     ClQueryDepthSList
+// Description:  Returns the number of entries in the list, it may be stale by
+//               the time the caller uses it.
+// Returns:      DWORD
+// Parameter:    IN PCL_INTERLOCKED_SLIST_HEADER ListHead
+//******************************************************************************
+DWORD
+ClQueryDepthSList(
+    IN      PCL_INTERLOCKED_SLIST_HEADER    ListHead
+    );
+
+//******************************************************************************
+// Function:     ClMpscQueueInit
+// Description:  Initializes an empty queue.
+// Returns:      void
+// Parameter:    OUT PCL_MPSC_QUEUE Queue
+//******************************************************************************
+void
+ClMpscQueueInit(
+    OUT     PCL_MPSC_QUEUE                  Queue
+    );
+
+//******************************************************************************
+// Function:     ClMpscQueuePush
+// Description:  Appends an entry to the queue, may be called concurrently
+//               from any number of CPUs.
+// Returns:      void
+// Parameter:    INOUT PCL_MPSC_QUEUE Queue
+// Parameter:    INOUT PCL_SLIST_ENTRY Entry
+//******************************************************************************
+void
+ClMpscQueuePush(
+    INOUT   PCL_MPSC_QUEUE                  Queue,
+    INOUT   PCL_SLIST_ENTRY                 Entry
+    );
+
+//******************************************************************************
+// Function:     ClMpscQueuePop
+// Description:  Removes the oldest entry of the queue, only a single CPU at a
+//               time may call it.
+// Returns:      PCL_SLIST_ENTRY - The entry removed, NULL if the queue is empty
+// Parameter:    INOUT PCL_MPSC_QUEUE Queue
+// NOTE:         A producer links its entry right after exchanging the tail, if
+//               it was interrupted in between NULL is returned even if there
+//               are entries after it. Producers should wake the consumer only
+//               after the push returned.
+//******************************************************************************
+PTR_SUCCESS
+PCL_SLIST_ENTRY
+ClMpscQueuePop(
+    INOUT   PCL_MPSC_QUEUE                  Queue
+    );
+
+//******************************************************************************
+// Function:     ClMpscQueueIsEmpty
+// Description:  Checks if there is no entry in the queue, only the consumer
+//               may call it.
+// Returns:      BOOLEAN
+// Parameter:    IN PCL_MPSC_QUEUE Queue
+//******************************************************************************
+BOOLEAN
+ClMpscQueueIsEmpty(
+    IN      PCL_MPSC_QUEUE                  Queue
+    );
+C_HEADER_END
\ No newline at end of file
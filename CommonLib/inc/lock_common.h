@@ -5,6 +5,7 @@
 #include "monlock.h"
 #include "rw_spinlock.h"
 #include "rec_rw_spinlock.h"
+#include "seqlock.h"
 
 typedef
 INTR_STATE
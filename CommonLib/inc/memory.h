@@ -18,6 +18,27 @@ memset(
 
 #define memzero(addr,size)      memset((addr),0,(size))
 
+//******************************************************************************
+// Function:     memsetnt
+// Description:  Same as memset, however the data written bypasses the caches.
+//               Use it for buffers which will not be accessed soon, e.g.
+//               frames zeroed ahead of time. memset also switches to
+//               non-temporal stores for very large buffers.
+// Returns:      void
+// Parameter:    OUT PVOID address
+// Parameter:    IN BYTE value
+// Parameter:    IN DWORD size
+//******************************************************************************
+_At_buffer_( address, i, size, _Post_satisfies_( ((PBYTE)address)[i] == value ))
+void
+memsetnt(
+    OUT_WRITES_BYTES_ALL(size)  PVOID address,
+    IN                          BYTE value,
+    IN                          DWORD size
+    );
+
+#define memzeront(addr,size)    memsetnt((addr),0,(size))
+
 //******************************************************************************
 // Function:     memcpy
 // Description:  This function does not guarantee proper handling of overlapped
@@ -36,10 +57,27 @@ memcpy(
     IN                          QWORD   Count
     );
 
+//******************************************************************************
+// Function:     memcpynt
+// Description:  Same as memcpy, however the data written bypasses the caches,
+//               see memsetnt.
+// Returns:      void
+// Parameter:    OUT PVOID Destination
+// Parameter:    IN PVOID Source
+// Parameter:    IN QWORD Count
+//******************************************************************************
+_At_buffer_(Destination,i, Count,
+            _Post_satisfies_(((PBYTE)Destination)[i] == ((PBYTE)Source)[i]))
+void
+memcpynt(
+    OUT_WRITES_BYTES_ALL(Count) PVOID   Destination,
+    IN_READS(Count)             PVOID   Source,
+    IN                          QWORD   Count
+    );
+
 //******************************************************************************
 // Function:     memmove
-// Description:  Executes slower than memcpy but it can be used for overlapped
-//               memory regions.
+// Description:  Can be used for overlapped memory regions.
 // Returns:      void
 // Parameter:    OUT PVOID Destination
 // Parameter:    IN PVOID Source
@@ -87,4 +125,64 @@ memscan(
     IN_READS_BYTES(size)    PVOID buffer,
     IN                      DWORD size,
     IN                      BYTE  value
+    );
+
+//******************************************************************************
+// Function:     memchecksum
+// Description:  Computes the 16-bit ones-complement sum (RFC 1071) of a memory
+//               region. The result is NOT complemented so it can be passed as
+//               the InitialSum of a subsequent call, allowing discontiguous
+//               regions (e.g. pseudo-header + payload) to be checksummed. All
+//               regions except the last one must have an even size.
+//               Uses AVX2 or SSE2 when available.
+// Returns:      WORD - Folded ones-complement sum, use CHECKSUM_FINALIZE to
+//               obtain the value to place in a header.
+// Parameter:    IN PVOID buffer
+// Parameter:    IN DWORD size
+// Parameter:    IN WORD InitialSum - 0 or the result of a previous call
+//******************************************************************************
+WORD
+memchecksum(
+    IN_READS_BYTES(size)    PVOID   buffer,
+    IN                      DWORD   size,
+    IN                      WORD    InitialSum
+    );
+
+#define CHECKSUM_FINALIZE(PartialSum)       ((WORD)~(PartialSum))
+
+//******************************************************************************
+// Function:     memcpychecksum
+// Description:  Copies Count bytes from Source to Destination and computes
+//               the ones-complement sum of the copied data in the same pass.
+//               The same overlapping restrictions as for memcpy apply.
+// Returns:      WORD - Folded ones-complement sum, see memchecksum
+// Parameter:    OUT PVOID Destination
+// Parameter:    IN PVOID Source
+// Parameter:    IN QWORD Count
+// Parameter:    IN WORD InitialSum
+//******************************************************************************
+WORD
+memcpychecksum(
+    OUT_WRITES_BYTES_ALL(Count) PVOID   Destination,
+    IN_READS(Count)             PVOID   Source,
+    IN                          QWORD   Count,
+    IN                          WORD    InitialSum
+    );
+
+//******************************************************************************
+// Function:     memchecksumupdate
+// Description:  Incrementally updates a finalized checksum after a 16-bit
+//               field covered by it changed from OldValue to NewValue
+//               (RFC 1624). All values are in the same byte order as the
+//               data they were computed over.
+// Returns:      WORD - The new finalized checksum
+// Parameter:    IN WORD Checksum
+// Parameter:    IN WORD OldValue
+// Parameter:    IN WORD NewValue
+//******************************************************************************
+WORD
+memchecksumupdate(
+    IN                      WORD    Checksum,
+    IN                      WORD    OldValue,
+    IN                      WORD    NewValue
     );
\ No newline at end of file
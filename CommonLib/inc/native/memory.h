@@ -4,7 +4,10 @@
 
 #define memset          cl_memset
 #define memzero         cl_memzero
+#define memsetnt        cl_memsetnt
+#define memzeront       cl_memzeront
 #define memcpy          cl_memcpy
+#define memcpynt        cl_memcpynt
 #define memmove         cl_memmove
 #define memcmp          cl_memcmp
 #define memscan         cl_memscan
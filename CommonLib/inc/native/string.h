@@ -13,4 +13,5 @@
 #define snprintf        cl_snprintf
 #define sprintf         cl_sprintf
 #define vsnprintf       cl_vsnprintf
+#define vsnprintfex     cl_vsnprintfex
 #define strtok_s        cl_strtok_s
\ No newline at end of file
@@ -0,0 +1,357 @@
+#pragma once
+//******************************************************************************
+// Open addressing hash table
+//
+//
+// Unlike HASH_TABLE, which chains the colliding elements in a fixed number of
+// buckets, this table keeps all the elements in a single array of slots and
+// grows it as elements are inserted, the average number of slots looked at
+// by a lookup remains small regardless of the number of elements.
+//
+// Collisions are solved with linear probing using the Robin Hood scheme: an
+// element being inserted takes the place of any element which is closer to
+// its home slot than the inserted one is, this keeps the probe lengths even.
+// The 32 bit hash of each element is kept in a separate dense array so most
+// of the slots which don't match are skipped without looking at the keys,
+// the keys themselves are copied in the slots so the elements are never
+// touched by a lookup.
+//
+// When the table becomes 7/8 full a new array twice as large is allocated,
+// the elements are moved to it a few slots at a time by each insertion so no
+// single operation has to move the whole table.
+//
+// The table can be used in two ways:
+//
+// 1. Intrusively, exactly as a HASH_TABLE: each element contains a HASH_ENTRY
+// field and the key is found at OffsetToKey bytes from it. The HASH_ENTRY
+// field itself is not used by this table, it only identifies the element, so
+// switching from HASH_TABLE only requires changing the function calls:
+//
+// OPEN_HASH_TABLE hashTable;
+//
+// status = OpenHashTableInit(&hashTable,
+//                            0,
+//                            sizeof(WORD),
+//                            NULL,
+//                            FIELD_OFFSET(FOO, Id) - FIELD_OFFSET(FOO, HashEntry),
+//                            MyAlloc,
+//                            MyFree,
+//                            NULL);
+//
+// status = OpenHashTableInsert(&hashTable, &pMyData->HashEntry, NULL);
+// pEntry = OpenHashTableLookup(&hashTable, &idToSearchFor);
+// pEntry = OpenHashTableRemove(&hashTable, &idToRemove);
+// OpenHashTableRemoveEntry(&hashTable, &pMyData->HashEntry);
+//
+// 2. As a map from keys of up to 8 bytes to pointers, when there is no
+// structure to embed a HASH_ENTRY into:
+//
+// status = OpenHashTableInsertValue(&hashTable, key, pValue, NULL);
+// if (OpenHashTableLookupValue(&hashTable, key, &pValue)) { ... }
+//
+// The same table must not be used both ways. The iterator works for both, in
+// the second case OpenHashTableIteratorNext returns the value cast to a
+// PHASH_ENTRY, for this reason the values stored cannot be NULL.
+//
+// Insertions can fail if a larger array cannot be allocated, lookups and
+// removals never allocate memory. The table is not synchronized.
+//******************************************************************************
+
+C_HEADER_START
+#include "hash_table.h"
+
+#define OPEN_HASH_TABLE_MIN_CAPACITY            16
+
+typedef struct _OPEN_HASH_SLOT*     POPEN_HASH_SLOT;
+
+//******************************************************************************
+// Function:     FUNC_OpenHashAlloc
+// Description:  Allocates the slot arrays of the table. The memory is freed
+//               with the FUNC_FreeFunction given at initialization.
+// Returns:      PVOID - NULL if the memory could not be allocated
+// Parameter:    IN DWORD Size - number of bytes required, the memory must be
+//               aligned to at least 8 bytes
+// Parameter:    IN_OPT PVOID Context
+//******************************************************************************
+typedef
+PTR_SUCCESS
+PVOID
+(__cdecl FUNC_OpenHashAlloc)(
+    IN      DWORD               Size,
+    IN_OPT  PVOID               Context
+    );
+
+typedef FUNC_OpenHashAlloc*     PFUNC_OpenHashAlloc;
+
+typedef struct _OPEN_HASH_ARRAY
+{
+    // Always a power of 2, 0 if the array is not allocated
+    DWORD                       Capacity;
+
+    DWORD                       NumberOfElements;
+
+    // 0 for the free slots, the hash of the element with the highest bit set
+    // for the used ones
+    PDWORD                      Hashes;
+
+    POPEN_HASH_SLOT             Slots;
+} OPEN_HASH_ARRAY, *POPEN_HASH_ARRAY;
+
+typedef struct _OPEN_HASH_TABLE
+{
+    // Size of the key in bytes, maximum is 8 bytes
+    DWORD                       KeySize;
+
+    // The offset difference in bytes between the HASH_ENTRY and the key, not
+    // used if the table stores values
+    INT32                       OffsetToKey;
+
+    // Optional, the result is mixed again before being used
+    PFUNC_HashFunction          HashFunc;
+
+    PFUNC_OpenHashAlloc         AllocFunc;
+    PFUNC_FreeFunction          FreeFunc;
+    PVOID                       AllocContext;
+
+    // The array new elements are inserted into
+    OPEN_HASH_ARRAY             Current;
+
+    // While growing, the array whose elements are still being moved to
+    // Current, the slots before MigrationIndex are all free
+    OPEN_HASH_ARRAY             Previous;
+    DWORD                       MigrationIndex;
+} OPEN_HASH_TABLE, *POPEN_HASH_TABLE;
+
+typedef struct _OPEN_HASH_ITERATOR
+{
+    POPEN_HASH_TABLE            HashTable;
+
+    // The previous array is walked first, then the current one
+    POPEN_HASH_ARRAY            Array;
+
+    // Each array is walked starting after a free slot, the elements moved back
+    // when an element is removed are then never moved over that slot
+    DWORD                       Index;
+    DWORD                       SlotsLeft;
+
+    // The key of the element returned last, if it is no longer in its slot
+    // the element was removed and the slot is looked at again
+    QWORD                       LastKey;
+    BOOLEAN                     LastKeyValid;
+} OPEN_HASH_ITERATOR, *POPEN_HASH_ITERATOR;
+
+//******************************************************************************
+// Function:     OpenHashTableInit
+// Description:  Initializes an empty hash table with room for at least
+//               InitialCapacity elements before it needs to grow.
+// Returns:      STATUS
+// Parameter:    OUT POPEN_HASH_TABLE HashTable
+// Parameter:    IN DWORD InitialCapacity - may be 0
+// Parameter:    IN DWORD KeySize - The length in bytes of a key
+// Parameter:    IN_OPT PFUNC_HashFunction HashFunction - If NULL the key
+//               itself is mixed. It is called with MaxKeys set to MAX_DWORD,
+//               HashFuncUniversal only returns 10007 distinct values and
+//               should not be used.
+// Parameter:    IN INT32 OffsetToKey - see HashTableInit, ignored if the table
+//               is used to store values
+// Parameter:    IN PFUNC_OpenHashAlloc AllocFunction
+// Parameter:    IN PFUNC_FreeFunction FreeFunction
+// Parameter:    IN_OPT PVOID AllocContext - passed to the allocation functions
+//******************************************************************************
+SAL_SUCCESS
+STATUS
+OpenHashTableInit(
+    OUT     POPEN_HASH_TABLE    HashTable,
+    IN      DWORD               InitialCapacity,
+    IN      DWORD               KeySize,
+    IN_OPT  PFUNC_HashFunction  HashFunction,
+    IN      INT32               OffsetToKey,
+    IN      PFUNC_OpenHashAlloc AllocFunction,
+    IN      PFUNC_FreeFunction  FreeFunction,
+    IN_OPT  PVOID               AllocContext
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableUninit
+// Description:  Frees the memory used by the table, the elements still found
+//               in it are not touched.
+// Returns:      void
+// Parameter:    INOUT POPEN_HASH_TABLE HashTable
+//******************************************************************************
+void
+OpenHashTableUninit(
+    INOUT   POPEN_HASH_TABLE    HashTable
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableClear
+// Description:  Removes all the elements from the hash table, optionally
+//               calling a free function for each element: this function
+//               receives a pointer to the HASH_ENTRY field of the element or
+//               the value stored.
+// Returns:      void
+// Parameter:    INOUT POPEN_HASH_TABLE HashTable
+// Parameter:    IN_OPT PFUNC_FreeFunction FreeFunction
+// Parameter:    IN_OPT PVOID FreeContext
+//******************************************************************************
+void
+OpenHashTableClear(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN_OPT  PFUNC_FreeFunction  FreeFunction,
+    IN_OPT  PVOID               FreeContext
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableSize
+// Description:
+// Returns:      DWORD - Number of elements in the hash table
+// Parameter:    IN POPEN_HASH_TABLE HashTable
+//******************************************************************************
+DWORD
+OpenHashTableSize(
+    IN      POPEN_HASH_TABLE    HashTable
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableInsert
+// Description:  Inserts a new element into the hash table, replacing the
+//               element with the same key if one exists.
+// Returns:      STATUS - STATUS_HEAP_INSUFFICIENT_RESOURCES if the table had
+//               to grow and the memory could not be allocated
+// Parameter:    INOUT POPEN_HASH_TABLE HashTable
+// Parameter:    INOUT PHASH_ENTRY Element
+// Parameter:    OUT_OPT PHASH_ENTRY* PreviousElement - receives the replaced
+//               element, NULL if there was none
+//******************************************************************************
+SAL_SUCCESS
+STATUS
+OpenHashTableInsert(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    INOUT   PHASH_ENTRY         Element,
+    OUT_OPT PHASH_ENTRY*        PreviousElement
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableRemove
+// Description:  Removes from the hash table the element with key Key.
+// Returns:      PHASH_ENTRY - Pointer to the HASH_ENTRY field in the found
+//                             element
+//                             NULL if no element with Key present
+// Parameter:    INOUT POPEN_HASH_TABLE HashTable
+// Parameter:    IN PHASH_KEY Key
+//******************************************************************************
+PTR_SUCCESS
+PHASH_ENTRY
+OpenHashTableRemove(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      PHASH_KEY           Key
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableRemoveEntry
+// Description:  Removes an element from the hash table.
+// Returns:      void
+// Parameter:    INOUT POPEN_HASH_TABLE HashTable
+// Parameter:    IN PHASH_ENTRY Element - must be in the table
+//******************************************************************************
+void
+OpenHashTableRemoveEntry(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      PHASH_ENTRY         Element
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableLookup
+// Description:  Searches for the element with key Key in the hash table.
+// Returns:      PHASH_ENTRY - A pointer to the HASH_ENTRY field in the found
+//                             element
+//                             NULL if no element with Key present
+// Parameter:    IN POPEN_HASH_TABLE HashTable
+// Parameter:    IN PHASH_KEY Key
+//******************************************************************************
+PTR_SUCCESS
+PHASH_ENTRY
+OpenHashTableLookup(
+    IN      POPEN_HASH_TABLE    HashTable,
+    IN      PHASH_KEY           Key
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableInsertValue
+// Description:  Maps Key to Value, replacing the previous value if Key was
+//               already present.
+// Returns:      STATUS - STATUS_HEAP_INSUFFICIENT_RESOURCES if the table had
+//               to grow and the memory could not be allocated
+// Parameter:    INOUT POPEN_HASH_TABLE HashTable
+// Parameter:    IN QWORD Key - only the low KeySize bytes are used
+// Parameter:    IN PVOID Value - cannot be NULL
+// Parameter:    OUT_OPT PVOID* PreviousValue - NULL if Key was not present
+//******************************************************************************
+SAL_SUCCESS
+STATUS
+OpenHashTableInsertValue(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key,
+    IN      PVOID               Value,
+    OUT_OPT PVOID*              PreviousValue
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableRemoveValue
+// Description:  Removes Key from the hash table.
+// Returns:      BOOLEAN - FALSE if Key was not present
+// Parameter:    INOUT POPEN_HASH_TABLE HashTable
+// Parameter:    IN QWORD Key
+// Parameter:    OUT_OPT PVOID* Value - the value Key was mapped to
+//******************************************************************************
+BOOLEAN
+OpenHashTableRemoveValue(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key,
+    OUT_OPT PVOID*              Value
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableLookupValue
+// Description:  Searches for Key in the hash table.
+// Returns:      BOOLEAN - FALSE if Key is not present
+// Parameter:    IN POPEN_HASH_TABLE HashTable
+// Parameter:    IN QWORD Key
+// Parameter:    OUT_OPT PVOID* Value - the value Key is mapped to
+//******************************************************************************
+BOOLEAN
+OpenHashTableLookupValue(
+    IN      POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key,
+    OUT_OPT PVOID*              Value
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableIteratorInit
+// Description:  Initializes an iterator over the hash table.
+// Returns:      void
+// Parameter:    IN POPEN_HASH_TABLE HashTable
+// Parameter:    OUT POPEN_HASH_ITERATOR HashIterator
+// NOTE:         There is no guarantee regarding the order in which the hash
+//               table is traversed. The element returned by the iterator can
+//               be removed, no element may be inserted while iterating.
+//******************************************************************************
+void
+OpenHashTableIteratorInit(
+    IN      POPEN_HASH_TABLE    HashTable,
+    OUT     POPEN_HASH_ITERATOR HashIterator
+    );
+
+//******************************************************************************
+// Function:     OpenHashTableIteratorNext
+// Description:  Returns the next element in the hash table.
+// Returns:      PHASH_ENTRY - A pointer to the HASH_ENTRY field in the found
+//                             element, or the value stored
+//                             NULL if there are no more elements
+// Parameter:    INOUT POPEN_HASH_ITERATOR HashIterator
+//******************************************************************************
+PHASH_ENTRY
+OpenHashTableIteratorNext(
+    INOUT   POPEN_HASH_ITERATOR HashIterator
+    );
+C_HEADER_END
\ No newline at end of file
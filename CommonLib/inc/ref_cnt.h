@@ -1,5 +1,9 @@
 #pragma once
 
+#include "interlocked_list.h"
+
+C_HEADER_START
+
 //******************************************************************************
 // Function:     FUNC_FreeFunction
 // Description:  Function called when the ReferenceCount of the object reaches 0
@@ -16,12 +20,46 @@ void
 
 typedef FUNC_FreeFunction*      PFUNC_FreeFunction;
 
+// Added to the shared count of a biased object for as long as it is biased,
+// the shared count can't reach 0 while the owner still holds references
+#define RFC_OWNER_BIAS          0x4000'0000UL
+
+#pragma warning(push)
+
+// warning C4324: structure was padded due to alignment specifier
+#pragma warning(disable:4324)
+
+// A biased object is referenced and dereferenced by its owner without
+// interlocked operations. The caller must ensure a single context acts as a
+// given owner at a time, e.g. a CPU with interrupts disabled.
+typedef struct _RFC_OWNER
+{
+    // Objects which were dereferenced by someone else than their owner, they
+    // are pushed by any CPU and removed by RfcOwnerProcessMergeRequests
+    CL_INTERLOCKED_SLIST_HEADER MergeRequests;
+} RFC_OWNER, *PRFC_OWNER;
+#pragma warning(pop)
+
 #pragma pack(push,16)
 typedef struct _REF_COUNT
 {
+    // Shared count, only updated with interlocked operations. It includes
+    // RFC_OWNER_BIAS while Owner is set.
     volatile DWORD              ReferenceCount;
     PFUNC_FreeFunction          FreeFunction;
     PVOID                       Context;
+
+    // NULL if the object was not biased or if the owner merged its references
+    // into the shared count
+    PRFC_OWNER volatile         Owner;
+
+    // References held by the owner, only accessed by the owner
+    DWORD                       BiasedCount;
+
+    // Set by the first dereference done by someone else than the owner, the
+    // dereferenced reference is handed to the owner with the merge request
+    volatile BYTE               MergeRequested;
+    CL_SLIST_ENTRY              MergeEntry;
 } REF_COUNT, *PREF_COUNT;
 #pragma pack(pop)
 
@@ -46,6 +84,29 @@ RfcInit(
     IN_OPT  PVOID                   Context
     );
 
+//******************************************************************************
+// Function:     RfcInitBiased
+// Description:  Initializes a reference counted object biased towards Owner.
+//               The initial reference belongs to the owner.
+// Returns:      STATUS
+// Parameter:    OUT REF_COUNT * Object
+// Parameter:    IN_OPT PFUNC_FreeFunction FreeFunction
+// Parameter:    IN_OPT PVOID Context
+// Parameter:    IN PRFC_OWNER Owner
+// NOTE:         Meant for objects which are mostly referenced and
+//               dereferenced by the same owner. The first time someone else
+//               dereferences the object the owner is asked to merge its
+//               references into the shared count, from then on the object
+//               behaves as one initialized with RfcInit.
+//******************************************************************************
+STATUS
+RfcInitBiased(
+    OUT     REF_COUNT*              Object,
+    IN_OPT  PFUNC_FreeFunction      FreeFunction,
+    IN_OPT  PVOID                   Context,
+    IN      PRFC_OWNER              Owner
+    );
+
 //******************************************************************************
 // Function:     RfcReference
 // Description:  Increments the reference count of the object
@@ -68,4 +129,98 @@ SIZE_SUCCESS
 DWORD
 RfcDereference(
     INOUT   REF_COUNT*              Object
-    );
\ No newline at end of file
+    );
+
+//******************************************************************************
+// Function:     RfcReferenceEx
+// Description:  Increments the reference count of the object. If the object
+//               is biased towards CurrentOwner no interlocked operation is
+//               done.
+// Returns:      DWORD - Current reference count of the object, for a biased
+//               object the value is only a snapshot
+// Parameter:    INOUT REF_COUNT * Object
+// Parameter:    IN_OPT PRFC_OWNER CurrentOwner - owner the caller acts as,
+//               NULL is the same as calling RfcReference
+//******************************************************************************
+SIZE_SUCCESS
+DWORD
+RfcReferenceEx(
+    INOUT   REF_COUNT*              Object,
+    IN_OPT  PRFC_OWNER              CurrentOwner
+    );
+
+//******************************************************************************
+// Function:     RfcDereferenceEx
+// Description:  Decrements the reference count of the object. If the object
+//               is biased towards CurrentOwner no interlocked operation is
+//               done, unless this was the last reference of the owner.
+// Returns:      DWORD - Current reference count of the object, for a biased
+//               object the value is only a snapshot
+// Parameter:    INOUT REF_COUNT * Object
+// Parameter:    IN_OPT PRFC_OWNER CurrentOwner - owner the caller acts as,
+//               NULL is the same as calling RfcDereference
+//******************************************************************************
+SIZE_SUCCESS
+DWORD
+RfcDereferenceEx(
+    INOUT   REF_COUNT*              Object,
+    IN_OPT  PRFC_OWNER              CurrentOwner
+    );
+
+//******************************************************************************
+// Function:     RfcDereferenceNoFree
+// Description:  Same as RfcDereferenceEx, except the object is not freed when
+//               its last reference is dropped, the caller must then call
+//               RfcFree.
+// Returns:      BOOLEAN - TRUE if the last reference of the object was dropped
+// Parameter:    INOUT REF_COUNT * Object
+// Parameter:    IN_OPT PRFC_OWNER CurrentOwner
+// NOTE:         Meant for owners which can only act as the owner in a
+//               restricted context (e.g. with interrupts disabled) in which
+//               the free function can't run.
+//******************************************************************************
+BOOLEAN
+RfcDereferenceNoFree(
+    INOUT   REF_COUNT*              Object,
+    IN_OPT  PRFC_OWNER              CurrentOwner
+    );
+
+//******************************************************************************
+// Function:     RfcFree
+// Description:  Calls the free function of an object whose last reference
+//               was dropped by RfcDereferenceNoFree.
+// Returns:      void
+// Parameter:    INOUT REF_COUNT * Object
+//******************************************************************************
+void
+RfcFree(
+    INOUT   REF_COUNT*              Object
+    );
+
+//******************************************************************************
+// Function:     RfcOwnerInit
+// Description:  Initializes an owner of biased objects.
+// Returns:      void
+// Parameter:    OUT PRFC_OWNER Owner - must be 16 byte aligned
+//******************************************************************************
+void
+RfcOwnerInit(
+    OUT     PRFC_OWNER              Owner
+    );
+
+//******************************************************************************
+// Function:     RfcOwnerProcessMergeRequests
+// Description:  Merges into the shared counts the references held by the
+//               owner on the objects dereferenced by someone else and drops
+//               the references handed over with the requests. The objects
+//               which no longer have references are freed.
+// Returns:      void
+// Parameter:    INOUT PRFC_OWNER Owner
+// NOTE:         Must be called by the owner, until it is called the objects
+//               for which merges were requested are not freed.
+//******************************************************************************
+void
+RfcOwnerProcessMergeRequests(
+    INOUT   PRFC_OWNER              Owner
+    );
+C_HEADER_END
\ No newline at end of file
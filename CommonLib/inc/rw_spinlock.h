@@ -1,14 +1,32 @@
 #pragma once
 
 #pragma pack(push,16)
+#pragma warning(push)
+
+// warning C4201: nonstandard extension used: nameless struct/union
+#pragma warning(disable:4201)
+
+// The readers and the writers exchange a DWORD spanning two of the counters
+// so the counters can't be moved to separate cache lines. Instead the lock is
+// QWORD aligned so the counters never straddle two cache lines, an exchange
+// crossing a cache line locks the bus.
 typedef struct _RW_SPINLOCK
 {
-    volatile WORD   WaitingWriters;
-    volatile WORD   ActiveWriter;
-    volatile WORD   ActiveReaders;
+    union
+    {
+        struct
+        {
+            volatile WORD   WaitingWriters;
+            volatile WORD   ActiveWriter;
+            volatile WORD   ActiveReaders;
+        };
+        QWORD               __Alignment;
+    };
 } RW_SPINLOCK, *PRW_SPINLOCK;
 STATIC_ASSERT(FIELD_OFFSET(RW_SPINLOCK,WaitingWriters) + sizeof(WORD) == FIELD_OFFSET(RW_SPINLOCK, ActiveWriter));
 STATIC_ASSERT(FIELD_OFFSET(RW_SPINLOCK,ActiveWriter) + sizeof(WORD) == FIELD_OFFSET(RW_SPINLOCK, ActiveReaders));
+STATIC_ASSERT(__alignof(RW_SPINLOCK) == sizeof(QWORD) && CACHE_LINE_SIZE % sizeof(QWORD) == 0);
+#pragma warning(pop)
 #pragma pack(pop)
 
 void
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "spinlock.h"
+
+// Sequence lock for small, rarely written data. The writers serialize on a
+// spinlock and keep the sequence odd while they update the data. The readers
+// never write to the lock: they copy the data and retry if the sequence
+// changed meanwhile, the copy may be torn and must not be used until
+// SeqlockReadRetry returns FALSE.
+#pragma pack(push,16)
+typedef struct _SEQLOCK
+{
+    volatile DWORD      Sequence;
+
+    SPINLOCK            WriterLock;
+} SEQLOCK, *PSEQLOCK;
+#pragma pack(pop)
+
+//******************************************************************************
+// Function:     SeqlockInit
+// Description:  Initializes a sequence lock.
+// Returns:      void
+// Parameter:    OUT PSEQLOCK Seqlock
+//******************************************************************************
+void
+SeqlockInit(
+    OUT     PSEQLOCK        Seqlock
+    );
+
+//******************************************************************************
+// Function:     SeqlockReadBegin
+// Description:  Waits for the writer in progress, if any, and returns the
+//               sequence to pass to SeqlockReadRetry after copying the data.
+// Returns:      DWORD
+// Parameter:    IN PSEQLOCK Seqlock
+//******************************************************************************
+DWORD
+SeqlockReadBegin(
+    IN      PSEQLOCK        Seqlock
+    );
+
+//******************************************************************************
+// Function:     SeqlockReadRetry
+// Description:  Checks if a writer updated the data since SeqlockReadBegin.
+// Returns:      BOOLEAN - TRUE if the data read must be discarded and read
+//               again
+// Parameter:    IN PSEQLOCK Seqlock
+// Parameter:    IN DWORD Sequence - value returned by SeqlockReadBegin
+//******************************************************************************
+BOOLEAN
+SeqlockReadRetry(
+    IN      PSEQLOCK        Seqlock,
+    IN      DWORD           Sequence
+    );
+
+//******************************************************************************
+// Function:     SeqlockWriteAcquire
+// Description:  Serializes with the other writers and marks the data as being
+//               updated. On return interrupts are disabled and IntrState holds
+//               the previous interruptibility state.
+// Returns:      void
+// Parameter:    INOUT PSEQLOCK Seqlock
+// Parameter:    OUT INTR_STATE* IntrState
+//******************************************************************************
+REQUIRES_NOT_HELD_LOCK(*Seqlock)
+ACQUIRES_EXCL_AND_NON_REENTRANT_LOCK(*Seqlock)
+void
+SeqlockWriteAcquire(
+    INOUT   PSEQLOCK        Seqlock,
+    OUT     INTR_STATE*     IntrState
+    );
+
+//******************************************************************************
+// Function:     SeqlockWriteRelease
+// Description:  Publishes the updated data and lets the next writer in.
+// Returns:      void
+// Parameter:    INOUT PSEQLOCK Seqlock
+// Parameter:    IN INTR_STATE IntrState
+//******************************************************************************
+REQUIRES_EXCL_LOCK(*Seqlock)
+RELEASES_EXCL_AND_NON_REENTRANT_LOCK(*Seqlock)
+void
+SeqlockWriteRelease(
+    INOUT   PSEQLOCK        Seqlock,
+    IN      INTR_STATE      IntrState
+    );
\ No newline at end of file
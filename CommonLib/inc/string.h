@@ -134,6 +134,17 @@ vsnprintf(
     INOUT                   va_list     argptr
     );
 
+// Same as vsnprintf, also returns the number of characters written to
+// outputBuffer without the NULL terminator, even if the buffer was too small.
+STATUS
+vsnprintfex(
+    OUT_WRITES(buffSize)    char*       outputBuffer,
+    IN                      DWORD       buffSize,
+    IN_Z                    char*       inputBuffer,
+    INOUT                   va_list     argptr,
+    OUT_OPT                 DWORD*      length
+    );
+
 const
 char*
 strtok_s(
@@ -19,7 +19,8 @@
 //                specified base.
 //                If the number digits occupied by value in base Base is under
 //                MinimumDigits then the rest is completed with leading zeros.
-// Returns:       void
+// Returns:       DWORD - Number of characters written, without the NULL
+//                terminator
 // Parameter:     IN PVOID valueAddress - Pointer to the number to convert
 // Parameter:     IN BOOLEAN signedValue - If set the value is signed, else unsigned
 // Parameter:     OUT char * buffer - Buffer in which to write the number
@@ -29,8 +30,8 @@
 // Parameter:     IN BOOLEAN is64BitValue - If set the value is treated as a 64bit 
 //                value
 //******************************************************************************
-void 
-itoa( 
+DWORD
+itoa(
     IN      PVOID       valueAddress,
     IN      BOOLEAN     signedValue,
     OUT_Z   char*       buffer,
@@ -1,10 +1,28 @@
 #include "common_lib.h"
 #include "bitmap.h"
+#include <intrin.h>
 
 // we defined BITMAP_ENTRY_BITS directly to 32 so as not to call
 // BITS_FOR_STRUCTURE for each index calculation
 #define BITMAP_ENTRY_BITS           8
 
+// the buffer is still addressed in bytes, the scans load it a QWORD at a
+// time: bit i of the bitmap is bit (i % 64) of QWORD (i / 64) on a little
+// endian CPU
+#define BITMAP_WORD_BITS            64
+
+#define CPUID_LEAF_FEATURE_INFORMATION          0x1
+#define CPUID_FEAT_ECX_POPCNT                   (1UL<<23)
+
+typedef enum _BITMAP_POPCNT_SUPPORT
+{
+    BitmapPopcntUnknown = 0,
+    BitmapPopcntMissing,
+    BitmapPopcntAvailable
+} BITMAP_POPCNT_SUPPORT;
+
+static volatile BITMAP_POPCNT_SUPPORT m_bitmapPopcntSupport = BitmapPopcntUnknown;
+
 static
 void
 _BitmapChangeBit(
@@ -40,6 +58,43 @@ _BitmapScanInternal(
     IN          BOOLEAN     Set
     );
 
+static
+DWORD
+_BitmapPopcount(
+    IN          QWORD       Value
+    );
+
+__forceinline
+static
+QWORD
+_BitmapGetWord(
+    IN          PBITMAP     Bitmap,
+    IN          DWORD       WordIndex
+    )
+{
+    DWORD byteIndex;
+    QWORD word;
+
+    byteIndex = WordIndex * sizeof(QWORD);
+
+    if (Bitmap->BufferSize - byteIndex >= sizeof(QWORD))
+    {
+        // x64 tolerates unaligned loads, the buffers are not required to be
+        // QWORD aligned
+        return *(QWORD*) (Bitmap->BitmapBuffer + byteIndex);
+    }
+
+    // the buffer size is not necessarily a multiple of QWORDs, we must not
+    // read past its end
+    word = 0;
+    for (DWORD i = 0; byteIndex + i < Bitmap->BufferSize; ++i)
+    {
+        word = word | ((QWORD) Bitmap->BitmapBuffer[byteIndex + i] << (i * BITS_PER_BYTE));
+    }
+
+    return word;
+}
+
 DWORD
 BitmapPreinit(
     OUT         PBITMAP     Bitmap,
@@ -247,6 +302,91 @@ BitmapScanFromToAndFlip(
     return bitmapIndex;
 }
 
+SIZE_SUCCESS
+DWORD
+BitmapScanNextFitAndFlip(
+    INOUT       PBITMAP     Bitmap,
+    IN          DWORD       Index,
+    IN          DWORD       ConsecutiveBits,
+    IN          BOOLEAN     Set
+    )
+{
+    DWORD bitmapIndex;
+    DWORD hint;
+    DWORD wrapEnd;
+
+    if (NULL == Bitmap)
+    {
+        return MAX_DWORD;
+    }
+
+    if (0 == ConsecutiveBits)
+    {
+        return MAX_DWORD;
+    }
+
+    if (Index > Bitmap->BitCount)
+    {
+        return MAX_DWORD;
+    }
+
+    hint = max(Index, Bitmap->NextFitHint);
+    if (hint >= Bitmap->BitCount)
+    {
+        hint = Index;
+    }
+
+    bitmapIndex = _BitmapScanInternal(Bitmap, hint, Bitmap->BitCount, ConsecutiveBits, Set);
+    if (MAX_DWORD == bitmapIndex && hint != Index)
+    {
+        // the runs which start before the hint may end after it
+        wrapEnd = (Bitmap->BitCount - hint > ConsecutiveBits - 1) ? hint + ConsecutiveBits - 1 : Bitmap->BitCount;
+
+        bitmapIndex = _BitmapScanInternal(Bitmap, Index, wrapEnd, ConsecutiveBits, Set);
+    }
+
+    if (MAX_DWORD == bitmapIndex)
+    {
+        return MAX_DWORD;
+    }
+
+    _BitmapChangeBits(Bitmap->BitmapBuffer, bitmapIndex, !Set, ConsecutiveBits);
+
+    Bitmap->NextFitHint = bitmapIndex + ConsecutiveBits;
+
+    return bitmapIndex;
+}
+
+DWORD
+BitmapCountSetBits(
+    IN          PBITMAP     Bitmap
+    )
+{
+    DWORD noOfWords;
+    DWORD count;
+    QWORD word;
+
+    ASSERT(NULL != Bitmap);
+
+    noOfWords = (DWORD) AlignAddressUpper(Bitmap->BitCount, BITMAP_WORD_BITS) / BITMAP_WORD_BITS;
+    count = 0;
+
+    for (DWORD i = 0; i < noOfWords; ++i)
+    {
+        word = _BitmapGetWord(Bitmap, i);
+
+        // the bits past the end of the bitmap have no meaning
+        if (Bitmap->BitCount - i * BITMAP_WORD_BITS < BITMAP_WORD_BITS)
+        {
+            word = word & ~(MAX_QWORD << (Bitmap->BitCount - i * BITMAP_WORD_BITS));
+        }
+
+        count = count + _BitmapPopcount(word);
+    }
+
+    return count;
+}
+
 static
 void
 _BitmapChangeBit(
@@ -283,8 +423,24 @@ _BitmapChangeBits(
     )
 {
     DWORD i;
+    DWORD noOfBytes;
 
-    for (i = 0; i < Count; ++i)
+    // bits up to the first byte boundary
+    for (i = 0; i < Count && 0 != ((Index + i) % BITMAP_ENTRY_BITS); ++i)
+    {
+        _BitmapChangeBit(BitmapBuffer, Index + i, Set);
+    }
+
+    // whole bytes
+    noOfBytes = (Count - i) / BITMAP_ENTRY_BITS;
+    if (0 != noOfBytes)
+    {
+        memset(&BitmapBuffer[(Index + i) / BITMAP_ENTRY_BITS], Set ? MAX_BYTE : 0, noOfBytes);
+        i = i + noOfBytes * BITMAP_ENTRY_BITS;
+    }
+
+    // remaining bits in the last byte
+    for (; i < Count; ++i)
     {
         _BitmapChangeBit(BitmapBuffer, Index + i, Set);
     }
@@ -319,10 +475,14 @@ _BitmapScanInternal(
     IN          BOOLEAN     Set
     )
 {
-    DWORD i, j;
-    DWORD lastIndex;
-    DWORD firstIndex;
-    BOOLEAN found;
+    QWORD word;
+    DWORD wordIndex;
+    DWORD lastWordIndex;
+    DWORD firstBitInWord;
+    DWORD bitInWord;
+    DWORD runStart;
+    DWORD runLength;
+    unsigned long offset;
 
     ASSERT( NULL != Bitmap );
     ASSERT( 0 != ConsecutiveBits );
@@ -335,27 +495,120 @@ _BitmapScanInternal(
         return MAX_DWORD;
     }
 
-    lastIndex = FirstInvalidBitIndex - ConsecutiveBits;
-    firstIndex = StartIndex;
-    found = FALSE;
+    // The bits we look for are turned into ones and the bits outside the
+    // range into zeroes, a run of ones may span any number of words. The
+    // words full of ones or zeroes are handled without looking at their
+    // bits, for the others each run is found with two bit scans.
+    runStart = MAX_DWORD;
+    runLength = 0;
+    lastWordIndex = (FirstInvalidBitIndex - 1) / BITMAP_WORD_BITS;
 
-    for (i = firstIndex; i <= lastIndex; ++i)
+    for (wordIndex = StartIndex / BITMAP_WORD_BITS; wordIndex <= lastWordIndex; ++wordIndex)
     {
-        found = TRUE;
-        for (j = 0; j < ConsecutiveBits; ++j)
+        word = _BitmapGetWord(Bitmap, wordIndex);
+        if (!Set)
+        {
+            word = ~word;
+        }
+
+        firstBitInWord = wordIndex * BITMAP_WORD_BITS;
+        if (firstBitInWord < StartIndex)
+        {
+            word = word & (MAX_QWORD << (StartIndex - firstBitInWord));
+        }
+        if (FirstInvalidBitIndex - firstBitInWord < BITMAP_WORD_BITS)
         {
-            if (Set != _BitmapGetBit(Bitmap->BitmapBuffer, i + j))
+            word = word & ~(MAX_QWORD << (FirstInvalidBitIndex - firstBitInWord));
+        }
+
+        if (MAX_QWORD == word)
+        {
+            if (0 == runLength)
             {
-                found = FALSE;
-                break;
+                runStart = firstBitInWord;
             }
+
+            runLength = runLength + BITMAP_WORD_BITS;
+            if (runLength >= ConsecutiveBits)
+            {
+                return runStart;
+            }
+
+            continue;
         }
 
-        if (found)
+        // the run coming from the previous word stops here
+        if (!IsBooleanFlagOn(word, 1))
         {
-            return i;
+            runLength = 0;
+        }
+
+        bitInWord = 0;
+        while (0 != word)
+        {
+            // skip the zeroes up to the next run
+            _BitScanForward64(&offset, word);
+            word = word >> offset;
+            bitInWord = bitInWord + offset;
+
+            if (0 == runLength)
+            {
+                runStart = firstBitInWord + bitInWord;
+            }
+
+            // the upper bits of the shifted word are zero => there is
+            // always a zero to find unless the whole word was full, which
+            // was handled above
+            _BitScanForward64(&offset, ~word);
+            runLength = runLength + offset;
+            if (runLength >= ConsecutiveBits)
+            {
+                return runStart;
+            }
+
+            bitInWord = bitInWord + offset;
+            if (bitInWord >= BITMAP_WORD_BITS)
+            {
+                // the run may continue in the next word
+                break;
+            }
+
+            word = word >> offset;
+            runLength = 0;
         }
     }
 
     return MAX_DWORD;
+}
+
+static
+DWORD
+_BitmapPopcount(
+    IN          QWORD       Value
+    )
+{
+    int cpuInfo[4];
+    BITMAP_POPCNT_SUPPORT support;
+
+    support = m_bitmapPopcntSupport;
+    if (BitmapPopcntUnknown == support)
+    {
+        __cpuid(cpuInfo, CPUID_LEAF_FEATURE_INFORMATION);
+        support = IsBooleanFlagOn((DWORD)cpuInfo[2], CPUID_FEAT_ECX_POPCNT) ? BitmapPopcntAvailable : BitmapPopcntMissing;
+
+        // benign race: all CPUs will compute the same value
+        m_bitmapPopcntSupport = support;
+    }
+
+    if (BitmapPopcntAvailable == support)
+    {
+        return (DWORD) __popcnt64(Value);
+    }
+
+    // Hacker's Delight 5-1: count the bits in pairs, nibbles, then bytes
+    Value = Value - ((Value >> 1) & 0x5555'5555'5555'5555ULL);
+    Value = (Value & 0x3333'3333'3333'3333ULL) + ((Value >> 2) & 0x3333'3333'3333'3333ULL);
+    Value = (Value + (Value >> 4)) & 0x0F0F'0F0F'0F0F'0F0FULL;
+
+    return (DWORD) ((Value * 0x0101'0101'0101'0101ULL) >> 56);
 }
\ No newline at end of file
@@ -1,7 +1,6 @@
 #include "common_lib.h"
 #include "cl_memory.h"
-
-extern void CpuClearDirectionFlag();
+#include "memory_simd.h"
 
 _At_buffer_( address, i, size, _Post_satisfies_( ((PBYTE)address)[i] == value ))
 void
@@ -11,19 +10,28 @@ cl_memset(
     IN                          DWORD size
     )
 {
-    DWORD i;
-
-    // validate parameters
-    // size validation is done implicitly in the for loop
     if (NULL == address)
     {
         return;
     }
 
-    for (i = 0; i < size; ++i)
+    MemFill(address, value, size, FALSE);
+}
+
+_At_buffer_( address, i, size, _Post_satisfies_( ((PBYTE)address)[i] == value ))
+void
+cl_memsetnt(
+    OUT_WRITES_BYTES_ALL(size)  PVOID address,
+    IN                          BYTE value,
+    IN                          DWORD size
+    )
+{
+    if (NULL == address)
     {
-        ((BYTE*)address)[i] = value;
+        return;
     }
+
+    MemFill(address, value, size, TRUE);
 }
 
 _At_buffer_(Destination, i, Count,
@@ -35,54 +43,29 @@ cl_memcpy(
     IN                          QWORD   Count
     )
 {
-    PBYTE dst;
-    PBYTE src;
-    QWORD alignedCount;
-    QWORD unalignedCount;
-
     if( (NULL == Destination) || (NULL == Source))
     {
         return;
     }
 
-    unalignedCount = Count & 0x7;
-    alignedCount = Count - unalignedCount;
-
-    dst = (PBYTE)Destination;
-    src = (PBYTE)Source;
-
-    if (unalignedCount & 0x4)
-    {
-        *((PDWORD)dst) = *((PDWORD)src);
-        dst = dst + sizeof(DWORD);
-        src = src + sizeof(DWORD);
-    }
-
-    if (unalignedCount & 0x2)
-    {
-        *((PWORD)dst) = *((PWORD)src);
-        dst = dst + sizeof(WORD);
-        src = src + sizeof(WORD);
-    }
+    MemCopyForward(Destination, Source, Count, FALSE);
+}
 
-    if (unalignedCount & 0x1)
+_At_buffer_(Destination, i, Count,
+            _Post_satisfies_(((PBYTE)Destination)[i] == ((PBYTE)Source)[i]))
+void
+cl_memcpynt(
+    OUT_WRITES_BYTES_ALL(Count) PVOID   Destination,
+    IN_READS(Count)             void*   Source,
+    IN                          QWORD   Count
+    )
+{
+    if ((NULL == Destination) || (NULL == Source))
     {
-        *((PBYTE)dst) = *((PBYTE)src);
-        dst = dst + sizeof(BYTE);
-        src = src + sizeof(BYTE);
+        return;
     }
 
-    if (0 != alignedCount)
-    {
-        ASSERT(IsAddressAligned(alignedCount, sizeof(QWORD)));
-
-        dst = (PBYTE)Destination + unalignedCount;
-        src = (PBYTE)Source + unalignedCount;
-
-        CpuClearDirectionFlag();
-
-        __movsq(dst, src, alignedCount / sizeof(QWORD));
-    }
+    MemCopyForward(Destination, Source, Count, TRUE);
 }
 
 _At_buffer_(Destination, i, Count,
@@ -96,7 +79,6 @@ cl_memmove(
 {
     PBYTE dst;
     const BYTE* src;
-    QWORD i;
 
     if ((NULL == Destination) || (NULL == Source))
     {
@@ -106,9 +88,14 @@ cl_memmove(
     dst = Destination;
     src = Source;
 
-    for (i = 0; i < Count; ++i)
+    // only a destination starting inside the source must be copied backwards
+    if (dst > src && dst < src + Count)
     {
-        dst[i] = src[i];
+        MemCopyBackward(dst, src, Count);
+    }
+    else
+    {
+        MemCopyForward(dst, src, Count, FALSE);
     }
 }
 
@@ -119,7 +106,7 @@ cl_memcmp(
     IN                      DWORD size
     )
 {
-    INT64 i = size;
+    QWORD i;
     const BYTE* p1;
     const BYTE* p2;
 
@@ -133,15 +120,9 @@ cl_memcmp(
     p1 = ptr1;
     p2 = ptr2;
 
-    for (i = 0; i < size; ++i)
-    {
-        if (p1[i] != p2[i])
-        {
-            return p1[i] - p2[i];
-        }
-    }
+    i = MemFindDifference(p1, p2, size);
 
-    return 0;
+    return (i == size) ? 0 : p1[i] - p2[i];
 }
 
 int
@@ -183,24 +164,10 @@ cl_memscan(
     IN                      BYTE  value
     )
 {
-    DWORD i;
-    const BYTE* pData;
-
     if (NULL == buffer)
     {
         return 0;
     }
 
-    pData = buffer;
-
-    for (i = 0; i < size; ++i)
-    {
-        if (pData[i] != value)
-        {
-            // game over
-            return i;
-        }
-    }
-
-    return i;
+    return (int)MemFindNotEqual(buffer, value, size);
 }
\ No newline at end of file
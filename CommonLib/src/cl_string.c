@@ -1,6 +1,7 @@
 #include "common_lib.h"
 #include "cl_string.h"
 #include "strutils.h"
+#include "memory_simd.h"
 
 // 64 characters needed in case of %B specifier
 // with NULL terminator => 65 characters are required
@@ -331,21 +332,13 @@ cl_strlen(
     IN_Z  char* str
     )
 {
-    DWORD i;
-
     if (NULL == str)
     {
         return INVALID_STRING_SIZE;
     }
 
-    i = 0;
-
-    while ('\0' != str[i])
-    {
-        ++i;
-    }
-
-    return i;
+    // a valid length must never be confused with INVALID_STRING_SIZE
+    return MemStringLength(str, INVALID_STRING_SIZE - 1);
 }
 
 SIZE_SUCCESS
@@ -356,21 +349,12 @@ cl_strlen_s(
     IN          DWORD   maxLen
     )
 {
-    DWORD i;
-
     if (NULL == str)
     {
         return INVALID_STRING_SIZE;
     }
 
-    i = 0;
-
-    while (i < maxLen && '\0' != str[i])
-    {
-        ++i;
-    }
-
-    return i;
+    return MemStringLength(str, maxLen);
 }
 
 STATUS
@@ -395,14 +379,26 @@ cl_vsnprintf(
     IN_Z                    char*       inputBuffer,
     INOUT                   va_list     argptr
     )
+{
+    return cl_vsnprintfex(outputBuffer, buffSize, inputBuffer, argptr, NULL);
+}
+
+STATUS
+cl_vsnprintfex(
+    OUT_WRITES(buffSize)    char*       outputBuffer,
+    IN                      DWORD       buffSize,
+    IN_Z                    char*       inputBuffer,
+    INOUT                   va_list     argptr,
+    OUT_OPT                 DWORD*      length
+    )
 {
     char temp[VSNPRINTF_BUFFER_SIZE];        // temporary buffer
-    DWORD index;                // index in Buffer
-    DWORD param_index;            // index which we want to find
-    QWORD temp_value;
-    DWORD outBufferOffset;
-    DWORD temp_len;
-    char* temp_str;
+    const char* pFormat;        // current position in the format string
+    const char* pLiteral;
+    char* pOutput;              // current position in the output buffer
+    char* pOutputEnd;           // reserved for the NULL terminator
+    DWORD noOfParameters;
+    STATUS status;
 
     if (NULL == outputBuffer)
     {
@@ -419,156 +415,171 @@ cl_vsnprintf(
         return STATUS_INVALID_PARAMETER3;
     }
 
-    index = 0;
-    param_index = 1;
-    temp_value = 0;
-    outBufferOffset = 0;
-    temp_len = 0;
-    temp_str = temp;
+    pFormat = inputBuffer;
+    pOutput = outputBuffer;
+    pOutputEnd = outputBuffer + buffSize - 1;
+    noOfParameters = 0;
+    status = STATUS_SUCCESS;
+
+#pragma warning(suppress:4127)
+    while (TRUE)
+    {
+        const char* pValue;
+        DWORD valueLength;
+        DWORD charsToCopy;
+        DWORD digits;
+        DWORD fillSpaces;
+        char fillChar;
+        DWORD base;
+        BOOLEAN signedValue;
+        BOOLEAN is64BitValue;
+        QWORD value;
+        char specifier;
+
+        // copy all the characters up to the next specifier at once
+        pLiteral = pFormat;
+        while ('\0' != *pFormat && '%' != *pFormat)
+        {
+            pFormat++;
+        }
 
-    while ('\0' != inputBuffer[index])
-    {
-        if ('%' == inputBuffer[index])
+        valueLength = (DWORD)(pFormat - pLiteral);
+        if (valueLength > (DWORD)(pOutputEnd - pOutput))
         {
-            DWORD digits = 0;
-            DWORD fillSpaces = 0;
-            char next = inputBuffer[index + 1];
-            BOOLEAN firstSpecificator = TRUE;
-            char fillChar = ' ';
-            DWORD charsToCopy;
-
-            while (('0' <= next) && (next <= '9'))
-            {
-                if (firstSpecificator)
-                {
-                    firstSpecificator = FALSE;
-
-                    if ('0' == next)
-                    {
-                        fillChar = '0';
-                    }
-                }
-
-                digits = digits * 10 + next - '0';
-                index++;
-                next = inputBuffer[index + 1];
-            }
+            // copy as much as we have space for
+            valueLength = (DWORD)(pOutputEnd - pOutput);
+            status = STATUS_BUFFER_TOO_SMALL;
+        }
 
+        memcpy(pOutput, (PVOID)pLiteral, valueLength);
+        pOutput = pOutput + valueLength;
 
-            switch (next)
-            {
-            case 'b':
-                // we have an unsigned 32 bit value to print
-                temp_value = va_arg(argptr, DWORD);
-                itoa(&temp_value, FALSE, temp_str, BASE_TWO, FALSE);
-                break;
-            case 'B':
-                // we have an unsigned 64 bit value to print
-                temp_value = va_arg(argptr, QWORD);
-                itoa(&temp_value, FALSE, temp_str, BASE_TWO, TRUE);
-                break;
-            case 'u':
-                // we have an unsigned 32 bit value to print
-                temp_value = va_arg(argptr, DWORD);
-                itoa(&temp_value, FALSE, temp_str, BASE_TEN, FALSE);
-                break;
-            case 'U':
-                // we have an unsigned 64 bit value to print
-                temp_value = va_arg(argptr, QWORD);
-                itoa(&temp_value, FALSE, temp_str, BASE_TEN, TRUE);
-                break;
-            case 'd':
-                // we have a signed 32 bit value to print
-                temp_value = va_arg(argptr, DWORD);
-                itoa(&temp_value, TRUE, temp_str, BASE_TEN, FALSE);
-                break;
-            case 'D':
-                // we have a signed 64 bit value
-                temp_value = va_arg(argptr, QWORD);
-                itoa(&temp_value, TRUE, temp_str, BASE_TEN, TRUE);
-                break;
-            case 'x':
-                // we have a 32 bit hexadecimal value to print
-                temp_value = va_arg(argptr, DWORD);
-                itoa(&temp_value, FALSE, temp_str, BASE_HEXA, FALSE);
-                break;
-            case 'X':
-                // we have a 64 bit hexadecimal value to print
-                temp_value = va_arg(argptr, QWORD);
-                itoa(&temp_value, FALSE, temp_str, BASE_HEXA, TRUE);
-                break;
-            case 'c':
-                // we have a character value to print
-                temp_value = va_arg(argptr, char);
-                cl_strncpy(temp_str, (char*)&temp_value, sizeof(char));
-                break;
-            case 's':
-            case 'S':
-                // we have a string to print
-                temp_str = va_arg(argptr, char*);
-                break;
-            default:
-                // A parsing error - an incorrect string was supplied =>
-                // return a status error
-                return STATUS_PARSE_FAILED;
-            }
+        if (!SUCCEEDED(status) || '\0' == *pFormat)
+        {
+            break;
+        }
 
-            temp_len = strlen(temp_str);
-            ASSERT(temp_len != INVALID_STRING_SIZE);
+        // skip the '%'
+        pFormat++;
 
-            charsToCopy = (next == 'S') ? min(digits, temp_len) : temp_len;
+        digits = 0;
+        fillChar = ('0' == *pFormat) ? '0' : ' ';
 
-            if (outBufferOffset + temp_len >= buffSize)
-            {
-                // we don't have any more space
-                return STATUS_BUFFER_TOO_SMALL;
-            }
-            // see if we need to pad the string with spaces or with digits
-            fillSpaces = digits > temp_len ? digits - temp_len : 0;
-            if (outBufferOffset + temp_len + fillSpaces >= buffSize)
-            {
-                // we don't have any more space
-                return STATUS_BUFFER_TOO_SMALL;
-            }
-            if (0 != fillSpaces)
-            {
-                // put spaces
-                cl_memset(outputBuffer + outBufferOffset, fillChar, fillSpaces);
-                outBufferOffset = outBufferOffset + fillSpaces;
-            }
+        while (('0' <= *pFormat) && (*pFormat <= '9'))
+        {
+            digits = digits * 10 + *pFormat - '0';
+            pFormat++;
+        }
 
-            if (charsToCopy != 0)
-            {
-                cl_strncpy(outputBuffer + outBufferOffset, temp_str, charsToCopy);
-            }
-            outBufferOffset = outBufferOffset + charsToCopy;
+        specifier = *pFormat;
+        base = 0;
+        signedValue = FALSE;
+        is64BitValue = FALSE;
+        pValue = temp;
+        valueLength = 0;
 
-            param_index++;          // number of parameters parsed
-            index += 2;             // we advance in the format string
-            temp_str = temp;        // we need to reset temp_str to point to temp
-                                    // else, after a string operation it will point to the
-                                    // printed string
+        switch (specifier)
+        {
+        case 'b':
+            // we have an unsigned 32 bit value to print
+            base = BASE_TWO;
+            break;
+        case 'B':
+            // we have an unsigned 64 bit value to print
+            base = BASE_TWO;
+            is64BitValue = TRUE;
+            break;
+        case 'u':
+            // we have an unsigned 32 bit value to print
+            base = BASE_TEN;
+            break;
+        case 'U':
+            // we have an unsigned 64 bit value to print
+            base = BASE_TEN;
+            is64BitValue = TRUE;
+            break;
+        case 'd':
+            // we have a signed 32 bit value to print
+            base = BASE_TEN;
+            signedValue = TRUE;
+            break;
+        case 'D':
+            // we have a signed 64 bit value
+            base = BASE_TEN;
+            signedValue = TRUE;
+            is64BitValue = TRUE;
+            break;
+        case 'x':
+            // we have a 32 bit hexadecimal value to print
+            base = BASE_HEXA;
+            break;
+        case 'X':
+            // we have a 64 bit hexadecimal value to print
+            base = BASE_HEXA;
+            is64BitValue = TRUE;
+            break;
+        case 'c':
+            // we have a character value to print
+            temp[0] = va_arg(argptr, char);
+            valueLength = ('\0' == temp[0]) ? 0 : 1;
+            break;
+        case 's':
+        case 'S':
+            // we have a string to print
+            pValue = va_arg(argptr, char*);
+            valueLength = cl_strlen((char*)pValue);
+            ASSERT(valueLength != INVALID_STRING_SIZE);
+            break;
+        default:
+            // A parsing error - an incorrect string was supplied =>
+            // return a status error
+            status = STATUS_PARSE_FAILED;
+            break;
         }
-        else
+
+        if (!SUCCEEDED(status))
         {
-            if (outBufferOffset + 1 >= buffSize)
-            {
-                // we don't have any more space
-                outputBuffer[outBufferOffset] = '\0';
-                return STATUS_BUFFER_TOO_SMALL;
-            }
+            break;
+        }
+
+        if (0 != base)
+        {
+            value = is64BitValue ? va_arg(argptr, QWORD) : va_arg(argptr, DWORD);
+            valueLength = itoa(&value, signedValue, temp, base, is64BitValue);
+        }
 
-            outputBuffer[outBufferOffset] = inputBuffer[index];
+        charsToCopy = (specifier == 'S') ? min(digits, valueLength) : valueLength;
 
-            outBufferOffset++;
-            index++;
+        // see if we need to pad the string with spaces or with digits
+        fillSpaces = digits > valueLength ? digits - valueLength : 0;
+        if (valueLength + fillSpaces > (DWORD)(pOutputEnd - pOutput))
+        {
+            // we don't have any more space
+            status = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+
+        if (0 != fillSpaces)
+        {
+            memset(pOutput, fillChar, fillSpaces);
+            pOutput = pOutput + fillSpaces;
         }
 
+        memcpy(pOutput, (PVOID)pValue, charsToCopy);
+        pOutput = pOutput + charsToCopy;
+
+        noOfParameters++;
+        pFormat++;
     }
 
-    outputBuffer[outBufferOffset] = '\0';
+    *pOutput = '\0';
+
+    if (NULL != length)
+    {
+        *length = (DWORD)(pOutput - outputBuffer);
+    }
 
-    return param_index - 1;
+    return SUCCEEDED(status) ? noOfParameters : status;
 }
 
 const
@@ -0,0 +1,234 @@
+#include "common_lib.h"
+#include "interlocked_list.h"
+#include <intrin.h>
+
+static
+__forceinline
+BOOLEAN
+_ClSListCompareExchange(
+    INOUT   PCL_INTERLOCKED_SLIST_HEADER    ListHead,
+    INOUT   PCL_INTERLOCKED_SLIST_HEADER    Comparand,
+    IN_OPT  PCL_SLIST_ENTRY                 First,
+    IN      DWORD                           Depth,
+    IN      DWORD                           Sequence
+    )
+{
+    // on failure Comparand receives the current value of the header
+    return 0 != _InterlockedCompareExchange128((__int64 volatile*) ListHead,
+                                               (__int64) (((QWORD) Sequence << 32) | Depth),
+                                               (__int64) First,
+                                               (__int64*) Comparand);
+}
+
+void
+ClInitializeInterlockedSListHead(
+    OUT     PCL_INTERLOCKED_SLIST_HEADER    ListHead
+    )
+{
+    ASSERT(NULL != ListHead);
+    ASSERT(IsAddressAligned(ListHead, sizeof(CL_INTERLOCKED_SLIST_HEADER)));
+
+    ListHead->First = NULL;
+    ListHead->Depth = 0;
+    ListHead->Sequence = 0;
+}
+
+PCL_SLIST_ENTRY
+ClInterlockedPushEntrySList(
+    INOUT   PCL_INTERLOCKED_SLIST_HEADER    ListHead,
+    INOUT   PCL_SLIST_ENTRY                 Entry
+    )
+{
+    CL_INTERLOCKED_SLIST_HEADER oldHeader;
+
+    ASSERT(NULL != ListHead);
+    ASSERT(NULL != Entry);
+
+    // a torn read only makes the first exchange fail
+    oldHeader.First = ListHead->First;
+    oldHeader.Depth = ListHead->Depth;
+    oldHeader.Sequence = ListHead->Sequence;
+
+    do
+    {
+        Entry->Next = oldHeader.First;
+
+        // a push can't suffer from ABA, the entry it links to is not read
+    } while (!_ClSListCompareExchange(ListHead,
+                                      &oldHeader,
+                                      Entry,
+                                      oldHeader.Depth + 1,
+                                      oldHeader.Sequence));
+
+    return oldHeader.First;
+}
+
+PTR_SUCCESS
+PCL_SLIST_ENTRY
+ClInterlockedPopEntrySList(
+    INOUT   PCL_INTERLOCKED_SLIST_HEADER    ListHead
+    )
+{
+    CL_INTERLOCKED_SLIST_HEADER oldHeader;
+
+    ASSERT(NULL != ListHead);
+
+    oldHeader.First = ListHead->First;
+    oldHeader.Depth = ListHead->Depth;
+    oldHeader.Sequence = ListHead->Sequence;
+
+    do
+    {
+        if (NULL == oldHeader.First)
+        {
+            return NULL;
+        }
+
+        // if the entry was popped in the meantime the sequence number changed
+        // and the exchange fails, regardless of what was read here. The read
+        // itself is only safe because the entries are type-stable, see the
+        // header.
+    } while (!_ClSListCompareExchange(ListHead,
+                                      &oldHeader,
+                                      *(PCL_SLIST_ENTRY volatile*) &oldHeader.First->Next,
+                                      oldHeader.Depth - 1,
+                                      oldHeader.Sequence + 1));
+
+    return oldHeader.First;
+}
+
+PTR_SUCCESS
+PCL_SLIST_ENTRY
+ClInterlockedFlushSList(
+    INOUT   PCL_INTERLOCKED_SLIST_HEADER    ListHead
+    )
+{
+    CL_INTERLOCKED_SLIST_HEADER oldHeader;
+
+    ASSERT(NULL != ListHead);
+
+    oldHeader.First = ListHead->First;
+    oldHeader.Depth = ListHead->Depth;
+    oldHeader.Sequence = ListHead->Sequence;
+
+    do
+    {
+        if (NULL == oldHeader.First)
+        {
+            return NULL;
+        }
+    } while (!_ClSListCompareExchange(ListHead,
+                                      &oldHeader,
+                                      NULL,
+                                      0,
+                                      oldHeader.Sequence + 1));
+
+    return oldHeader.First;
+}
+
+DWORD
+ClQueryDepthSList(
+    IN      PCL_INTERLOCKED_SLIST_HEADER    ListHead
+    )
+{
+    ASSERT(NULL != ListHead);
+
+    return ListHead->Depth;
+}
+
+void
+ClMpscQueueInit(
+    OUT     PCL_MPSC_QUEUE                  Queue
+    )
+{
+    ASSERT(NULL != Queue);
+
+    Queue->Stub.Next = NULL;
+    Queue->Head = &Queue->Stub;
+    Queue->Tail = &Queue->Stub;
+}
+
+void
+ClMpscQueuePush(
+    INOUT   PCL_MPSC_QUEUE                  Queue,
+    INOUT   PCL_SLIST_ENTRY                 Entry
+    )
+{
+    PCL_SLIST_ENTRY pPrevious;
+
+    ASSERT(NULL != Queue);
+    ASSERT(NULL != Entry);
+
+    Entry->Next = NULL;
+
+    pPrevious = _InterlockedExchangePointer((PVOID volatile*) &Queue->Tail, Entry);
+
+    // until this store the consumer can't see Entry or any entry pushed after
+    // it, see the NOTE of ClMpscQueuePop
+    *(PCL_SLIST_ENTRY volatile*) &pPrevious->Next = Entry;
+}
+
+PTR_SUCCESS
+PCL_SLIST_ENTRY
+ClMpscQueuePop(
+    INOUT   PCL_MPSC_QUEUE                  Queue
+    )
+{
+    PCL_SLIST_ENTRY pHead;
+    PCL_SLIST_ENTRY pNext;
+
+    ASSERT(NULL != Queue);
+
+    pHead = Queue->Head;
+    pNext = *(PCL_SLIST_ENTRY volatile*) &pHead->Next;
+
+    if (pHead == &Queue->Stub)
+    {
+        if (NULL == pNext)
+        {
+            return NULL;
+        }
+
+        // skip the stub, it was put back the last time the queue emptied
+        Queue->Head = pNext;
+        pHead = pNext;
+        pNext = *(PCL_SLIST_ENTRY volatile*) &pHead->Next;
+    }
+
+    if (NULL != pNext)
+    {
+        Queue->Head = pNext;
+        return pHead;
+    }
+
+    if (pHead != Queue->Tail)
+    {
+        // a producer exchanged the tail but didn't link its entry yet
+        return NULL;
+    }
+
+    // pHead is the last entry, it can't be removed without leaving the queue
+    // without entries, so put the stub back behind it
+    ClMpscQueuePush(Queue, &Queue->Stub);
+
+    pNext = *(PCL_SLIST_ENTRY volatile*) &pHead->Next;
+    if (NULL != pNext)
+    {
+        Queue->Head = pNext;
+        return pHead;
+    }
+
+    // a producer exchanged the tail before the stub, its entry will be
+    // returned by a later call
+    return NULL;
+}
+
+BOOLEAN
+ClMpscQueueIsEmpty(
+    IN      PCL_MPSC_QUEUE                  Queue
+    )
+{
+    ASSERT(NULL != Queue);
+
+    return Queue->Head == &Queue->Stub && NULL == *(PCL_SLIST_ENTRY volatile*) &Queue->Stub.Next;
+}
\ No newline at end of file
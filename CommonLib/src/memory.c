@@ -1,7 +1,45 @@
 #include "common_lib.h"
 #include "memory.h"
+#include "memory_simd.h"
+#include <immintrin.h>
 
-extern void CpuClearDirectionFlag();
+// buffers smaller than this are checksummed faster by the scalar loop
+#define MEM_CHECKSUM_SIMD_THRESHOLD             64
+
+typedef
+QWORD
+(__cdecl FUNC_MemChecksumBlocks)(
+    OUT_WRITES_BYTES_OPT(Size)  PBYTE       Destination,
+    IN_READS_BYTES(Size)        const BYTE* Source,
+    IN                          QWORD       Size,
+    OUT                         QWORD*      BytesProcessed
+    );
+
+static FUNC_MemChecksumBlocks _MemChecksumBlocksSse2;
+static FUNC_MemChecksumBlocks _MemChecksumBlocksAvx2;
+
+static
+QWORD
+_MemChecksumScalar(
+    OUT_WRITES_BYTES_OPT(Size)  PBYTE       Destination,
+    IN_READS_BYTES(Size)        const BYTE* Source,
+    IN                          QWORD       Size
+    );
+
+static
+WORD
+_MemChecksumFold(
+    IN                          QWORD       Sum
+    );
+
+static
+WORD
+_MemChecksumInternal(
+    OUT_WRITES_BYTES_OPT(Size)  PBYTE       Destination,
+    IN_READS_BYTES(Size)        const BYTE* Source,
+    IN                          QWORD       Size,
+    IN                          WORD        InitialSum
+    );
 
 _At_buffer_( address, i, size, _Post_satisfies_( ((PBYTE)address)[i] == value ))
 void
@@ -11,19 +49,28 @@ memset(
     IN                          DWORD size
     )
 {
-    DWORD i;
-
-    // validate parameters
-    // size validation is done implicitly in the for loop
     if (NULL == address)
     {
         return;
     }
 
-    for (i = 0; i < size; ++i)
+    MemFill(address, value, size, FALSE);
+}
+
+_At_buffer_( address, i, size, _Post_satisfies_( ((PBYTE)address)[i] == value ))
+void
+memsetnt(
+    OUT_WRITES_BYTES_ALL(size)  PVOID address,
+    IN                          BYTE value,
+    IN                          DWORD size
+    )
+{
+    if (NULL == address)
     {
-        ((BYTE*)address)[i] = value;
+        return;
     }
+
+    MemFill(address, value, size, TRUE);
 }
 
 _At_buffer_(Destination, i, Count,
@@ -35,54 +82,29 @@ memcpy(
     IN                          QWORD   Count
     )
 {
-    PBYTE dst;
-    PBYTE src;
-    QWORD alignedCount;
-    QWORD unalignedCount;
-
     if( (NULL == Destination) || (NULL == Source))
     {
         return;
     }
 
-    unalignedCount = Count & 0x7;
-    alignedCount = Count - unalignedCount;
-
-    dst = (PBYTE)Destination;
-    src = (PBYTE)Source;
-
-    if (unalignedCount & 0x4)
-    {
-        *((PDWORD)dst) = *((PDWORD)src);
-        dst = dst + sizeof(DWORD);
-        src = src + sizeof(DWORD);
-    }
+    MemCopyForward(Destination, Source, Count, FALSE);
+}
 
-    if (unalignedCount & 0x2)
-    {
-        *((PWORD)dst) = *((PWORD)src);
-        dst = dst + sizeof(WORD);
-        src = src + sizeof(WORD);
-    }
-    
-    if (unalignedCount & 0x1)
+_At_buffer_(Destination, i, Count,
+            _Post_satisfies_(((PBYTE)Destination)[i] == ((PBYTE)Source)[i]))
+void
+memcpynt(
+    OUT_WRITES_BYTES_ALL(Count) PVOID   Destination,
+    IN_READS(Count)             PVOID   Source,
+    IN                          QWORD   Count
+    )
+{
+    if ((NULL == Destination) || (NULL == Source))
     {
-        *((PBYTE)dst) = *((PBYTE)src);
-        dst = dst + sizeof(BYTE);
-        src = src + sizeof(BYTE);
+        return;
     }
 
-    if (0 != alignedCount)
-    {
-        ASSERT(IsAddressAligned(alignedCount, sizeof(QWORD)));
-
-        dst = (PBYTE)Destination + unalignedCount;
-        src = (PBYTE)Source + unalignedCount;
-
-        CpuClearDirectionFlag();
-
-        __movsq(dst, src, alignedCount / sizeof(QWORD));
-    }
+    MemCopyForward(Destination, Source, Count, TRUE);
 }
 
 _At_buffer_(Destination, i, Count,
@@ -96,7 +118,6 @@ memmove(
 {
     PBYTE dst;
     PBYTE src;
-    QWORD i;
 
     if ((NULL == Destination) || (NULL == Source))
     {
@@ -106,9 +127,14 @@ memmove(
     dst = Destination;
     src = Source;
 
-    for (i = 0; i < Count; ++i)
+    // only a destination starting inside the source must be copied backwards
+    if (dst > src && dst < src + Count)
     {
-        dst[i] = src[i];
+        MemCopyBackward(dst, src, Count);
+    }
+    else
+    {
+        MemCopyForward(dst, src, Count, FALSE);
     }
 }
 
@@ -119,7 +145,7 @@ memcmp(
     IN                      DWORD size
     )
 {
-    INT64 i = size;
+    QWORD i;
     PBYTE p1;
     PBYTE p2;
 
@@ -133,15 +159,9 @@ memcmp(
     p1 = (PBYTE)ptr1;
     p2 = (PBYTE)ptr2;
 
-    for (i = 0; i < size; ++i)
-    {
-        if (p1[i] != p2[i])
-        {
-            return p1[i] - p2[i];
-        }
-    }
+    i = MemFindDifference(p1, p2, size);
 
-    return 0;
+    return (i == size) ? 0 : p1[i] - p2[i];
 }
 
 int
@@ -151,24 +171,237 @@ memscan(
     IN                      BYTE  value
     )
 {
-    DWORD i;
-    PBYTE pData;
-
     if (NULL == buffer)
     {
         return 0;
     }
 
-    pData = (PBYTE)buffer;
+    return (int)MemFindNotEqual(buffer, value, size);
+}
+
+WORD
+memchecksum(
+    IN_READS_BYTES(size)    PVOID   buffer,
+    IN                      DWORD   size,
+    IN                      WORD    InitialSum
+    )
+{
+    if (NULL == buffer)
+    {
+        return InitialSum;
+    }
+
+    return _MemChecksumInternal(NULL, buffer, size, InitialSum);
+}
+
+WORD
+memcpychecksum(
+    OUT_WRITES_BYTES_ALL(Count) PVOID   Destination,
+    IN_READS(Count)             PVOID   Source,
+    IN                          QWORD   Count,
+    IN                          WORD    InitialSum
+    )
+{
+    if ((NULL == Destination) || (NULL == Source))
+    {
+        return InitialSum;
+    }
+
+    return _MemChecksumInternal(Destination, Source, Count, InitialSum);
+}
+
+WORD
+memchecksumupdate(
+    IN                      WORD    Checksum,
+    IN                      WORD    OldValue,
+    IN                      WORD    NewValue
+    )
+{
+    DWORD sum;
+
+    // RFC 1624 eqn. 3: HC' = ~(~HC + ~m + m')
+    sum = (WORD) ~Checksum;
+    sum += (WORD) ~OldValue;
+    sum += NewValue;
+
+    return (WORD) ~_MemChecksumFold(sum);
+}
+
+static
+WORD
+_MemChecksumFold(
+    IN                          QWORD       Sum
+    )
+{
+    Sum = QWORD_LOW(Sum) + QWORD_HIGH(Sum);
+    Sum = QWORD_LOW(Sum) + QWORD_HIGH(Sum);
+    Sum = DWORD_LOW(Sum) + DWORD_HIGH(Sum);
+    Sum = DWORD_LOW(Sum) + DWORD_HIGH(Sum);
+
+    return (WORD) Sum;
+}
+
+static
+QWORD
+_MemChecksumScalar(
+    OUT_WRITES_BYTES_OPT(Size)  PBYTE       Destination,
+    IN_READS_BYTES(Size)        const BYTE* Source,
+    IN                          QWORD       Size
+    )
+{
+    QWORD sum;
+    QWORD i;
+    DWORD value;
+
+    sum = 0;
 
-    for (i = 0; i < size; ++i)
+    // the ones-complement sum is byte order independent (RFC 1071 2.B) so
+    // we can add up native DWORDs and fold the result at the end
+    for (i = 0; i + sizeof(DWORD) <= Size; i += sizeof(DWORD))
     {
-        if (pData[i] != value)
+        value = *((const DWORD*)(Source + i));
+        if (NULL != Destination)
         {
-            // game over
-            return i;
+            *((PDWORD)(Destination + i)) = value;
         }
+        sum += value;
     }
 
-    return i;
-}
\ No newline at end of file
+    if (i + sizeof(WORD) <= Size)
+    {
+        value = *((const WORD*)(Source + i));
+        if (NULL != Destination)
+        {
+            *((PWORD)(Destination + i)) = (WORD) value;
+        }
+        sum += value;
+        i += sizeof(WORD);
+    }
+
+    if (i < Size)
+    {
+        // a trailing odd byte is padded with zero on the right in network
+        // order, i.e. it is the low byte of a little endian WORD
+        value = Source[i];
+        if (NULL != Destination)
+        {
+            Destination[i] = (BYTE) value;
+        }
+        sum += value;
+    }
+
+    return sum;
+}
+
+static
+QWORD
+(__cdecl _MemChecksumBlocksSse2)(
+    OUT_WRITES_BYTES_OPT(Size)  PBYTE       Destination,
+    IN_READS_BYTES(Size)        const BYTE* Source,
+    IN                          QWORD       Size,
+    OUT                         QWORD*      BytesProcessed
+    )
+{
+    __m128i acc0;
+    __m128i acc1;
+    __m128i zero;
+    __m128i data;
+    QWORD i;
+    QWORD result[2];
+
+    acc0 = _mm_setzero_si128();
+    acc1 = _mm_setzero_si128();
+    zero = _mm_setzero_si128();
+
+    // each DWORD is widened to a QWORD lane before being added so the
+    // accumulators cannot overflow regardless of the buffer size
+    for (i = 0; i + sizeof(__m128i) <= Size; i += sizeof(__m128i))
+    {
+        data = _mm_loadu_si128((const __m128i*)(Source + i));
+        if (NULL != Destination)
+        {
+            _mm_storeu_si128((__m128i*)(Destination + i), data);
+        }
+
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(data, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(data, zero));
+    }
+
+    _mm_storeu_si128((__m128i*)result, _mm_add_epi64(acc0, acc1));
+    *BytesProcessed = i;
+
+    return _MemChecksumFold(result[0]) + (QWORD)_MemChecksumFold(result[1]);
+}
+
+static
+QWORD
+(__cdecl _MemChecksumBlocksAvx2)(
+    OUT_WRITES_BYTES_OPT(Size)  PBYTE       Destination,
+    IN_READS_BYTES(Size)        const BYTE* Source,
+    IN                          QWORD       Size,
+    OUT                         QWORD*      BytesProcessed
+    )
+{
+    __m256i acc0;
+    __m256i acc1;
+    __m256i zero;
+    __m256i data;
+    QWORD i;
+    QWORD result[4];
+
+    acc0 = _mm256_setzero_si256();
+    acc1 = _mm256_setzero_si256();
+    zero = _mm256_setzero_si256();
+
+    for (i = 0; i + sizeof(__m256i) <= Size; i += sizeof(__m256i))
+    {
+        data = _mm256_loadu_si256((const __m256i*)(Source + i));
+        if (NULL != Destination)
+        {
+            _mm256_storeu_si256((__m256i*)(Destination + i), data);
+        }
+
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(data, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(data, zero));
+    }
+
+    _mm256_storeu_si256((__m256i*)result, _mm256_add_epi64(acc0, acc1));
+
+    // avoid AVX-SSE transition penalties in the caller
+    _mm256_zeroupper();
+
+    *BytesProcessed = i;
+
+    return (QWORD)_MemChecksumFold(result[0]) + _MemChecksumFold(result[1]) +
+           _MemChecksumFold(result[2]) + _MemChecksumFold(result[3]);
+}
+
+static
+WORD
+_MemChecksumInternal(
+    OUT_WRITES_BYTES_OPT(Size)  PBYTE       Destination,
+    IN_READS_BYTES(Size)        const BYTE* Source,
+    IN                          QWORD       Size,
+    IN                          WORD        InitialSum
+    )
+{
+    QWORD sum;
+    QWORD processed;
+
+    sum = InitialSum;
+    processed = 0;
+
+    // vectorizing only pays off once we have a few blocks to process
+    if (Size >= MEM_CHECKSUM_SIMD_THRESHOLD)
+    {
+        sum += IsBooleanFlagOn(MemGetCpuFeatures(), MEM_FEATURE_AVX2)
+            ? _MemChecksumBlocksAvx2(Destination, Source, Size, &processed)
+            : _MemChecksumBlocksSse2(Destination, Source, Size, &processed);
+    }
+
+    sum += _MemChecksumScalar(NULL == Destination ? NULL : Destination + processed,
+                              Source + processed,
+                              Size - processed);
+
+    return _MemChecksumFold(sum);
+}
@@ -0,0 +1,628 @@
+#include "common_lib.h"
+#include "memory_simd.h"
+#include <immintrin.h>
+
+extern void CpuClearDirectionFlag();
+
+#define CPUID_LEAF_BASIC_INFORMATION            0x0
+#define CPUID_LEAF_FEATURE_INFORMATION          0x1
+#define CPUID_LEAF_STRUCTURED_EXTENDED_FEATURES 0x7
+
+#define CPUID_FEAT_ECX_OSXSAVE                  (1UL<<27)
+#define CPUID_FEAT_ECX_AVX                      (1UL<<28)
+#define CPUID_STRUCT_EXT_EBX_AVX2               (1UL<<5)
+#define CPUID_STRUCT_EXT_EBX_ERMS               (1UL<<9)
+
+// XCR0 bits 1 and 2 must be set by the OS for YMM state to be usable
+#define XCR0_SSE_AVX_STATE                      0x6ULL
+
+// below this size the startup cost of REP MOVSB/STOSB is higher than the
+// time the vector loops need for the whole buffer
+#define MEM_REP_STRING_THRESHOLD                2048
+
+#define MEM_BYTE_PATTERN                        0x0101010101010101ULL
+
+static volatile DWORD m_memCpuFeatures = 0;
+
+static
+__forceinline
+void
+_MemCopySmall(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN_READS_BYTES(Count)       const BYTE* Source,
+    IN                          QWORD       Count
+    )
+{
+    ASSERT(Count <= 2 * sizeof(__m128i));
+
+    // everything is loaded before anything is stored, the first and last
+    // chunks overlap when Count is not a power of 2 and the buffers may
+    // overlap in any way
+    if (Count >= sizeof(__m128i))
+    {
+        __m128i head = _mm_loadu_si128((const __m128i*)Source);
+        __m128i tail = _mm_loadu_si128((const __m128i*)(Source + Count - sizeof(__m128i)));
+
+        _mm_storeu_si128((__m128i*)Destination, head);
+        _mm_storeu_si128((__m128i*)(Destination + Count - sizeof(__m128i)), tail);
+    }
+    else if (Count >= sizeof(QWORD))
+    {
+        QWORD head = *((const QWORD*)Source);
+        QWORD tail = *((const QWORD*)(Source + Count - sizeof(QWORD)));
+
+        *((PQWORD)Destination) = head;
+        *((PQWORD)(Destination + Count - sizeof(QWORD))) = tail;
+    }
+    else if (Count >= sizeof(DWORD))
+    {
+        DWORD head = *((const DWORD*)Source);
+        DWORD tail = *((const DWORD*)(Source + Count - sizeof(DWORD)));
+
+        *((PDWORD)Destination) = head;
+        *((PDWORD)(Destination + Count - sizeof(DWORD))) = tail;
+    }
+    else if (Count >= sizeof(WORD))
+    {
+        WORD head = *((const WORD*)Source);
+        WORD tail = *((const WORD*)(Source + Count - sizeof(WORD)));
+
+        *((PWORD)Destination) = head;
+        *((PWORD)(Destination + Count - sizeof(WORD))) = tail;
+    }
+    else if (Count != 0)
+    {
+        *Destination = *Source;
+    }
+}
+
+static
+void
+_MemCopyForwardSse2(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN_READS_BYTES(Count)       const BYTE* Source,
+    IN                          QWORD       Count,
+    IN                          BOOLEAN     NonTemporal
+    )
+{
+    __m128i head;
+    __m128i tail;
+    __m128i v0;
+    __m128i v1;
+    __m128i v2;
+    __m128i v3;
+    QWORD i;
+
+    ASSERT(Count > 2 * sizeof(__m128i));
+
+    // The loop stores to aligned addresses, the unaligned start and end of
+    // Destination are covered by head and tail. They are stored last so the
+    // loop never reads data already overwritten if the buffers overlap.
+    head = _mm_loadu_si128((const __m128i*)Source);
+    tail = _mm_loadu_si128((const __m128i*)(Source + Count - sizeof(__m128i)));
+
+    i = sizeof(__m128i) - ((QWORD)Destination & (sizeof(__m128i) - 1));
+
+    if (NonTemporal)
+    {
+        for (; i + 4 * sizeof(__m128i) <= Count; i += 4 * sizeof(__m128i))
+        {
+            v0 = _mm_loadu_si128((const __m128i*)(Source + i));
+            v1 = _mm_loadu_si128((const __m128i*)(Source + i + sizeof(__m128i)));
+            v2 = _mm_loadu_si128((const __m128i*)(Source + i + 2 * sizeof(__m128i)));
+            v3 = _mm_loadu_si128((const __m128i*)(Source + i + 3 * sizeof(__m128i)));
+
+            _mm_stream_si128((__m128i*)(Destination + i), v0);
+            _mm_stream_si128((__m128i*)(Destination + i + sizeof(__m128i)), v1);
+            _mm_stream_si128((__m128i*)(Destination + i + 2 * sizeof(__m128i)), v2);
+            _mm_stream_si128((__m128i*)(Destination + i + 3 * sizeof(__m128i)), v3);
+        }
+
+        for (; i + sizeof(__m128i) <= Count; i += sizeof(__m128i))
+        {
+            _mm_stream_si128((__m128i*)(Destination + i), _mm_loadu_si128((const __m128i*)(Source + i)));
+        }
+
+        // the streaming stores are weakly ordered, they must be globally
+        // visible before the caller hands the buffer to someone else
+        _mm_sfence();
+    }
+    else
+    {
+        for (; i + 4 * sizeof(__m128i) <= Count; i += 4 * sizeof(__m128i))
+        {
+            v0 = _mm_loadu_si128((const __m128i*)(Source + i));
+            v1 = _mm_loadu_si128((const __m128i*)(Source + i + sizeof(__m128i)));
+            v2 = _mm_loadu_si128((const __m128i*)(Source + i + 2 * sizeof(__m128i)));
+            v3 = _mm_loadu_si128((const __m128i*)(Source + i + 3 * sizeof(__m128i)));
+
+            _mm_store_si128((__m128i*)(Destination + i), v0);
+            _mm_store_si128((__m128i*)(Destination + i + sizeof(__m128i)), v1);
+            _mm_store_si128((__m128i*)(Destination + i + 2 * sizeof(__m128i)), v2);
+            _mm_store_si128((__m128i*)(Destination + i + 3 * sizeof(__m128i)), v3);
+        }
+
+        for (; i + sizeof(__m128i) <= Count; i += sizeof(__m128i))
+        {
+            _mm_store_si128((__m128i*)(Destination + i), _mm_loadu_si128((const __m128i*)(Source + i)));
+        }
+    }
+
+    _mm_storeu_si128((__m128i*)(Destination + Count - sizeof(__m128i)), tail);
+    _mm_storeu_si128((__m128i*)Destination, head);
+}
+
+static
+void
+_MemCopyForwardAvx2(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN_READS_BYTES(Count)       const BYTE* Source,
+    IN                          QWORD       Count,
+    IN                          BOOLEAN     NonTemporal
+    )
+{
+    __m256i head;
+    __m256i tail;
+    __m256i v0;
+    __m256i v1;
+    QWORD i;
+
+    ASSERT(Count > 2 * sizeof(__m256i));
+
+    // same as _MemCopyForwardSse2
+    head = _mm256_loadu_si256((const __m256i*)Source);
+    tail = _mm256_loadu_si256((const __m256i*)(Source + Count - sizeof(__m256i)));
+
+    i = sizeof(__m256i) - ((QWORD)Destination & (sizeof(__m256i) - 1));
+
+    if (NonTemporal)
+    {
+        for (; i + 2 * sizeof(__m256i) <= Count; i += 2 * sizeof(__m256i))
+        {
+            v0 = _mm256_loadu_si256((const __m256i*)(Source + i));
+            v1 = _mm256_loadu_si256((const __m256i*)(Source + i + sizeof(__m256i)));
+
+            _mm256_stream_si256((__m256i*)(Destination + i), v0);
+            _mm256_stream_si256((__m256i*)(Destination + i + sizeof(__m256i)), v1);
+        }
+
+        for (; i + sizeof(__m256i) <= Count; i += sizeof(__m256i))
+        {
+            _mm256_stream_si256((__m256i*)(Destination + i), _mm256_loadu_si256((const __m256i*)(Source + i)));
+        }
+
+        _mm_sfence();
+    }
+    else
+    {
+        for (; i + 2 * sizeof(__m256i) <= Count; i += 2 * sizeof(__m256i))
+        {
+            v0 = _mm256_loadu_si256((const __m256i*)(Source + i));
+            v1 = _mm256_loadu_si256((const __m256i*)(Source + i + sizeof(__m256i)));
+
+            _mm256_store_si256((__m256i*)(Destination + i), v0);
+            _mm256_store_si256((__m256i*)(Destination + i + sizeof(__m256i)), v1);
+        }
+
+        for (; i + sizeof(__m256i) <= Count; i += sizeof(__m256i))
+        {
+            _mm256_store_si256((__m256i*)(Destination + i), _mm256_loadu_si256((const __m256i*)(Source + i)));
+        }
+    }
+
+    _mm256_storeu_si256((__m256i*)(Destination + Count - sizeof(__m256i)), tail);
+    _mm256_storeu_si256((__m256i*)Destination, head);
+
+    // avoid AVX-SSE transition penalties in the caller
+    _mm256_zeroupper();
+}
+
+static
+void
+_MemFillSse2(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN                          BYTE        Value,
+    IN                          QWORD       Count,
+    IN                          BOOLEAN     NonTemporal
+    )
+{
+    __m128i value;
+    QWORD i;
+
+    ASSERT(Count >= sizeof(__m128i));
+
+    value = _mm_set1_epi8((char)Value);
+
+    _mm_storeu_si128((__m128i*)Destination, value);
+    _mm_storeu_si128((__m128i*)(Destination + Count - sizeof(__m128i)), value);
+
+    i = sizeof(__m128i) - ((QWORD)Destination & (sizeof(__m128i) - 1));
+
+    if (NonTemporal)
+    {
+        for (; i + 4 * sizeof(__m128i) <= Count; i += 4 * sizeof(__m128i))
+        {
+            _mm_stream_si128((__m128i*)(Destination + i), value);
+            _mm_stream_si128((__m128i*)(Destination + i + sizeof(__m128i)), value);
+            _mm_stream_si128((__m128i*)(Destination + i + 2 * sizeof(__m128i)), value);
+            _mm_stream_si128((__m128i*)(Destination + i + 3 * sizeof(__m128i)), value);
+        }
+
+        for (; i + sizeof(__m128i) <= Count; i += sizeof(__m128i))
+        {
+            _mm_stream_si128((__m128i*)(Destination + i), value);
+        }
+
+        _mm_sfence();
+    }
+    else
+    {
+        for (; i + 4 * sizeof(__m128i) <= Count; i += 4 * sizeof(__m128i))
+        {
+            _mm_store_si128((__m128i*)(Destination + i), value);
+            _mm_store_si128((__m128i*)(Destination + i + sizeof(__m128i)), value);
+            _mm_store_si128((__m128i*)(Destination + i + 2 * sizeof(__m128i)), value);
+            _mm_store_si128((__m128i*)(Destination + i + 3 * sizeof(__m128i)), value);
+        }
+
+        for (; i + sizeof(__m128i) <= Count; i += sizeof(__m128i))
+        {
+            _mm_store_si128((__m128i*)(Destination + i), value);
+        }
+    }
+}
+
+static
+void
+_MemFillAvx2(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN                          BYTE        Value,
+    IN                          QWORD       Count,
+    IN                          BOOLEAN     NonTemporal
+    )
+{
+    __m256i value;
+    QWORD i;
+
+    ASSERT(Count >= sizeof(__m256i));
+
+    value = _mm256_set1_epi8((char)Value);
+
+    _mm256_storeu_si256((__m256i*)Destination, value);
+    _mm256_storeu_si256((__m256i*)(Destination + Count - sizeof(__m256i)), value);
+
+    i = sizeof(__m256i) - ((QWORD)Destination & (sizeof(__m256i) - 1));
+
+    if (NonTemporal)
+    {
+        for (; i + 2 * sizeof(__m256i) <= Count; i += 2 * sizeof(__m256i))
+        {
+            _mm256_stream_si256((__m256i*)(Destination + i), value);
+            _mm256_stream_si256((__m256i*)(Destination + i + sizeof(__m256i)), value);
+        }
+
+        for (; i + sizeof(__m256i) <= Count; i += sizeof(__m256i))
+        {
+            _mm256_stream_si256((__m256i*)(Destination + i), value);
+        }
+
+        _mm_sfence();
+    }
+    else
+    {
+        for (; i + 2 * sizeof(__m256i) <= Count; i += 2 * sizeof(__m256i))
+        {
+            _mm256_store_si256((__m256i*)(Destination + i), value);
+            _mm256_store_si256((__m256i*)(Destination + i + sizeof(__m256i)), value);
+        }
+
+        for (; i + sizeof(__m256i) <= Count; i += sizeof(__m256i))
+        {
+            _mm256_store_si256((__m256i*)(Destination + i), value);
+        }
+    }
+
+    _mm256_zeroupper();
+}
+
+DWORD
+MemGetCpuFeatures(
+    void
+    )
+{
+    int cpuInfo[4];
+    DWORD features;
+    DWORD maxLeaf;
+
+    features = m_memCpuFeatures;
+    if (IsBooleanFlagOn(features, MEM_FEATURE_DETECTED))
+    {
+        return features;
+    }
+
+    features = MEM_FEATURE_DETECTED;
+
+    __cpuid(cpuInfo, CPUID_LEAF_BASIC_INFORMATION);
+    maxLeaf = (DWORD)cpuInfo[0];
+
+    if (maxLeaf >= CPUID_LEAF_STRUCTURED_EXTENDED_FEATURES)
+    {
+        __cpuidex(cpuInfo, CPUID_LEAF_STRUCTURED_EXTENDED_FEATURES, 0);
+        if (IsBooleanFlagOn((DWORD)cpuInfo[1], CPUID_STRUCT_EXT_EBX_ERMS))
+        {
+            features |= MEM_FEATURE_ERMS;
+        }
+
+        // SSE2 is architectural on x64, the only thing we need to validate
+        // for AVX2 is that the CPU supports it and that the OS enabled YMM
+        // state
+        if (IsBooleanFlagOn((DWORD)cpuInfo[1], CPUID_STRUCT_EXT_EBX_AVX2))
+        {
+            __cpuid(cpuInfo, CPUID_LEAF_FEATURE_INFORMATION);
+            if (IsBooleanFlagOn((DWORD)cpuInfo[2], CPUID_FEAT_ECX_OSXSAVE | CPUID_FEAT_ECX_AVX) &&
+                IsBooleanFlagOn(_xgetbv(0), XCR0_SSE_AVX_STATE))
+            {
+                features |= MEM_FEATURE_AVX2;
+            }
+        }
+    }
+
+    // benign race: all CPUs will compute the same value
+    m_memCpuFeatures = features;
+
+    return features;
+}
+
+void
+MemCopyForward(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN_READS_BYTES(Count)       const BYTE* Source,
+    IN                          QWORD       Count,
+    IN                          BOOLEAN     NonTemporal
+    )
+{
+    DWORD features;
+
+    if (Count <= 2 * sizeof(__m128i))
+    {
+        _MemCopySmall(Destination, Source, Count);
+        return;
+    }
+
+    features = MemGetCpuFeatures();
+    NonTemporal = NonTemporal || Count >= MEM_NON_TEMPORAL_THRESHOLD;
+
+    // the microcode copies whole cache lines, it's the fastest option for
+    // medium and large copies which should stay in the caches
+    if (!NonTemporal && Count >= MEM_REP_STRING_THRESHOLD && IsBooleanFlagOn(features, MEM_FEATURE_ERMS))
+    {
+        CpuClearDirectionFlag();
+
+        __movsb(Destination, Source, Count);
+        return;
+    }
+
+    if (Count > 2 * sizeof(__m256i) && IsBooleanFlagOn(features, MEM_FEATURE_AVX2))
+    {
+        _MemCopyForwardAvx2(Destination, Source, Count, NonTemporal);
+    }
+    else
+    {
+        _MemCopyForwardSse2(Destination, Source, Count, NonTemporal);
+    }
+}
+
+void
+MemCopyBackward(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN_READS_BYTES(Count)       const BYTE* Source,
+    IN                          QWORD       Count
+    )
+{
+    __m128i head;
+    __m128i v0;
+    __m128i v1;
+    __m128i v2;
+    __m128i v3;
+    QWORD i;
+
+    if (Count <= 2 * sizeof(__m128i))
+    {
+        _MemCopySmall(Destination, Source, Count);
+        return;
+    }
+
+    // the first bytes of Source may be overwritten by the last stores
+    head = _mm_loadu_si128((const __m128i*)Source);
+
+    for (i = Count; i >= 4 * sizeof(__m128i); i -= 4 * sizeof(__m128i))
+    {
+        v0 = _mm_loadu_si128((const __m128i*)(Source + i - sizeof(__m128i)));
+        v1 = _mm_loadu_si128((const __m128i*)(Source + i - 2 * sizeof(__m128i)));
+        v2 = _mm_loadu_si128((const __m128i*)(Source + i - 3 * sizeof(__m128i)));
+        v3 = _mm_loadu_si128((const __m128i*)(Source + i - 4 * sizeof(__m128i)));
+
+        _mm_storeu_si128((__m128i*)(Destination + i - sizeof(__m128i)), v0);
+        _mm_storeu_si128((__m128i*)(Destination + i - 2 * sizeof(__m128i)), v1);
+        _mm_storeu_si128((__m128i*)(Destination + i - 3 * sizeof(__m128i)), v2);
+        _mm_storeu_si128((__m128i*)(Destination + i - 4 * sizeof(__m128i)), v3);
+    }
+
+    for (; i > sizeof(__m128i); i -= sizeof(__m128i))
+    {
+        _mm_storeu_si128((__m128i*)(Destination + i - sizeof(__m128i)),
+                         _mm_loadu_si128((const __m128i*)(Source + i - sizeof(__m128i))));
+    }
+
+    _mm_storeu_si128((__m128i*)Destination, head);
+}
+
+void
+MemFill(
+    OUT_WRITES_BYTES_ALL(Count) PBYTE       Destination,
+    IN                          BYTE        Value,
+    IN                          QWORD       Count,
+    IN                          BOOLEAN     NonTemporal
+    )
+{
+    DWORD features;
+    QWORD pattern;
+
+    if (Count < sizeof(__m128i))
+    {
+        pattern = MEM_BYTE_PATTERN * Value;
+
+        if (Count >= sizeof(QWORD))
+        {
+            *((PQWORD)Destination) = pattern;
+            *((PQWORD)(Destination + Count - sizeof(QWORD))) = pattern;
+        }
+        else if (Count >= sizeof(DWORD))
+        {
+            *((PDWORD)Destination) = (DWORD)pattern;
+            *((PDWORD)(Destination + Count - sizeof(DWORD))) = (DWORD)pattern;
+        }
+        else if (Count >= sizeof(WORD))
+        {
+            *((PWORD)Destination) = (WORD)pattern;
+            *((PWORD)(Destination + Count - sizeof(WORD))) = (WORD)pattern;
+        }
+        else if (Count != 0)
+        {
+            *Destination = Value;
+        }
+
+        return;
+    }
+
+    features = MemGetCpuFeatures();
+    NonTemporal = NonTemporal || Count >= MEM_NON_TEMPORAL_THRESHOLD;
+
+    if (!NonTemporal && Count >= MEM_REP_STRING_THRESHOLD && IsBooleanFlagOn(features, MEM_FEATURE_ERMS))
+    {
+        CpuClearDirectionFlag();
+
+        __stosb(Destination, Value, Count);
+        return;
+    }
+
+    if (Count > 2 * sizeof(__m256i) && IsBooleanFlagOn(features, MEM_FEATURE_AVX2))
+    {
+        _MemFillAvx2(Destination, Value, Count, NonTemporal);
+    }
+    else
+    {
+        _MemFillSse2(Destination, Value, Count, NonTemporal);
+    }
+}
+
+QWORD
+MemFindDifference(
+    IN_READS_BYTES(Count)       const BYTE* First,
+    IN_READS_BYTES(Count)       const BYTE* Second,
+    IN                          QWORD       Count
+    )
+{
+    unsigned long index;
+    DWORD equalMask;
+    QWORD i;
+
+    for (i = 0; i + sizeof(__m128i) <= Count; i += sizeof(__m128i))
+    {
+        equalMask = (DWORD)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(First + i)),
+                                                             _mm_loadu_si128((const __m128i*)(Second + i))));
+        if (equalMask != MAX_WORD)
+        {
+            _BitScanForward(&index, ~equalMask);
+            return i + index;
+        }
+    }
+
+    for (; i < Count; ++i)
+    {
+        if (First[i] != Second[i])
+        {
+            return i;
+        }
+    }
+
+    return Count;
+}
+
+QWORD
+MemFindNotEqual(
+    IN_READS_BYTES(Count)       const BYTE* Buffer,
+    IN                          BYTE        Value,
+    IN                          QWORD       Count
+    )
+{
+    unsigned long index;
+    __m128i value;
+    DWORD equalMask;
+    QWORD i;
+
+    value = _mm_set1_epi8((char)Value);
+
+    for (i = 0; i + sizeof(__m128i) <= Count; i += sizeof(__m128i))
+    {
+        equalMask = (DWORD)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(Buffer + i)), value));
+        if (equalMask != MAX_WORD)
+        {
+            _BitScanForward(&index, ~equalMask);
+            return i + index;
+        }
+    }
+
+    for (; i < Count; ++i)
+    {
+        if (Buffer[i] != Value)
+        {
+            return i;
+        }
+    }
+
+    return Count;
+}
+
+DWORD
+MemStringLength(
+    IN_Z                        const char* String,
+    IN                          DWORD       MaxLength
+    )
+{
+    const __m128i* pBlock;
+    unsigned long index;
+    DWORD misalignment;
+    DWORD zeroMask;
+    QWORD length;
+
+    if (MaxLength == 0)
+    {
+        return 0;
+    }
+
+    // Aligned loads never cross a page boundary so they can't fault even if
+    // they go past the end of the string. The bytes of the first block found
+    // before the string are shifted out of the mask.
+    misalignment = (DWORD)((QWORD)String & (sizeof(__m128i) - 1));
+    pBlock = (const __m128i*)(String - misalignment);
+
+    zeroMask = (DWORD)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(pBlock), _mm_setzero_si128())) >> misalignment;
+    length = 0;
+
+    while (zeroMask == 0)
+    {
+        length += (length == 0) ? sizeof(__m128i) - misalignment : sizeof(__m128i);
+        if (length >= MaxLength)
+        {
+            return MaxLength;
+        }
+
+        pBlock++;
+        zeroMask = (DWORD)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(pBlock), _mm_setzero_si128()));
+    }
+
+    _BitScanForward(&index, zeroMask);
+
+    return (DWORD)min(length + index, MaxLength);
+}
\ No newline at end of file
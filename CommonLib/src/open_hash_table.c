@@ -0,0 +1,748 @@
+#include "common_lib.h"
+#include "open_hash_table.h"
+
+// set in the stored hash of every used slot so a used slot is never 0
+#define OPEN_HASH_USED_BIT              0x80000000UL
+
+// number of slots of the previous array looked at by each insertion while the
+// table grows, the previous array is always emptied long before the current
+// one fills up
+#define OPEN_HASH_MIGRATION_SLOTS       16
+
+typedef struct _OPEN_HASH_SLOT
+{
+    QWORD                   Key;
+
+    // the HASH_ENTRY of the element or the value stored
+    PVOID                   Element;
+} OPEN_HASH_SLOT;
+
+static
+__forceinline
+DWORD
+_OpenHashMaxElements(
+    IN      DWORD               Capacity
+    )
+{
+    return Capacity - Capacity / 8;
+}
+
+static
+__forceinline
+QWORD
+_OpenHashNormalizeKey(
+    IN      POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key
+    )
+{
+    return (HashTable->KeySize < sizeof(QWORD))
+        ? Key & (((QWORD)1 << (HashTable->KeySize * BITS_PER_BYTE)) - 1)
+        : Key;
+}
+
+static
+__forceinline
+QWORD
+_OpenHashReadKey(
+    IN      POPEN_HASH_TABLE    HashTable,
+    IN      PHASH_KEY           Key
+    )
+{
+    QWORD keyValue;
+
+    ASSERT(Key != NULL);
+
+    keyValue = 0;
+    cl_memcpy(&keyValue, Key, HashTable->KeySize);
+
+    return keyValue;
+}
+
+static
+__forceinline
+DWORD
+_OpenHashComputeHash(
+    IN      POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key
+    )
+{
+    QWORD hash;
+
+    hash = (HashTable->HashFunc != NULL)
+        ? HashTable->HashFunc((PHASH_KEY) &Key, HashTable->KeySize, MAX_DWORD)
+        : Key;
+
+    // the 64 bit finalizer of MurmurHash3, the slot is chosen by the low bits
+    // so they must depend on all the bits of the key
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+
+    return (DWORD) hash | OPEN_HASH_USED_BIT;
+}
+
+static
+__forceinline
+DWORD
+_OpenHashProbeDistance(
+    IN      POPEN_HASH_ARRAY    Array,
+    IN      DWORD               Index,
+    IN      DWORD               Hash
+    )
+{
+    return (Index - Hash) & (Array->Capacity - 1);
+}
+
+static
+STATUS
+_OpenHashArrayCreate(
+    IN      POPEN_HASH_TABLE    HashTable,
+    IN      DWORD               Capacity,
+    OUT     POPEN_HASH_ARRAY    Array
+    )
+{
+    PVOID pBuffer;
+
+    ASSERT(Capacity != 0 && (Capacity & (Capacity - 1)) == 0);
+
+    if (Capacity > MAX_DWORD / (sizeof(OPEN_HASH_SLOT) + sizeof(DWORD)))
+    {
+        return STATUS_HEAP_INSUFFICIENT_RESOURCES;
+    }
+
+    pBuffer = HashTable->AllocFunc(Capacity * (DWORD) (sizeof(OPEN_HASH_SLOT) + sizeof(DWORD)), HashTable->AllocContext);
+    if (pBuffer == NULL)
+    {
+        return STATUS_HEAP_INSUFFICIENT_RESOURCES;
+    }
+
+    // the slots go first, they need the alignment
+    Array->Capacity = Capacity;
+    Array->NumberOfElements = 0;
+    Array->Slots = pBuffer;
+    Array->Hashes = (PDWORD) (Array->Slots + Capacity);
+
+    memzero(Array->Hashes, Capacity * (DWORD) sizeof(DWORD));
+
+    return STATUS_SUCCESS;
+}
+
+static
+void
+_OpenHashArrayDestroy(
+    IN      POPEN_HASH_TABLE    HashTable,
+    INOUT   POPEN_HASH_ARRAY    Array
+    )
+{
+    if (Array->Capacity != 0)
+    {
+        HashTable->FreeFunc(Array->Slots, HashTable->AllocContext);
+    }
+
+    memzero(Array, sizeof(OPEN_HASH_ARRAY));
+}
+
+static
+DWORD
+_OpenHashArrayFind(
+    IN      POPEN_HASH_ARRAY    Array,
+    IN      DWORD               Hash,
+    IN      QWORD               Key
+    )
+{
+    DWORD index;
+
+    if (Array->NumberOfElements == 0)
+    {
+        return MAX_DWORD;
+    }
+
+    index = Hash & (Array->Capacity - 1);
+
+    // There is always a free slot. Because of the Robin Hood insertion the
+    // elements found after the place where the key would have been are all
+    // farther from their home slot than the key would be.
+    for (DWORD distance = 0; ; ++distance)
+    {
+        DWORD slotHash = Array->Hashes[index];
+
+        if (slotHash == 0 || _OpenHashProbeDistance(Array, index, slotHash) < distance)
+        {
+            return MAX_DWORD;
+        }
+
+        if (slotHash == Hash && Array->Slots[index].Key == Key)
+        {
+            return index;
+        }
+
+        index = (index + 1) & (Array->Capacity - 1);
+    }
+}
+
+static
+void
+_OpenHashArrayInsert(
+    INOUT   POPEN_HASH_ARRAY    Array,
+    IN      DWORD               Hash,
+    IN      QWORD               Key,
+    IN      PVOID               Element
+    )
+{
+    OPEN_HASH_SLOT slot;
+    DWORD index;
+    DWORD distance;
+
+    ASSERT(Array->NumberOfElements + 1 < Array->Capacity);
+
+    slot.Key = Key;
+    slot.Element = Element;
+    index = Hash & (Array->Capacity - 1);
+    distance = 0;
+
+    while (Array->Hashes[index] != 0)
+    {
+        DWORD slotDistance = _OpenHashProbeDistance(Array, index, Array->Hashes[index]);
+
+        // the element which is closer to its home slot gives its place to the
+        // one being inserted and continues the search instead
+        if (slotDistance < distance)
+        {
+            OPEN_HASH_SLOT tempSlot = Array->Slots[index];
+            DWORD tempHash = Array->Hashes[index];
+
+            Array->Slots[index] = slot;
+            Array->Hashes[index] = Hash;
+
+            slot = tempSlot;
+            Hash = tempHash;
+            distance = slotDistance;
+        }
+
+        index = (index + 1) & (Array->Capacity - 1);
+        distance++;
+    }
+
+    Array->Slots[index] = slot;
+    Array->Hashes[index] = Hash;
+    Array->NumberOfElements++;
+}
+
+static
+void
+_OpenHashArrayRemoveAt(
+    INOUT   POPEN_HASH_ARRAY    Array,
+    IN      DWORD               Index
+    )
+{
+    DWORD next;
+
+    ASSERT(Array->Hashes[Index] != 0);
+
+    // move the following elements one slot back until one is found which is
+    // in its home slot, no tombstones are needed
+    for (next = (Index + 1) & (Array->Capacity - 1);
+         Array->Hashes[next] != 0 && _OpenHashProbeDistance(Array, next, Array->Hashes[next]) != 0;
+         next = (next + 1) & (Array->Capacity - 1))
+    {
+        Array->Slots[Index] = Array->Slots[next];
+        Array->Hashes[Index] = Array->Hashes[next];
+        Index = next;
+    }
+
+    Array->Hashes[Index] = 0;
+    Array->NumberOfElements--;
+}
+
+static
+BOOLEAN
+_OpenHashFind(
+    IN      POPEN_HASH_TABLE    HashTable,
+    IN      DWORD               Hash,
+    IN      QWORD               Key,
+    OUT     POPEN_HASH_ARRAY*   Array,
+    OUT     DWORD*              Index
+    )
+{
+    *Array = &HashTable->Current;
+    *Index = _OpenHashArrayFind(*Array, Hash, Key);
+    if (*Index != MAX_DWORD)
+    {
+        return TRUE;
+    }
+
+    *Array = &HashTable->Previous;
+    *Index = _OpenHashArrayFind(*Array, Hash, Key);
+
+    return *Index != MAX_DWORD;
+}
+
+static
+void
+_OpenHashMigrate(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      DWORD               NumberOfSlots
+    )
+{
+    POPEN_HASH_ARRAY pPrevious = &HashTable->Previous;
+
+    // All the slots before MigrationIndex are free: removing the element at
+    // MigrationIndex only moves back the elements after it and the elements
+    // which wrapped around to the start of the array were already moved.
+    for (DWORD i = 0; i < NumberOfSlots && pPrevious->NumberOfElements != 0; ++i)
+    {
+        DWORD index = HashTable->MigrationIndex;
+
+        ASSERT(index < pPrevious->Capacity);
+
+        if (pPrevious->Hashes[index] == 0)
+        {
+            HashTable->MigrationIndex++;
+            continue;
+        }
+
+        _OpenHashArrayInsert(&HashTable->Current,
+                             pPrevious->Hashes[index],
+                             pPrevious->Slots[index].Key,
+                             pPrevious->Slots[index].Element);
+        _OpenHashArrayRemoveAt(pPrevious, index);
+    }
+
+    if (pPrevious->NumberOfElements == 0)
+    {
+        _OpenHashArrayDestroy(HashTable, pPrevious);
+        HashTable->MigrationIndex = 0;
+    }
+}
+
+static
+STATUS
+_OpenHashMakeRoom(
+    INOUT   POPEN_HASH_TABLE    HashTable
+    )
+{
+    POPEN_HASH_ARRAY pCurrent = &HashTable->Current;
+    OPEN_HASH_ARRAY newArray;
+    STATUS status;
+
+    if (HashTable->Previous.Capacity != 0)
+    {
+        _OpenHashMigrate(HashTable, OPEN_HASH_MIGRATION_SLOTS);
+
+        // the current array is twice as large so this should never happen
+        if (HashTable->Previous.Capacity != 0
+            && pCurrent->NumberOfElements + 1 > _OpenHashMaxElements(pCurrent->Capacity))
+        {
+            _OpenHashMigrate(HashTable, MAX_DWORD);
+        }
+    }
+
+    if (HashTable->Previous.Capacity != 0
+        || pCurrent->NumberOfElements + 1 <= _OpenHashMaxElements(pCurrent->Capacity))
+    {
+        return STATUS_SUCCESS;
+    }
+
+    status = (pCurrent->Capacity <= MAX_DWORD / 2)
+        ? _OpenHashArrayCreate(HashTable, pCurrent->Capacity * 2, &newArray)
+        : STATUS_HEAP_INSUFFICIENT_RESOURCES;
+    if (!SUCCEEDED(status))
+    {
+        // the table may become fuller than it should, but it must always keep
+        // a free slot
+        return (pCurrent->NumberOfElements + 2 <= pCurrent->Capacity) ? STATUS_SUCCESS : status;
+    }
+
+    HashTable->Previous = *pCurrent;
+    HashTable->MigrationIndex = 0;
+    *pCurrent = newArray;
+
+    _OpenHashMigrate(HashTable, OPEN_HASH_MIGRATION_SLOTS);
+
+    return STATUS_SUCCESS;
+}
+
+static
+STATUS
+_OpenHashInsert(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key,
+    IN      PVOID               Element,
+    OUT_OPT PVOID*              PreviousElement
+    )
+{
+    POPEN_HASH_ARRAY pArray;
+    DWORD index;
+    DWORD hash;
+    STATUS status;
+
+    ASSERT(Element != NULL);
+
+    hash = _OpenHashComputeHash(HashTable, Key);
+
+    if (_OpenHashFind(HashTable, hash, Key, &pArray, &index))
+    {
+        if (PreviousElement != NULL)
+        {
+            *PreviousElement = pArray->Slots[index].Element;
+        }
+
+        pArray->Slots[index].Element = Element;
+
+        return STATUS_SUCCESS;
+    }
+
+    status = _OpenHashMakeRoom(HashTable);
+    if (!SUCCEEDED(status))
+    {
+        return status;
+    }
+
+    _OpenHashArrayInsert(&HashTable->Current, hash, Key, Element);
+
+    if (PreviousElement != NULL)
+    {
+        *PreviousElement = NULL;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+PVOID
+_OpenHashRemove(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key
+    )
+{
+    POPEN_HASH_ARRAY pArray;
+    DWORD index;
+    PVOID pElement;
+
+    if (!_OpenHashFind(HashTable, _OpenHashComputeHash(HashTable, Key), Key, &pArray, &index))
+    {
+        return NULL;
+    }
+
+    pElement = pArray->Slots[index].Element;
+    _OpenHashArrayRemoveAt(pArray, index);
+
+    return pElement;
+}
+
+static
+PVOID
+_OpenHashLookup(
+    IN      POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key
+    )
+{
+    POPEN_HASH_ARRAY pArray;
+    DWORD index;
+
+    return _OpenHashFind(HashTable, _OpenHashComputeHash(HashTable, Key), Key, &pArray, &index)
+        ? pArray->Slots[index].Element
+        : NULL;
+}
+
+static
+void
+_OpenHashIteratorStartArray(
+    INOUT   POPEN_HASH_ITERATOR HashIterator,
+    IN      POPEN_HASH_ARRAY    Array
+    )
+{
+    DWORD freeIndex;
+
+    HashIterator->Array = Array;
+    HashIterator->LastKeyValid = FALSE;
+
+    if (Array->NumberOfElements == 0)
+    {
+        HashIterator->Index = 0;
+        HashIterator->SlotsLeft = 0;
+        return;
+    }
+
+    freeIndex = 0;
+    while (Array->Hashes[freeIndex] != 0)
+    {
+        freeIndex++;
+    }
+
+    HashIterator->Index = (freeIndex + 1) & (Array->Capacity - 1);
+    HashIterator->SlotsLeft = Array->Capacity - 1;
+}
+
+SAL_SUCCESS
+STATUS
+OpenHashTableInit(
+    OUT     POPEN_HASH_TABLE    HashTable,
+    IN      DWORD               InitialCapacity,
+    IN      DWORD               KeySize,
+    IN_OPT  PFUNC_HashFunction  HashFunction,
+    IN      INT32               OffsetToKey,
+    IN      PFUNC_OpenHashAlloc AllocFunction,
+    IN      PFUNC_FreeFunction  FreeFunction,
+    IN_OPT  PVOID               AllocContext
+    )
+{
+    DWORD capacity;
+
+    ASSERT(HashTable != NULL);
+    ASSERT(0 < KeySize && KeySize <= sizeof(QWORD));
+    ASSERT(AllocFunction != NULL);
+    ASSERT(FreeFunction != NULL);
+
+    memzero(HashTable, sizeof(OPEN_HASH_TABLE));
+
+    HashTable->KeySize = KeySize;
+    HashTable->OffsetToKey = OffsetToKey;
+    HashTable->HashFunc = HashFunction;
+    HashTable->AllocFunc = AllocFunction;
+    HashTable->FreeFunc = FreeFunction;
+    HashTable->AllocContext = AllocContext;
+
+    for (capacity = OPEN_HASH_TABLE_MIN_CAPACITY;
+         _OpenHashMaxElements(capacity) < InitialCapacity;
+         capacity = capacity * 2)
+    {
+        if (capacity > MAX_DWORD / 2)
+        {
+            return STATUS_HEAP_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    return _OpenHashArrayCreate(HashTable, capacity, &HashTable->Current);
+}
+
+void
+OpenHashTableUninit(
+    INOUT   POPEN_HASH_TABLE    HashTable
+    )
+{
+    ASSERT(HashTable != NULL);
+
+    _OpenHashArrayDestroy(HashTable, &HashTable->Previous);
+    _OpenHashArrayDestroy(HashTable, &HashTable->Current);
+}
+
+void
+OpenHashTableClear(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN_OPT  PFUNC_FreeFunction  FreeFunction,
+    IN_OPT  PVOID               FreeContext
+    )
+{
+    ASSERT(HashTable != NULL);
+
+    for (DWORD i = 0; i < 2; ++i)
+    {
+        POPEN_HASH_ARRAY pArray = (i == 0) ? &HashTable->Previous : &HashTable->Current;
+
+        for (DWORD j = 0; j < pArray->Capacity && FreeFunction != NULL; ++j)
+        {
+            if (pArray->Hashes[j] != 0)
+            {
+                FreeFunction(pArray->Slots[j].Element, FreeContext);
+            }
+        }
+    }
+
+    _OpenHashArrayDestroy(HashTable, &HashTable->Previous);
+    HashTable->MigrationIndex = 0;
+
+    memzero(HashTable->Current.Hashes, HashTable->Current.Capacity * (DWORD) sizeof(DWORD));
+    HashTable->Current.NumberOfElements = 0;
+}
+
+DWORD
+OpenHashTableSize(
+    IN      POPEN_HASH_TABLE    HashTable
+    )
+{
+    ASSERT(HashTable != NULL);
+
+    return HashTable->Current.NumberOfElements + HashTable->Previous.NumberOfElements;
+}
+
+SAL_SUCCESS
+STATUS
+OpenHashTableInsert(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    INOUT   PHASH_ENTRY         Element,
+    OUT_OPT PHASH_ENTRY*        PreviousElement
+    )
+{
+    ASSERT(HashTable != NULL);
+    ASSERT(Element != NULL);
+
+    return _OpenHashInsert(HashTable,
+                           _OpenHashReadKey(HashTable, (PHASH_KEY) ((PBYTE)Element + HashTable->OffsetToKey)),
+                           Element,
+                           (PVOID*) PreviousElement);
+}
+
+PTR_SUCCESS
+PHASH_ENTRY
+OpenHashTableRemove(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      PHASH_KEY           Key
+    )
+{
+    ASSERT(HashTable != NULL);
+
+    return _OpenHashRemove(HashTable, _OpenHashReadKey(HashTable, Key));
+}
+
+void
+OpenHashTableRemoveEntry(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      PHASH_ENTRY         Element
+    )
+{
+    PHASH_ENTRY pRemoved;
+
+    ASSERT(HashTable != NULL);
+    ASSERT(Element != NULL);
+
+    pRemoved = _OpenHashRemove(HashTable,
+                               _OpenHashReadKey(HashTable, (PHASH_KEY) ((PBYTE)Element + HashTable->OffsetToKey)));
+    ASSERT(pRemoved == Element);
+}
+
+PTR_SUCCESS
+PHASH_ENTRY
+OpenHashTableLookup(
+    IN      POPEN_HASH_TABLE    HashTable,
+    IN      PHASH_KEY           Key
+    )
+{
+    ASSERT(HashTable != NULL);
+
+    return _OpenHashLookup(HashTable, _OpenHashReadKey(HashTable, Key));
+}
+
+SAL_SUCCESS
+STATUS
+OpenHashTableInsertValue(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key,
+    IN      PVOID               Value,
+    OUT_OPT PVOID*              PreviousValue
+    )
+{
+    ASSERT(HashTable != NULL);
+
+    return _OpenHashInsert(HashTable, _OpenHashNormalizeKey(HashTable, Key), Value, PreviousValue);
+}
+
+BOOLEAN
+OpenHashTableRemoveValue(
+    INOUT   POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key,
+    OUT_OPT PVOID*              Value
+    )
+{
+    PVOID pValue;
+
+    ASSERT(HashTable != NULL);
+
+    pValue = _OpenHashRemove(HashTable, _OpenHashNormalizeKey(HashTable, Key));
+    if (Value != NULL)
+    {
+        *Value = pValue;
+    }
+
+    return pValue != NULL;
+}
+
+BOOLEAN
+OpenHashTableLookupValue(
+    IN      POPEN_HASH_TABLE    HashTable,
+    IN      QWORD               Key,
+    OUT_OPT PVOID*              Value
+    )
+{
+    PVOID pValue;
+
+    ASSERT(HashTable != NULL);
+
+    pValue = _OpenHashLookup(HashTable, _OpenHashNormalizeKey(HashTable, Key));
+    if (Value != NULL)
+    {
+        *Value = pValue;
+    }
+
+    return pValue != NULL;
+}
+
+void
+OpenHashTableIteratorInit(
+    IN      POPEN_HASH_TABLE    HashTable,
+    OUT     POPEN_HASH_ITERATOR HashIterator
+    )
+{
+    ASSERT(HashTable != NULL);
+    ASSERT(HashIterator != NULL);
+
+    HashIterator->HashTable = HashTable;
+
+    _OpenHashIteratorStartArray(HashIterator,
+                                (HashTable->Previous.Capacity != 0) ? &HashTable->Previous : &HashTable->Current);
+}
+
+PHASH_ENTRY
+OpenHashTableIteratorNext(
+    INOUT   POPEN_HASH_ITERATOR HashIterator
+    )
+{
+    ASSERT(HashIterator != NULL);
+
+#pragma warning(suppress:4127)
+    while (TRUE)
+    {
+        POPEN_HASH_ARRAY pArray = HashIterator->Array;
+        DWORD mask = pArray->Capacity - 1;
+
+        if (HashIterator->LastKeyValid)
+        {
+            DWORD lastIndex = (HashIterator->Index - 1) & mask;
+
+            // if the element returned last was removed the following element
+            // may have been moved back in its slot
+            if (pArray->Hashes[lastIndex] != 0 && pArray->Slots[lastIndex].Key != HashIterator->LastKey)
+            {
+                HashIterator->Index = lastIndex;
+                HashIterator->SlotsLeft++;
+            }
+
+            HashIterator->LastKeyValid = FALSE;
+        }
+
+        while (HashIterator->SlotsLeft != 0)
+        {
+            DWORD index = HashIterator->Index;
+
+            HashIterator->Index = (index + 1) & mask;
+            HashIterator->SlotsLeft--;
+
+            if (pArray->Hashes[index] != 0)
+            {
+                HashIterator->LastKey = pArray->Slots[index].Key;
+                HashIterator->LastKeyValid = TRUE;
+
+                return pArray->Slots[index].Element;
+            }
+        }
+
+        if (pArray == &HashIterator->HashTable->Current)
+        {
+            return NULL;
+        }
+
+        _OpenHashIteratorStartArray(HashIterator, &HashIterator->HashTable->Current);
+    }
+}
\ No newline at end of file
@@ -2,6 +2,26 @@
 #include "ref_cnt.h"
 #include "memory.h"
 
+static
+void
+_RfcFree(
+    INOUT   REF_COUNT*              Object
+    );
+
+static
+DWORD
+_RfcMergeBiasedReferences(
+    INOUT   REF_COUNT*              Object
+    );
+
+static
+DWORD
+_RfcDereferenceEx(
+    INOUT   REF_COUNT*              Object,
+    IN_OPT  PRFC_OWNER              CurrentOwner,
+    OUT     BOOLEAN*                LastReference
+    );
+
 void
 RfcPreInit(
     OUT     REF_COUNT*              Object
@@ -35,6 +55,34 @@ RfcInit(
     return status;
 }
 
+STATUS
+RfcInitBiased(
+    OUT     REF_COUNT*              Object,
+    IN_OPT  PFUNC_FreeFunction      FreeFunction,
+    IN_OPT  PVOID                   Context,
+    IN      PRFC_OWNER              Owner
+    )
+{
+    if (NULL == Object)
+    {
+        return STATUS_INVALID_PARAMETER1;
+    }
+
+    if (NULL == Owner)
+    {
+        return STATUS_INVALID_PARAMETER4;
+    }
+
+    Object->FreeFunction = FreeFunction;
+    Object->Context = Context;
+    Object->ReferenceCount = RFC_OWNER_BIAS;
+    Object->Owner = Owner;
+    Object->BiasedCount = 1;
+    Object->MergeRequested = FALSE;
+
+    return STATUS_SUCCESS;
+}
+
 SIZE_SUCCESS
 DWORD
 RfcReference(
@@ -70,11 +118,224 @@ RfcDereference(
 
     if (0 == newRefCount)
     {
-        if (NULL != Object->FreeFunction)
+        _RfcFree(Object);
+    }
+
+    return newRefCount;
+}
+
+SIZE_SUCCESS
+DWORD
+RfcReferenceEx(
+    INOUT   REF_COUNT*              Object,
+    IN_OPT  PRFC_OWNER              CurrentOwner
+    )
+{
+    ASSERT(NULL != Object);
+
+    // only the owner sets Owner to NULL => for the others the comparison
+    // fails regardless of when the owner merges
+    if (NULL == CurrentOwner || CurrentOwner != Object->Owner)
+    {
+        return RfcReference(Object);
+    }
+
+    ASSERT(0 != Object->BiasedCount);
+
+    Object->BiasedCount++;
+    ASSERT_INFO(RFC_OWNER_BIAS > Object->BiasedCount, "Reached max biased reference count");
+
+    return Object->BiasedCount + (Object->ReferenceCount - RFC_OWNER_BIAS);
+}
+
+SIZE_SUCCESS
+DWORD
+RfcDereferenceEx(
+    INOUT   REF_COUNT*              Object,
+    IN_OPT  PRFC_OWNER              CurrentOwner
+    )
+{
+    DWORD newRefCount;
+    BOOLEAN bLastReference;
+
+    ASSERT(NULL != Object);
+
+    newRefCount = _RfcDereferenceEx(Object, CurrentOwner, &bLastReference);
+    if (bLastReference)
+    {
+        _RfcFree(Object);
+    }
+
+    return newRefCount;
+}
+
+BOOLEAN
+RfcDereferenceNoFree(
+    INOUT   REF_COUNT*              Object,
+    IN_OPT  PRFC_OWNER              CurrentOwner
+    )
+{
+    BOOLEAN bLastReference;
+
+    ASSERT(NULL != Object);
+
+    _RfcDereferenceEx(Object, CurrentOwner, &bLastReference);
+
+    return bLastReference;
+}
+
+void
+RfcFree(
+    INOUT   REF_COUNT*              Object
+    )
+{
+    ASSERT(NULL != Object);
+    ASSERT(0 == Object->ReferenceCount && NULL == Object->Owner);
+
+    _RfcFree(Object);
+}
+
+void
+RfcOwnerInit(
+    OUT     PRFC_OWNER              Owner
+    )
+{
+    ASSERT(NULL != Owner);
+
+    ClInitializeInterlockedSListHead(&Owner->MergeRequests);
+}
+
+void
+RfcOwnerProcessMergeRequests(
+    INOUT   PRFC_OWNER              Owner
+    )
+{
+    PCL_SLIST_ENTRY pEntry;
+
+    ASSERT(NULL != Owner);
+
+    // cheap check, this is called often and there are rarely any requests
+    if (NULL == Owner->MergeRequests.First)
+    {
+        return;
+    }
+
+    pEntry = ClInterlockedFlushSList(&Owner->MergeRequests);
+    while (NULL != pEntry)
+    {
+        REF_COUNT* pObject = CONTAINING_RECORD(pEntry, REF_COUNT, MergeEntry);
+
+        // the object may be freed by the dereference
+        pEntry = pEntry->Next;
+
+        ASSERT(pObject->MergeRequested);
+
+        // the owner may have already merged when it dropped its last
+        // reference, the reference handed over with the request kept the
+        // object alive
+        if (NULL != pObject->Owner)
+        {
+            ASSERT(Owner == pObject->Owner);
+
+            _RfcMergeBiasedReferences(pObject);
+        }
+
+        RfcDereference(pObject);
+    }
+}
+
+static
+void
+_RfcFree(
+    INOUT   REF_COUNT*              Object
+    )
+{
+    ASSERT(NULL != Object);
+
+    if (NULL != Object->FreeFunction)
+    {
+        Object->FreeFunction(Object, Object->Context);
+    }
+}
+
+static
+DWORD
+_RfcMergeBiasedReferences(
+    INOUT   REF_COUNT*              Object
+    )
+{
+    DWORD biasedCount;
+
+    ASSERT(NULL != Object);
+    ASSERT(NULL != Object->Owner);
+
+    biasedCount = Object->BiasedCount;
+
+    Object->BiasedCount = 0;
+    Object->Owner = NULL;
+
+    // a single interlocked operation replaces the bias with the references
+    // of the owner => the shared count never passes through 0 on the way
+    return _InterlockedExchangeAdd(&Object->ReferenceCount, biasedCount - RFC_OWNER_BIAS)
+        + biasedCount - RFC_OWNER_BIAS;
+}
+
+static
+DWORD
+_RfcDereferenceEx(
+    INOUT   REF_COUNT*              Object,
+    IN_OPT  PRFC_OWNER              CurrentOwner,
+    OUT     BOOLEAN*                LastReference
+    )
+{
+    PRFC_OWNER pOwner;
+    DWORD newRefCount;
+
+    ASSERT(NULL != Object);
+    ASSERT(NULL != LastReference);
+
+    *LastReference = FALSE;
+    pOwner = Object->Owner;
+
+    if (NULL != pOwner && CurrentOwner == pOwner)
+    {
+        ASSERT(0 != Object->BiasedCount);
+
+        Object->BiasedCount--;
+        if (0 != Object->BiasedCount)
         {
-            Object->FreeFunction(Object, Object->Context);
+            return Object->BiasedCount + (Object->ReferenceCount - RFC_OWNER_BIAS);
         }
+
+        // the owner dropped its last reference, from now on all the
+        // references are counted in the shared count
+        newRefCount = _RfcMergeBiasedReferences(Object);
+        *LastReference = (0 == newRefCount);
+
+        return newRefCount;
     }
 
+    if (NULL != pOwner &&
+        FALSE == _InterlockedCompareExchange8(&Object->MergeRequested, TRUE, FALSE))
+    {
+        // we can't tell how many of the references of the owner are still
+        // held => instead of dropping our reference we hand it to the owner,
+        // it keeps the object alive until the owner merges
+        newRefCount = Object->BiasedCount + (Object->ReferenceCount - RFC_OWNER_BIAS) - 1;
+
+        // the object must not be accessed after it is pushed, the owner may
+        // free it right away
+        ClInterlockedPushEntrySList(&pOwner->MergeRequests, &Object->MergeEntry);
+
+        return newRefCount;
+    }
+
+    // the shared count includes the bias until the merge => it can't reach 0
+    // before the owner released its references
+    newRefCount = (DWORD)_InterlockedDecrement(&Object->ReferenceCount);
+    ASSERT_INFO(MAX_DWORD != newRefCount, "Object reference count reached -1");
+
+    *LastReference = (0 == newRefCount);
+
     return newRefCount;
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "common_lib.h"
+#include "lock_common.h"
+
+#ifndef _COMMONLIB_NO_LOCKS_
+
+void
+SeqlockInit(
+    OUT     PSEQLOCK        Seqlock
+    )
+{
+    ASSERT(NULL != Seqlock);
+
+    memzero(Seqlock, sizeof(SEQLOCK));
+
+    SpinlockInit(&Seqlock->WriterLock);
+}
+
+DWORD
+SeqlockReadBegin(
+    IN      PSEQLOCK        Seqlock
+    )
+{
+    DWORD sequence;
+
+    ASSERT(NULL != Seqlock);
+
+    for (sequence = Seqlock->Sequence;
+         IsBooleanFlagOn(sequence, 1);
+         sequence = Seqlock->Sequence)
+    {
+        _mm_pause();
+    }
+
+    // loads are not reordered with older loads on x86, only the compiler
+    // must be kept from reading the data before the sequence
+    _ReadWriteBarrier();
+
+    return sequence;
+}
+
+BOOLEAN
+SeqlockReadRetry(
+    IN      PSEQLOCK        Seqlock,
+    IN      DWORD           Sequence
+    )
+{
+    ASSERT(NULL != Seqlock);
+
+    _ReadWriteBarrier();
+
+    return Sequence != Seqlock->Sequence;
+}
+
+REQUIRES_NOT_HELD_LOCK(*Seqlock)
+ACQUIRES_EXCL_AND_NON_REENTRANT_LOCK(*Seqlock)
+void
+SeqlockWriteAcquire(
+    INOUT   PSEQLOCK        Seqlock,
+    OUT     INTR_STATE*     IntrState
+    )
+{
+    ASSERT(NULL != Seqlock);
+    ASSERT(NULL != IntrState);
+
+    SpinlockAcquire(&Seqlock->WriterLock, IntrState);
+
+    // odd => readers wait or retry, the interlocked operation also keeps the
+    // data stores from being done before it
+    _InterlockedIncrement(&Seqlock->Sequence);
+    _Analysis_assume_lock_acquired_(*Seqlock);
+}
+
+REQUIRES_EXCL_LOCK(*Seqlock)
+RELEASES_EXCL_AND_NON_REENTRANT_LOCK(*Seqlock)
+void
+SeqlockWriteRelease(
+    INOUT   PSEQLOCK        Seqlock,
+    IN      INTR_STATE      IntrState
+    )
+{
+    ASSERT(NULL != Seqlock);
+    ASSERT(IsBooleanFlagOn(Seqlock->Sequence, 1));
+
+    _InterlockedIncrement(&Seqlock->Sequence);
+    _Analysis_assume_lock_released_(*Seqlock);
+
+    SpinlockRelease(&Seqlock->WriterLock, IntrState);
+}
+
+#endif // _COMMONLIB_NO_LOCKS_
\ No newline at end of file
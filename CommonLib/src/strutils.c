@@ -1,19 +1,25 @@
 #include "common_lib.h"
 #include "strutils.h"
 
-__forceinline
-void
-swap(
-    INOUT   BYTE* a,
-    INOUT   BYTE* b
-    )
-{
-    *a ^= *b;
-    *b ^= *a;
-    *a ^= *b;
-}
-
-void
+// enough for a 64 bit value in base two
+#define ITOA_MAX_DIGITS             BITS_FOR_STRUCTURE(QWORD)
+
+// "00" "01" ... "99", two decimal digits are produced for each division
+static const char DECIMAL_DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char DIGITS[] = "0123456789ABCDEF";
+
+DWORD
 itoa(
     IN      PVOID       valueAddress,
     IN      BOOLEAN     signedValue,
@@ -22,8 +28,9 @@ itoa(
     IN      BOOLEAN     is64BitValue
     )
 {
-    DWORD index = 0;
-    DWORD i;
+    char digits[ITOA_MAX_DIGITS];
+    DWORD index;
+    DWORD length;
     QWORD value;
     BOOLEAN negative;
 
@@ -43,14 +50,9 @@ itoa(
             }
         }
 
-        if (negative)
-        {
-            value = (-(*(INT64*)valueAddress));
-        }
-        else
-        {
-            value = *(QWORD*)valueAddress;
-        }
+        // the negation is done on unsigned values, it is also correct for
+        // the smallest negative number
+        value = negative ? 0 - *(QWORD*)valueAddress : *(QWORD*)valueAddress;
     }
     else
     {
@@ -62,59 +64,87 @@ itoa(
             }
         }
 
-        if (negative)
-        {
-            value = (-(*(INT32*)valueAddress));
-        }
-        else
-        {
-            value = *(DWORD*)valueAddress;
-        }
+        value = negative ? 0 - (QWORD)*(INT32*)valueAddress : *(DWORD*)valueAddress;
     }
 
+    // the digits are generated starting with the least significant one at
+    // the end of the local buffer
+    index = ITOA_MAX_DIGITS;
 
-
-    if (0 == value)
+    if (BASE_TEN == base)
     {
-        buffer[index] = '0';
-        index++;
-    }
+        DWORD pair;
 
-    // we convert the number and get a 
-    // reversed ordered string
-    while (0 != value)
-    {
-        // we get the current digit
-        int digit = (value % base);
+        // the divisions by a constant are done with multiplications
+        while (value >= 100)
+        {
+            pair = (DWORD)(value % 100) * 2;
+            value = value / 100;
+
+            index = index - 2;
+            digits[index] = DECIMAL_DIGIT_PAIRS[pair];
+            digits[index + 1] = DECIMAL_DIGIT_PAIRS[pair + 1];
+        }
 
-        // we convert it to an ASCII character
-        if (digit > 9)
+        if (value >= 10)
         {
-            buffer[index] = (char)(digit - 10) + 'A';
+            pair = (DWORD)value * 2;
+
+            index = index - 2;
+            digits[index] = DECIMAL_DIGIT_PAIRS[pair];
+            digits[index + 1] = DECIMAL_DIGIT_PAIRS[pair + 1];
         }
         else
         {
-            buffer[index] = (char)digit + '0';
+            index--;
+            digits[index] = DIGITS[value];
+        }
+    }
+    else if (0 == (base & (base - 1)) && base <= sizeof(DIGITS) - 1)
+    {
+        DWORD shift;
+
+        // each digit is a group of bits
+        shift = 0;
+        while ((1UL << shift) < base)
+        {
+            shift++;
         }
 
-        value = value / base;
-        index++;
+        do
+        {
+            index--;
+            digits[index] = DIGITS[value & (base - 1)];
+            value = value >> shift;
+        } while (0 != value);
+    }
+    else
+    {
+        do
+        {
+            DWORD digit = (DWORD)(value % base);
+
+            index--;
+            digits[index] = (digit > 9) ? (char)(digit - 10) + 'A' : (char)digit + '0';
+            value = value / base;
+        } while (0 != value);
     }
 
+    length = 0;
+
     if (negative)
     {
-        buffer[index] = '-';
-        index++;
+        buffer[length] = '-';
+        length++;
     }
 
+    memcpy(buffer + length, digits + index, ITOA_MAX_DIGITS - index);
+    length = length + ITOA_MAX_DIGITS - index;
+
     // we null terminate the string
-    buffer[index] = '\0';
+    buffer[length] = '\0';
 
-    for (i = 0; i < index / 2; ++i)
-    {
-        // we reverse the string to have it ordered right
-        swap((BYTE*)&buffer[i], (BYTE*)&buffer[index - i - 1]);
-    }
+    return length;
 }
 
 void
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+namespace UtCl
+{
+    enum class BenchmarkFormat
+    {
+        Text,
+
+        // one comma separated line per benchmark, without the log prefix,
+        // so the results can be diffed or loaded by other tools
+        Csv
+    };
+
+    class Benchmark
+    {
+    public:
+        static void SetFormat(
+            _In_ BenchmarkFormat Format
+        );
+
+        // only the benchmarks whose name starts with Filter are run
+        static void SetFilter(
+            _In_ const std::string& Filter
+        );
+
+        static void PrintHeader();
+
+        // Sample must execute OperationsPerSample operations, it is called
+        // repeatedly until enough samples were collected. Setup, if present,
+        // is called before each sample and is not timed. The percentiles are
+        // computed over the per operation time of each sample.
+        static void Run(
+            _In_        const std::string&              Name,
+            _In_        QWORD                           Size,
+            _In_        DWORD                           OperationsPerSample,
+            _In_        const std::function<void()>&    Sample,
+            _In_opt_    const std::function<void()>&    Setup = nullptr
+        );
+
+    private:
+        static BenchmarkFormat m_format;
+        static std::string m_filter;
+    };
+}
+
+STATUS
+UtClBenchmarkSuite();
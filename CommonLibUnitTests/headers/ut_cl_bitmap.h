@@ -1,6 +1,7 @@
 #pragma once
 
-BOOLEAN
-TcBitmapRun(
-    void
-    );
\ No newline at end of file
+STATUS
+UtClBitmap();
+
+STATUS
+UtClBitmapBenchmark();
\ No newline at end of file
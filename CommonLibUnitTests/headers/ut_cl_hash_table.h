@@ -2,3 +2,9 @@
 
 STATUS
 UtClHashTable();
+
+STATUS
+UtClOpenHashTable();
+
+STATUS
+UtClHashTableBenchmark();
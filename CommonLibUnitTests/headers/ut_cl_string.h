@@ -4,3 +4,8 @@ STATUS
 UtClStrings(
     void
     );
+
+STATUS
+UtClFormatting(
+    void
+    );
@@ -7,6 +7,12 @@
 #include "ut_cl_string.h"
 #include "ut_cl_stack_dynamic.h"
 #include "ut_cl_hash_table.h"
+#include "ut_cl_checksum.h"
+#include "ut_cl_bitmap.h"
+#include "ut_cl_memory.h"
+#include "ut_cl_interlocked_list.h"
+#include "ut_cl_ref_cnt.h"
+#include "ut_cl_benchmark.h"
 
 typedef struct _CL_UNIT_TEST
 {
@@ -24,14 +30,29 @@ STATUS TstStrings(void)
 const CL_UNIT_TEST CL_TESTS[] =
 {
     {"Strings", UtClStrings},
+    {"Formatting", UtClFormatting},
     {"Memory", TstStrings},
+    {"MemoryPrimitives", UtClMemory},
+    {"MemoryPrimitivesBenchmark", UtClMemoryBenchmark},
     {"DynamicStack", UtClStackDynamic},
     {"HashTable", UtClHashTable},
+    {"OpenHashTable", UtClOpenHashTable},
+    {"HashTableBenchmark", UtClHashTableBenchmark},
+    {"Checksum", UtClChecksum},
+    {"ChecksumBenchmark", UtClChecksumBenchmark},
+    {"InterlockedList", UtClInterlockedList},
+    {"RefCount", UtClRefCount},
+    {"Bitmap", UtClBitmap},
+    {"BitmapBenchmark", UtClBitmapBenchmark},
 };
 
 static constexpr auto NO_OF_CL_TESTS = ARRAYSIZE(CL_TESTS);
 static constexpr auto DEFAULT_TIMES_TO_RUN = 1;
 
+// runs the timed benchmark suite instead of a test case
+static constexpr auto BENCHMARK_MODE = "-benchmark";
+static constexpr auto BENCHMARK_FORMAT_CSV = "csv";
+
 int main(
     int argc,
     char* argv[]
@@ -58,9 +79,24 @@ int main(
     if (argc < 2)
     {
         LOG_ERROR("Usage %s $TEST_CASE [$NO_OF_TIMES]\n", argv[0]);
+        LOG_ERROR("Usage %s %s [text|%s] [$BENCHMARK_NAME_PREFIX]\n",
+            argv[0], BENCHMARK_MODE, BENCHMARK_FORMAT_CSV);
         return 1;
     }
 
+    if (std::string(argv[1]) == BENCHMARK_MODE)
+    {
+        UtCl::Benchmark::SetFormat((argc >= 3 && std::string(argv[2]) == BENCHMARK_FORMAT_CSV)
+                                   ? UtCl::BenchmarkFormat::Csv
+                                   : UtCl::BenchmarkFormat::Text);
+        if (argc >= 4)
+        {
+            UtCl::Benchmark::SetFilter(argv[3]);
+        }
+
+        return UtClBenchmarkSuite();
+    }
+
     auto timesToRun = (argc >= 3) ? std::strtol(argv[2], nullptr, 10) : DEFAULT_TIMES_TO_RUN;
     auto tstToRun = argv[1];
 
@@ -0,0 +1,476 @@
+#include "ut_base.h"
+#include "ut_cl_benchmark.h"
+#include "ut_cl_rng.h"
+#include "cl_string.h"
+#include "bitmap.h"
+#include "list.h"
+#include "hash_table.h"
+#include "open_hash_table.h"
+#include "ref_cnt.h"
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+// a benchmark runs until it has both enough samples for the percentiles to be
+// meaningful and it ran long enough for the clock resolution not to matter
+static constexpr DWORD MIN_SAMPLES = 50;
+static constexpr DWORD MAX_SAMPLES = 10'000;
+static constexpr double MIN_DURATION_SECONDS = 0.2;
+
+static constexpr DWORD BITMAP_SIZES[] = { 4096, 64 * 1024, MB_SIZE };
+static constexpr DWORD BITMAP_SCANS_PER_SAMPLE = 16;
+
+static constexpr DWORD CONTAINER_SIZES[] = { 256, 4096, 64 * 1024 };
+
+static constexpr DWORD MEMORY_SIZES[] = { 16, 256, 4096, 64 * 1024, MB_SIZE };
+static constexpr QWORD MEMORY_BYTES_PER_SAMPLE = 4 * MB_SIZE;
+
+static constexpr DWORD STRING_SIZES[] = { 8, 64, 256 };
+static constexpr DWORD FORMAT_BUFFER_SIZE = 512;
+static constexpr DWORD FORMATS_PER_SAMPLE = 1000;
+
+static constexpr DWORD REFERENCES_PER_SAMPLE = 1000;
+
+typedef struct _UT_BENCHMARK_ELEM
+{
+    HASH_ENTRY                  HashEntry;
+    LIST_ENTRY                  ListEntry;
+
+    QWORD                       Key;
+} UT_BENCHMARK_ELEM, *PUT_BENCHMARK_ELEM;
+
+namespace UtCl
+{
+    BenchmarkFormat Benchmark::m_format = BenchmarkFormat::Text;
+    std::string Benchmark::m_filter;
+
+    void Benchmark::SetFormat(
+        _In_ BenchmarkFormat Format
+    )
+    {
+        m_format = Format;
+    }
+
+    void Benchmark::SetFilter(
+        _In_ const std::string& Filter
+    )
+    {
+        m_filter = Filter;
+    }
+
+    void Benchmark::PrintHeader()
+    {
+        if (m_format == BenchmarkFormat::Csv)
+        {
+            printf("benchmark,size,samples,ops_per_sec,p50_ns,p90_ns,p99_ns,max_ns\n");
+        }
+        else
+        {
+            LOG("%-28s %10s %8s %14s %10s %10s %10s %10s\n",
+                "Benchmark", "Size", "Samples", "ops/s", "p50 ns", "p90 ns", "p99 ns", "max ns");
+        }
+    }
+
+    void Benchmark::Run(
+        _In_        const std::string&              Name,
+        _In_        QWORD                           Size,
+        _In_        DWORD                           OperationsPerSample,
+        _In_        const std::function<void()>&    Sample,
+        _In_opt_    const std::function<void()>&    Setup
+    )
+    {
+        std::vector<double> nsPerOperation;
+        double totalSeconds = 0;
+
+        ASSERT(OperationsPerSample != 0);
+
+        if (Name.compare(0, m_filter.size(), m_filter) != 0)
+        {
+            return;
+        }
+
+        // warm up the caches and the branch predictors
+        if (Setup) Setup();
+        Sample();
+
+        while (nsPerOperation.size() < MAX_SAMPLES &&
+               (nsPerOperation.size() < MIN_SAMPLES || totalSeconds < MIN_DURATION_SECONDS))
+        {
+            if (Setup) Setup();
+
+            auto start = std::chrono::high_resolution_clock::now();
+            Sample();
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            totalSeconds += elapsed.count();
+            nsPerOperation.push_back(elapsed.count() * 1e9 / OperationsPerSample);
+        }
+
+        std::sort(nsPerOperation.begin(), nsPerOperation.end());
+
+        auto percentile = [&nsPerOperation](DWORD Percent)
+        {
+            return nsPerOperation[(nsPerOperation.size() - 1) * Percent / 100];
+        };
+
+        double opsPerSecond = (double) nsPerOperation.size() * OperationsPerSample / totalSeconds;
+
+        if (m_format == BenchmarkFormat::Csv)
+        {
+            printf("%s,%llu,%u,%.1f,%.2f,%.2f,%.2f,%.2f\n",
+                Name.c_str(), Size, (DWORD) nsPerOperation.size(), opsPerSecond,
+                percentile(50), percentile(90), percentile(99), nsPerOperation.back());
+        }
+        else
+        {
+            LOG("%-28s %10llu %8u %14.1f %10.2f %10.2f %10.2f %10.2f\n",
+                Name.c_str(), Size, (DWORD) nsPerOperation.size(), opsPerSecond,
+                percentile(50), percentile(90), percentile(99), nsPerOperation.back());
+        }
+    }
+}
+
+static
+PVOID
+(__cdecl _BenchmarkAlloc)(
+    IN      DWORD               Size,
+    IN_OPT  PVOID               Context
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    return new BYTE[Size];
+}
+
+static
+void
+(__cdecl _BenchmarkFree)(
+    IN      PVOID               Object,
+    IN_OPT  PVOID               Context
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    delete[] (PBYTE) Object;
+}
+
+static
+void
+_BenchmarkBitmap()
+{
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    volatile DWORD sink = 0;
+
+    for (const auto bits : BITMAP_SIZES)
+    {
+        std::vector<BYTE> buffer(bits / BITS_PER_BYTE);
+        BITMAP bitmap;
+
+        BitmapPreinit(&bitmap, bits);
+        BitmapInit(&bitmap, buffer.data());
+
+        // mostly used memory with a free run at the end, every scan has to
+        // walk the whole bitmap
+        for (DWORD i = 0; i < bits - 64; ++i)
+        {
+            if (rng.GetNextRandom() % 100 < 90)
+            {
+                BitmapSetBit(&bitmap, i);
+            }
+        }
+
+        UtCl::Benchmark::Run("BitmapScan", bits, BITMAP_SCANS_PER_SAMPLE, [&]()
+        {
+            for (DWORD i = 0; i < BITMAP_SCANS_PER_SAMPLE; ++i)
+            {
+                sink = BitmapScan(&bitmap, 32, FALSE);
+            }
+        });
+
+        UtCl::Benchmark::Run("BitmapCountSetBits", bits, BITMAP_SCANS_PER_SAMPLE, [&]()
+        {
+            for (DWORD i = 0; i < BITMAP_SCANS_PER_SAMPLE; ++i)
+            {
+                sink = BitmapCountSetBits(&bitmap);
+            }
+        });
+
+        // single bit allocations until the bitmap is full
+        UtCl::Benchmark::Run("BitmapScanNextFitAndFlip", bits, bits, [&]()
+        {
+            for (DWORD i = 0; i < bits; ++i)
+            {
+                sink = BitmapScanNextFitAndFlip(&bitmap, 0, 1, FALSE);
+            }
+        },
+        [&]()
+        {
+            BitmapInit(&bitmap, buffer.data());
+        });
+    }
+}
+
+static
+void
+_BenchmarkHashTables()
+{
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    volatile PVOID sink = nullptr;
+
+    for (const auto noOfElements : CONTAINER_SIZES)
+    {
+        std::vector<UT_BENCHMARK_ELEM> elems(noOfElements);
+        std::vector<BYTE> chainedData;
+        HASH_TABLE chainedTable;
+        OPEN_HASH_TABLE openTable;
+        STATUS status;
+
+        // duplicate keys would only make the tables a bit smaller
+        for (auto& elem : elems)
+        {
+            elem.Key = ((QWORD) rng.GetNextRandom() << 32) | rng.GetNextRandom();
+        }
+
+        chainedData.resize(HashTablePreinit(&chainedTable, noOfElements, sizeof(QWORD)));
+        HashTableInit(&chainedTable,
+                      (PHASH_TABLE_DATA) chainedData.data(),
+                      HashFuncGenericIncremental,
+                      FIELD_OFFSET(UT_BENCHMARK_ELEM, Key) - FIELD_OFFSET(UT_BENCHMARK_ELEM, HashEntry));
+
+        status = OpenHashTableInit(&openTable,
+                                   0,
+                                   sizeof(QWORD),
+                                   nullptr,
+                                   FIELD_OFFSET(UT_BENCHMARK_ELEM, Key) - FIELD_OFFSET(UT_BENCHMARK_ELEM, HashEntry),
+                                   _BenchmarkAlloc,
+                                   _BenchmarkFree,
+                                   nullptr);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("OpenHashTableInit", status);
+            return;
+        }
+
+        auto fillChained = [&]()
+        {
+            HashTableClear(&chainedTable, nullptr, nullptr);
+            for (auto& elem : elems) HashTableInsert(&chainedTable, &elem.HashEntry);
+        };
+
+        auto fillOpen = [&]()
+        {
+            OpenHashTableClear(&openTable, nullptr, nullptr);
+            for (auto& elem : elems) OpenHashTableInsert(&openTable, &elem.HashEntry, nullptr);
+        };
+
+        UtCl::Benchmark::Run("HashTableInsert", noOfElements, noOfElements, [&]()
+        {
+            for (auto& elem : elems) sink = HashTableInsert(&chainedTable, &elem.HashEntry);
+        },
+        [&]()
+        {
+            HashTableClear(&chainedTable, nullptr, nullptr);
+        });
+
+        fillChained();
+        UtCl::Benchmark::Run("HashTableLookup", noOfElements, noOfElements, [&]()
+        {
+            for (auto& elem : elems) sink = HashTableLookup(&chainedTable, (PHASH_KEY) &elem.Key);
+        });
+
+        UtCl::Benchmark::Run("HashTableRemove", noOfElements, noOfElements, [&]()
+        {
+            for (auto& elem : elems) sink = HashTableRemove(&chainedTable, (PHASH_KEY) &elem.Key);
+        },
+        fillChained);
+
+        UtCl::Benchmark::Run("OpenHashTableInsert", noOfElements, noOfElements, [&]()
+        {
+            for (auto& elem : elems) OpenHashTableInsert(&openTable, &elem.HashEntry, nullptr);
+        },
+        [&]()
+        {
+            OpenHashTableClear(&openTable, nullptr, nullptr);
+        });
+
+        fillOpen();
+        UtCl::Benchmark::Run("OpenHashTableLookup", noOfElements, noOfElements, [&]()
+        {
+            for (auto& elem : elems) sink = OpenHashTableLookup(&openTable, (PHASH_KEY) &elem.Key);
+        });
+
+        UtCl::Benchmark::Run("OpenHashTableRemove", noOfElements, noOfElements, [&]()
+        {
+            for (auto& elem : elems) sink = OpenHashTableRemove(&openTable, (PHASH_KEY) &elem.Key);
+        },
+        fillOpen);
+
+        OpenHashTableUninit(&openTable);
+    }
+}
+
+static
+void
+_BenchmarkLists()
+{
+    volatile PVOID sink = nullptr;
+
+    for (const auto noOfElements : CONTAINER_SIZES)
+    {
+        std::vector<UT_BENCHMARK_ELEM> elems(noOfElements);
+        LIST_ENTRY head;
+
+        auto fill = [&]()
+        {
+            InitializeListHead(&head);
+            for (auto& elem : elems) InsertTailList(&head, &elem.ListEntry);
+        };
+
+        UtCl::Benchmark::Run("ListInsertTail", noOfElements, noOfElements, [&]()
+        {
+            for (auto& elem : elems) InsertTailList(&head, &elem.ListEntry);
+        },
+        [&]()
+        {
+            InitializeListHead(&head);
+        });
+
+        UtCl::Benchmark::Run("ListRemoveHead", noOfElements, noOfElements, [&]()
+        {
+            for (DWORD i = 0; i < noOfElements; ++i) sink = RemoveHeadList(&head);
+        },
+        fill);
+
+        // the traversal cost is reported per element
+        fill();
+        UtCl::Benchmark::Run("ListSize", noOfElements, noOfElements, [&]()
+        {
+            sink = (PVOID)(QWORD) ListSize(&head);
+        });
+    }
+}
+
+static
+void
+_BenchmarkMemory()
+{
+    std::vector<BYTE> source(MEMORY_SIZES[ARRAYSIZE(MEMORY_SIZES) - 1]);
+    std::vector<BYTE> destination(source.size());
+    volatile DWORD sink = 0;
+
+    for (auto& byte : source)
+    {
+        byte = 'a' + (BYTE)(UtCl::RNG::GetInstance().GetNextRandom() % 26);
+    }
+
+    for (const auto size : MEMORY_SIZES)
+    {
+        DWORD operations = (DWORD) max(1, MEMORY_BYTES_PER_SAMPLE / size);
+
+        UtCl::Benchmark::Run("memcpy", size, operations, [&]()
+        {
+            for (DWORD i = 0; i < operations; ++i) cl_memcpy(destination.data(), source.data(), size);
+        });
+
+        UtCl::Benchmark::Run("memset", size, operations, [&]()
+        {
+            for (DWORD i = 0; i < operations; ++i) cl_memset(destination.data(), (BYTE) i, size);
+        });
+
+        // the terminator is placed at the end of the buffer
+        source[size - 1] = '\0';
+        UtCl::Benchmark::Run("strlen", size, operations, [&]()
+        {
+            for (DWORD i = 0; i < operations; ++i) sink = cl_strlen((char*) source.data());
+        });
+        source[size - 1] = 'a';
+    }
+}
+
+static
+void
+_BenchmarkFormatting()
+{
+    std::vector<char> output(FORMAT_BUFFER_SIZE);
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    volatile STATUS sink = 0;
+
+    UtCl::Benchmark::Run("vsnprintf-integers", 0, FORMATS_PER_SAMPLE, [&]()
+    {
+        for (DWORD i = 0; i < FORMATS_PER_SAMPLE; ++i)
+        {
+            sink = cl_snprintf(output.data(), FORMAT_BUFFER_SIZE, "%u %d 0x%x %U 0x%X",
+                               i, -(INT32)i, i * 0x9E3779B9, (QWORD) i << 40, (QWORD) i << 40);
+        }
+    });
+
+    for (const auto size : STRING_SIZES)
+    {
+        std::string str(size, 'a');
+        DWORD value = rng.GetNextRandom();
+
+        UtCl::Benchmark::Run("vsnprintf-string", size, FORMATS_PER_SAMPLE, [&]()
+        {
+            for (DWORD i = 0; i < FORMATS_PER_SAMPLE; ++i)
+            {
+                sink = cl_snprintf(output.data(), FORMAT_BUFFER_SIZE, "[%s] = %x", str.c_str(), value);
+            }
+        });
+    }
+}
+
+static
+void
+_BenchmarkRefCount()
+{
+    REF_COUNT shared;
+    REF_COUNT biased;
+    RFC_OWNER owner;
+    volatile DWORD sink = 0;
+
+    RfcOwnerInit(&owner);
+
+    RfcPreInit(&shared);
+    RfcInit(&shared, NULL, NULL);
+
+    RfcPreInit(&biased);
+    RfcInitBiased(&biased, NULL, NULL, &owner);
+
+    // each operation is a reference and dereference pair, neither drops the
+    // initial reference
+    UtCl::Benchmark::Run("RfcReference-shared", 0, REFERENCES_PER_SAMPLE, [&]()
+    {
+        for (DWORD i = 0; i < REFERENCES_PER_SAMPLE; ++i)
+        {
+            RfcReference(&shared);
+            sink = RfcDereference(&shared);
+        }
+    });
+
+    UtCl::Benchmark::Run("RfcReference-biased", 0, REFERENCES_PER_SAMPLE, [&]()
+    {
+        for (DWORD i = 0; i < REFERENCES_PER_SAMPLE; ++i)
+        {
+            RfcReferenceEx(&biased, &owner);
+            sink = RfcDereferenceEx(&biased, &owner);
+        }
+    });
+
+    RfcDereference(&shared);
+    RfcDereferenceEx(&biased, &owner);
+}
+
+STATUS
+UtClBenchmarkSuite()
+{
+    UtCl::Benchmark::PrintHeader();
+
+    _BenchmarkBitmap();
+    _BenchmarkHashTables();
+    _BenchmarkLists();
+    _BenchmarkMemory();
+    _BenchmarkFormatting();
+    _BenchmarkRefCount();
+
+    return CL_STATUS_SUCCESS;
+}
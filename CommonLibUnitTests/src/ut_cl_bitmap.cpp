@@ -1,17 +1,293 @@
 #include "ut_base.h"
 #include "ut_cl_bitmap.h"
+#include "ut_cl_rng.h"
 #include "bitmap.h"
+#include "cl_memory.h"
+#include <vector>
+#include <chrono>
 
-BOOLEAN
-TcBitmapRun(
-    void
+static constexpr DWORD NO_OF_RANDOM_BITMAPS = 200;
+static constexpr DWORD MAX_RANDOM_BITMAP_BITS = 0x2000;
+static constexpr DWORD NO_OF_SCANS_PER_BITMAP = 100;
+
+// the bitmap buffer is placed at a few unaligned offsets to make sure the
+// QWORD loads don't depend on alignment
+static constexpr DWORD MAX_BUFFER_OFFSET = 8;
+
+// roughly the frame bitmap of a 4GB machine
+static constexpr DWORD BENCHMARK_BITS = 1024 * 1024;
+static constexpr DWORD BENCHMARK_RUN_LENGTHS[] = { 1, 8, 64, 512 };
+static constexpr DWORD BENCHMARK_SCANS = 200;
+
+// bits allocated one by one until the bitmap is full
+static constexpr DWORD BENCHMARK_ALLOCATION_BITS = 64 * 1024;
+
+// the bit by bit scan the library used to do
+static
+DWORD
+_UtReferenceScan(
+    _In_    const std::vector<bool>&    Bits,
+    _In_    DWORD                       StartIndex,
+    _In_    DWORD                       FirstInvalidBitIndex,
+    _In_    DWORD                       ConsecutiveBits,
+    _In_    bool                        Set
+    )
+{
+    if (FirstInvalidBitIndex - StartIndex < ConsecutiveBits)
+    {
+        return MAX_DWORD;
+    }
+
+    for (DWORD i = StartIndex; i <= FirstInvalidBitIndex - ConsecutiveBits; ++i)
+    {
+        DWORD j;
+
+        for (j = 0; j < ConsecutiveBits; ++j)
+        {
+            if (Bits[i + j] != Set)
+            {
+                break;
+            }
+        }
+
+        if (j == ConsecutiveBits)
+        {
+            return i;
+        }
+    }
+
+    return MAX_DWORD;
+}
+
+static
+void
+_UtFillBitmap(
+    _Inout_ PBITMAP                     Bitmap,
+    _Out_   std::vector<bool>&          Bits,
+    _In_    DWORD                       Density
     )
 {
-    BITMAP bmp;
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    DWORD i = 0;
+
+    Bits.assign(Bitmap->BitCount, false);
+
+    // runs of random length make the multi-word runs and the word
+    // boundaries likely, a density of 0 or 100 gives a uniform bitmap
+    while (i < Bitmap->BitCount)
+    {
+        bool value = (rng.GetNextRandom() % 100) < Density;
+        DWORD length = 1 + rng.GetNextRandom() % ((0 == rng.GetNextRandom() % 4) ? 200 : 8);
+
+        for (DWORD j = 0; j < length && i < Bitmap->BitCount; ++j, ++i)
+        {
+            Bits[i] = value;
+            BitmapSetBitValue(Bitmap, i, value);
+        }
+    }
+}
+
+static
+STATUS
+_UtBitmapSingle(
+    _In_    DWORD                       NumberOfBits,
+    _In_    DWORD                       Density,
+    _Inout_ std::vector<BYTE>&          Buffer
+    )
+{
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    BITMAP bitmap;
+    std::vector<bool> bits;
+    DWORD bufferSize;
+
+    bufferSize = BitmapPreinit(&bitmap, NumberOfBits);
+    BitmapInit(&bitmap, &Buffer[rng.GetNextRandom() % MAX_BUFFER_OFFSET]);
+
+    // the bytes past the end of the buffer must never be looked at
+    cl_memset(bitmap.BitmapBuffer + bufferSize, 0xA5, MAX_BUFFER_OFFSET);
+
+    _UtFillBitmap(&bitmap, bits, Density);
+
+    DWORD expectedCount = 0;
+    for (const auto bit : bits)
+    {
+        expectedCount += bit ? 1 : 0;
+    }
+
+    if (BitmapCountSetBits(&bitmap) != expectedCount)
+    {
+        LOG_ERROR("BitmapCountSetBits returned %u for %u bits, expected %u\n",
+            BitmapCountSetBits(&bitmap), NumberOfBits, expectedCount);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    for (DWORD i = 0; i < NO_OF_SCANS_PER_BITMAP; ++i)
+    {
+        DWORD start = rng.GetNextRandom() % (NumberOfBits + 1);
+        DWORD end = start + rng.GetNextRandom() % (NumberOfBits - start + 1);
+        DWORD length = 1 + rng.GetNextRandom() % ((0 == i % 2) ? 16 : 300);
+        bool set = (0 == rng.GetNextRandom() % 2);
+
+        DWORD expected = _UtReferenceScan(bits, start, end, length, set);
+        DWORD actual = BitmapScanFromTo(&bitmap, start, end, length, set);
+        if (expected != actual)
+        {
+            LOG_ERROR("Scan [%u, %u) of %u bits for %u %s bits returned %u, expected %u\n",
+                start, end, NumberOfBits, length, set ? "set" : "clear", actual, expected);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    // Allocate runs until the bitmap is full. Each run returned by the next
+    // fit scan must be free, start after the previous one unless the scan
+    // wrapped and be the first free one from where the scan started.
+    DWORD minIndex = rng.GetNextRandom() % (NumberOfBits / 2 + 1);
+    for (;;)
+    {
+        DWORD length = 1 + rng.GetNextRandom() % 8;
+        DWORD hint = max(minIndex, bitmap.NextFitHint);
+        hint = (hint >= NumberOfBits) ? minIndex : hint;
+
+        DWORD expected = _UtReferenceScan(bits, hint, NumberOfBits, length, false);
+        if (MAX_DWORD == expected)
+        {
+            expected = _UtReferenceScan(bits, minIndex, min(hint + length - 1, NumberOfBits), length, false);
+        }
+
+        DWORD actual = BitmapScanNextFitAndFlip(&bitmap, minIndex, length, FALSE);
+        if (expected != actual)
+        {
+            LOG_ERROR("Next fit scan from %u (hint %u) of %u bits for %u bits returned %u, expected %u\n",
+                minIndex, hint, NumberOfBits, length, actual, expected);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+
+        if (MAX_DWORD == actual)
+        {
+            break;
+        }
+
+        for (DWORD j = 0; j < length; ++j)
+        {
+            bits[actual + j] = true;
+
+            if (!BitmapGetBitValue(&bitmap, actual + j))
+            {
+                LOG_ERROR("Bit %u was not set by the next fit scan\n", actual + j);
+                return CL_STATUS_INTERNAL_ERROR;
+            }
+        }
+    }
+
+    for (DWORD i = 0; i < MAX_BUFFER_OFFSET; ++i)
+    {
+        if (0xA5 != bitmap.BitmapBuffer[bufferSize + i])
+        {
+            LOG_ERROR("Byte %u past the end of the bitmap of %u bits was changed\n", i, NumberOfBits);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+STATUS
+UtClBitmap()
+{
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    std::vector<BYTE> buffer(MAX_RANDOM_BITMAP_BITS / BITS_PER_BYTE + 3 * MAX_BUFFER_OFFSET);
+    static constexpr DWORD DENSITIES[] = { 0, 10, 50, 90, 100 };
+
+    for (DWORD i = 0; i < NO_OF_RANDOM_BITMAPS; ++i)
+    {
+        // all the sizes around the first few word boundaries are tested
+        // before going random
+        DWORD noOfBits = (i < 2 * 64 + 2) ? i + 1 : 1 + rng.GetNextRandom() % MAX_RANDOM_BITMAP_BITS;
+        DWORD density = DENSITIES[i % ARRAYSIZE(DENSITIES)];
+
+        STATUS status = _UtBitmapSingle(noOfBits, density, buffer);
+        if (!SUCCEEDED(status))
+        {
+            LOG_ERROR("Failed on bitmap %u with %u bits and density %u\n", i, noOfBits, density);
+            return status;
+        }
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+STATUS
+UtClBitmapBenchmark()
+{
+    std::vector<BYTE> buffer(BENCHMARK_BITS / BITS_PER_BYTE);
+    std::vector<bool> bits;
+    BITMAP bitmap;
+    volatile DWORD sink = 0;
+
+    BitmapPreinit(&bitmap, BENCHMARK_BITS);
+    BitmapInit(&bitmap, buffer.data());
+
+    // mostly used memory with short free holes, the longer runs are found
+    // only towards the end of the bitmap
+    _UtFillBitmap(&bitmap, bits, 90);
+
+    LOG("%10s %16s %16s\n", "Run", "bitwise scans/s", "word scans/s");
+
+    for (const auto length : BENCHMARK_RUN_LENGTHS)
+    {
+        double throughput[2];
+
+        for (DWORD func = 0; func < ARRAYSIZE(throughput); ++func)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (DWORD i = 0; i < BENCHMARK_SCANS; ++i)
+            {
+                sink = (0 == func)
+                    ? _UtReferenceScan(bits, 0, BENCHMARK_BITS, length, false)
+                    : BitmapScan(&bitmap, length, FALSE);
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            throughput[func] = BENCHMARK_SCANS / elapsed.count();
+        }
+
+        LOG("%10u %16.1f %16.1f\n", length, throughput[0], throughput[1]);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (DWORD i = 0; i < BENCHMARK_SCANS; ++i)
+    {
+        sink = BitmapCountSetBits(&bitmap);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    LOG("BitmapCountSetBits: %.1f MB/s\n", (double) BENCHMARK_SCANS * BENCHMARK_BITS / BITS_PER_BYTE / MB_SIZE / elapsed.count());
+
+    // single bit allocations, the first fit scan walks over all the bits
+    // taken before while the next fit one continues where it stopped
+    LOG("%10s %16s %16s\n", "Bits", "first fit us", "next fit us");
+
+    BitmapPreinit(&bitmap, BENCHMARK_ALLOCATION_BITS);
+
+    double allocationTime[2];
+    for (DWORD func = 0; func < ARRAYSIZE(allocationTime); ++func)
+    {
+        BitmapInit(&bitmap, buffer.data());
+
+        start = std::chrono::high_resolution_clock::now();
+
+        for (DWORD i = 0; i < BENCHMARK_ALLOCATION_BITS; ++i)
+        {
+            sink = (0 == func)
+                ? BitmapScanAndFlip(&bitmap, 1, FALSE)
+                : BitmapScanNextFitAndFlip(&bitmap, 0, 1, FALSE);
+        }
 
-    printf("Will test BITMAP functions\n");
+        elapsed = std::chrono::high_resolution_clock::now() - start;
+        allocationTime[func] = elapsed.count() * 1000000;
+    }
 
-    BitmapPreinit(&bmp, 10 );
+    LOG("%10u %16.1f %16.1f\n", BENCHMARK_ALLOCATION_BITS, allocationTime[0], allocationTime[1]);
 
-    return TRUE;
-}
\ No newline at end of file
+    return CL_STATUS_SUCCESS;
+}
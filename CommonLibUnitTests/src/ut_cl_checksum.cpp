@@ -0,0 +1,217 @@
+#include "ut_base.h"
+#include "ut_cl_checksum.h"
+#include "ut_cl_rng.h"
+#include <vector>
+#include <chrono>
+
+static constexpr DWORD NO_OF_RANDOM_BUFFERS = 1000;
+static constexpr DWORD MAX_RANDOM_BUFFER_SIZE = 0x4000;
+
+// the buffers are checksummed at a few unaligned offsets as well to make sure
+// the vectorized loads don't depend on alignment
+static constexpr DWORD MAX_BUFFER_OFFSET = 0x20;
+
+static constexpr DWORD BENCHMARK_SIZES[] =
+{
+    20, 64, 576, 1500, 4096, 9000, 64 * 1024
+};
+
+static constexpr QWORD BENCHMARK_BYTES_PER_SIZE = 256 * MB_SIZE;
+
+// Straightforward RFC 1071 implementation working on big endian WORDs
+static
+WORD
+_UtReferenceChecksum(
+    _In_reads_bytes_(Size)  const BYTE*     Buffer,
+    _In_                    DWORD           Size
+    )
+{
+    QWORD sum = 0;
+    DWORD i;
+
+    for (i = 0; i + 1 < Size; i += 2)
+    {
+        sum += BYTES_TO_WORD(Buffer[i], Buffer[i + 1]);
+    }
+
+    if (i < Size)
+    {
+        sum += BYTES_TO_WORD(Buffer[i], 0);
+    }
+
+    while (sum > MAX_WORD)
+    {
+        sum = (sum & MAX_WORD) + (sum >> 16);
+    }
+
+    return (WORD) sum;
+}
+
+// 0x0000 and 0xFFFF are both representations of zero in ones-complement
+static
+bool
+_UtChecksumsEqual(
+    _In_    WORD    First,
+    _In_    WORD    Second
+    )
+{
+    return (First == Second) ||
+        ((First == 0 || First == MAX_WORD) && (Second == 0 || Second == MAX_WORD));
+}
+
+static
+STATUS
+_UtChecksumSingleBuffer(
+    _In_reads_bytes_(Size)  const BYTE*     Buffer,
+    _In_                    DWORD           Size,
+    _Inout_                 BYTE*           CopyBuffer
+    )
+{
+    WORD expected = _UtReferenceChecksum(Buffer, Size);
+
+    // our implementation sums little endian WORDs, RFC 1071 2.B guarantees
+    // the byte swapped result is the same
+    WORD actual = ntohw(memchecksum((PVOID)Buffer, Size, 0));
+    if (!_UtChecksumsEqual(expected, actual))
+    {
+        LOG_ERROR("Checksum for buffer of size %u is 0x%x, expected 0x%x\n",
+            Size, actual, expected);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    WORD copied = ntohw(memcpychecksum(CopyBuffer, (PVOID)Buffer, Size, 0));
+    if (!_UtChecksumsEqual(expected, copied))
+    {
+        LOG_ERROR("Copy-checksum for buffer of size %u is 0x%x, expected 0x%x\n",
+            Size, copied, expected);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    if (cl_memcmp(CopyBuffer, (PVOID)Buffer, Size) != 0)
+    {
+        LOG_ERROR("Copy-checksum did not copy buffer of size %u correctly\n", Size);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    if (Size >= 2 * sizeof(WORD))
+    {
+        // checksum the buffer in two parts, the first one must be of even size
+        DWORD firstPart = (DWORD) AlignAddressLower(Size / 2, sizeof(WORD));
+        WORD partial = memchecksum((PVOID)Buffer, firstPart, 0);
+        partial = memchecksum((PVOID)(Buffer + firstPart), Size - firstPart, partial);
+
+        if (!_UtChecksumsEqual(expected, ntohw(partial)))
+        {
+            LOG_ERROR("Partial checksums for buffer of size %u give 0x%x, expected 0x%x\n",
+                Size, ntohw(partial), expected);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+
+        // change a WORD and incrementally update the checksum
+        std::vector<BYTE> modified(Buffer, Buffer + Size);
+        WORD oldValue = *(PWORD)&modified[0];
+        WORD newValue = (WORD) UtCl::RNG::GetInstance().GetNextRandom();
+        *(PWORD)&modified[0] = newValue;
+
+        WORD updated = memchecksumupdate(CHECKSUM_FINALIZE(memchecksum((PVOID)Buffer, Size, 0)),
+                                         oldValue,
+                                         newValue);
+        WORD recomputed = CHECKSUM_FINALIZE(memchecksum(modified.data(), Size, 0));
+        if (!_UtChecksumsEqual(updated, recomputed))
+        {
+            LOG_ERROR("Incremental update for buffer of size %u gives 0x%x, expected 0x%x\n",
+                Size, updated, recomputed);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+STATUS
+UtClChecksum()
+{
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    std::vector<BYTE> buffer(MAX_RANDOM_BUFFER_SIZE + MAX_BUFFER_OFFSET);
+    std::vector<BYTE> copyBuffer(MAX_RANDOM_BUFFER_SIZE + MAX_BUFFER_OFFSET);
+
+    for (DWORD i = 0; i < NO_OF_RANDOM_BUFFERS; ++i)
+    {
+        // make sure all the small sizes which exercise the scalar tails
+        // are tested before going random
+        DWORD size = (i <= 2 * MAX_BUFFER_OFFSET) ? i : rng.GetNextRandom() % MAX_RANDOM_BUFFER_SIZE;
+        DWORD offset = rng.GetNextRandom() % MAX_BUFFER_OFFSET;
+
+        for (auto& byte : buffer)
+        {
+            byte = (BYTE) rng.GetNextRandom();
+        }
+
+        STATUS status = _UtChecksumSingleBuffer(&buffer[offset], size, &copyBuffer[MAX_BUFFER_OFFSET - offset]);
+        if (!SUCCEEDED(status))
+        {
+            LOG_ERROR("Failed on buffer %u with size %u at offset %u\n", i, size, offset);
+            return status;
+        }
+    }
+
+    // all ones must not become zero
+    buffer.assign(MAX_RANDOM_BUFFER_SIZE, MAX_BYTE);
+    if (!_UtChecksumsEqual(_UtReferenceChecksum(buffer.data(), MAX_RANDOM_BUFFER_SIZE),
+                           memchecksum(buffer.data(), MAX_RANDOM_BUFFER_SIZE, 0)))
+    {
+        LOG_ERROR("Checksum of all ones buffer is wrong\n");
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+STATUS
+UtClChecksumBenchmark()
+{
+    std::vector<BYTE> source(BENCHMARK_SIZES[ARRAYSIZE(BENCHMARK_SIZES) - 1]);
+    std::vector<BYTE> destination(source.size());
+    volatile WORD sink = 0;
+
+    for (auto& byte : source)
+    {
+        byte = (BYTE) UtCl::RNG::GetInstance().GetNextRandom();
+    }
+
+    LOG("%10s %16s %16s %16s\n", "Size", "checksum MB/s", "copy+csum MB/s", "memcpy MB/s");
+
+    for (const auto size : BENCHMARK_SIZES)
+    {
+        QWORD iterations = BENCHMARK_BYTES_PER_SIZE / size;
+        double throughput[3];
+
+        for (DWORD func = 0; func < ARRAYSIZE(throughput); ++func)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (QWORD i = 0; i < iterations; ++i)
+            {
+                switch (func)
+                {
+                case 0:
+                    sink = memchecksum(source.data(), size, sink);
+                    break;
+                case 1:
+                    sink = memcpychecksum(destination.data(), source.data(), size, sink);
+                    break;
+                default:
+                    cl_memcpy(destination.data(), source.data(), size);
+                    break;
+                }
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            throughput[func] = (double)(iterations * size) / MB_SIZE / elapsed.count();
+        }
+
+        LOG("%10u %16.1f %16.1f %16.1f\n", size, throughput[0], throughput[1], throughput[2]);
+    }
+
+    return CL_STATUS_SUCCESS;
+}
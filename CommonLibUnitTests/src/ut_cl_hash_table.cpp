@@ -1,7 +1,10 @@
 #include "ut_base.h"
 #include "ut_cl_hash_table.h"
 #include "hash_table.h"
+#include "open_hash_table.h"
 #include <unordered_map>
+#include <vector>
+#include <chrono>
 #include "ut_cl_rng.h"
 
 typedef struct _UT_HASH_ELEM
@@ -531,3 +534,385 @@ UtClHashTable()
 
     return status;
 }
+
+// operations done on the open hash table for each key size, a lot of them are
+// done while the table grows
+static constexpr DWORD OPEN_HASH_OPERATIONS = 200'000;
+static constexpr DWORD OPEN_HASH_MAX_ELEMENTS = 20'000;
+
+// all the elements of the benchmark are present at once
+static constexpr DWORD BENCHMARK_ELEMENTS = 200'000;
+static constexpr DWORD BENCHMARK_CHAINED_KEYS[] = { 4, 4096, 100'000 };
+
+static
+PVOID
+(__cdecl _HashAlloc)(
+    IN      DWORD               Size,
+    IN_OPT  PVOID               Context
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    return new BYTE[Size];
+}
+
+static
+void
+(__cdecl _HashFree)(
+    IN      PVOID               Object,
+    IN_OPT  PVOID               Context
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    delete[] (PBYTE) Object;
+}
+
+static
+QWORD
+_HashRandomKey(
+    _In_        DWORD               KeySize
+    )
+{
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+
+    QWORD key = ((QWORD) rng.GetNextRandom() << 32) | rng.GetNextRandom();
+
+    return (KeySize < sizeof(QWORD)) ? key & CREATE_BIT_MASK_FOR_N_BITS(BITS_PER_BYTE * KeySize) : key;
+}
+
+static
+STATUS
+_OpenHashCheckIteration(
+    _Inout_     OPEN_HASH_TABLE*                    HashTable,
+    _Inout_     std::unordered_map<QWORD, PVOID>&   ShadowHash,
+    _In_        bool                                StoredKeys,
+    _In_        bool                                RemoveAll
+    )
+{
+    OPEN_HASH_ITERATOR it;
+    PHASH_ENTRY pEntry;
+    std::unordered_map<QWORD, DWORD> timesSeen;
+
+    OpenHashTableIteratorInit(HashTable, &it);
+
+    while ((pEntry = OpenHashTableIteratorNext(&it)) != nullptr)
+    {
+        QWORD key = StoredKeys
+            ? (QWORD) pEntry - 1
+            : (CONTAINING_RECORD(pEntry, UT_HASH_ELEM, HashEntry))->Value;
+
+        if (++timesSeen[key] != 1)
+        {
+            LOG_ERROR("Key 0x%I64X was returned more than once by the iterator\n", key);
+            return CL_STATUS_ELEMENT_FOUND;
+        }
+
+        if (ShadowHash.find(key) == ShadowHash.end())
+        {
+            LOG_ERROR("Key 0x%I64X returned by the iterator is not in the shadow hash\n", key);
+            return CL_STATUS_ELEMENT_NOT_FOUND;
+        }
+
+        // every other element is removed while iterating
+        if (RemoveAll || (key % 2) == 0)
+        {
+            if (StoredKeys)
+            {
+                OpenHashTableRemoveValue(HashTable, key, nullptr);
+            }
+            else
+            {
+                OpenHashTableRemoveEntry(HashTable, pEntry);
+            }
+
+            ShadowHash.erase(key);
+        }
+    }
+
+    for (const auto& elem : ShadowHash)
+    {
+        if (timesSeen.find(elem.first) == timesSeen.end())
+        {
+            LOG_ERROR("Key 0x%I64X was never returned by the iterator\n", elem.first);
+            return CL_STATUS_ELEMENT_NOT_FOUND;
+        }
+    }
+
+    if (OpenHashTableSize(HashTable) != ShadowHash.size())
+    {
+        LOG_ERROR("Our reported hash size is %u, while the shadow hash size is %zu\n",
+            OpenHashTableSize(HashTable), ShadowHash.size());
+        return CL_STATUS_SIZE_INVALID;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+// Random insertions, lookups and removals compared with an unordered_map. In
+// the stored keys mode the value of each key is the key + 1 so it is never
+// NULL, otherwise the elements are UT_HASH_ELEMs.
+static
+STATUS
+_UtClOpenHashRun(
+    _In_        DWORD                               KeySize,
+    _In_        PFUNC_HashFunction                  HashFunc,
+    _In_        bool                                StoredKeys
+    )
+{
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    STATUS status;
+    OPEN_HASH_TABLE hashTable;
+    std::unordered_map<QWORD, PVOID> shadowHash;
+    std::vector<UT_HASH_ELEM> elems(OPEN_HASH_OPERATIONS);
+
+    status = OpenHashTableInit(&hashTable,
+                               0,
+                               KeySize,
+                               HashFunc,
+                               FIELD_OFFSET(UT_HASH_ELEM, Value) - FIELD_OFFSET(UT_HASH_ELEM, HashEntry),
+                               _HashAlloc,
+                               _HashFree,
+                               nullptr);
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("OpenHashTableInit", status);
+        return status;
+    }
+
+    for (DWORD i = 0; i < OPEN_HASH_OPERATIONS && SUCCEEDED(status); ++i)
+    {
+        // the keys removed or looked up are usually present
+        DWORD operation = rng.GetNextRandom() % 4;
+        QWORD key = (!shadowHash.empty() && (rng.GetNextRandom() % 4) != 0)
+            ? std::next(shadowHash.begin(), (ptrdiff_t) (rng.GetNextRandom() % min(shadowHash.size(), (size_t) 16)))->first
+            : _HashRandomKey(KeySize);
+        auto shadowIt = shadowHash.find(key);
+        PVOID pExpected = (shadowIt == shadowHash.end()) ? nullptr : shadowIt->second;
+        PVOID pActual;
+
+        if (operation <= 1 && shadowHash.size() < OPEN_HASH_MAX_ELEMENTS)
+        {
+            PVOID pElement = StoredKeys ? (PVOID) (key + 1) : &elems[i].HashEntry;
+
+            elems[i].Value = key;
+
+            status = StoredKeys
+                ? OpenHashTableInsertValue(&hashTable, key, pElement, &pActual)
+                : OpenHashTableInsert(&hashTable, (PHASH_ENTRY) pElement, (PHASH_ENTRY*) &pActual);
+            if (!SUCCEEDED(status))
+            {
+                LOG_FUNC_ERROR("OpenHashTableInsert", status);
+                break;
+            }
+
+            shadowHash[key] = pElement;
+        }
+        else if (operation == 2)
+        {
+            if (StoredKeys)
+            {
+                OpenHashTableRemoveValue(&hashTable, key, &pActual);
+            }
+            else
+            {
+                pActual = OpenHashTableRemove(&hashTable, (PHASH_KEY) &key);
+            }
+
+            shadowHash.erase(key);
+        }
+        else
+        {
+            if (StoredKeys)
+            {
+                OpenHashTableLookupValue(&hashTable, key, &pActual);
+            }
+            else
+            {
+                pActual = OpenHashTableLookup(&hashTable, (PHASH_KEY) &key);
+            }
+        }
+
+        if (pActual != pExpected)
+        {
+            LOG_ERROR("Operation %u on key 0x%I64X returned 0x%p, expected 0x%p\n",
+                operation, key, pActual, pExpected);
+            status = CL_STATUS_VALUE_MISMATCH;
+        }
+        else if (OpenHashTableSize(&hashTable) != shadowHash.size())
+        {
+            LOG_ERROR("Our reported hash size is %u, while the shadow hash size is %zu\n",
+                OpenHashTableSize(&hashTable), shadowHash.size());
+            status = CL_STATUS_SIZE_INVALID;
+        }
+        else if ((i % 10'000) == 0)
+        {
+            status = _OpenHashCheckIteration(&hashTable, shadowHash, StoredKeys, false);
+        }
+    }
+
+    if (SUCCEEDED(status))
+    {
+        status = _OpenHashCheckIteration(&hashTable, shadowHash, StoredKeys, true);
+    }
+
+    OpenHashTableUninit(&hashTable);
+
+    return status;
+}
+
+STATUS
+UtClOpenHashTable()
+{
+    STATUS status = CL_STATUS_SUCCESS;
+
+    for (const auto& keySize : KEY_SIZES)
+    {
+        for (const auto hashFunc : { (PFUNC_HashFunction) nullptr, (PFUNC_HashFunction) HashFuncGenericIncremental })
+        {
+            for (const auto storedKeys : { false, true })
+            {
+                status = _UtClOpenHashRun(keySize, hashFunc, storedKeys);
+                if (!SUCCEEDED(status))
+                {
+                    LOG_ERROR("Failed open hash test with key size %u, hash func 0x%p and %s keys with status 0x%X\n",
+                        keySize, hashFunc, storedKeys ? "stored" : "intrusive", status);
+                    return status;
+                }
+            }
+        }
+    }
+
+    return status;
+}
+
+// Runs the same operations on the chained hash table for a few numbers of keys
+// and on the open hash table, the results are in operations per second
+STATUS
+UtClHashTableBenchmark()
+{
+    static const char* const OPERATIONS[] = { "Insert", "Lookup", "Lookup miss", "Remove" };
+    static constexpr DWORD NO_OF_TABLES = ARRAYSIZE(BENCHMARK_CHAINED_KEYS) + 1;
+
+    std::vector<UT_HASH_ELEM> elems(BENCHMARK_ELEMENTS);
+    std::vector<QWORD> missingKeys(BENCHMARK_ELEMENTS);
+    std::unordered_map<QWORD, DWORD> uniqueKeys;
+    double throughput[ARRAYSIZE(OPERATIONS)][NO_OF_TABLES];
+    volatile PVOID sink = nullptr;
+
+    // the keys are random so neither table gets its best or worst case
+    for (auto& elem : elems)
+    {
+        do
+        {
+            elem.Value = _HashRandomKey(sizeof(DWORD));
+        } while (!uniqueKeys.emplace(elem.Value, 0).second);
+    }
+
+    for (auto& key : missingKeys)
+    {
+        do
+        {
+            key = _HashRandomKey(sizeof(DWORD));
+        } while (uniqueKeys.find(key) != uniqueKeys.end());
+    }
+
+    for (DWORD table = 0; table < NO_OF_TABLES; ++table)
+    {
+        bool bOpen = (table == ARRAYSIZE(BENCHMARK_CHAINED_KEYS));
+        HASH_TABLE chainedTable;
+        OPEN_HASH_TABLE openTable;
+        PBYTE pChainedData = nullptr;
+        STATUS status;
+
+        if (bOpen)
+        {
+            status = OpenHashTableInit(&openTable,
+                                       0,
+                                       sizeof(DWORD),
+                                       nullptr,
+                                       FIELD_OFFSET(UT_HASH_ELEM, Value) - FIELD_OFFSET(UT_HASH_ELEM, HashEntry),
+                                       _HashAlloc,
+                                       _HashFree,
+                                       nullptr);
+            if (!SUCCEEDED(status))
+            {
+                LOG_FUNC_ERROR("OpenHashTableInit", status);
+                return status;
+            }
+        }
+        else
+        {
+            pChainedData = new BYTE[HashTablePreinit(&chainedTable, BENCHMARK_CHAINED_KEYS[table], sizeof(DWORD))];
+
+            HashTableInit(&chainedTable,
+                          (PHASH_TABLE_DATA) pChainedData,
+                          HashFuncGenericIncremental,
+                          FIELD_OFFSET(UT_HASH_ELEM, Value) - FIELD_OFFSET(UT_HASH_ELEM, HashEntry));
+        }
+
+        for (DWORD op = 0; op < ARRAYSIZE(OPERATIONS); ++op)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (DWORD i = 0; i < BENCHMARK_ELEMENTS; ++i)
+            {
+                PHASH_KEY pKey = (PHASH_KEY) ((op == 2) ? &missingKeys[i] : &elems[i].Value);
+
+                switch (op)
+                {
+                case 0:
+                    if (bOpen)
+                    {
+                        status = OpenHashTableInsert(&openTable, &elems[i].HashEntry, nullptr);
+                        ASSERT(SUCCEEDED(status));
+                    }
+                    else
+                    {
+                        sink = HashTableInsert(&chainedTable, &elems[i].HashEntry);
+                    }
+                    break;
+                case 1:
+                case 2:
+                    sink = bOpen ? OpenHashTableLookup(&openTable, pKey) : HashTableLookup(&chainedTable, pKey);
+                    break;
+                default:
+                    sink = bOpen ? OpenHashTableRemove(&openTable, pKey) : HashTableRemove(&chainedTable, pKey);
+                    break;
+                }
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            throughput[op][table] = BENCHMARK_ELEMENTS / elapsed.count();
+        }
+
+        if (bOpen)
+        {
+            OpenHashTableUninit(&openTable);
+        }
+        else
+        {
+            delete[] pChainedData;
+        }
+    }
+
+    LOG("%u elements, operations per second\n", BENCHMARK_ELEMENTS);
+    LOG("%12s", "");
+    for (const auto keys : BENCHMARK_CHAINED_KEYS)
+    {
+        printf(" %9u keys", keys);
+    }
+    printf(" %14s\n", "open");
+
+    for (DWORD op = 0; op < ARRAYSIZE(OPERATIONS); ++op)
+    {
+        LOG("%12s", OPERATIONS[op]);
+        for (DWORD table = 0; table < NO_OF_TABLES; ++table)
+        {
+            printf(" %14.1f", throughput[op][table]);
+        }
+        printf("\n");
+    }
+
+    return CL_STATUS_SUCCESS;
+}
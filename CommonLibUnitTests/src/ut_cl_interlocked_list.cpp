@@ -0,0 +1,239 @@
+#include "ut_base.h"
+#include "ut_cl_interlocked_list.h"
+#include "interlocked_list.h"
+#include <vector>
+#include <thread>
+
+static constexpr DWORD NO_OF_THREADS = 4;
+static constexpr DWORD ENTRIES_PER_THREAD = 0x1000;
+
+// each SLIST thread pops and pushes back this many times
+static constexpr DWORD SLIST_ITERATIONS = 0x40000;
+
+typedef struct _UT_LIST_ELEM
+{
+    CL_SLIST_ENTRY              Entry;
+
+    DWORD                       Owner;
+    DWORD                       Index;
+} UT_LIST_ELEM, *PUT_LIST_ELEM;
+
+static
+STATUS
+_UtSListSingleThreaded()
+{
+    CL_INTERLOCKED_SLIST_HEADER head;
+    std::vector<UT_LIST_ELEM> elems(ENTRIES_PER_THREAD);
+
+    ClInitializeInterlockedSListHead(&head);
+
+    if (ClInterlockedPopEntrySList(&head) != NULL || ClInterlockedFlushSList(&head) != NULL)
+    {
+        LOG_ERROR("Empty list returned an entry\n");
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    for (DWORD i = 0; i < elems.size(); ++i)
+    {
+        elems[i].Index = i;
+
+        PCL_SLIST_ENTRY pPrevious = ClInterlockedPushEntrySList(&head, &elems[i].Entry);
+        if (pPrevious != (i == 0 ? NULL : &elems[i - 1].Entry))
+        {
+            LOG_ERROR("Push %u returned the wrong previous entry\n", i);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    if (ClQueryDepthSList(&head) != elems.size())
+    {
+        LOG_ERROR("Depth is %u instead of %u\n", ClQueryDepthSList(&head), (DWORD) elems.size());
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    // pop half of them in LIFO order and flush the rest
+    for (DWORD i = 0; i < elems.size() / 2; ++i)
+    {
+        PCL_SLIST_ENTRY pEntry = ClInterlockedPopEntrySList(&head);
+        if (pEntry != &elems[elems.size() - 1 - i].Entry)
+        {
+            LOG_ERROR("Pop %u returned the wrong entry\n", i);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    DWORD count = 0;
+    for (PCL_SLIST_ENTRY pEntry = ClInterlockedFlushSList(&head); pEntry != NULL; pEntry = pEntry->Next)
+    {
+        ++count;
+    }
+
+    if (count != elems.size() / 2 || ClQueryDepthSList(&head) != 0 || ClInterlockedPopEntrySList(&head) != NULL)
+    {
+        LOG_ERROR("Flush returned %u entries instead of %u\n", count, (DWORD) elems.size() / 2);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+static
+STATUS
+_UtSListMultiThreaded()
+{
+    CL_INTERLOCKED_SLIST_HEADER head;
+    std::vector<UT_LIST_ELEM> elems(NO_OF_THREADS * ENTRIES_PER_THREAD);
+    std::vector<std::thread> threads;
+
+    ClInitializeInterlockedSListHead(&head);
+
+    for (DWORD i = 0; i < elems.size(); ++i)
+    {
+        elems[i].Index = i;
+        ClInterlockedPushEntrySList(&head, &elems[i].Entry);
+    }
+
+    // the same entries keep going in and out of the list which is where an ABA
+    // would corrupt it
+    for (DWORD i = 0; i < NO_OF_THREADS; ++i)
+    {
+        threads.emplace_back([&head]()
+        {
+            PCL_SLIST_ENTRY popped[4];
+
+            for (DWORD j = 0; j < SLIST_ITERATIONS; ++j)
+            {
+                DWORD count = 1 + j % ARRAYSIZE(popped);
+                DWORD k;
+
+                for (k = 0; k < count; ++k)
+                {
+                    popped[k] = ClInterlockedPopEntrySList(&head);
+                    if (popped[k] == NULL) break;
+                }
+
+                while (k-- > 0)
+                {
+                    ClInterlockedPushEntrySList(&head, popped[k]);
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::vector<bool> seen(elems.size());
+    DWORD count = 0;
+
+    for (PCL_SLIST_ENTRY pEntry = ClInterlockedFlushSList(&head); pEntry != NULL; pEntry = pEntry->Next)
+    {
+        PUT_LIST_ELEM pElem = CONTAINING_RECORD(pEntry, UT_LIST_ELEM, Entry);
+
+        if (seen[pElem->Index] || ++count > elems.size())
+        {
+            LOG_ERROR("Entry %u was found twice in the list\n", pElem->Index);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+        seen[pElem->Index] = true;
+    }
+
+    if (count != elems.size())
+    {
+        LOG_ERROR("%u entries out of %u were lost\n", (DWORD) elems.size() - count, (DWORD) elems.size());
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+static
+STATUS
+_UtMpscQueue()
+{
+    CL_MPSC_QUEUE queue;
+    std::vector<UT_LIST_ELEM> elems(NO_OF_THREADS * ENTRIES_PER_THREAD);
+    std::vector<DWORD> nextIndex(NO_OF_THREADS);
+    std::vector<std::thread> threads;
+
+    ClMpscQueueInit(&queue);
+
+    if (!ClMpscQueueIsEmpty(&queue) || ClMpscQueuePop(&queue) != NULL)
+    {
+        LOG_ERROR("Empty queue returned an entry\n");
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    for (DWORD i = 0; i < NO_OF_THREADS; ++i)
+    {
+        threads.emplace_back([&queue, &elems, i]()
+        {
+            for (DWORD j = 0; j < ENTRIES_PER_THREAD; ++j)
+            {
+                PUT_LIST_ELEM pElem = &elems[i * ENTRIES_PER_THREAD + j];
+
+                pElem->Owner = i;
+                pElem->Index = j;
+                ClMpscQueuePush(&queue, &pElem->Entry);
+            }
+        });
+    }
+
+    // the entries of each producer must come out in the order they were pushed
+    STATUS status = CL_STATUS_SUCCESS;
+    DWORD received = 0;
+    while (received < elems.size())
+    {
+        PCL_SLIST_ENTRY pEntry = ClMpscQueuePop(&queue);
+        if (pEntry == NULL)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        PUT_LIST_ELEM pElem = CONTAINING_RECORD(pEntry, UT_LIST_ELEM, Entry);
+        if (pElem->Owner >= NO_OF_THREADS || pElem->Index != nextIndex[pElem->Owner])
+        {
+            LOG_ERROR("Received entry %u of producer %u\n", pElem->Index, pElem->Owner);
+            status = CL_STATUS_INTERNAL_ERROR;
+            break;
+        }
+
+        ++nextIndex[pElem->Owner];
+        ++received;
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    if (!SUCCEEDED(status))
+    {
+        return status;
+    }
+
+    if (!ClMpscQueueIsEmpty(&queue) || ClMpscQueuePop(&queue) != NULL)
+    {
+        LOG_ERROR("Queue is not empty after all the entries were received\n");
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+STATUS
+UtClInterlockedList()
+{
+    STATUS status;
+
+    status = _UtSListSingleThreaded();
+    if (!SUCCEEDED(status)) return status;
+
+    status = _UtSListMultiThreaded();
+    if (!SUCCEEDED(status)) return status;
+
+    return _UtMpscQueue();
+}
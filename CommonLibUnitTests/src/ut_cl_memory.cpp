@@ -0,0 +1,329 @@
+#include "ut_base.h"
+#include "ut_cl_memory.h"
+#include "ut_cl_rng.h"
+#include "cl_memory.h"
+#include "cl_string.h"
+#include <vector>
+#include <chrono>
+
+static constexpr DWORD NO_OF_RANDOM_BUFFERS = 2000;
+static constexpr DWORD MAX_RANDOM_BUFFER_SIZE = 0x4000;
+
+// all the sizes up to this value are tested before going random, they cover
+// every small size class and the vector loop heads and tails
+static constexpr DWORD MAX_EXHAUSTIVE_SIZE = 0x100;
+
+// the source and destination are placed at independent offsets so all the
+// relative alignments are exercised
+static constexpr DWORD MAX_BUFFER_OFFSET = 0x40;
+
+// bytes around the destination which must not be touched
+static constexpr DWORD GUARD_SIZE = 0x40;
+static constexpr BYTE GUARD_VALUE = 0xCC;
+
+// above the non-temporal threshold of the implementation
+static constexpr DWORD LARGE_BUFFER_SIZE = MB_SIZE + 0x37;
+
+static constexpr DWORD MAX_STRING_LENGTH = 0x200;
+
+static constexpr DWORD BENCHMARK_SIZES[] =
+{
+    7, 16, 31, 64, 200, 1500, 4096, 64 * 1024, 2 * MB_SIZE
+};
+
+static constexpr QWORD BENCHMARK_BYTES_PER_SIZE = 256 * MB_SIZE;
+
+static
+bool
+_UtGuardsIntact(
+    _In_    const std::vector<BYTE>&    Buffer,
+    _In_    DWORD                       Offset,
+    _In_    DWORD                       Size
+    )
+{
+    for (DWORD i = 0; i < Buffer.size(); ++i)
+    {
+        if ((i < Offset || i >= Offset + Size) && Buffer[i] != GUARD_VALUE)
+        {
+            LOG_ERROR("Byte at offset 0x%x outside of [0x%x, 0x%x) was overwritten\n",
+                i, Offset, Offset + Size);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static
+STATUS
+_UtMemorySingleBuffer(
+    _In_    DWORD   Size,
+    _In_    DWORD   SourceOffset,
+    _In_    DWORD   DestinationOffset
+    )
+{
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    std::vector<BYTE> source(Size + MAX_BUFFER_OFFSET);
+    std::vector<BYTE> destination(Size + MAX_BUFFER_OFFSET + 2 * GUARD_SIZE);
+    DWORD dstOffset = GUARD_SIZE + DestinationOffset;
+
+    for (auto& byte : source)
+    {
+        byte = (BYTE) rng.GetNextRandom();
+    }
+    BYTE* src = &source[SourceOffset];
+
+    for (DWORD nonTemporal = 0; nonTemporal < 2; ++nonTemporal)
+    {
+        destination.assign(destination.size(), GUARD_VALUE);
+
+        if (nonTemporal)
+        {
+            cl_memcpynt(&destination[dstOffset], src, Size);
+        }
+        else
+        {
+            cl_memcpy(&destination[dstOffset], src, Size);
+        }
+
+        if (!_UtGuardsIntact(destination, dstOffset, Size)) return CL_STATUS_INTERNAL_ERROR;
+
+        for (DWORD i = 0; i < Size; ++i)
+        {
+            if (destination[dstOffset + i] != src[i])
+            {
+                LOG_ERROR("memcpy%s of size %u failed at index %u\n", nonTemporal ? "nt" : "", Size, i);
+                return CL_STATUS_INTERNAL_ERROR;
+            }
+        }
+
+        BYTE value = (BYTE) rng.GetNextRandom();
+        destination.assign(destination.size(), GUARD_VALUE);
+
+        if (nonTemporal)
+        {
+            cl_memsetnt(&destination[dstOffset], value, Size);
+        }
+        else
+        {
+            cl_memset(&destination[dstOffset], value, Size);
+        }
+
+        if (!_UtGuardsIntact(destination, dstOffset, Size)) return CL_STATUS_INTERNAL_ERROR;
+
+        for (DWORD i = 0; i < Size; ++i)
+        {
+            if (destination[dstOffset + i] != value)
+            {
+                LOG_ERROR("memset%s of size %u failed at index %u\n", nonTemporal ? "nt" : "", Size, i);
+                return CL_STATUS_INTERNAL_ERROR;
+            }
+        }
+
+        // memscan must stop at the first different byte
+        DWORD expectedIndex = (Size == 0) ? 0 : rng.GetNextRandom() % (Size + 1);
+        if (expectedIndex < Size)
+        {
+            destination[dstOffset + expectedIndex] = (BYTE)(value + 1);
+        }
+
+        int index = cl_memscan(&destination[dstOffset], Size, value);
+        if ((DWORD)index != expectedIndex)
+        {
+            LOG_ERROR("memscan of size %u returned %d, expected %u\n", Size, index, expectedIndex);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    // memcmp must see the first difference and return its sign
+    cl_memcpy(&destination[dstOffset], src, Size);
+    if (cl_memcmp(&destination[dstOffset], src, Size) != 0)
+    {
+        LOG_ERROR("memcmp of equal buffers of size %u failed\n", Size);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    if (Size != 0)
+    {
+        DWORD index = rng.GetNextRandom() % Size;
+        BYTE original = src[index];
+
+        destination[dstOffset + index] = (BYTE)(original + 1 + rng.GetNextRandom() % MAX_BYTE);
+
+        int result = cl_memcmp(&destination[dstOffset], src, Size);
+        int expected = destination[dstOffset + index] - original;
+        if (result != expected)
+        {
+            LOG_ERROR("memcmp of size %u with difference at %u returned %d, expected %d\n",
+                Size, index, result, expected);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    // memmove in both directions, the regions overlap in any possible way
+    // because the offsets are smaller than the buffer size
+    for (DWORD direction = 0; direction < 2; ++direction)
+    {
+        std::vector<BYTE> expected(source);
+        std::vector<BYTE> moved(source);
+        DWORD from = direction ? SourceOffset : DestinationOffset;
+        DWORD to = direction ? DestinationOffset : SourceOffset;
+
+        for (DWORD i = 0; i < Size; ++i)
+        {
+            expected[to + i] = source[from + i];
+        }
+
+        cl_memmove(&moved[to], &moved[from], Size);
+
+        if (moved != expected)
+        {
+            LOG_ERROR("memmove of size %u from offset %u to %u failed\n", Size, from, to);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+static
+STATUS
+_UtStringLength()
+{
+    std::vector<char> buffer(MAX_STRING_LENGTH + MAX_BUFFER_OFFSET + 1);
+
+    for (DWORD offset = 0; offset < MAX_BUFFER_OFFSET; ++offset)
+    {
+        for (DWORD length = 0; length <= MAX_STRING_LENGTH; ++length)
+        {
+            buffer.assign(buffer.size(), 'a');
+            buffer[offset + length] = '\0';
+
+            // a terminator before the string must not be seen
+            if (offset != 0)
+            {
+                buffer[offset - 1] = '\0';
+            }
+
+            char* str = &buffer[offset];
+
+            if (cl_strlen(str) != length)
+            {
+                LOG_ERROR("strlen of string of length %u at offset %u returned %u\n",
+                    length, offset, cl_strlen(str));
+                return CL_STATUS_INTERNAL_ERROR;
+            }
+
+            DWORD maxLen = UtCl::RNG::GetInstance().GetNextRandom() % (MAX_STRING_LENGTH + 1);
+            if (cl_strlen_s(str, maxLen) != min(length, maxLen))
+            {
+                LOG_ERROR("strlen_s of string of length %u at offset %u with max length %u returned %u\n",
+                    length, offset, maxLen, cl_strlen_s(str, maxLen));
+                return CL_STATUS_INTERNAL_ERROR;
+            }
+        }
+    }
+
+    if (cl_strlen(NULL) != INVALID_STRING_SIZE)
+    {
+        LOG_ERROR("strlen(NULL) should return INVALID_STRING_SIZE\n");
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+STATUS
+UtClMemory()
+{
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    STATUS status;
+
+    for (DWORD i = 0; i < NO_OF_RANDOM_BUFFERS; ++i)
+    {
+        DWORD size = (i <= MAX_EXHAUSTIVE_SIZE) ? i : rng.GetNextRandom() % MAX_RANDOM_BUFFER_SIZE;
+        DWORD sourceOffset = rng.GetNextRandom() % MAX_BUFFER_OFFSET;
+        DWORD destinationOffset = rng.GetNextRandom() % MAX_BUFFER_OFFSET;
+
+        status = _UtMemorySingleBuffer(size, sourceOffset, destinationOffset);
+        if (!SUCCEEDED(status))
+        {
+            LOG_ERROR("Failed on buffer %u with size %u, offsets %u and %u\n",
+                i, size, sourceOffset, destinationOffset);
+            return status;
+        }
+    }
+
+    status = _UtMemorySingleBuffer(LARGE_BUFFER_SIZE, 3, 0x11);
+    if (!SUCCEEDED(status))
+    {
+        LOG_ERROR("Failed on large buffer\n");
+        return status;
+    }
+
+    return _UtStringLength();
+}
+
+STATUS
+UtClMemoryBenchmark()
+{
+    std::vector<BYTE> source(BENCHMARK_SIZES[ARRAYSIZE(BENCHMARK_SIZES) - 1]);
+    std::vector<BYTE> destination(source.size());
+    volatile int sink = 0;
+
+    for (auto& byte : source)
+    {
+        byte = (BYTE) UtCl::RNG::GetInstance().GetNextRandom();
+    }
+
+    LOG("%10s %14s %14s %14s %14s %14s\n", "Size", "memcpy MB/s", "memset MB/s", "memcmp MB/s", "bytes MB/s", "memcpynt MB/s");
+
+    for (const auto size : BENCHMARK_SIZES)
+    {
+        QWORD iterations = BENCHMARK_BYTES_PER_SIZE / size;
+        double throughput[5];
+
+        for (DWORD func = 0; func < ARRAYSIZE(throughput); ++func)
+        {
+            // memcmp must go through the whole buffer
+            cl_memcpy(destination.data(), source.data(), size);
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (QWORD i = 0; i < iterations; ++i)
+            {
+                switch (func)
+                {
+                case 0:
+                    cl_memcpy(destination.data(), source.data(), size);
+                    break;
+                case 1:
+                    cl_memset(destination.data(), (BYTE)i, size);
+                    break;
+                case 2:
+                    sink = cl_memcmp(destination.data(), source.data(), size);
+                    break;
+                case 3:
+                    // the byte by byte loop the functions used before, as a
+                    // reference
+                    for (DWORD j = 0; j < size; ++j)
+                    {
+                        ((volatile BYTE*)destination.data())[j] = source[j];
+                    }
+                    break;
+                default:
+                    cl_memcpynt(destination.data(), source.data(), size);
+                    break;
+                }
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            throughput[func] = (double)(iterations * size) / MB_SIZE / elapsed.count();
+        }
+
+        LOG("%10u %14.1f %14.1f %14.1f %14.1f %14.1f\n",
+            size, throughput[0], throughput[1], throughput[2], throughput[3], throughput[4]);
+    }
+
+    return CL_STATUS_SUCCESS;
+}
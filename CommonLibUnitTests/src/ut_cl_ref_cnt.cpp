@@ -0,0 +1,278 @@
+#include "ut_base.h"
+#include "ut_cl_ref_cnt.h"
+#include "ref_cnt.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+
+static constexpr DWORD NO_OF_THREADS = 4;
+static constexpr DWORD REFERENCES_PER_THREAD = 0x40000;
+
+// the owner processes the merge requests every this many iterations
+static constexpr DWORD OWNER_PROCESS_INTERVAL = 0x100;
+
+static
+void
+(_cdecl _UtRefCountFree)(
+    IN      PVOID       Object,
+    IN_OPT  PVOID       Context
+    )
+{
+    UNREFERENCED_PARAMETER(Object);
+
+    ASSERT(Context != NULL);
+
+    ++*(std::atomic<DWORD>*) Context;
+}
+
+static
+STATUS
+_UtRefCountShared()
+{
+    REF_COUNT refCount;
+    std::atomic<DWORD> noOfFrees = 0;
+
+    RfcPreInit(&refCount);
+    RfcInit(&refCount, _UtRefCountFree, &noOfFrees);
+
+    for (DWORD i = 0; i < 10; ++i)
+    {
+        if (RfcReference(&refCount) != i + 2)
+        {
+            LOG_ERROR("Reference %u returned the wrong count\n", i);
+            return CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    for (DWORD i = 0; i < 11; ++i)
+    {
+        RfcDereference(&refCount);
+    }
+
+    if (noOfFrees != 1)
+    {
+        LOG_ERROR("Object was freed %u times\n", (DWORD) noOfFrees);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+static
+STATUS
+_UtRefCountBiasedOwnerOnly()
+{
+    RFC_OWNER owner;
+    REF_COUNT refCount;
+    std::atomic<DWORD> noOfFrees = 0;
+
+    RfcOwnerInit(&owner);
+    RfcPreInit(&refCount);
+    RfcInitBiased(&refCount, _UtRefCountFree, &noOfFrees, &owner);
+
+    for (DWORD i = 0; i < 10; ++i)
+    {
+        RfcReferenceEx(&refCount, &owner);
+    }
+
+    for (DWORD i = 0; i < 10; ++i)
+    {
+        RfcDereferenceEx(&refCount, &owner);
+    }
+
+    // none of the operations of the owner may touch the shared count
+    if (refCount.ReferenceCount != RFC_OWNER_BIAS || refCount.BiasedCount != 1)
+    {
+        LOG_ERROR("Shared count is 0x%x, biased count is %u\n", refCount.ReferenceCount, refCount.BiasedCount);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    RfcDereferenceEx(&refCount, &owner);
+
+    if (noOfFrees != 1 || refCount.Owner != NULL)
+    {
+        LOG_ERROR("Object was freed %u times after the owner released it\n", (DWORD) noOfFrees);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+static
+STATUS
+_UtRefCountBiasedNoFree()
+{
+    RFC_OWNER owner;
+    REF_COUNT refCount;
+    std::atomic<DWORD> noOfFrees = 0;
+
+    RfcOwnerInit(&owner);
+    RfcPreInit(&refCount);
+    RfcInitBiased(&refCount, _UtRefCountFree, &noOfFrees, &owner);
+
+    RfcReferenceEx(&refCount, &owner);
+
+    if (RfcDereferenceNoFree(&refCount, &owner))
+    {
+        LOG_ERROR("Last reference reported while the owner holds another one\n");
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    // the owner merges its last reference but leaves the free to the caller
+    if (!RfcDereferenceNoFree(&refCount, &owner) || noOfFrees != 0 || refCount.Owner != NULL)
+    {
+        LOG_ERROR("Last reference not reported or object freed %u times\n", (DWORD) noOfFrees);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    RfcFree(&refCount);
+
+    if (noOfFrees != 1)
+    {
+        LOG_ERROR("Object was freed %u times\n", (DWORD) noOfFrees);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+static
+STATUS
+_UtRefCountBiasedTransfer()
+{
+    RFC_OWNER owner;
+    RFC_OWNER other;
+    REF_COUNT refCount;
+    std::atomic<DWORD> noOfFrees = 0;
+
+    RfcOwnerInit(&owner);
+    RfcOwnerInit(&other);
+    RfcPreInit(&refCount);
+    RfcInitBiased(&refCount, _UtRefCountFree, &noOfFrees, &owner);
+
+    // three references taken by the owner, one of them is released by
+    // someone else
+    RfcReferenceEx(&refCount, &owner);
+    RfcReferenceEx(&refCount, &owner);
+    RfcDereferenceEx(&refCount, &other);
+
+    if (!refCount.MergeRequested || owner.MergeRequests.First != &refCount.MergeEntry)
+    {
+        LOG_ERROR("No merge was requested\n");
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    RfcDereferenceEx(&refCount, &owner);
+    RfcDereferenceEx(&refCount, &owner);
+
+    // the reference handed over with the request keeps the object alive
+    if (noOfFrees != 0)
+    {
+        LOG_ERROR("Object was freed before the merge\n");
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    RfcOwnerProcessMergeRequests(&other);
+    if (noOfFrees != 0)
+    {
+        LOG_ERROR("Object was freed by another owner\n");
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    RfcOwnerProcessMergeRequests(&owner);
+    if (noOfFrees != 1)
+    {
+        LOG_ERROR("Object was freed %u times after the merge\n", (DWORD) noOfFrees);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+static
+STATUS
+_UtRefCountBiasedMultiThreaded()
+{
+    RFC_OWNER owner;
+    std::vector<RFC_OWNER> others(NO_OF_THREADS);
+    REF_COUNT refCount;
+    std::atomic<DWORD> noOfFrees = 0;
+    std::atomic<DWORD> noOfRunning = NO_OF_THREADS;
+    std::vector<std::thread> threads;
+
+    RfcOwnerInit(&owner);
+    RfcPreInit(&refCount);
+    RfcInitBiased(&refCount, _UtRefCountFree, &noOfFrees, &owner);
+
+    // the other threads take their references from the shared count and
+    // release them as other owners, the first release asks for a merge
+    for (DWORD i = 0; i < NO_OF_THREADS; ++i)
+    {
+        RfcOwnerInit(&others[i]);
+
+        threads.emplace_back([&refCount, &others, &noOfRunning, i]()
+        {
+            for (DWORD j = 0; j < REFERENCES_PER_THREAD; ++j)
+            {
+                RfcReferenceEx(&refCount, &others[i]);
+                RfcDereferenceEx(&refCount, &others[i]);
+            }
+
+            --noOfRunning;
+        });
+    }
+
+    // only this thread acts as the owner
+    for (DWORD j = 0; noOfRunning != 0; ++j)
+    {
+        RfcReferenceEx(&refCount, &owner);
+        RfcDereferenceEx(&refCount, &owner);
+
+        if (j % OWNER_PROCESS_INTERVAL == 0)
+        {
+            RfcOwnerProcessMergeRequests(&owner);
+        }
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    if (noOfFrees != 0)
+    {
+        LOG_ERROR("Object was freed while the owner held its initial reference\n");
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    RfcDereferenceEx(&refCount, &owner);
+    RfcOwnerProcessMergeRequests(&owner);
+
+    if (noOfFrees != 1)
+    {
+        LOG_ERROR("Object was freed %u times\n", (DWORD) noOfFrees);
+        return CL_STATUS_INTERNAL_ERROR;
+    }
+
+    return CL_STATUS_SUCCESS;
+}
+
+STATUS
+UtClRefCount()
+{
+    STATUS status;
+
+    status = _UtRefCountShared();
+    if (!SUCCEEDED(status)) return status;
+
+    status = _UtRefCountBiasedOwnerOnly();
+    if (!SUCCEEDED(status)) return status;
+
+    status = _UtRefCountBiasedNoFree();
+    if (!SUCCEEDED(status)) return status;
+
+    status = _UtRefCountBiasedTransfer();
+    if (!SUCCEEDED(status)) return status;
+
+    return _UtRefCountBiasedMultiThreaded();
+}
@@ -1,5 +1,7 @@
 #include "ut_base.h"
 #include "ut_cl_string.h"
+#include "ut_cl_rng.h"
+#include <string>
 
 #define MAX_STRING_LENGTH           100
 
@@ -56,6 +58,71 @@ typedef struct _UT_STRING_TC_ARGS
 
 static FUNC_UtStringTestFunc _UtStringTestTrim;
 
+typedef struct _UT_FORMAT_TEST
+{
+    DWORD                       BufferSize;
+    STATUS                      ExpectedStatus;
+    const char*                 ExpectedResult;
+    STATUS                      (*Format)(char* Buffer, DWORD BufferSize);
+} UT_FORMAT_TEST;
+
+// the expected results are the ones produced by the implementation before the
+// formatter was rewritten, except for INT32_MIN which used to be sign extended
+static const UT_FORMAT_TEST FORMAT_TESTS[] =
+{
+    {64, 1, "0", [](char* B, DWORD S) { return cl_snprintf(B, S, "%u", 0); }},
+    {64, 1, "4294967295", [](char* B, DWORD S) { return cl_snprintf(B, S, "%u", MAX_DWORD); }},
+    {64, 1, "-2147483648", [](char* B, DWORD S) { return cl_snprintf(B, S, "%d", (INT32) 0x80000000); }},
+    {64, 1, "-1", [](char* B, DWORD S) { return cl_snprintf(B, S, "%d", -1); }},
+    {64, 1, "2147483647", [](char* B, DWORD S) { return cl_snprintf(B, S, "%d", 0x7FFFFFFF); }},
+    {64, 1, "18446744073709551615", [](char* B, DWORD S) { return cl_snprintf(B, S, "%U", MAX_QWORD); }},
+    {64, 1, "-9223372036854775808", [](char* B, DWORD S) { return cl_snprintf(B, S, "%D", (INT64) 0x8000000000000000ULL); }},
+    {64, 1, "-1234567890123", [](char* B, DWORD S) { return cl_snprintf(B, S, "%D", -1234567890123LL); }},
+    {64, 1, "DEADBEEF", [](char* B, DWORD S) { return cl_snprintf(B, S, "%x", 0xDEADBEEF); }},
+    {64, 1, "123456789ABCDEF", [](char* B, DWORD S) { return cl_snprintf(B, S, "%X", 0x123456789ABCDEFULL); }},
+    {64, 1, "101", [](char* B, DWORD S) { return cl_snprintf(B, S, "%b", 5); }},
+    {128, 1, "1000000000000000000000000000000000000000000000000000000000000001",
+        [](char* B, DWORD S) { return cl_snprintf(B, S, "%B", 0x8000000000000001ULL); }},
+    {64, 1, "[   42]", [](char* B, DWORD S) { return cl_snprintf(B, S, "[%5u]", 42); }},
+    {64, 1, "[00042]", [](char* B, DWORD S) { return cl_snprintf(B, S, "[%05u]", 42); }},
+    {64, 1, "[000000-5]", [](char* B, DWORD S) { return cl_snprintf(B, S, "[%08d]", -5); }},
+    {64, 1, "[    -5]", [](char* B, DWORD S) { return cl_snprintf(B, S, "[%6d]", -5); }},
+    {64, 1, "[12345]", [](char* B, DWORD S) { return cl_snprintf(B, S, "[%2u]", 12345); }},
+    {64, 1, "0x0000000000000ABC", [](char* B, DWORD S) { return cl_snprintf(B, S, "0x%016X", 0xABCULL); }},
+    {64, 2, "[Hi]", [](char* B, DWORD S) { return cl_snprintf(B, S, "[%c%c]", 'H', 'i'); }},
+    {64, 1, "[string]", [](char* B, DWORD S) { return cl_snprintf(B, S, "[%s]", "string"); }},
+    {64, 1, "[     abc]", [](char* B, DWORD S) { return cl_snprintf(B, S, "[%8s]", "abc"); }},
+    {64, 1, "[abc]", [](char* B, DWORD S) { return cl_snprintf(B, S, "[%3S]", "abcdef"); }},
+    {64, 1, "[]", [](char* B, DWORD S) { return cl_snprintf(B, S, "[%S]", "abc"); }},
+    {64, 2, "a and 7", [](char* B, DWORD S) { return cl_snprintf(B, S, "%s and %u", "a", 7); }},
+    {8, 1, "1234567", [](char* B, DWORD S) { return cl_snprintf(B, S, "%u", 1234567); }},
+    {8, STATUS_BUFFER_TOO_SMALL, "", [](char* B, DWORD S) { return cl_snprintf(B, S, "%u", 12345678); }},
+    {8, STATUS_BUFFER_TOO_SMALL, "abc", [](char* B, DWORD S) { return cl_snprintf(B, S, "abc%s", "defgh"); }},
+    {4, STATUS_BUFFER_TOO_SMALL, "tex", [](char* B, DWORD S) { return cl_snprintf(B, S, "text"); }},
+    {64, STATUS_PARSE_FAILED, "100", [](char* B, DWORD S) { return cl_snprintf(B, S, "100%%"); }},
+    {64, STATUS_PARSE_FAILED, "", [](char* B, DWORD S) { return cl_snprintf(B, S, "%q", 1); }},
+};
+
+static constexpr DWORD NO_OF_RANDOM_FORMATS = 100000;
+static constexpr DWORD FORMAT_BUFFER_SIZE = 256;
+
+static
+STATUS
+_UtFormatLength(
+    _Out_writes_(BufferSize)    char*   Buffer,
+    _In_                        DWORD   BufferSize,
+    _Out_                       DWORD*  Length,
+    _In_z_                      char*   Format,
+    ...
+    )
+{
+    va_list va;
+
+    va_start(va, Format);
+
+    return cl_vsnprintfex(Buffer, BufferSize, Format, va, Length);
+}
+
 static const UT_SINGLE_STRING_TEST STR_LIST_TO_TEST[] =
 {
     {"Test Simplu", "Test Simplu"},
@@ -104,6 +171,73 @@ UtClStrings(
     return CL_STATUS_SUCCESS;
 }
 
+STATUS
+UtClFormatting(
+    void
+    )
+{
+    UtCl::RNG& rng = UtCl::RNG::GetInstance();
+    char buffer[FORMAT_BUFFER_SIZE];
+    char expected[FORMAT_BUFFER_SIZE];
+    STATUS status = CL_STATUS_SUCCESS;
+
+    for (DWORD i = 0; i < ARRAYSIZE(FORMAT_TESTS); ++i)
+    {
+        STATUS result;
+
+        cl_memset(buffer, 'Z', sizeof(buffer));
+
+        result = FORMAT_TESTS[i].Format(buffer, FORMAT_TESTS[i].BufferSize);
+        if (result != FORMAT_TESTS[i].ExpectedStatus || cl_strcmp(buffer, FORMAT_TESTS[i].ExpectedResult) != 0)
+        {
+            LOG_ERROR("Format test %u returned 0x%x [%s], expected 0x%x [%s]\n",
+                i, result, buffer, FORMAT_TESTS[i].ExpectedStatus, FORMAT_TESTS[i].ExpectedResult);
+            status = CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    // the C runtime is the reference for the numeric conversions, %x and %X of
+    // the library print upper case digits, %x being the 32 bit version
+    for (DWORD i = 0; i < NO_OF_RANDOM_FORMATS; ++i)
+    {
+        DWORD value = rng.GetNextRandom() >> (rng.GetNextRandom() % 32);
+        QWORD value64 = ((QWORD) rng.GetNextRandom() << 32 | rng.GetNextRandom()) >> (rng.GetNextRandom() % 64);
+        DWORD bufferSize = 1 + rng.GetNextRandom() % 80;
+        DWORD length;
+        STATUS result;
+        int expectedLength;
+
+        expectedLength = snprintf(expected, sizeof(expected), "%u|%d|%X|%llu|%lld|%llX",
+                                  value, (INT32) value, value, value64, (INT64) value64, value64);
+
+        result = _UtFormatLength(buffer, bufferSize, &length, "%u|%d|%x|%U|%D|%X",
+                                 value, (INT32) value, value, value64, (INT64) value64, value64);
+
+        if (length != cl_strlen(buffer))
+        {
+            LOG_ERROR("Length %u reported for [%s]\n", length, buffer);
+            status = CL_STATUS_INTERNAL_ERROR;
+        }
+
+        if (expectedLength < (int) bufferSize)
+        {
+            if (result != 6 || cl_strcmp(buffer, expected) != 0)
+            {
+                LOG_ERROR("Formatted [%s] with status 0x%x, expected [%s]\n", buffer, result, expected);
+                status = CL_STATUS_INTERNAL_ERROR;
+            }
+        }
+        else if (result != STATUS_BUFFER_TOO_SMALL || cl_strncmp(buffer, expected, length) != 0)
+        {
+            LOG_ERROR("Formatted [%s] with status 0x%x in a %u byte buffer, expected a prefix of [%s]\n",
+                buffer, result, bufferSize, expected);
+            status = CL_STATUS_INTERNAL_ERROR;
+        }
+    }
+
+    return status;
+}
+
 static
 BOOLEAN
 (__cdecl _UtStringTestTrim)(
@@ -19,7 +19,8 @@ STATUS
 EthSendFrame(
     IN                              PETH_DEVICE     Device,
     IN                              WORD            DescriptorIndex,
-    IN                              WORD            Length
+    IN                              WORD            Length,
+    IN                              BOOLEAN         EndOfPacket
     );
 
 _No_competing_thread_
@@ -31,8 +31,20 @@
 #define ETH_NO_OF_RX_DESCS                      32
 #define ETH_NO_OF_TX_DESCS                      32
 
-#define ETH_BUFFER_SIZE                         4*KB_SIZE
-
+// any size supported by RCTL.BSIZE may be used, frames larger than a
+// buffer are spread over multiple descriptors
+#ifndef ETH_BUFFER_SIZE
+#define ETH_BUFFER_SIZE                         (4*KB_SIZE)
+#endif
+
+// RCTL.BSIZE values, the _SEX ones are valid only when RCTL.BSEX is set
+#define ETH_BSIZE_2KB                           0b00
+#define ETH_BSIZE_1KB                           0b01
+#define ETH_BSIZE_512B                          0b10
+#define ETH_BSIZE_256B                          0b11
+
+#define ETH_BSIZE_16KB_SEX                      0b01
+#define ETH_BSIZE_8KB_SEX                       0b10
 #define ETH_BSIZE_4KB_SEX                       0b11
 
 #pragma pack(push,1)
@@ -68,6 +68,7 @@ STATUS
     memzero(&registration, sizeof(MINIPORT_REGISTRATION));
 
     registration.DeviceContextSize = sizeof(ETH_DEVICE);
+    registration.MaximumMtu = ETHERNET_JUMBO_MTU;
 
     registration.RxBuffers.BufferSize = ETH_BUFFER_SIZE;
     registration.RxBuffers.DescriptorSize = ETH_DESCRIPTOR_SIZE;
@@ -162,7 +163,8 @@ STATUS
 (__cdecl _Eth82574LSendBuffer)(
     IN  PMINIPORT_DEVICE            MiniportDevice,
     IN  WORD                        DescriptorIndex,
-    IN  WORD                        Length
+    IN  WORD                        Length,
+    IN  BOOLEAN                     EndOfPacket
     )
 {
     PETH_DEVICE pEthDevice;
@@ -172,7 +174,7 @@ STATUS
     pEthDevice = NetworkPortGetMiniportExtension(MiniportDevice);
     ASSERT(NULL != pEthDevice);
 
-    return EthSendFrame(pEthDevice, DescriptorIndex, Length);
+    return EthSendFrame(pEthDevice, DescriptorIndex, Length, EndOfPacket);
 }
 
 static
@@ -84,6 +84,24 @@ _EthSignalTxQueueFullIfNecessary(
     IN      PETH_DEVICE         Device
     );
 
+static
+SAL_SUCCESS
+STATUS
+_EthGetRxBufferSizeEncoding(
+    IN      WORD                BufferSize,
+    OUT     BOOLEAN*            BufferSizeExtension,
+    OUT     BYTE*               ReceiveBufferSize
+    );
+
+static
+BOOLEAN
+_EthGetReceivedFrame(
+    IN      PETH_DEVICE         Device,
+    IN      WORD                FirstDescriptorIndex,
+    OUT     WORD*               NumberOfDescriptors,
+    OUT     DWORD*              FrameLength
+    );
+
 SAL_SUCCESS
 STATUS
 EthInitializeDevice(
@@ -226,19 +244,37 @@ EthReceiveFrame(
 
     noOfFramesReceived = 0;
 
+    // descriptors written back by the hardware which we haven't processed yet
+    NetworkPortUpdateRingHighWaterMark(&Device->MiniportDevice->Statistics.RxRingHighWaterMark,
+                                       (EthGetRxHead(Device) + Device->RxData.Buffers.NumberOfDescriptors - curRxIndex) % Device->RxData.Buffers.NumberOfDescriptors
+                                       );
+
     while (Device->RxData.ReceiveBuffer[curRxIndex].Status.DescriptorDone)
     {
-        WORD len = Device->RxData.ReceiveBuffer[curRxIndex].Length;
+        WORD noOfDescriptors;
+        DWORD frameLength;
+        STATUS notifyStatus;
 
-        ASSERT( len <= Device->RxData.Buffers.BufferSize );
-        ASSERT( 1 == Device->RxData.ReceiveBuffer[curRxIndex].Status.EOP );
+        if (!_EthGetReceivedFrame(Device, curRxIndex, &noOfDescriptors, &frameLength))
+        {
+            // the rest of the frame will be written back later
+            break;
+        }
 
-        status = NetworkPortNotifyReceiveBuffer(Device->MiniportDevice, curRxIndex, len );
-        ASSERT( SUCCEEDED(status));
+        // if the port driver cannot take the frame it is dropped and accounted
+        // for by the port, the descriptors must be given back to the hardware anyway
+        notifyStatus = NetworkPortNotifyReceiveFrame(Device->MiniportDevice, curRxIndex, noOfDescriptors, frameLength );
+        if (!SUCCEEDED(notifyStatus))
+        {
+            LOG_TRACE_NETWORK("NetworkPortNotifyReceiveFrame failed with status 0x%x\n", notifyStatus);
+        }
 
-        Device->RxData.ReceiveBuffer[curRxIndex].Status.DescriptorDone = 0;
-        prevRxIndex = curRxIndex;
-        curRxIndex = (curRxIndex + 1) % Device->RxData.Buffers.NumberOfDescriptors;
+        for (WORD i = 0; i < noOfDescriptors; ++i)
+        {
+            Device->RxData.ReceiveBuffer[curRxIndex].Status.DescriptorDone = 0;
+            prevRxIndex = curRxIndex;
+            curRxIndex = (curRxIndex + 1) % Device->RxData.Buffers.NumberOfDescriptors;
+        }
         EthSetRxTail(Device, prevRxIndex);
 
         noOfFramesReceived = noOfFramesReceived + 1;
@@ -259,7 +295,8 @@ STATUS
 EthSendFrame(
     IN                              PETH_DEVICE     Device,
     IN                              WORD            DescriptorIndex,
-    IN                              WORD            Length
+    IN                              WORD            Length,
+    IN                              BOOLEAN         EndOfPacket
     )
 {
     WORD curTxIndex;
@@ -277,7 +314,12 @@ EthSendFrame(
     pDescriptor->Command.DEXT = FALSE;
     pDescriptor->Command.IC = FALSE;
     pDescriptor->Command.IFCS = TRUE;
-    pDescriptor->Command.EOP = TRUE;
+
+    // the hardware transmits the frame once it fetches the last descriptor,
+    // each descriptor reports its completion so it can be reused as soon as
+    // its data was read
+    pDescriptor->Command.EOP = EndOfPacket;
+
     pDescriptor->Command.IDE = TRUE;
     pDescriptor->Command.RS = TRUE;
     pDescriptor->Command.VLE = FALSE;
@@ -288,6 +330,11 @@ EthSendFrame(
     curTxIndex = (curTxIndex + 1) % Device->TxData.Buffers.NumberOfDescriptors;
     Device->TxData.Buffers.CurrentDescriptor = curTxIndex;
 
+    // descriptors handed to the hardware which were not yet transmitted
+    NetworkPortUpdateRingHighWaterMark(&Device->MiniportDevice->Statistics.TxRingHighWaterMark,
+                                       (curTxIndex + Device->TxData.Buffers.NumberOfDescriptors - EthGetTxHead(Device)) % Device->TxData.Buffers.NumberOfDescriptors
+                                       );
+
     _EthSignalTxQueueFullIfNecessary(Device);
 
     EthSetTxTail(Device, curTxIndex);
@@ -472,6 +519,8 @@ _EthRxInit(
     PHYSICAL_ADDRESS ringBufferPa;
     RECEIVE_CONTROL_REGISTER ctrlRegister;
     RECEIVE_FILTER_CONTROL_REGISTER filterRegister;
+    BOOLEAN bufferSizeExtension;
+    BYTE receiveBufferSize;
 
     ASSERT(NULL != Device);
 
@@ -482,6 +531,16 @@ _EthRxInit(
     ctrlRegister.Raw = 0;
     filterRegister.Raw = 0;
 
+    status = _EthGetRxBufferSizeEncoding(Device->RxData.Buffers.BufferSize,
+                                         &bufferSizeExtension,
+                                         &receiveBufferSize
+                                         );
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("_EthGetRxBufferSizeEncoding", status);
+        return status;
+    }
+
     ringBufferPa = IoGetPhysicalAddress((PVOID)Device->RxData.ReceiveBuffer);
     if (NULL == ringBufferPa)
     {
@@ -516,8 +575,14 @@ _EthRxInit(
     // accept broadcast, why not
     ctrlRegister.BroadcastAcceptMode = TRUE;
 
-    ctrlRegister.BufferSizeExtension = TRUE;
-    ctrlRegister.ReceiveBufferSize = ETH_BSIZE_4KB_SEX;
+    ctrlRegister.BufferSizeExtension = bufferSizeExtension;
+    ctrlRegister.ReceiveBufferSize = receiveBufferSize;
+
+    // frames larger than 1522 bytes are received only if LPE is set, they
+    // are spread over as many descriptors as needed, the port driver
+    // limits the size of the frames sent
+    ctrlRegister.LongPacketEnable = TRUE;
+
     ctrlRegister.StoreBadPackets = TRUE;
     ctrlRegister.StripEthCRC = TRUE;
 
@@ -684,4 +749,100 @@ _EthSignalTxQueueFullIfNecessary(
 
         LockRelease(&Device->TxData.TxInterruptLock, intrState);
     }
+}
+
+static
+SAL_SUCCESS
+STATUS
+_EthGetRxBufferSizeEncoding(
+    IN      WORD                BufferSize,
+    OUT     BOOLEAN*            BufferSizeExtension,
+    OUT     BYTE*               ReceiveBufferSize
+    )
+{
+    ASSERT( NULL != BufferSizeExtension );
+    ASSERT( NULL != ReceiveBufferSize );
+
+    *BufferSizeExtension = (BOOLEAN) (BufferSize >= 4096);
+
+    switch (BufferSize)
+    {
+    case 256:
+        *ReceiveBufferSize = ETH_BSIZE_256B;
+        break;
+    case 512:
+        *ReceiveBufferSize = ETH_BSIZE_512B;
+        break;
+    case 1024:
+        *ReceiveBufferSize = ETH_BSIZE_1KB;
+        break;
+    case 2048:
+        *ReceiveBufferSize = ETH_BSIZE_2KB;
+        break;
+    case 4096:
+        *ReceiveBufferSize = ETH_BSIZE_4KB_SEX;
+        break;
+    case 8192:
+        *ReceiveBufferSize = ETH_BSIZE_8KB_SEX;
+        break;
+    case 16384:
+        *ReceiveBufferSize = ETH_BSIZE_16KB_SEX;
+        break;
+    default:
+        LOG_ERROR("RX buffer size %u is not supported by the device\n", BufferSize);
+        return STATUS_UNSUPPORTED;
+    }
+
+    LOG_TRACE_NETWORK("RX buffer size %u => BSEX: %u, BSIZE: 0x%x\n",
+                      BufferSize, *BufferSizeExtension, *ReceiveBufferSize);
+
+    return STATUS_SUCCESS;
+}
+
+static
+BOOLEAN
+_EthGetReceivedFrame(
+    IN      PETH_DEVICE         Device,
+    IN      WORD                FirstDescriptorIndex,
+    OUT     WORD*               NumberOfDescriptors,
+    OUT     DWORD*              FrameLength
+    )
+{
+    WORD curRxIndex;
+    WORD noOfDescriptors;
+    DWORD frameLength;
+
+    ASSERT( NULL != Device );
+    ASSERT( NULL != NumberOfDescriptors );
+    ASSERT( NULL != FrameLength );
+
+    curRxIndex = FirstDescriptorIndex;
+    noOfDescriptors = 1;
+    frameLength = 0;
+
+    ASSERT( Device->RxData.ReceiveBuffer[curRxIndex].Status.DescriptorDone );
+
+    // the frame ends with the first descriptor which has EOP set, all the
+    // descriptors before it were completely filled by the hardware
+    while (!Device->RxData.ReceiveBuffer[curRxIndex].Status.EOP)
+    {
+        ASSERT( Device->RxData.ReceiveBuffer[curRxIndex].Length == Device->RxData.Buffers.BufferSize );
+        frameLength = frameLength + Device->RxData.ReceiveBuffer[curRxIndex].Length;
+
+        curRxIndex = (curRxIndex + 1) % Device->RxData.Buffers.NumberOfDescriptors;
+        if (!Device->RxData.ReceiveBuffer[curRxIndex].Status.DescriptorDone)
+        {
+            return FALSE;
+        }
+
+        noOfDescriptors = noOfDescriptors + 1;
+    }
+
+    ASSERT( Device->RxData.ReceiveBuffer[curRxIndex].Length <= Device->RxData.Buffers.BufferSize );
+    frameLength = frameLength + Device->RxData.ReceiveBuffer[curRxIndex].Length;
+
+    *NumberOfDescriptors = noOfDescriptors;
+    *FrameLength = frameLength;
+
+    return TRUE;
 }
\ No newline at end of file
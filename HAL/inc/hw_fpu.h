@@ -52,6 +52,14 @@ typedef struct  _XSAVE_LEGACY_REGION
 STATIC_ASSERT_INFO(sizeof(XSAVE_LEGACY_REGION) == PREDEFINED_XSAVE_LEGACY_REGION_SIZE,
     "Intel Software Developer Manual Vol 1 Section 13.4.1 Legacy Region of an XSAVE Area");
 
+// FXSAVE/FXRSTOR operate on a XSAVE_LEGACY_REGION aligned to 16 bytes
+#define FXSAVE_AREA_REQUIRED_ALIGNMENT              0x10
+
+// Values loaded by FNINIT and found in MXCSR after reset: all the x87 and
+// SIMD floating-point exceptions are masked
+#define FPU_DEFAULT_CONTROL_WORD                    0x037F
+#define FPU_DEFAULT_MXCSR                           0x1F80
+
 #define PREDEFINED_XSAVE_AREA_HEADER_SIZE           0x40
 
 typedef struct  _XSAVE_AREA_HEADER
@@ -27,6 +27,13 @@
 
 #define MOV_TO_CR3_DO_NOT_INVALIDATE_PCID_MAPPINGS  ((QWORD)1<<63)
 
+// INVPCID invalidation types
+// Intel System Programming Manual Vol 2A, INVPCID - Invalidate Process-Context Identifier
+#define INVPCID_INDIVIDUAL_ADDRESS                  0
+#define INVPCID_SINGLE_CONTEXT                      1
+#define INVPCID_ALL_CONTEXTS_INCLUDING_GLOBAL       2
+#define INVPCID_ALL_CONTEXTS                        3
+
 typedef WORD PCID;
 
 #pragma pack(push,1)
@@ -170,7 +177,18 @@ typedef struct _PT_ENTRY
     QWORD           Dirty               :   1;
     QWORD           PAT                 :   1;
     QWORD           Global              :   1;
-    QWORD           Ignored0            :   3;
+
+    // software defined: the page is shared read-only and must be copied on
+    // the first write
+    QWORD           CopyOnWrite         :   1;
+
+    // software defined: valid only when the entry is not present, the page
+    // was written to the swap space and PhysicalAddress holds its slot
+    QWORD           SwappedOut          :   1;
+
+    // software defined: the frame is owned by someone else, e.g. the image
+    // cache, it is not released when the page is unmapped
+    QWORD           SharedFrame         :   1;
     QWORD           PhysicalAddress     :   MAXPHYADDR-12;          
     QWORD           Ignored1            :   11;
     QWORD           XD                  :   1;
@@ -331,9 +349,21 @@ typedef struct _PTE_MAP_FLAGS
     WORD            PagingStructure      :    1;
     WORD            UserAccess           :    1;
     WORD            GlobalPage           :    1;
-    WORD            __Reserved0          :    7;
+    WORD            CopyOnWrite          :    1;
+    WORD            SharedFrame          :    1;
+    WORD            __Reserved0          :    5;
 } PTE_MAP_FLAGS, *PPTE_MAP_FLAGS;
 STATIC_ASSERT(sizeof(PTE_MAP_FLAGS) == sizeof(WORD));
+
+// the memory operand of INVPCID, the linear address is used only for
+// INVPCID_INDIVIDUAL_ADDRESS
+typedef struct _INVPCID_DESCRIPTOR
+{
+    QWORD           PCID                 :    PCID_NO_OF_BITS;
+    QWORD           Reserved             :    64 - PCID_NO_OF_BITS;
+    QWORD           LinearAddress;
+} INVPCID_DESCRIPTOR, *PINVPCID_DESCRIPTOR;
+STATIC_ASSERT(sizeof(INVPCID_DESCRIPTOR) == 2 * sizeof(QWORD));
 #pragma warning(default:4214)
 #pragma warning(default:4201)
 #pragma pack(pop)
@@ -345,6 +375,23 @@ PteMap(
     IN          PTE_MAP_FLAGS       Flags
     );
 
+//******************************************************************************
+// Function:     PteMapLargePage
+// Description:  Maps a 2MB page through a PD entry or a 1GB page through a
+//               PDPT entry, both leaf formats share the same layout.
+// Returns:      void
+// Parameter:    IN PVOID PageTable - PD or PDPT entry to fill
+// Parameter:    IN PHYSICAL_ADDRESS PhysicalAddress - must be aligned to the
+//               size of the page mapped
+// Parameter:    IN PTE_MAP_FLAGS Flags
+//******************************************************************************
+void
+PteMapLargePage(
+    IN          PVOID               PageTable,
+    IN          PHYSICAL_ADDRESS    PhysicalAddress,
+    IN          PTE_MAP_FLAGS       Flags
+    );
+
 void
 PteUnmap(
     IN          PVOID           PageTable
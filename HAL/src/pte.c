@@ -32,9 +32,49 @@ PteMap(
         pTablePointer->PWT = (Flags.PatIndex >> 0) & 1;
 
         pTablePointer->Global = Flags.GlobalPage;
+        pTablePointer->CopyOnWrite = Flags.CopyOnWrite;
+        pTablePointer->SharedFrame = Flags.SharedFrame;
     }
 }
 
+void
+PteMapLargePage(
+    IN          PVOID               PageTable,
+    IN          PHYSICAL_ADDRESS    PhysicalAddress,
+    IN          PTE_MAP_FLAGS       Flags
+    )
+{
+    PD_ENTRY_2MB* pTablePointer;
+
+    ASSERT(NULL != PageTable);
+    ASSERT(IsAddressAligned(PhysicalAddress, PAGE_2MB_OFFSET + 1));
+    ASSERT(!Flags.PagingStructure);
+
+    // shared pages are copied one at a time
+    ASSERT(!Flags.CopyOnWrite);
+    ASSERT(!Flags.SharedFrame);
+
+    pTablePointer = PageTable;
+    memzero(pTablePointer, sizeof(PD_ENTRY_2MB));
+
+    // for 1GB pages bits 29:21 of the address are reserved and they will
+    // be 0 because the address is 1GB aligned
+    pTablePointer->PhysicalAddress = (QWORD) PhysicalAddress >> SHIFT_FOR_LARGE_PAGE;
+    pTablePointer->PageSize = 1;
+    pTablePointer->Present = 1;
+
+    pTablePointer->ReadWrite = Flags.Writable;
+    pTablePointer->XD = !Flags.Executable;
+    pTablePointer->UserSupervisor = Flags.UserAccess;
+
+    // the PAT bit of a large page is bit 12, bit 7 is the PS bit
+    pTablePointer->PAT = (Flags.PatIndex >> 2) & 1;
+    pTablePointer->PCD = (Flags.PatIndex >> 1) & 1;
+    pTablePointer->PWT = (Flags.PatIndex >> 0) & 1;
+
+    pTablePointer->Global = Flags.GlobalPage;
+}
+
 void
 PteUnmap(
     IN          PVOID           PageTable
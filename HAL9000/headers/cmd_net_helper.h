@@ -5,4 +5,6 @@
 FUNC_GenericCommand CmdListNetworks;
 FUNC_GenericCommand CmdNetRecv;
 FUNC_GenericCommand CmdNetSend;
-FUNC_GenericCommand CmdChangeDevStatus;
\ No newline at end of file
+FUNC_GenericCommand CmdChangeDevStatus;
+FUNC_GenericCommand CmdNetStat;
+FUNC_GenericCommand CmdSetNetMtu;
\ No newline at end of file
@@ -7,3 +7,6 @@ FUNC_GenericCommand CmdSetIdle;
 FUNC_GenericCommand CmdGetIdle;
 FUNC_GenericCommand CmdResetSystem;
 FUNC_GenericCommand CmdShutdownSystem;
+FUNC_GenericCommand CmdDisplayTlbStats;
+FUNC_GenericCommand CmdDisplaySwapStats;
+FUNC_GenericCommand CmdDisplayCounters;
@@ -6,6 +6,8 @@
 #include "list.h"
 #include "synch.h"
 #include "cpu_structures.h"
+#include "percpu_counter.h"
+#include "ref_cnt.h"
 
 #define STACK_DEFAULT_SIZE          (4*PAGE_SIZE)
 #define STACK_GUARD_SIZE            (2*PAGE_SIZE)
@@ -23,17 +25,61 @@ typedef struct _THREADING_DATA
     QWORD               KernelTicks;
 } THREADING_DATA, *PTHREADING_DATA;
 
+// number of address spaces whose translations a CPU keeps cached at the same
+// time, each under its own PCID
+#define CPU_NO_OF_PCID_SLOTS        8
+
+typedef struct _PCID_SLOT
+{
+    // ContextId of the address space tagged with the PCID of the slot, 0 if
+    // the slot was never used
+    QWORD               ContextId;
+
+    // TlbGeneration of the address space the cached translations reflect
+    QWORD               Generation;
+
+    // value of AddressSpaceSwitches when the slot was last loaded, the least
+    // recently used slot is recycled
+    QWORD               LastUse;
+} PCID_SLOT, *PPCID_SLOT;
+
+typedef struct _PCID_DATA
+{
+    // slot i is tagged with PCID PCID_FIRST_VALID_VALUE + i
+    PCID_SLOT               Slots[CPU_NO_OF_PCID_SLOTS];
+    BYTE                    ActiveSlot;
+
+    // paging tables currently loaded in CR3
+    struct _PAGING_DATA*    ActivePagingData;
+
+    // kept per CPU so the switches do not contend on shared counters, see
+    // TLB_STATISTICS
+    QWORD                   AddressSpaceSwitches;
+    QWORD                   TaggedSwitches;
+    QWORD                   PcidsRecycled;
+} PCID_DATA, *PPCID_DATA;
+
+#pragma warning(push)
+
+// warning C4324: structure was padded due to alignment specifier
+#pragma warning(disable:4324)
+
+// Allocated cache line aligned. The fields are grouped by who writes them so
+// the CPUs walking the list of PCPUs or sending IPIs do not keep stealing the
+// lines the CPU itself updates on each interrupt and thread switch.
 typedef struct _PCPU
 {
+    // Setup when the CPU is initialized, afterwards only read
     PVOID                       StackTop;
     DWORD                       StackSize;
 
+    // Read through GS by GetCurrentPcpuFast
+    struct _PCPU*               Self;
+
     APIC_ID                     ApicId;
     APIC_ID                     LogicalApicId;
     BOOLEAN                     BspProcessor;
 
-    // TSS base address
-    TSS                         Tss;
     PVOID                       TssStacks[NO_OF_IST];
     BYTE                        NumberOfTssStacks;
     WORD                        TrSelector;
@@ -42,23 +88,49 @@ typedef struct _PCPU
 
     BOOLEAN                     ApicInitialized;
 
-    THREADING_DATA              ThreadData;
-
-    // IPC data
-    LIST_ENTRY                  EventList;
+    // IPC data, written by the CPUs sending IPIs to this one
+    __declspec(align(CACHE_LINE_SIZE))
     LOCK                        EventListLock;
+    LIST_ENTRY                  EventList;
     DWORD                       NoOfEventsInList;
 
+    // Owner of the objects biased towards this CPU, the other CPUs push
+    // merge requests, see ref_cnt.h
+    RFC_OWNER                   RfcOwner;
+
+    // Only written by the CPU itself from here on
+
+    // TSS base address, RSP0 changes on each thread switch
+    __declspec(align(CACHE_LINE_SIZE))
+    TSS                         Tss;
+
+    THREADING_DATA              ThreadData;
+
+    // RCU epoch of the last quiescent state, read by the CPUs waiting for a
+    // grace period, see ex_rcu.c
+    volatile QWORD              RcuQuiescentEpoch;
+
     // Used to mark the fact that the VMM specialized functions for
     // allocating or freeing a VA reservation are working with the VA reservation
     // space metadata (if #PFs occur on these pages a mapping must be created on
     // the spot and they must be resolved)
     BOOLEAN                     VmmMemoryAccess;
-    QWORD                       PageFaults;
+
+    // Only accessed by the CPU itself with interrupts disabled, see tlb.c
+    PCID_DATA                   PcidData;
 
     QWORD                       InterruptsTriggered[NO_OF_TOTAL_INTERRUPTS];
+
+    // Only written by the CPU itself, see percpu_counter.h
+    PERCPU_COUNTER_BLOCK        Counters;
 } PCPU, *PPCPU;
 STATIC_ASSERT_INFO(FIELD_OFFSET(PCPU,StackTop) == 0x0, "Used by _syscall.yasm:20 on syscalls to determine the user thread's kernel stack!");
+STATIC_ASSERT(FIELD_OFFSET(PCPU, EventListLock) % CACHE_LINE_SIZE == 0);
+STATIC_ASSERT(FIELD_OFFSET(PCPU, Tss) % CACHE_LINE_SIZE == 0);
+STATIC_ASSERT(FIELD_OFFSET(PCPU, ApicInitialized) + sizeof(BOOLEAN) <= FIELD_OFFSET(PCPU, EventListLock));
+STATIC_ASSERT(FIELD_OFFSET(PCPU, RfcOwner) + sizeof(RFC_OWNER) <= FIELD_OFFSET(PCPU, Tss));
+STATIC_ASSERT(FIELD_OFFSET(PCPU, Counters) % CACHE_LINE_SIZE == 0);
+#pragma warning(pop)
 
 // This function should only be called when interrupts are disabled, else the CPU on which
 // the thread is running may change between the moment GetCurrentPcpu() was called and the moment
@@ -67,6 +139,10 @@ STATIC_ASSERT_INFO(FIELD_OFFSET(PCPU,StackTop) == 0x0, "Used by _syscall.yasm:20
 #define GetCurrentPcpu()    ((PCPU*)__readmsr(IA32_GS_BASE_MSR))
 #define SetCurrentPcpu(pc)  (__writemsr(IA32_GS_BASE_MSR,(pc)))
 
+// Same as GetCurrentPcpu() but a single GS relative load instead of a MSR
+// read, it must not be used before the PCPU is installed.
+#define GetCurrentPcpuFast()    ((PCPU*)__readgsqword(FIELD_OFFSET(PCPU, Self)))
+
 void
 CpuMuPreinit(
     void
@@ -82,6 +158,29 @@ CpuMuSetMonitorFilterSize(
     IN          WORD        FilterSize
     );
 
+//******************************************************************************
+// Function:     CpuMuIsGigabytePageSupported
+// Description:  Checks if the CPU supports 1GB pages (CPUID.80000001H:EDX[26]).
+// Returns:      BOOLEAN
+// Parameter:    void
+//******************************************************************************
+BOOLEAN
+CpuMuIsGigabytePageSupported(
+    void
+    );
+
+//******************************************************************************
+// Function:     CpuMuIsInvpcidSupported
+// Description:  Checks if the CPU supports the INVPCID instruction
+//               (CPUID.(EAX=07H,ECX=0):EBX[10]).
+// Returns:      BOOLEAN
+// Parameter:    void
+//******************************************************************************
+BOOLEAN
+CpuMuIsInvpcidSupported(
+    void
+    );
+
 STATUS
 CpuMuAllocAndInitCpu(
     OUT_PTR     PPCPU*      PhysicalCpu,
@@ -5,4 +5,10 @@
 void
 DumpNetworkDevice(
     IN      PNETWORK_DEVICE_INFO        NetworkDevice
+    );
+
+void
+DumpNetworkDeviceStatistics(
+    IN      DEVICE_ID                   DeviceId,
+    IN      PNETWORK_DEVICE_STATS       Statistics
     );
\ No newline at end of file
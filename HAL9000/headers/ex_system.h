@@ -4,3 +4,16 @@ void
 ExSystemTimerTick(
     void
     );
+
+//******************************************************************************
+// Function:     ExRcuReportQuiescentState
+// Description:  Called with interrupts disabled from points where the current
+//               CPU can't be in a RCU read side critical section, i.e. on
+//               each timer interrupt.
+// Returns:      void
+// Parameter:    void
+//******************************************************************************
+void
+ExRcuReportQuiescentState(
+    void
+    );
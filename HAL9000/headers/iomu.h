@@ -50,6 +50,19 @@ IomuDriverInstalled(
     IN      PDRIVER_OBJECT  Driver
     );
 
+void
+IomuDeviceCreated(
+    INOUT   PDRIVER_OBJECT  Driver,
+    INOUT   PDEVICE_OBJECT  Device
+    );
+
+// only the devices of a driver which is not yet installed may be deleted,
+// they were never reachable => they may be freed right away
+void
+IomuDeviceDeleted(
+    INOUT   PDEVICE_OBJECT  Device
+    );
+
 PLIST_ENTRY
 IomuGetPciDeviceList(
     void
@@ -40,4 +40,9 @@ IpcProcessEvent(
     _Pre_valid_ _Post_ptr_invalid_
             PIPC_EVENT_CPU      CpuEvent,
     OUT     STATUS*             FunctionStatus
+    );
+
+PFUNC_IpcProcessEvent
+IpcGetEventFunction(
+    IN      PIPC_EVENT_CPU      CpuEvent
     );
\ No newline at end of file
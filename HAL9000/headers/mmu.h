@@ -11,13 +11,27 @@ typedef struct _PAGING_DATA
 {
     PHYSICAL_ADDRESS        BasePhysicalAddress;
 
-    // because we don't have any functions to unmap
-    // paging structures (and we probably won't need to)
-    // there is no use in using a bitmap
+    // the frames are handed out in order, the paging structures
+    // freed on unmap are kept in a list linked through their first
+    // entry and are reused before taking new frames
     DWORD                   NumberOfFrames;
     DWORD                   CurrentIndex;
+    PHYSICAL_ADDRESS        FreePagingStructures;
 
     BOOLEAN                 KernelSpace;
+
+    // Logical APIC IDs of the CPUs which currently have these paging tables
+    // loaded in CR3, see TlbActivateAddressSpace
+    volatile BYTE           ActiveCpus;
+
+    // Never reused, identifies the address space in the PCID slots of the
+    // CPUs even after the structure is freed
+    QWORD                   ContextId;
+
+    // Incremented each time translations of a user address space are
+    // invalidated, a CPU which cached the translations under an older
+    // generation must flush its PCID before using them again
+    volatile QWORD          TlbGeneration;
 } PAGING_DATA, *PPAGING_DATA;
 
 typedef struct _PAGING_LOCK_DATA
@@ -152,6 +166,38 @@ MmuMapMemoryInternal(
     IN_OPT  PPAGING_LOCK_DATA       PagingData
     );
 
+//******************************************************************************
+// Function:     MmuMapCpuLocalPage
+// Description:  Maps PhysicalAddress at VirtualAddress in the system address
+//               space, the previous translation is invalidated only on the
+//               current CPU. VirtualAddress must be a page accessed by the
+//               current CPU alone, with interrupts disabled.
+// Returns:      void
+// Parameter:    IN PHYSICAL_ADDRESS PhysicalAddress
+// Parameter:    IN PVOID VirtualAddress
+//******************************************************************************
+void
+MmuMapCpuLocalPage(
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      PVOID                   VirtualAddress
+    );
+
+//******************************************************************************
+// Function:     MmuPreparePagingStructures
+// Description:  Creates the paging structures of a range of the system
+//               address space without mapping it: its pages stay not present
+//               until they are mapped with MmuMapCpuLocalPage, which then
+//               needs no new frame.
+// Returns:      void
+// Parameter:    IN PVOID VirtualAddress
+// Parameter:    IN QWORD Size
+//******************************************************************************
+void
+MmuPreparePagingStructures(
+    IN      PVOID                   VirtualAddress,
+    IN      QWORD                   Size
+    );
+
 //******************************************************************************
 // Function:     MmuUnmapMemory
 // Description:  Unmaps a previously mapped memory region.
@@ -181,6 +227,21 @@ MmuReleaseMemory(
     IN          DWORD                   NoOfFrames
     );
 
+//******************************************************************************
+// Function:     MmuReserveZeroedFrames
+// Description:  Takes NoOfFrames physically contiguous frames from the pool of
+//               frames already zeroed by the zero worker thread.
+// Returns:      PHYSICAL_ADDRESS - NULL if the pool has no run large enough,
+//               the frames must then be reserved from the PMM and zeroed by
+//               the caller
+// Parameter:    IN DWORD NoOfFrames
+//******************************************************************************
+PTR_SUCCESS
+PHYSICAL_ADDRESS
+MmuReserveZeroedFrames(
+    IN          DWORD                   NoOfFrames
+    );
+
 //******************************************************************************
 // Function:     MmuGetPhysicalAddress
 // Description:  Returns the physical address mapping for VirtualAddress using
@@ -285,7 +346,9 @@ MmuSolvePageFault(
 // Function:     MmuLoadPe
 // Description:  Maps a PE eagerly to a VA using the paging structures specified
 //               as a parameter. Currently the file alignment and the section
-//               alignment need to be equal for this to be possible.
+//               alignment need to be equal for this to be possible. The frames
+//               of the image are shared, the writable pages are mapped
+//               copy-on-write.
 // Returns:      STATUS
 // Parameter:    IN PPE_NT_HEADER_INFO NtHeader - The parsed PE header
 // Parameter:    IN PPAGING_LOCK_DATA PagingData - The paging data of the process
@@ -398,7 +461,10 @@ MmuIsBufferValid(
 //******************************************************************************
 // Function:     MmuGetSystemVirtualAddressForUserBuffer
 // Description:  Maps the physical memory which backs UserAddress from the
-//               Process process into kernel space with PageRights rights
+//               Process process into kernel space with PageRights rights.
+//               Process must be the current process: the pages are brought
+//               in and, for write rights, given their own frames before
+//               they are mapped. They are never evicted afterwards.
 // Returns:      STATUS
 // Parameter:    IN PVOID UserAddress
 // Parameter:    IN QWORD Size
@@ -0,0 +1,140 @@
+#pragma once
+
+// Counters with a value for each CPU. A CPU only writes its own value so
+// updating a counter never moves cache lines between CPUs, the values are
+// summed when the counter is read.
+
+#define PERCPU_MAX_COUNTERS                 64
+
+#define PERCPU_COUNTER_CACHE_LINE_SIZE      CACHE_LINE_SIZE
+
+// Zero initialized handles refer to this counter, it absorbs the updates done
+// before the registration and is never reported
+#define PERCPU_COUNTER_UNREGISTERED         0
+
+typedef DWORD PERCPU_COUNTER;
+
+#pragma warning(push)
+
+// warning C4324: structure was padded due to alignment specifier
+#pragma warning(disable:4324)
+
+// Part of each PCPU, the PCPU is allocated cache line aligned so no other
+// data shares the lines of the values
+typedef struct __declspec(align(PERCPU_COUNTER_CACHE_LINE_SIZE)) _PERCPU_COUNTER_BLOCK
+{
+    QWORD                   Values[PERCPU_MAX_COUNTERS];
+} PERCPU_COUNTER_BLOCK, *PPERCPU_COUNTER_BLOCK;
+STATIC_ASSERT(sizeof(PERCPU_COUNTER_BLOCK) % PERCPU_COUNTER_CACHE_LINE_SIZE == 0);
+#pragma warning(pop)
+
+typedef
+void
+(__cdecl FUNC_PerCpuCounterVisit)(
+    IN      PERCPU_COUNTER          Counter,
+    IN_Z    const char*             Name,
+    IN_OPT  PVOID                   Context
+    );
+
+typedef FUNC_PerCpuCounterVisit*    PFUNC_PerCpuCounterVisit;
+
+struct _PCPU;
+
+//******************************************************************************
+// Function:     PerCpuCounterRegister
+// Description:  Allocates a counter starting from 0 on all the CPUs.
+// Returns:      STATUS - STATUS_LIMIT_REACHED if there are already
+//               PERCPU_MAX_COUNTERS counters, Counter is left
+//               PERCPU_COUNTER_UNREGISTERED so it can still be updated
+// Parameter:    IN_Z const char* Name - must remain valid, it is not copied
+// Parameter:    OUT PERCPU_COUNTER* Counter
+// NOTE:         Counters can't be unregistered, they are meant for subsystems
+//               which live as long as the system.
+//******************************************************************************
+STATUS
+PerCpuCounterRegister(
+    IN_Z    const char*             Name,
+    OUT     PERCPU_COUNTER*         Counter
+    );
+
+//******************************************************************************
+// Function:     PerCpuCounterEnable
+// Description:  Called by each CPU once its PCPU is installed in GS. Until
+//               the first call (done by the BSP) updates are discarded.
+// Returns:      void
+// Parameter:    void
+// NOTE:         The APs install their PCPU before running anything which
+//               updates a counter.
+//******************************************************************************
+void
+PerCpuCounterEnable(
+    void
+    );
+
+//******************************************************************************
+// Function:     PerCpuCounterAdd
+// Description:  Adds Value to the current CPU's value of the counter. It is a
+//               single GS relative instruction, it may be called with
+//               interrupts enabled and from interrupt handlers.
+// Returns:      void
+// Parameter:    IN PERCPU_COUNTER Counter
+// Parameter:    IN QWORD Value
+//******************************************************************************
+void
+PerCpuCounterAdd(
+    IN      PERCPU_COUNTER          Counter,
+    IN      QWORD                   Value
+    );
+
+#define PerCpuCounterIncrement(Counter)     PerCpuCounterAdd((Counter), 1)
+
+//******************************************************************************
+// Function:     PerCpuCounterRead
+// Description:  Sums the values of all the CPUs. The updates done while
+//               summing may or may not be included.
+// Returns:      QWORD
+// Parameter:    IN PERCPU_COUNTER Counter
+//******************************************************************************
+QWORD
+PerCpuCounterRead(
+    IN      PERCPU_COUNTER          Counter
+    );
+
+//******************************************************************************
+// Function:     PerCpuCounterReadForCpu
+// Description:  Returns the value of a single CPU.
+// Returns:      QWORD
+// Parameter:    IN PERCPU_COUNTER Counter
+// Parameter:    IN struct _PCPU* Cpu
+//******************************************************************************
+QWORD
+PerCpuCounterReadForCpu(
+    IN      PERCPU_COUNTER          Counter,
+    IN      struct _PCPU*           Cpu
+    );
+
+//******************************************************************************
+// Function:     PerCpuCounterLookup
+// Description:  Searches for a counter by name.
+// Returns:      PERCPU_COUNTER - PERCPU_COUNTER_UNREGISTERED if there is no
+//               counter named Name
+// Parameter:    IN_Z const char* Name
+//******************************************************************************
+PERCPU_COUNTER
+PerCpuCounterLookup(
+    IN_Z    const char*             Name
+    );
+
+//******************************************************************************
+// Function:     PerCpuCounterForEach
+// Description:  Calls Function for each registered counter, in the order of
+//               registration.
+// Returns:      void
+// Parameter:    IN PFUNC_PerCpuCounterVisit Function
+// Parameter:    IN_OPT PVOID Context
+//******************************************************************************
+void
+PerCpuCounterForEach(
+    IN      PFUNC_PerCpuCounterVisit    Function,
+    IN_OPT  PVOID                       Context
+    );
\ No newline at end of file
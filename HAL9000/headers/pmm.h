@@ -59,6 +59,19 @@ PmmGetTotalSystemMemory(
     void
     );
 
+//******************************************************************************
+// Function:     PmmGetNumberOfFreeFrames
+// Description:  The value is not synchronized with the allocations, it may
+//               already be stale when it is returned.
+// Returns:      QWORD - Returns the number of frames which can currently be
+//               reserved.
+// Parameter:    void
+//******************************************************************************
+QWORD
+PmmGetNumberOfFreeFrames(
+    void
+    );
+
 // Note: This address may reserved by the firmware or some other device.
 // If you want to retrieve the highest available physical address for software
 // usage use PmmGetHighestPhysicalMemoryAddressAvailable
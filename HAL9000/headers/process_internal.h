@@ -53,6 +53,10 @@ typedef struct _PROCESS
     // Pointer to the process' NT header information
     struct _PE_NT_HEADER_INFO*      HeaderInfo;
 
+    // The cached image the process was created from, its frames are
+    // mapped in the process
+    struct _UM_APPLICATION_IMAGE*   Image;
+
     // VaSpace used only for UM virtual memory allocations
     struct _VMM_RESERVATION_SPACE*  VaSpace;
 } PROCESS, *PPROCESS;
@@ -151,9 +155,8 @@ ProcessExecuteForEachProcessEntry(
 // Returns:      void
 // Parameter:    IN PPROCESS Process
 // Parameter:    IN BOOLEAN InvalidateAddressSpace - if TRUE all the cached
-//               translations for the Process PCID will be flushed. This option
-//               is useful when a process terminates and its PCID will be
-//               later used by another process.
+//               translations of the Process are flushed, else they are kept
+//               if they are still up to date, see TlbActivateAddressSpace.
 //******************************************************************************
 void
 ProcessActivatePagingTables(
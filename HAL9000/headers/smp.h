@@ -122,6 +122,25 @@ SmpSendGenericIpiEx(
             SMP_DESTINATION         Destination
     );
 
+//******************************************************************************
+// Function:     SmpProcessPendingIpcEvents
+// Description:  Processes the IPC events queued for the current CPU without
+//               waiting for the IPC interrupt.
+// Returns:      STATUS - the status of the first event which failed
+// Parameter:    IN_OPT PFUNC_IpcProcessEvent Function - if not NULL only the
+//               events which execute Function are processed, the others are
+//               left for the interrupt routine
+// NOTE:         Must be called with interrupts disabled. Meant for code which
+//               waits with interrupts disabled for other CPUs which may in
+//               turn wait for events sent to this CPU. Function must be safe
+//               to run from the waiting context, e.g. it must not take locks
+//               or report RCU quiescent states.
+//******************************************************************************
+STATUS
+SmpProcessPendingIpcEvents(
+    IN_OPT  PFUNC_IpcProcessEvent   Function
+    );
+
 SAL_SUCCESS
 STATUS
 SmpCpuInit(
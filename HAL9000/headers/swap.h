@@ -0,0 +1,167 @@
+#pragma once
+
+#include "mmu.h"
+
+// the swap slot of a page is kept in the PhysicalAddress field of its page
+// table entry
+#define SWAP_INVALID_SLOT                       MAX_DWORD
+
+typedef struct _SWAP_STATISTICS
+{
+    BOOLEAN                 Enabled;
+
+    DWORD                   NumberOfSlots;
+    DWORD                   SlotsInUse;
+
+    // frames which may currently be evicted
+    DWORD                   EvictableFrames;
+
+    QWORD                   PagesWritten;
+    QWORD                   PagesRead;
+
+    // pages put back in memory because they could not be written
+    QWORD                   WriteErrors;
+
+    // pages spared because they were accessed since the pager last saw them
+    QWORD                   SecondChances;
+
+    // pages found to be all zero and mapped back to the shared zero frame
+    // instead of being written
+    QWORD                   ZeroPagesMerged;
+
+    QWORD                   PagerWakeups;
+} SWAP_STATISTICS, *PSWAP_STATISTICS;
+
+_No_competing_thread_
+void
+SwapPreinit(
+    void
+    );
+
+//******************************************************************************
+// Function:     SwapInit
+// Description:  Opens the first volume on which SwapFS is mounted and starts
+//               the pager. If there is no such volume paging is disabled and
+//               the function still succeeds.
+// Returns:      STATUS
+// Parameter:    void
+// NOTE:         Must be called after the file systems are mounted.
+//******************************************************************************
+_No_competing_thread_
+STATUS
+SwapInit(
+    void
+    );
+
+//******************************************************************************
+// Function:     SwapRegisterFrame
+// Description:  Records that Frame is mapped at VirtualAddress in the user
+//               address space PagingData and may be evicted. The paging lock
+//               must be held and the page must still be mapped to Frame.
+// Returns:      void
+// Parameter:    IN PHYSICAL_ADDRESS Frame
+// Parameter:    IN PPAGING_LOCK_DATA PagingData
+// Parameter:    IN PVOID VirtualAddress
+//******************************************************************************
+void
+SwapRegisterFrame(
+    IN      PHYSICAL_ADDRESS        Frame,
+    IN      PPAGING_LOCK_DATA       PagingData,
+    IN      PVOID                   VirtualAddress
+    );
+
+//******************************************************************************
+// Function:     SwapUnregisterFrame
+// Description:  Forgets Frame, it will never be evicted. Must be called when
+//               a registered frame is unmapped or handed to someone else.
+// Returns:      void
+// Parameter:    IN PHYSICAL_ADDRESS Frame
+//******************************************************************************
+void
+SwapUnregisterFrame(
+    IN      PHYSICAL_ADDRESS        Frame
+    );
+
+//******************************************************************************
+// Function:     SwapUnregisterAddressSpace
+// Description:  Waits for the pager to stop using PagingData. Its frames must
+//               have already been unregistered, i.e. its user space unmapped.
+// Returns:      void
+// Parameter:    IN PPAGING_LOCK_DATA PagingData
+//******************************************************************************
+void
+SwapUnregisterAddressSpace(
+    IN      PPAGING_LOCK_DATA       PagingData
+    );
+
+//******************************************************************************
+// Function:     SwapReadPage
+// Description:  Reads the page stored in Slot into Frame. Can be called with
+//               interrupts disabled.
+// Returns:      STATUS - STATUS_DEVICE_BUSY if the pager has not yet finished
+//               writing the page, the read must be retried later
+// Parameter:    IN DWORD Slot
+// Parameter:    IN PHYSICAL_ADDRESS Frame
+//******************************************************************************
+SAL_SUCCESS
+STATUS
+SwapReadPage(
+    IN      DWORD                   Slot,
+    IN      PHYSICAL_ADDRESS        Frame
+    );
+
+//******************************************************************************
+// Function:     SwapReleaseSlot
+// Description:  Frees the slot of a page which is no longer swapped out.
+// Returns:      void
+// Parameter:    IN DWORD Slot
+//******************************************************************************
+void
+SwapReleaseSlot(
+    IN      DWORD                   Slot
+    );
+
+//******************************************************************************
+// Function:     SwapNotifyFramesReserved
+// Description:  Wakes the pager if the number of free frames dropped under
+//               the low watermark.
+// Returns:      void
+// Parameter:    void
+//******************************************************************************
+void
+SwapNotifyFramesReserved(
+    void
+    );
+
+//******************************************************************************
+// Function:     SwapRequestFrames
+// Description:  Called when no frame could be reserved for a user page, wakes
+//               the pager.
+// Returns:      BOOLEAN - TRUE if the pager may free frames and the access
+//               should be retried, FALSE if paging is disabled or there is
+//               nothing left to evict
+// Parameter:    void
+//******************************************************************************
+BOOLEAN
+SwapRequestFrames(
+    void
+    );
+
+//******************************************************************************
+// Function:     SwapSetZeroPageScanning
+// Description:  Enables or disables the background scan which periodically
+//               looks at the pages not accessed recently and maps the ones
+//               which became all zero back to the shared zero frame. Has no
+//               effect if paging is disabled.
+// Returns:      BOOLEAN - the previous setting
+// Parameter:    IN BOOLEAN Enable
+//******************************************************************************
+BOOLEAN
+SwapSetZeroPageScanning(
+    IN      BOOLEAN                 Enable
+    );
+
+void
+SwapGetStatistics(
+    OUT     PSWAP_STATISTICS        Statistics
+    );
\ No newline at end of file
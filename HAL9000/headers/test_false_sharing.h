@@ -0,0 +1,17 @@
+#pragma once
+
+#include "test_thread.h"
+
+// Each thread increments its own counter, the counters are either next to each
+// other (packed) or each in its own cache line (padded). Comparing the
+// durations of the two tests shows the cost of false sharing.
+#define FALSE_SHARING_TEST_PACKED               FALSE
+#define FALSE_SHARING_TEST_PADDED               TRUE
+
+#define FALSE_SHARING_TEST_NO_OF_INCREMENTS     0x100000
+
+FUNC_ThreadStart                        TestThreadFalseSharing;
+
+FUNC_ThreadPrepareTest                  TestThreadFalseSharingPrepare;
+FUNC_ThreadPostCreate                   TestThreadFalseSharingPostCreate;
+FUNC_ThreadPostFinish                   TestThreadFalseSharingPostFinish;
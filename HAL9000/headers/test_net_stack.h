@@ -9,4 +9,18 @@ TestNetwork(
     _When_(Transmit, _Reserved_)
     _When_(!Transmit, IN)
         IN      BOOLEAN         ResendRequets
+    );
+
+//******************************************************************************
+// Function:     TestNetworkPerformance
+// Description:  Measures the round trip time and the throughput of the
+//               network stack through the loopback device, for several frame
+//               sizes and injected latencies. Does nothing if the loopback
+//               device is not present.
+// Returns:      void
+// Parameter:    void
+//******************************************************************************
+void
+TestNetworkPerformance(
+    void
     );
\ No newline at end of file
@@ -59,4 +59,11 @@ TestThreadFunctionality(
 void
 TestAllThreadFunctionalities(
     IN      DWORD                       NumberOfThreads
+    );
+
+// Measures the time needed to create a thread, wait for it and close its
+// handle, and separately only the wait and close part
+void
+TestThreadPerformance(
+    void
     );
\ No newline at end of file
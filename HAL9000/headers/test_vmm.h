@@ -4,5 +4,45 @@
 
 void
 TestVmmAllocAndFreeFunctions(
+    void
+    );
+
+//******************************************************************************
+// Function:     TestVmmTlbPerformance
+// Description:  Measures the time needed to touch each page of a large
+//               physically contiguous region in a TLB unfriendly order when
+//               it is mapped with 4KB pages and when it is mapped with large
+//               pages.
+// Returns:      void
+// Parameter:    void
+//******************************************************************************
+void
+TestVmmTlbPerformance(
+    void
+    );
+
+//******************************************************************************
+// Function:     TestVmmReservationLookupPerformance
+// Description:  Measures the time needed to solve page faults in the oldest
+//               and in the newest of a large number of reservations.
+// Returns:      void
+// Parameter:    void
+//******************************************************************************
+void
+TestVmmReservationLookupPerformance(
+    void
+    );
+
+//******************************************************************************
+// Function:     TestVmmAddressSpaceSwitchPerformance
+// Description:  Measures the cost of switching back and forth between the
+//               address spaces of two processes and touching a few pages in
+//               each, when each switch flushes the TLB and when the
+//               translations are kept under per CPU PCIDs.
+// Returns:      void
+// Parameter:    void
+//******************************************************************************
+void
+TestVmmAddressSpaceSwitchPerformance(
     void
     );
\ No newline at end of file
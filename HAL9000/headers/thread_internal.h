@@ -4,6 +4,7 @@
 #include "ref_cnt.h"
 #include "ex_event.h"
 #include "thread.h"
+#include "hw_fpu.h"
 
 typedef enum _THREAD_STATE
 {
@@ -31,6 +32,11 @@ typedef DWORD           THREAD_FLAGS;
 #define THREAD_FLAG_FORCE_TERMINATE_PENDING         0x1
 #define THREAD_FLAG_FORCE_TERMINATED                0x2
 
+#pragma warning(push)
+
+// warning C4324: structure was padded due to alignment specifier
+#pragma warning(disable:4324)
+
 typedef struct _THREAD
 {
     REF_COUNT               RefCnt;
@@ -88,7 +94,15 @@ typedef struct _THREAD
     PVOID                   UserStack;
 
     struct _PROCESS*        Process;
+
+    // The x87, MMX and SSE registers of the thread while it is not running,
+    // saved and restored by ThreadSwitch. The ABI only lets the functions
+    // calling ThreadSwitch rely on XMM6-15 and the control words, but the
+    // whole state is needed for the threads preempted in user-mode.
+    __declspec(align(FXSAVE_AREA_REQUIRED_ALIGNMENT))
+    XSAVE_LEGACY_REGION     FpuState;
 } THREAD, *PTHREAD;
+#pragma warning(pop)
 
 //******************************************************************************
 // Function:     ThreadSystemPreinit
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "mmu.h"
+#include "pte.h"
+
+// If a batch covers more pages than this it is cheaper for each CPU to flush
+// its whole TLB than to invalidate the pages one by one
+#define TLB_SHOOTDOWN_FULL_FLUSH_THRESHOLD      32
+
+#define TLB_SHOOTDOWN_MAX_RANGES                8
+#define TLB_SHOOTDOWN_MAX_FRAME_RUNS            16
+
+typedef struct _TLB_RANGE
+{
+    PVOID                   BaseAddress;
+    QWORD                   NumberOfPages;
+} TLB_RANGE, *PTLB_RANGE;
+
+typedef struct _TLB_FRAME_RUN
+{
+    PHYSICAL_ADDRESS        BaseAddress;
+    DWORD                   NumberOfFrames;
+} TLB_FRAME_RUN, *PTLB_FRAME_RUN;
+
+// Collects the translations changed while the paging lock is held so the
+// other CPUs can be notified once, after the lock is released. The frames
+// unmapped with ReleaseMemory are kept in the batch until no CPU may still
+// access them through a stale translation.
+typedef struct _TLB_SHOOTDOWN_BATCH
+{
+    PPAGING_DATA            PagingData;
+
+    // if TRUE the ranges are no longer relevant, each CPU flushes all the
+    // translations of the address space
+    BOOLEAN                 FlushAll;
+
+    QWORD                   NumberOfPages;
+
+    DWORD                   NumberOfRanges;
+    TLB_RANGE               Ranges[TLB_SHOOTDOWN_MAX_RANGES];
+
+    DWORD                   NumberOfFrameRuns;
+    TLB_FRAME_RUN           FrameRuns[TLB_SHOOTDOWN_MAX_FRAME_RUNS];
+
+    // TlbGeneration of the address space after the flush, set by
+    // TlbBatchFlush for user address spaces
+    QWORD                   Generation;
+
+    // Paging structures emptied by the VMM, linked through their first
+    // entry. TlbBatchFlush leaves them in the batch, they are given back
+    // with VmmReclaimPagingStructures once no CPU may still walk them.
+    PHYSICAL_ADDRESS        FreedPagingStructures;
+} TLB_SHOOTDOWN_BATCH, *PTLB_SHOOTDOWN_BATCH;
+
+typedef struct _TLB_STATISTICS
+{
+    // number of batches which required other CPUs to be interrupted
+    QWORD                   Shootdowns;
+
+    // number of CPUs interrupted
+    QWORD                   IpisSent;
+
+    // number of batches for which a full flush was done instead of
+    // invalidating each page
+    QWORD                   FullFlushes;
+
+    QWORD                   PagesInvalidated;
+
+    // CR3 loads which switched to another address space
+    QWORD                   AddressSpaceSwitches;
+
+    // switches which kept the translations cached under the PCID of the
+    // new address space
+    QWORD                   TaggedSwitches;
+
+    // switches which took the PCID of another address space
+    QWORD                   PcidsRecycled;
+} TLB_STATISTICS, *PTLB_STATISTICS;
+
+//******************************************************************************
+// Function:     TlbPreinit
+// Description:  Registers the shootdown counters.
+// Returns:      void
+// Parameter:    void
+//******************************************************************************
+_No_competing_thread_
+void
+TlbPreinit(
+    void
+    );
+
+//******************************************************************************
+// Function:     TlbBatchInit
+// Description:  Prepares an empty batch for changes to PagingData.
+// Returns:      void
+// Parameter:    OUT PTLB_SHOOTDOWN_BATCH Batch
+// Parameter:    IN PPAGING_DATA PagingData - address space which will be
+//               modified
+//******************************************************************************
+void
+TlbBatchInit(
+    OUT     PTLB_SHOOTDOWN_BATCH    Batch,
+    IN      PPAGING_DATA            PagingData
+    );
+
+//******************************************************************************
+// Function:     TlbBatchAddRange
+// Description:  Records that the translations for [VirtualAddress,
+//               VirtualAddress + Size) were removed or changed. Ranges
+//               adjacent to the last one recorded are merged, if there is no
+//               room left or the threshold is exceeded the batch becomes a
+//               full flush.
+// Returns:      void
+// Parameter:    INOUT PTLB_SHOOTDOWN_BATCH Batch
+// Parameter:    IN PVOID VirtualAddress - page aligned
+// Parameter:    IN QWORD Size - page aligned
+//******************************************************************************
+void
+TlbBatchAddRange(
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch,
+    IN      PVOID                   VirtualAddress,
+    IN      QWORD                   Size
+    );
+
+//******************************************************************************
+// Function:     TlbBatchAddFramesToRelease
+// Description:  Defers the release of physical frames until the batch is
+//               flushed. The caller must check TlbBatchIsFull before.
+// Returns:      void
+// Parameter:    INOUT PTLB_SHOOTDOWN_BATCH Batch
+// Parameter:    IN PHYSICAL_ADDRESS PhysicalAddress
+// Parameter:    IN DWORD NumberOfFrames
+//******************************************************************************
+void
+TlbBatchAddFramesToRelease(
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      DWORD                   NumberOfFrames
+    );
+
+//******************************************************************************
+// Function:     TlbBatchIsFull
+// Description:  Returns TRUE if no more frames can be deferred in the batch,
+//               it must be flushed before unmapping memory which is to be
+//               released.
+// Returns:      BOOLEAN
+// Parameter:    IN PTLB_SHOOTDOWN_BATCH Batch
+//******************************************************************************
+BOOLEAN
+TlbBatchIsFull(
+    IN      PTLB_SHOOTDOWN_BATCH    Batch
+    );
+
+//******************************************************************************
+// Function:     TlbBatchFlush
+// Description:  Invalidates the translations recorded in the batch on all
+//               the CPUs which may have them cached, waits for them to finish
+//               and then releases the deferred frames. The batch is left
+//               empty and can be reused, except for FreedPagingStructures.
+// Returns:      void
+// Parameter:    INOUT PTLB_SHOOTDOWN_BATCH Batch
+// NOTE:         Must NOT be called with the paging lock held, sending the
+//               IPIs requires heap allocations which may page fault.
+//******************************************************************************
+void
+TlbBatchFlush(
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch
+    );
+
+//******************************************************************************
+// Function:     TlbInitAddressSpace
+// Description:  Gives newly created paging tables their context ID.
+// Returns:      void
+// Parameter:    OUT PPAGING_DATA PagingData
+//******************************************************************************
+void
+TlbInitAddressSpace(
+    OUT     PPAGING_DATA            PagingData
+    );
+
+//******************************************************************************
+// Function:     TlbActivateAddressSpace
+// Description:  Loads PagingData in CR3 on the current CPU. The address space
+//               keeps one of the PCIDs of the CPU for as long as possible, if
+//               the translations cached under it are still up to date they
+//               are not flushed. Must be called with interrupts disabled.
+// Returns:      void
+// Parameter:    INOUT PPAGING_DATA PagingData
+// Parameter:    IN BOOLEAN Invalidate - if TRUE the cached translations are
+//               flushed, required while PCIDs are not enabled
+//******************************************************************************
+void
+TlbActivateAddressSpace(
+    INOUT   PPAGING_DATA            PagingData,
+    IN      BOOLEAN                 Invalidate
+    );
+
+//******************************************************************************
+// Function:     TlbSetAddressSpaceTagging
+// Description:  If disabled each switch to another address space flushes
+//               its translations, as if the CPU had no PCIDs.
+// Returns:      BOOLEAN - the previous setting
+// Parameter:    IN BOOLEAN Enable
+//******************************************************************************
+BOOLEAN
+TlbSetAddressSpaceTagging(
+    IN      BOOLEAN                 Enable
+    );
+
+void
+TlbGetStatistics(
+    OUT     PTLB_STATISTICS         Statistics
+    );
\ No newline at end of file
@@ -2,11 +2,46 @@
 
 typedef struct _PROCESS* PPROCESS;
 typedef struct _PE_NT_HEADER_INFO* PPE_NT_HEADER_INFO;
+typedef struct _UM_APPLICATION_IMAGE* PUM_APPLICATION_IMAGE;
 
+_No_competing_thread_
+void
+UmApplicationPreinit(
+    void
+    );
+
+//******************************************************************************
+// Function:     UmApplicationRetrieveHeader
+// Description:  Retrieves the NT header of the executable found at Path. The
+//               executable is read from disk only the first time, afterwards
+//               the cached image is used while the size and last write time
+//               of the file are unchanged, its frames are shared by all the
+//               processes running it. The image is referenced until
+//               UmApplicationReleaseImage is called.
+// Returns:      STATUS
+// Parameter:    IN_Z char* Path
+// Parameter:    OUT PPE_NT_HEADER_INFO NtHeaderInfo
+// Parameter:    OUT_PTR PUM_APPLICATION_IMAGE* Image
+//******************************************************************************
 STATUS
 UmApplicationRetrieveHeader(
     IN_Z        char*                   Path,
-    OUT         PPE_NT_HEADER_INFO      NtHeaderInfo
+    OUT         PPE_NT_HEADER_INFO      NtHeaderInfo,
+    OUT_PTR     PUM_APPLICATION_IMAGE*  Image
+    );
+
+//******************************************************************************
+// Function:     UmApplicationReleaseImage
+// Description:  Drops the reference taken by UmApplicationRetrieveHeader, it
+//               must be called only after the image is no longer mapped in
+//               the process. An image dropped from the cache because its
+//               file changed is freed with its last reference.
+// Returns:      void
+// Parameter:    IN PUM_APPLICATION_IMAGE Image
+//******************************************************************************
+void
+UmApplicationReleaseImage(
+    IN          PUM_APPLICATION_IMAGE   Image
     );
 
 STATUS
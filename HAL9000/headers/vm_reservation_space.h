@@ -27,6 +27,21 @@ typedef struct _VMM_RESERVATION_SPACE
 
     _Guarded_by_(ReservationLock)
     struct _VMM_RESERVATION*    ReservationList;
+
+    DWORD               MaxNumberOfReservations;
+
+    // The first NumberOfReservations entries are the indexes in the
+    // ReservationList of the reservations in use, sorted by their StartVa.
+    // They are followed by the indexes of the free entries which were used
+    // at least once, up to NumberOfReservationSlots.
+    _Guarded_by_(ReservationLock)
+    DWORD*              SortedReservations;
+
+    _Guarded_by_(ReservationLock)
+    DWORD               NumberOfReservations;
+
+    _Guarded_by_(ReservationLock)
+    DWORD               NumberOfReservationSlots;
 } VMM_RESERVATION_SPACE, *PVMM_RESERVATION_SPACE;
 
 //******************************************************************************
@@ -85,6 +100,12 @@ VmReservationSpaceDetermineNextFreeVirtualAddress(
 // Parameter:    OUT BOOLEAN * Uncacheable
 // Parameter:    OUT_PTR_MAYBE_NULL PFILE_OBJECT * BackingFile
 // Parameter:    OUT QWORD * FileOffset
+// Parameter:    IN DWORD WindowPages - power of 2 number of pages, the
+//               naturally aligned window of this size containing the
+//               FaultingAddress is searched for committed pages
+// Parameter:    OUT PVOID * RangeStart - the first page of the run of
+//               committed pages from the window containing FaultingAddress
+// Parameter:    OUT DWORD * RangePages - the number of pages in the run
 //******************************************************************************
 BOOLEAN
 VmReservationCanAddressBeAccessed(
@@ -94,7 +115,10 @@ VmReservationCanAddressBeAccessed(
     OUT                     PAGE_RIGHTS*            MemoryRights,
     OUT                     BOOLEAN*                Uncacheable,
     OUT_PTR_MAYBE_NULL      PFILE_OBJECT*           BackingFile,
-    OUT                     QWORD*                  FileOffset
+    OUT                     QWORD*                  FileOffset,
+    IN                      DWORD                   WindowPages,
+    OUT                     PVOID*                  RangeStart,
+    OUT                     DWORD*                  RangePages
     );
 
 STATUS
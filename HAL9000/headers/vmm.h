@@ -2,6 +2,7 @@
 
 #include "mmu.h"
 #include "pte.h"
+#include "tlb.h"
 
 typedef struct _FILE_OBJECT* PFILE_OBJECT;
 
@@ -9,6 +10,9 @@ typedef struct _VMM_RESERVATION_SPACE* PVMM_RESERVATION_SPACE;
 
 typedef struct _MDL *PMDL;
 
+// per-CPU counter of the page faults solved, see percpu_counter.h
+#define VMM_PAGE_FAULTS_COUNTER_NAME            "vmm.page_faults"
+
 _No_competing_thread_
 void
 VmmPreinit(
@@ -43,10 +47,25 @@ VmmMapMemoryEx(
     IN      BOOLEAN                 Uncacheable
     );
 
+// Kernel only right which may be combined with PAGE_RIGHTS_WRITE when mapping
+// 4KB pages with VmmMapMemoryInternal: the frame is shared and mapped
+// read-only, the first write gives the address space its own copy of it, see
+// VmmSolvePageFault.
+#define VMM_PAGE_RIGHTS_COPY_ON_WRITE               0x80
+
+// Kernel only right which may be used when mapping 4KB pages with
+// VmmMapMemoryInternal: the frame is owned by someone else, e.g. the image
+// cache, VmmUnmapMemoryEx never releases it.
+#define VMM_PAGE_RIGHTS_SHARED_FRAME                0x100
+
 //******************************************************************************
 // Function:     VmmMapMemoryInternal
 // Description:  Same as VmmMapMemoryEx except it maps the address to an
-//               explicit virtual address.
+//               explicit virtual address. 2MB and 1GB pages are used for the
+//               parts of the range where the VA and PA are aligned, large
+//               pages already mapped are split if only a part of them is
+//               remapped. If Batch is given the translations replaced are
+//               recorded in it, else only the current CPU invalidates them.
 /// NOTE:        This should be used used only in the vmm and mmu files
 //******************************************************************************
 void
@@ -57,24 +76,150 @@ VmmMapMemoryInternal(
     IN      PVOID                   BaseAddress,
     IN      PAGE_RIGHTS             PageRights,
     IN      BOOLEAN                 Invalidate,
-    IN      BOOLEAN                 Uncacheable
+    IN      BOOLEAN                 Uncacheable,
+    INOUT_OPT
+            PTLB_SHOOTDOWN_BATCH    Batch
+    );
+
+//******************************************************************************
+// Function:     VmmPreparePagingStructures
+// Description:  Creates the paging structures needed to map the range, the
+//               PT entries are left as they are. The range must not be
+//               covered by a large page.
+// Returns:      void
+// Parameter:    IN PPAGING_DATA PagingData
+// Parameter:    IN PVOID BaseAddress
+// Parameter:    IN QWORD Size - PAGE_SIZE aligned number of bytes
+/// NOTE:        This should be used used only in the vmm and mmu files
+//******************************************************************************
+void
+VmmPreparePagingStructures(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   BaseAddress,
+    IN      QWORD                   Size
     );
 
 //******************************************************************************
 // Function:     VmmUnmapMemoryEx
 // Description:  Unmaps a previously mapped VA with VmmMapMemoryEx or
-//               VmmMapMemoryInternal
-// Returns:      void
-// Parameter:    IN PML4 Cr3 - paging tables
+//               VmmMapMemoryInternal. Large pages only partially covered by
+//               the range are split first, which may consume paging
+//               structures from PagingData. The translations removed and the
+//               frames to release are recorded in Batch, the caller must call
+//               TlbBatchFlush after it releases the paging lock. The page
+//               tables and page directories of UM address spaces left empty
+//               are freed, see VmmReclaimPagingStructures. The swap slots of
+//               the pages swapped out are released.
+// Returns:      QWORD - number of bytes processed, less than Size if the
+//               batch can't hold any more frames to release
+// Parameter:    IN PPAGING_DATA PagingData - paging tables
 // Parameter:    IN PVOID VirtualAddress
 // Parameter:    IN DWORD Size - PAGE_SIZE aligned number of bytes to unmap
+// Parameter:    IN BOOLEAN ReleaseMemory
+// Parameter:    INOUT PTLB_SHOOTDOWN_BATCH Batch
 //******************************************************************************
-void
+QWORD
 VmmUnmapMemoryEx(
-    IN      PML4                    Cr3,
+    IN      PPAGING_DATA            PagingData,
     IN      PVOID                   VirtualAddress,
     IN      QWORD                   Size,
-    IN      BOOLEAN                 ReleaseMemory
+    IN      BOOLEAN                 ReleaseMemory,
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch
+    );
+
+//******************************************************************************
+// Function:     VmmReclaimPagingStructures
+// Description:  Makes the paging structures emptied by VmmUnmapMemoryEx
+//               available for new mappings. Must be called with the paging
+//               lock held, after the batch was flushed.
+// Returns:      void
+// Parameter:    IN PPAGING_DATA PagingData
+// Parameter:    INOUT PTLB_SHOOTDOWN_BATCH Batch
+//******************************************************************************
+void
+VmmReclaimPagingStructures(
+    IN      PPAGING_DATA            PagingData,
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch
+    );
+
+typedef enum _VMM_EVICT_RESULT
+{
+    // the page is no longer mapped to the frame
+    VmmEvictStale,
+
+    // the page was accessed since the last check, its accessed bit was
+    // cleared
+    VmmEvictReferenced,
+
+    // the page now refers to the swap slot, the frame may be written to the
+    // swap space after the batch is flushed
+    VmmEvictDone
+} VMM_EVICT_RESULT;
+
+//******************************************************************************
+// Function:     VmmEvictPage
+// Description:  Replaces the mapping of a page of a user address space by a
+//               reference to its swap slot, unless it was accessed since the
+//               last call. The paging lock must be held exclusively.
+// Returns:      VMM_EVICT_RESULT
+// Parameter:    INOUT PPAGING_DATA PagingData
+// Parameter:    IN PVOID VirtualAddress
+// Parameter:    IN PHYSICAL_ADDRESS PhysicalAddress - frame expected to be
+//               mapped at VirtualAddress
+// Parameter:    IN DWORD Slot - swap slot which will receive the page
+// Parameter:    INOUT PTLB_SHOOTDOWN_BATCH Batch
+// Parameter:    OUT PT_ENTRY* OriginalEntry - the entry before the eviction,
+//               valid only for VmmEvictDone
+//******************************************************************************
+VMM_EVICT_RESULT
+VmmEvictPage(
+    INOUT   PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      DWORD                   Slot,
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch,
+    OUT     PT_ENTRY*               OriginalEntry
+    );
+
+//******************************************************************************
+// Function:     VmmRestoreEvictedPage
+// Description:  Undoes VmmEvictPage if the page still refers to Slot, used
+//               when the page was not written to the swap space. The paging
+//               lock must be held exclusively.
+// Returns:      BOOLEAN - FALSE if the page was unmapped in the meantime
+// Parameter:    INOUT PPAGING_DATA PagingData
+// Parameter:    IN PVOID VirtualAddress
+// Parameter:    IN DWORD Slot
+// Parameter:    IN PT_ENTRY OriginalEntry - as returned by VmmEvictPage
+// Parameter:    IN BOOLEAN MapZeroFrame - the contents of the page were found
+//               to be zero, it is mapped to the shared zero frame instead of
+//               its own frame, which the caller releases
+//******************************************************************************
+BOOLEAN
+VmmRestoreEvictedPage(
+    INOUT   PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress,
+    IN      DWORD                   Slot,
+    IN      PT_ENTRY                OriginalEntry,
+    IN      BOOLEAN                 MapZeroFrame
+    );
+
+//******************************************************************************
+// Function:     VmmPinPage
+// Description:  Makes the pager forget the frame of a page of a user address
+//               space so it will never be evicted. The paging lock must be
+//               held exclusively.
+// Returns:      BOOLEAN - FALSE if the page is not present or, for Writable,
+//               if it is still shared, the caller must access it and retry
+// Parameter:    INOUT PPAGING_DATA PagingData
+// Parameter:    IN PVOID VirtualAddress
+// Parameter:    IN BOOLEAN Writable - the page must have its own frame
+//******************************************************************************
+BOOLEAN
+VmmPinPage(
+    INOUT   PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress,
+    IN      BOOLEAN                 Writable
     );
 
 //******************************************************************************
@@ -150,6 +295,50 @@ VmmInitReservationSystem(
     void
     );
 
+//******************************************************************************
+// Function:     VmmSetLargePageUsage
+// Description:  Controls if new mappings may use 2MB and 1GB pages, existing
+//               mappings are not affected. Large pages are used by default.
+// Returns:      BOOLEAN - the previous setting
+// Parameter:    IN BOOLEAN Enable
+//******************************************************************************
+BOOLEAN
+VmmSetLargePageUsage(
+    IN      BOOLEAN                 Enable
+    );
+
+//******************************************************************************
+// Function:     VmmInitZeroFrame
+// Description:  Reserves the frame filled with zeroes which is mapped
+//               copy-on-write for the reads of anonymous user memory not
+//               yet written.
+// Returns:      STATUS
+// Parameter:    void
+// NOTE:         Must be called after the system memory can be mapped.
+//******************************************************************************
+_No_competing_thread_
+STATUS
+VmmInitZeroFrame(
+    void
+    );
+
+// a single page table
+#define VMM_MAX_FAULT_AROUND_PAGES                  512
+
+//******************************************************************************
+// Function:     VmmSetFaultAroundPages
+// Description:  Sets the size of the window from which the committed and not
+//               yet mapped pages are mapped together with the faulting page.
+//               A value of 1 maps only the faulting page.
+// Returns:      DWORD - the previous setting
+// Parameter:    IN DWORD NumberOfPages - a power of 2, at most
+//               VMM_MAX_FAULT_AROUND_PAGES
+//******************************************************************************
+DWORD
+VmmSetFaultAroundPages(
+    IN      DWORD                   NumberOfPages
+    );
+
 #define VmmAllocRegion(Addr,Size,Type,Rights)       VmmAllocRegionEx((Addr),(Size),(Type),(Rights),FALSE, NULL, NULL, NULL, NULL)
 
 //******************************************************************************
@@ -221,7 +410,11 @@ VmmFreeRegionEx(
 
 //******************************************************************************
 // Function:     VmmSolvePageFault
-// Description:
+// Description:  Writes to copy-on-write pages give the address space its own
+//               copy of the page, swapped out pages are read back, else the
+//               committed page is mapped together with its committed
+//               neighbours. When no frame is available for a user page the
+//               pager is woken and the access is retried.
 // Returns:      BOOLEAN - TRUE => The current process has RightsRequested for
 //               the FaultingAddress and the address was successfully mapped.
 //                       - FALSE => The address is not commited or the process
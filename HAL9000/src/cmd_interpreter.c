@@ -78,6 +78,9 @@ static const COMMAND_DEFINITION COMMANDS[] =
     { "sysinfo", "Retrieves system information", CmdDisplaySysInfo, 0, 0},
     { "getidle", "Retrieves idle timeout", CmdGetIdle, 0, 0},
     { "setidle", "$PERIOD_IN_SECONDS - Sets idle timeout", CmdSetIdle, 1, 1},
+    { "tlbstat", "Displays TLB shootdown statistics\n\tRates are computed since the previous tlbstat", CmdDisplayTlbStats, 0, 0},
+    { "swapstat", "[ON|OFF] - displays paging statistics\n\tIf specified enables or disables the zero page scan", CmdDisplaySwapStats, 0, 1},
+    { "counters", "[$PREFIX] - displays the per-CPU counters\n\tIf $PREFIX is specified only the counters whose name starts with it", CmdDisplayCounters, 0, 1},
 
     { "rdmsr", "0x$INDEX\n\t$INDEX is the MSR to read", CmdRdmsr, 1, 1},
     { "wrmsr", "0x$INDEX 0x$VALUE\n\t$INDEX is the MSR to write\n\t$VALUE is the value to place in the MSR", CmdWrmsr, 2, 2},
@@ -92,6 +95,10 @@ static const COMMAND_DEFINITION COMMANDS[] =
     { "netstatus", "$DEV_ID $RX_EN $TX_EN - changes the state of a network device"
                    "\n\tDevice ID\n\tIf $RX_EN is 1 => will enable receive on device\n\tIf $TX_EN is 1 => will enable send on device",
                     CmdChangeDevStatus, 3, 3},
+    { "netstat", "[$DEV_ID] - displays network device statistics\n\tIf $DEV_ID is not specified displays statistics for all devices",
+                  CmdNetStat, 0, 1},
+    { "netmtu", "$DEV_ID $MTU - changes the MTU of a network device\n\tValues above 1500 enable jumbo frames if the device supports them",
+                 CmdSetNetMtu, 2, 2},
 
     { "tests", "Runs functional tests", CmdRunAllFunctionalTests, 0, 0},
     { "perf", "Runs performance tests", CmdRunAllPerformanceTests, 0, 0},
@@ -6,6 +6,12 @@
 #include "test_net_stack.h"
 #include "strutils.h"
 
+static
+void
+_CmdDumpDeviceStatistics(
+    IN          DEVICE_ID   DeviceId
+    );
+
 #pragma warning(push)
 
 // warning C4212: nonstandard extension used: function declaration used ellipsis
@@ -152,4 +158,121 @@ CmdChangeDevStatus(
     }
 }
 
+void
+CmdNetStat(
+    IN      QWORD       NumberOfParameters,
+    IN_Z    char*       DeviceString
+    )
+{
+    PNETWORK_DEVICE_INFO pNetDevices;
+    DWORD noOfDevices;
+    STATUS status;
+    DEVICE_ID devId;
+
+    ASSERT(NumberOfParameters <= 1);
+
+    if (1 == NumberOfParameters)
+    {
+        atoi32(&devId, DeviceString, BASE_HEXA);
+
+        _CmdDumpDeviceStatistics(devId);
+        return;
+    }
+
+    pNetDevices = NULL;
+    noOfDevices = 0;
+    status = STATUS_SUCCESS;
+
+    status = NetGetNetworkDevices(NULL, &noOfDevices);
+    if (!SUCCEEDED(status))
+    {
+        perror("NetGetNetworkDevices failed with status: 0x%x\n", status);
+        return;
+    }
+
+    if (0 == noOfDevices)
+    {
+        pwarn("There are no network devices\n");
+        return;
+    }
+
+    __try
+    {
+        pNetDevices = ExAllocatePoolWithTag(PoolAllocateZeroMemory, sizeof(NETWORK_DEVICE_INFO) * noOfDevices, HEAP_TEMP_TAG, 0);
+        if (NULL == pNetDevices)
+        {
+            perror("ExAllocatePoolWithTag failed for size: 0x%x\n", sizeof(NETWORK_DEVICE_INFO) * noOfDevices);
+            __leave;
+        }
+
+        status = NetGetNetworkDevices(pNetDevices, &noOfDevices);
+        if (!SUCCEEDED(status))
+        {
+            perror("NetGetNetworkDevices failed with status: 0x%x\n", status);
+            __leave;
+        }
+
+        for (DWORD i = 0; i < noOfDevices; ++i)
+        {
+            _CmdDumpDeviceStatistics(pNetDevices[i].DeviceId);
+            LOG("\n");
+        }
+    }
+    __finally
+    {
+        if (NULL != pNetDevices)
+        {
+            ExFreePoolWithTag(pNetDevices, HEAP_TEMP_TAG);
+            pNetDevices = NULL;
+        }
+    }
+}
+
+void
+CmdSetNetMtu(
+    IN      QWORD       NumberOfParameters,
+    IN_Z    char*       DeviceString,
+    IN_Z    char*       MtuString
+    )
+{
+    STATUS status;
+    DEVICE_ID devId;
+    DWORD mtu;
+
+    ASSERT(NumberOfParameters == 2);
+
+    atoi32(&devId, DeviceString, BASE_HEXA);
+    atoi32(&mtu, MtuString, BASE_TEN);
+
+    printf("Device ID: 0x%x, MTU: %u\n", devId, mtu);
+
+    status = NetSetDeviceMtu(devId, mtu);
+    if (!SUCCEEDED(status))
+    {
+        perror("NetSetDeviceMtu failed with status: 0x%x\n", status);
+        return;
+    }
+}
+
 #pragma warning(pop)
+
+static
+void
+_CmdDumpDeviceStatistics(
+    IN          DEVICE_ID   DeviceId
+    )
+{
+    STATUS status;
+    NETWORK_DEVICE_STATS devStats;
+
+    memzero(&devStats, sizeof(NETWORK_DEVICE_STATS));
+
+    status = NetGetNetworkDeviceStatistics(DeviceId, &devStats);
+    if (!SUCCEEDED(status))
+    {
+        perror("NetGetNetworkDeviceStatistics failed with status: 0x%x\n", status);
+        return;
+    }
+
+    DumpNetworkDeviceStatistics(DeviceId, &devStats);
+}
@@ -6,6 +6,10 @@
 #include "strutils.h"
 #include "keyboard.h"
 #include "acpi_interface.h"
+#include "tlb.h"
+#include "swap.h"
+#include "cpumu.h"
+#include "smp.h"
 
 #pragma warning(push)
 
@@ -15,6 +19,17 @@
 // warning C4029: declared formal parameter list different from definition
 #pragma warning(disable:4029)
 
+typedef struct _CMD_TLB_SAMPLE
+{
+    TLB_STATISTICS          Statistics;
+    QWORD                   UptimeUs;
+} CMD_TLB_SAMPLE, *PCMD_TLB_SAMPLE;
+
+// the rates are computed relative to the previous tlbstat command
+static CMD_TLB_SAMPLE m_lastTlbSample;
+
+static FUNC_PerCpuCounterVisit _CmdPrintCounter;
+
 void
 (__cdecl CmdDisplaySysInfo)(
     IN          QWORD       NumberOfParameters
@@ -94,4 +109,137 @@ void
     AcpiShutdown();
 }
 
+void
+(__cdecl CmdDisplayTlbStats)(
+    IN          QWORD       NumberOfParameters
+    )
+{
+    CMD_TLB_SAMPLE sample;
+    SYSTEM_INFORMATION sysInfo;
+    QWORD elapsedUs;
+
+    ASSERT(NumberOfParameters == 0);
+
+    TlbGetStatistics(&sample.Statistics);
+
+    ExGetSystemInformation(&sysInfo);
+    sample.UptimeUs = sysInfo.SystemUptimeUs;
+
+    printf("Shootdowns: %U\n", sample.Statistics.Shootdowns);
+    printf("IPIs sent: %U\n", sample.Statistics.IpisSent);
+    printf("Full flushes: %U\n", sample.Statistics.FullFlushes);
+    printf("Pages invalidated: %U\n", sample.Statistics.PagesInvalidated);
+    printf("Address space switches: %U, %U kept the TLB, %U PCIDs recycled\n",
+           sample.Statistics.AddressSpaceSwitches,
+           sample.Statistics.TaggedSwitches,
+           sample.Statistics.PcidsRecycled);
+
+    elapsedUs = sample.UptimeUs - m_lastTlbSample.UptimeUs;
+    if (0 != elapsedUs)
+    {
+        printf("Over the last %U ms: %U shootdowns/sec, %U IPIs/sec\n",
+               elapsedUs / MS_IN_US,
+               (sample.Statistics.Shootdowns - m_lastTlbSample.Statistics.Shootdowns) * SEC_IN_US / elapsedUs,
+               (sample.Statistics.IpisSent - m_lastTlbSample.Statistics.IpisSent) * SEC_IN_US / elapsedUs);
+    }
+
+    m_lastTlbSample = sample;
+}
+
+void
+(__cdecl CmdDisplaySwapStats)(
+    IN          QWORD       NumberOfParameters,
+    IN_Z        char*       ScanString
+    )
+{
+    SWAP_STATISTICS stats;
+    BOOLEAN bEnable;
+
+    ASSERT(NumberOfParameters <= 1);
+
+    if (1 == NumberOfParameters)
+    {
+        bEnable = (0 == stricmp(ScanString, "ON"));
+
+        SwapSetZeroPageScanning(bEnable);
+        printf("Zero page scan %s\n", bEnable ? "enabled" : "disabled");
+    }
+
+    SwapGetStatistics(&stats);
+
+    if (!stats.Enabled)
+    {
+        printf("Paging is disabled\n");
+        return;
+    }
+
+    printf("Slots in use: %u/%u\n", stats.SlotsInUse, stats.NumberOfSlots);
+    printf("Evictable frames: %u\n", stats.EvictableFrames);
+    printf("Pages written: %U\n", stats.PagesWritten);
+    printf("Pages read: %U\n", stats.PagesRead);
+    printf("Write errors: %U\n", stats.WriteErrors);
+    printf("Second chances: %U\n", stats.SecondChances);
+    printf("Zero pages merged: %U\n", stats.ZeroPagesMerged);
+    printf("Pager wakeups: %U\n", stats.PagerWakeups);
+}
+
+void
+(__cdecl CmdDisplayCounters)(
+    IN          QWORD       NumberOfParameters,
+    IN_Z        char*       Prefix
+    )
+{
+    PLIST_ENTRY pCpuListHead;
+
+    ASSERT(NumberOfParameters <= 1);
+
+    SmpGetCpuList(&pCpuListHead);
+
+    printColor(MAGENTA_COLOR, "%25s", "Counter|");
+    printColor(MAGENTA_COLOR, "%13s", "Total|");
+
+    // a column for each CPU
+    for (PLIST_ENTRY pEntry = pCpuListHead->Flink; pEntry != pCpuListHead; pEntry = pEntry->Flink)
+    {
+        PPCPU pCpu = CONTAINING_RECORD(pEntry, PCPU, ListEntry);
+
+        printColor(MAGENTA_COLOR, "  CPU %02x|", pCpu->ApicId);
+    }
+    printf("\n");
+
+    PerCpuCounterForEach(_CmdPrintCounter, 1 == NumberOfParameters ? Prefix : NULL);
+}
+
+static
+void
+(__cdecl _CmdPrintCounter)(
+    IN      PERCPU_COUNTER          Counter,
+    IN_Z    const char*             Name,
+    IN_OPT  PVOID                   Context
+    )
+{
+    const char* pPrefix;
+    PLIST_ENTRY pCpuListHead;
+
+    pPrefix = Context;
+
+    if (NULL != pPrefix && 0 != strncmp(Name, pPrefix, strlen(pPrefix)))
+    {
+        return;
+    }
+
+    SmpGetCpuList(&pCpuListHead);
+
+    printf("%24s%c", Name, '|');
+    printf("%12U%c", PerCpuCounterRead(Counter), '|');
+
+    for (PLIST_ENTRY pEntry = pCpuListHead->Flink; pEntry != pCpuListHead; pEntry = pEntry->Flink)
+    {
+        PPCPU pCpu = CONTAINING_RECORD(pEntry, PCPU, ListEntry);
+
+        printf("%8U%c", PerCpuCounterReadForCpu(Counter, pCpu), '|');
+    }
+    printf("\n");
+}
+
 #pragma warning(pop)
@@ -14,6 +14,7 @@
 #include "strutils.h"
 #include "smp.h"
 #include "ex_timer.h"
+#include "vmm.h"
 
 #pragma warning(push)
 
@@ -61,10 +62,12 @@ void
 {
     PLIST_ENTRY pCpuListHead;
     PLIST_ENTRY pCurEntry;
+    PERCPU_COUNTER pageFaultsCounter;
 
     ASSERT(NumberOfParameters == 0);
 
     pCpuListHead = NULL;
+    pageFaultsCounter = PerCpuCounterLookup(VMM_PAGE_FAULTS_COUNTER_NAME);
 
     SmpGetCpuList(&pCpuListHead);
 
@@ -96,7 +99,7 @@ void
         printf("%12U%c", pCpu->ThreadData.KernelTicks, '|');
         printf("%12U%c", totalTicks, '|');
         printf("%3d.%02d%c", percentage / 100, percentage % 100, '|');
-        printf("%6U%c", pCpu->PageFaults, '|' );
+        printf("%6U%c", PerCpuCounterReadForCpu(pageFaultsCounter, pCpu), '|' );
         printf("%14s%c", pCpu->ThreadData.CurrentThread->Name, '|');
     }
 }
@@ -122,6 +122,8 @@ CpuMuValidateConfiguration(
 
     ASSERT_INFO( m_cpuMuData.FeatureInformation.edx.SSE2, "We need LFENCE/MFENCE support");
 
+    ASSERT_INFO( m_cpuMuData.FeatureInformation.ecx.CMPXCHG16B, "We need CMPXCHG16B for the interlocked lists");
+
     // No, they are not.
     // ASSERT_INFO( m_cpuMuData.FeatureInformation.ecx.PCID, "Things are too slow without PCID support");
 
@@ -154,6 +156,22 @@ CpuMuSetMonitorFilterSize(
     return STATUS_SUCCESS;
 }
 
+BOOLEAN
+CpuMuIsGigabytePageSupported(
+    void
+    )
+{
+    return (BOOLEAN) m_cpuMuData.ExtendedFeatureInformation.edx.LargePages;
+}
+
+BOOLEAN
+CpuMuIsInvpcidSupported(
+    void
+    )
+{
+    return (BOOLEAN) m_cpuMuData.StructuredExtendedFeatures.ebx.INVPCID;
+}
+
 STATUS
 CpuMuAllocAndInitCpu(
     OUT_PTR     PPCPU*      PhysicalCpu,
@@ -213,7 +231,8 @@ CpuMuAllocCpu(
     status = STATUS_SUCCESS;
     pPcpu = NULL;
 
-    pPcpu = ExAllocatePoolWithTag(PoolAllocateZeroMemory, sizeof(PCPU), HEAP_CPU_TAG, 0);
+    // the PCPU groups its fields by cache line, see its definition
+    pPcpu = ExAllocatePoolWithTag(PoolAllocateZeroMemory, sizeof(PCPU), HEAP_CPU_TAG, CACHE_LINE_SIZE);
     if (NULL == pPcpu)
     {
         LOG_FUNC_ERROR_ALLOC("HeapAllocatePoolWithTag", sizeof(PCPU));
@@ -255,6 +274,10 @@ CpuMuAllocCpu(
     LockInit(&pPcpu->EventListLock);
     pPcpu->NoOfEventsInList = 0;
 
+    RfcOwnerInit(&pPcpu->RfcOwner);
+
+    pPcpu->Self = pPcpu;
+
     *PhysicalCpu = pPcpu;
 
     LOG_FUNC_END;
@@ -286,6 +309,7 @@ CpuMuInitCpu(
     // write CPU structure to GS
     SetCurrentPcpu(PhysicalCpu);
     SetCurrentThread(NULL);
+    PerCpuCounterEnable();
     LOG("PROBLEMA4 [CPU:%02x]\n", CpuGetApicId());
 
     // we assume we haven't used more than 1 PAGE of our stack
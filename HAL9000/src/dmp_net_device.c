@@ -3,6 +3,13 @@
 #include "network_utils.h"
 #include "dmp_common.h"
 
+static
+void
+_DumpNetworkFrameStats(
+    IN      const char*                 Direction,
+    IN      PNETWORK_FRAME_STATS        Stats
+    );
+
 void
 DumpNetworkDevice(
     IN      PNETWORK_DEVICE_INFO        NetworkDevice
@@ -26,5 +33,58 @@ DumpNetworkDevice(
     LOG("Device TX is [%s]\n",
         NetworkDevice->DeviceStatus.TxEnabled ? "ENABLED" : "DISABLED"
         );
+    LOG("MTU: %u bytes\n", NetworkDevice->Mtu );
+    DumpReleaseLock(intrState);
+}
+
+void
+DumpNetworkDeviceStatistics(
+    IN      DEVICE_ID                   DeviceId,
+    IN      PNETWORK_DEVICE_STATS       Statistics
+    )
+{
+    INTR_STATE intrState;
+
+    ASSERT( NULL != Statistics );
+
+    intrState = DumpTakeLock();
+    LOG("Device ID: 0x%x\n", DeviceId );
+
+    _DumpNetworkFrameStats("RX", &Statistics->RxStats);
+    _DumpNetworkFrameStats("TX", &Statistics->TxStats);
+
+    LOG("Interrupts: %U, with RX frames: %U\n",
+        Statistics->NumberOfInterrupts, Statistics->NumberOfRxInterrupts);
+
+    if (0 != Statistics->NumberOfRxInterrupts)
+    {
+        // two decimals are more than enough
+        QWORD framesPerInterrupt = (Statistics->RxStats.NumberOfFrames * 100) / Statistics->NumberOfRxInterrupts;
+
+        LOG("Average RX frames per interrupt: %U.%02U\n",
+            framesPerInterrupt / 100, framesPerInterrupt % 100);
+    }
     DumpReleaseLock(intrState);
+}
+
+static
+void
+_DumpNetworkFrameStats(
+    IN      const char*                 Direction,
+    IN      PNETWORK_FRAME_STATS        Stats
+    )
+{
+    ASSERT( NULL != Direction );
+    ASSERT( NULL != Stats );
+
+    LOG("%s frames: %U, bytes: %U, dropped: %U\n",
+        Direction, Stats->NumberOfFrames, Stats->TotalBytes, Stats->DroppedFrames);
+    LOG("%s smallest frame: %U bytes, largest frame: %U bytes\n",
+        Direction, Stats->SmallestPacket, Stats->LargestPacket);
+    LOG("%s queue: %u frames, high-water mark: %u frames\n",
+        Direction, Stats->QueuedFrames, Stats->QueueHighWaterMark);
+    LOG("%s ring: %u descriptors, high-water mark: %u descriptors\n",
+        Direction, Stats->RingSize, Stats->RingHighWaterMark);
+    LOG("%s descriptors used: %U, buffer size: %u bytes\n",
+        Direction, Stats->NumberOfDescriptors, Stats->BufferSize);
 }
\ No newline at end of file
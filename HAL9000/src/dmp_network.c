@@ -203,12 +203,15 @@ DumpIp4Packet(
         "Destination: [%s]\n"
         "Length: %u bytes\n"
         "TTL: %u\n"
-        "Protocol: 0x%x [%s]\n\n",
+        "Protocol: 0x%x [%s]\n"
+        "Checksum: 0x%x [%s]\n\n",
         NetUtilIp4AddressToText(Ip4Packet->Source, sourceAddress),
         NetUtilIp4AddressToText(Ip4Packet->Destination, destinationAddress),
         dataLength,
         Ip4Packet->TimeToLive,
-        Ip4Packet->Protocol, _DumpProtocolTypeToString(Ip4Packet->Protocol)
+        Ip4Packet->Protocol, _DumpProtocolTypeToString(Ip4Packet->Protocol),
+        ntohw(Ip4Packet->Checksum),
+        SUCCEEDED(NetUtilIp4ParseHeader(Ip4Packet, BufferSize, NULL, NULL)) ? "valid" : "INVALID"
         )
         ;
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "HAL9000.h"
+#include "ex_rcu.h"
+#include "ex_system.h"
+#include "cpumu.h"
+#include "smp.h"
+#include "iomu.h"
+#include "thread_internal.h"
+
+// the timer interrupts are not delivered to each CPU on each period, after
+// waiting this long the CPUs which did not report are interrupted by an IPI
+#define RCU_FORCE_QUIESCENT_STATE_US        (100 * MS_IN_US)
+
+typedef struct _RCU_DATA
+{
+    // incremented by each grace period, the CPUs copy it in their PCPU on
+    // each quiescent state
+    volatile QWORD          Epoch;
+} RCU_DATA, *PRCU_DATA;
+
+// read on each timer interrupt, it must not share its line with data written
+// more often
+static __declspec(align(CACHE_LINE_SIZE)) RCU_DATA m_rcuData;
+
+static FUNC_IpcProcessEvent _ExRcuIpiQuiescentState;
+
+void
+ExRcuReadLock(
+    OUT     INTR_STATE*             IntrState
+    )
+{
+    ASSERT(NULL != IntrState);
+
+    // the CPU can't take a timer interrupt nor switch threads => it can't
+    // report a quiescent state until the section ends
+    *IntrState = CpuIntrDisable();
+}
+
+void
+ExRcuReadUnlock(
+    IN      INTR_STATE              IntrState
+    )
+{
+    CpuIntrSetState(IntrState);
+}
+
+void
+ExRcuSynchronize(
+    void
+    )
+{
+    PLIST_ENTRY pCpuList;
+    INTR_STATE intrState;
+    QWORD epoch;
+    QWORD startTimeUs;
+    BOOLEAN bForced;
+
+    ASSERT(INTR_ON == CpuIntrGetState());
+
+    // the interlocked operation also orders the unlinking done by the caller
+    // before the new epoch
+    epoch = (QWORD) _InterlockedIncrement64(&m_rcuData.Epoch);
+
+    // the caller is not in a read side critical section => neither is its CPU
+    intrState = CpuIntrDisable();
+    ExRcuReportQuiescentState();
+    CpuIntrSetState(intrState);
+
+    startTimeUs = IomuGetSystemTimeUs();
+    bForced = FALSE;
+
+    SmpGetCpuList(&pCpuList);
+
+    for (PLIST_ENTRY pEntry = pCpuList->Flink; pEntry != pCpuList; pEntry = pEntry->Flink)
+    {
+        PPCPU pCpu = CONTAINING_RECORD(pEntry, PCPU, ListEntry);
+
+        while (pCpu->RcuQuiescentEpoch < epoch)
+        {
+            if (!bForced && IomuGetSystemTimeUs() - startTimeUs >= RCU_FORCE_QUIESCENT_STATE_US)
+            {
+                STATUS status;
+
+                status = SmpSendGenericIpi(_ExRcuIpiQuiescentState, NULL, NULL, NULL, TRUE);
+                ASSERT(SUCCEEDED(status));
+
+                bForced = TRUE;
+            }
+
+            ThreadYield();
+        }
+    }
+}
+
+void
+ExRcuInsertTailList(
+    INOUT   PLIST_ENTRY             ListHead,
+    INOUT   PLIST_ENTRY             Entry
+    )
+{
+    PLIST_ENTRY pBlink;
+
+    ASSERT(NULL != ListHead);
+    ASSERT(NULL != Entry);
+
+    pBlink = ListHead->Blink;
+    Entry->Flink = ListHead;
+    Entry->Blink = pBlink;
+
+    // stores are not reordered with older stores on x86, only the compiler
+    // must be kept from publishing the entry before its fields are written
+    _ReadWriteBarrier();
+
+    *(PLIST_ENTRY volatile*) &pBlink->Flink = Entry;
+    ListHead->Blink = Entry;
+}
+
+void
+ExRcuRemoveEntryList(
+    INOUT   PLIST_ENTRY             Entry
+    )
+{
+    PLIST_ENTRY pFlink;
+    PLIST_ENTRY pBlink;
+
+    ASSERT(NULL != Entry);
+
+    pFlink = Entry->Flink;
+    pBlink = Entry->Blink;
+
+    // the Flink of the entry is left intact, the readers positioned on it
+    // continue with the rest of the list
+    *(PLIST_ENTRY volatile*) &pBlink->Flink = pFlink;
+    pFlink->Blink = pBlink;
+}
+
+void
+ExRcuReportQuiescentState(
+    void
+    )
+{
+    PPCPU pCpu;
+    QWORD epoch;
+
+    ASSERT(INTR_OFF == CpuIntrGetState());
+
+    pCpu = GetCurrentPcpu();
+    ASSERT(NULL != pCpu);
+
+    // don't dirty the line while no grace period is in progress, the waiters
+    // would have to fetch it again
+    epoch = m_rcuData.Epoch;
+    if (pCpu->RcuQuiescentEpoch != epoch)
+    {
+        pCpu->RcuQuiescentEpoch = epoch;
+    }
+}
+
+static
+STATUS
+(__cdecl _ExRcuIpiQuiescentState)(
+    IN_OPT  PVOID   Context
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    // the IPI was taken => the CPU was not in a read side critical section
+    ExRcuReportQuiescentState();
+
+    return STATUS_SUCCESS;
+}
\ No newline at end of file
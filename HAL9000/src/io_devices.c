@@ -9,6 +9,7 @@
 #include "mmu.h"
 #include "vmm.h"
 #include "os_time.h"
+#include "ex_rcu.h"
 
 /// TODO: These function calls cross trust boundaries, validate parameters
 /// and do not ASSERT
@@ -80,26 +81,21 @@ IoCreateDevice(
             }
         }
         pDevice->DeviceType = DeviceType;
+        pDevice->StackSize = 1;
 
+        // set driver object
+        pDevice->DriverObject = DriverObject;
+
+        // the device and its VPB are traversed without locks by the readers
+        // => they are published only after they are fully initialized
         if (DeviceTypeVolume == pDevice->DeviceType)
         {
             // we need to allocate a volume parameter block
             _IoAllocateVpb(pDevice);
         }
 
-        pDevice->StackSize = 1;
-
         // insert device into list
-        /// TODO: need to lock
-        /// Actually this is debatable: the IoCreateDevice should normally be called only in the DriverEntry portion
-        /// of the driver which is single-threaded. Because we have no PNP support (ATM) I see no way in which we could
-        /// have a problem by not synchronizing access to this list.
-
-        InsertTailList(&DriverObject->DeviceList, &pDevice->NextDevice);
-        DriverObject->NoOfDevices = DriverObject->NoOfDevices + 1;
-
-        // set driver object
-        pDevice->DriverObject = DriverObject;
+        IomuDeviceCreated(DriverObject, pDevice);
     }
     __finally
     {
@@ -139,16 +135,20 @@ IoDeleteDevice(
     INOUT   PDEVICE_OBJECT      Device
     )
 {
-    PDRIVER_OBJECT pDriver;
-
     ASSERT(NULL != Device);
+    ASSERT(NULL != Device->DriverObject);
 
-    pDriver = Device->DriverObject;
-
-    ASSERT(NULL != pDriver);
+    // Devices are deleted only by the DriverEntry of their driver, when
+    // their initialization fails. The driver is not yet installed so no
+    // reader could have found the device or its VPB: the devices returned by
+    // IoGetDevicesByType and the VPBs are used without references.
+    IomuDeviceDeleted(Device);
 
-    RemoveEntryList(&Device->NextDevice);
-    pDriver->NoOfDevices = pDriver->NoOfDevices - 1;
+    if (DeviceTypeVolume == Device->DeviceType)
+    {
+        ExFreePoolWithTag(Device->Vpb, HEAP_VPB_TAG);
+        Device->Vpb = NULL;
+    }
 
     if (0 != Device->DeviceExtensionSize)
     {
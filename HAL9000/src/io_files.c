@@ -344,6 +344,110 @@ IoReadFile(
     return status;
 }
 
+SAL_SUCCESS
+STATUS
+IoWriteFile(
+    IN          PFILE_OBJECT            FileHandle,
+    IN          QWORD                   BytesToWrite,
+    IN_OPT      QWORD*                  FileOffset,
+    IN          PVOID                   Buffer,
+    OUT         QWORD*                  BytesWritten
+    )
+{
+    STATUS status;
+    PIRP pIrp;
+    PDEVICE_OBJECT pFileSystemDevice;
+    PIO_STACK_LOCATION pStackLocation;
+    QWORD fileOffset;
+
+    LOG_FUNC_START;
+
+    ASSERT(NULL != FileHandle);
+    ASSERT(NULL != Buffer);
+    ASSERT(NULL != BytesWritten);
+
+    status = STATUS_SUCCESS;
+    pIrp = NULL;
+    pFileSystemDevice = NULL;
+    pStackLocation = NULL;
+    
+    if (FileHandle->Flags.Asynchronous)
+    {
+        ASSERT(NULL != FileOffset);
+
+        fileOffset = *FileOffset;
+    }
+    else
+    {
+        if (NULL == FileOffset)
+        {
+            fileOffset = FileHandle->CurrentByteOffset;
+        }
+        else
+        {
+            fileOffset = *FileOffset;
+        }
+    }
+
+    pFileSystemDevice = FileHandle->FileSystemDevice;
+    ASSERT(NULL != pFileSystemDevice);
+
+    pIrp = IoAllocateIrp(pFileSystemDevice->StackSize);
+    if (NULL == pIrp)
+    {
+        LOG_FUNC_ERROR_ALLOC("IoAllocateIrp", sizeof(IRP));
+        return STATUS_HEAP_NO_MORE_MEMORY;
+    }
+    pIrp->Buffer = Buffer;
+
+    // pass async parameter
+    pIrp->Flags.Asynchronous = FileHandle->Flags.Asynchronous;
+
+    pStackLocation = IoGetNextIrpStackLocation(pIrp);
+    pStackLocation->MajorFunction = IRP_MJ_WRITE;
+    pStackLocation->DeviceObject = pFileSystemDevice;
+
+    // setup parameters
+    pStackLocation->Parameters.ReadWrite.Length = BytesToWrite;
+    pStackLocation->Parameters.ReadWrite.Offset = fileOffset;
+    pStackLocation->FileObject = FileHandle;
+    
+    __try
+    {
+        // call file system
+        status = IoCallDriver(pFileSystemDevice, pIrp);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("IoCallDriver", status);
+            __leave;
+        }
+
+        status = pIrp->IoStatus.Status;
+        *BytesWritten = pIrp->IoStatus.Information;
+
+        if (SUCCEEDED(status))
+        {
+            // if synchronous operation => update file offset
+            if (!FileHandle->Flags.Asynchronous)
+            {
+                FileHandle->CurrentByteOffset = FileHandle->CurrentByteOffset + *BytesWritten;
+            }
+        }
+    }
+    __finally
+    {
+        if (NULL != pIrp)
+        {
+            IoFreeIrp(pIrp);
+            pIrp = NULL;
+        }
+
+        LOG_FUNC_END;
+    }
+
+    return status;
+}
+
 SAL_SUCCESS
 STATUS
 IoQueryInformationFile(
@@ -11,6 +11,7 @@
 #include "ata.h"
 #include "filesystem.h"
 #include "fat32.h"
+#include "swapfs.h"
 #include "lapic_system.h"
 #include "dmp_io.h"
 #include "isr.h"
@@ -23,6 +24,7 @@
 #include "smp.h"
 #include "ex_system.h"
 #include "lock_common.h"
+#include "ex_rcu.h"
 
 #define PIC_MASTER_OFFSET                   0x20
 #define PIC_SLAVE_OFFSET                    0x28
@@ -68,8 +70,15 @@ typedef struct _IOMU_DATA
 
     LIST_ENTRY                  PciBridgeList;
 
+    // serializes the writers of the driver list, of the device lists of the
+    // drivers and of the VPB list, the readers traverse them under
+    // ExRcuReadLock
+    LOCK                        ListsLock;
+
+    _Guarded_by_(ListsLock)
     LIST_ENTRY                  DriverList;
 
+    _Guarded_by_(ListsLock)
     LIST_ENTRY                  VpbList;
 
     UPTIME                      SystemUptime;
@@ -112,6 +121,7 @@ static const DRIVER_DECLARATION DRIVER_NAMES[] = {
     DECLARE_DRIVER("disk", DiskDriverEntry, FALSE),
     DECLARE_DRIVER("vol", VolDriverEntry, FALSE),
     DECLARE_DRIVER("fat", FatDriverEntry, FALSE),
+    DECLARE_DRIVER("swapfs", SwapFsDriverEntry, FALSE),
     DECLARE_DRIVER("eth82574L", Eth82574LDriverEntry, FALSE)
 };
 
@@ -136,6 +146,20 @@ _IomuGetNextVolumeLetter(
     return m_currentVolumeLetter;
 }
 
+REQUIRES_EXCL_LOCK(m_iomuData.ListsLock)
+static
+void
+_IomuPublishVpb(
+    INOUT       PVPB                Vpb
+    )
+{
+    ASSERT(NULL != Vpb);
+
+    Vpb->VolumeLetter = _IomuGetNextVolumeLetter();
+
+    ExRcuInsertTailList(&m_iomuData.VpbList, &Vpb->NextVpb);
+}
+
 static
 __forceinline
 void
@@ -233,6 +257,7 @@ IomuPreinitSystem(
     BitmapSetBits(&m_iomuData.InterruptBitmap, 0, NO_OF_RESERVED_EXCEPTIONS );
 
     LockInit(&m_iomuData.GlobalInterruptLock);
+    LockInit(&m_iomuData.ListsLock);
 
     IoApicSystemPreinit();
 }
@@ -536,26 +561,33 @@ IomuGetDriverByName(
     IN_Z    char*           DriverName
     )
 {
-    PDRIVER_OBJECT pDriver;
+    PDRIVER_OBJECT pFoundDriver;
     PLIST_ENTRY pCurEntry;
+    INTR_STATE intrState;
 
     ASSERT(NULL != DriverName);
 
-    pDriver = NULL;
-    for(pCurEntry = m_iomuData.DriverList.Flink;
+    pFoundDriver = NULL;
+
+    // drivers are never uninstalled => the result remains valid after the
+    // read side critical section
+    ExRcuReadLock(&intrState);
+    for(pCurEntry = ExRcuListNext(&m_iomuData.DriverList);
         pCurEntry != &m_iomuData.DriverList;
-        pCurEntry = pCurEntry->Flink)
+        pCurEntry = ExRcuListNext(pCurEntry))
     {
-        pDriver = CONTAINING_RECORD(pCurEntry, DRIVER_OBJECT, NextDriver);
+        PDRIVER_OBJECT pDriver = CONTAINING_RECORD(pCurEntry, DRIVER_OBJECT, NextDriver);
 
         if (0 == strcmp(pDriver->DriverName, DriverName))
         {
             // found driver
-            return pDriver;
+            pFoundDriver = pDriver;
+            break;
         }
     }
+    ExRcuReadUnlock(intrState);
 
-    return NULL;
+    return pFoundDriver;
 }
 
 void
@@ -563,9 +595,70 @@ IomuDriverInstalled(
     IN      PDRIVER_OBJECT  Driver
     )
 {
+    INTR_STATE intrState;
+
+    ASSERT(NULL != Driver);
+
+    LockAcquire(&m_iomuData.ListsLock, &intrState);
+
+    // The devices created by DriverEntry and the VPBs of its volumes become
+    // reachable only now, until then the driver may still delete them, see
+    // IoDeleteDevice
+    for (PLIST_ENTRY pCurEntry = Driver->DeviceList.Flink;
+         pCurEntry != &Driver->DeviceList;
+         pCurEntry = pCurEntry->Flink)
+    {
+        PDEVICE_OBJECT pDevice = CONTAINING_RECORD(pCurEntry, DEVICE_OBJECT, NextDevice);
+
+        if (DeviceTypeVolume == pDevice->DeviceType)
+        {
+            _IomuPublishVpb(pDevice->Vpb);
+        }
+    }
+
+    Driver->Installed = TRUE;
+    ExRcuInsertTailList(&m_iomuData.DriverList, &Driver->NextDriver);
+    LockRelease(&m_iomuData.ListsLock, intrState);
+}
+
+void
+IomuDeviceCreated(
+    INOUT   PDRIVER_OBJECT  Driver,
+    INOUT   PDEVICE_OBJECT  Device
+    )
+{
+    INTR_STATE intrState;
+
     ASSERT(NULL != Driver);
+    ASSERT(NULL != Device);
+    ASSERT(Driver == Device->DriverObject);
 
-    InsertTailList(&m_iomuData.DriverList, &Driver->NextDriver);
+    LockAcquire(&m_iomuData.ListsLock, &intrState);
+    ExRcuInsertTailList(&Driver->DeviceList, &Device->NextDevice);
+    Driver->NoOfDevices++;
+    LockRelease(&m_iomuData.ListsLock, intrState);
+}
+
+void
+IomuDeviceDeleted(
+    INOUT   PDEVICE_OBJECT  Device
+    )
+{
+    INTR_STATE intrState;
+
+    ASSERT(NULL != Device);
+    ASSERT(NULL != Device->DriverObject);
+
+    LockAcquire(&m_iomuData.ListsLock, &intrState);
+
+    // the readers find the device and its VPB only once the driver is
+    // installed, IomuGetDevicesByType and IomuSearchForVpb return them
+    // without taking any reference
+    ASSERT(!Device->DriverObject->Installed);
+
+    RemoveEntryList(&Device->NextDevice);
+    Device->DriverObject->NoOfDevices--;
+    LockRelease(&m_iomuData.ListsLock, intrState);
 }
 
 PLIST_ENTRY
@@ -594,6 +687,7 @@ IomuGetDevicesByType(
     DWORD i;
     PDEVICE_OBJECT* pFoundDevices;
     DWORD indexInArray;
+    INTR_STATE intrState;
 
     ASSERT(NULL != DeviceObjects);
     ASSERT(NULL != NumberOfDevices);
@@ -622,15 +716,19 @@ IomuGetDevicesByType(
             }
         }
 
-        for(pCurDriverEntry = m_iomuData.DriverList.Flink;
+        // the allocation can't be done inside the read side critical section
+        // => devices may be created between the two iterations, the second
+        // one stops when the array is full
+        ExRcuReadLock(&intrState);
+        for(pCurDriverEntry = ExRcuListNext(&m_iomuData.DriverList);
             pCurDriverEntry != &m_iomuData.DriverList;
-            pCurDriverEntry = pCurDriverEntry->Flink)
+            pCurDriverEntry = ExRcuListNext(pCurDriverEntry))
         {
             PDRIVER_OBJECT pDriver = CONTAINING_RECORD(pCurDriverEntry, DRIVER_OBJECT, NextDriver);
 
-            for (pCurDeviceEntry = pDriver->DeviceList.Flink;
-            pCurDeviceEntry != &pDriver->DeviceList;
-                pCurDeviceEntry = pCurDeviceEntry->Flink)
+            for (pCurDeviceEntry = ExRcuListNext(&pDriver->DeviceList);
+                 pCurDeviceEntry != &pDriver->DeviceList;
+                 pCurDeviceEntry = ExRcuListNext(pCurDeviceEntry))
             {
                 PDEVICE_OBJECT pDeviceObject = CONTAINING_RECORD(pCurDeviceEntry, DEVICE_OBJECT, NextDevice);
 
@@ -642,7 +740,7 @@ IomuGetDevicesByType(
                         // on the first iteration we count
                         count = count + 1;
                     }
-                    else
+                    else if (indexInArray < count)
                     {
                         // on the second iteration we add to our allocated array
                         pFoundDevices[indexInArray] = pDeviceObject;
@@ -651,14 +749,15 @@ IomuGetDevicesByType(
                 }
             }
         }
+        ExRcuReadUnlock(intrState);
     }
 
     if (SUCCEEDED(status))
     {
-        ASSERT(indexInArray == count);
+        ASSERT(indexInArray <= count);
 
         *DeviceObjects = pFoundDevices;
-        *NumberOfDevices = count;
+        *NumberOfDevices = indexInArray;
     }
 
     return status;
@@ -669,11 +768,20 @@ IomuNewVpbCreated(
     INOUT       struct _VPB*        Vpb
     )
 {
+    INTR_STATE intrState;
+
     ASSERT(NULL != Vpb);
+    ASSERT(NULL != Vpb->VolumeDevice);
 
-    Vpb->VolumeLetter = _IomuGetNextVolumeLetter();
+    LockAcquire(&m_iomuData.ListsLock, &intrState);
 
-    InsertTailList(&m_iomuData.VpbList, &Vpb->NextVpb);
+    // the VPBs of the volumes created by DriverEntry are published by
+    // IomuDriverInstalled
+    if (Vpb->VolumeDevice->DriverObject->Installed)
+    {
+        _IomuPublishVpb(Vpb);
+    }
+    LockRelease(&m_iomuData.ListsLock, intrState);
 }
 
 void
@@ -683,13 +791,30 @@ IomuExecuteForEachVpb(
     IN          BOOLEAN             Exclusive
     )
 {
+    INTR_STATE intrState;
+
     ASSERT(NULL != Function);
 
-    UNREFERENCED_PARAMETER(Exclusive);
+    // in both cases Function runs with interrupts disabled and must not block
+    if (Exclusive)
+    {
+        LockAcquire(&m_iomuData.ListsLock, &intrState);
+    }
+    else
+    {
+        ExRcuReadLock(&intrState);
+    }
 
-    // take lock
     ForEachElementExecute(&m_iomuData.VpbList, Function, Context, FALSE);
-    // release lock
+
+    if (Exclusive)
+    {
+        LockRelease(&m_iomuData.ListsLock, intrState);
+    }
+    else
+    {
+        ExRcuReadUnlock(intrState);
+    }
 }
 
 PTR_SUCCESS
@@ -700,13 +825,30 @@ IomuSearchForVpb(
 {
     VPB vpbToSearchFor;
     PLIST_ENTRY pCorrespondingVpb;
+    INTR_STATE intrState;
 
     memzero(&vpbToSearchFor, sizeof(VPB));
 
     // take volume letter
     vpbToSearchFor.VolumeLetter = DriveLetter;
 
-    pCorrespondingVpb = ListSearchForElement(&m_iomuData.VpbList, &vpbToSearchFor.NextVpb, _VpbCompareFunction);
+    pCorrespondingVpb = NULL;
+
+    // the VPBs are freed only together with their volume devices, which are
+    // never deleted once they are reachable, see IoDeleteDevice
+    ExRcuReadLock(&intrState);
+    for (PLIST_ENTRY pCurEntry = ExRcuListNext(&m_iomuData.VpbList);
+         pCurEntry != &m_iomuData.VpbList;
+         pCurEntry = ExRcuListNext(pCurEntry))
+    {
+        if (0 == _VpbCompareFunction(pCurEntry, &vpbToSearchFor.NextVpb))
+        {
+            pCorrespondingVpb = pCurEntry;
+            break;
+        }
+    }
+    ExRcuReadUnlock(intrState);
+
     if (NULL == pCorrespondingVpb)
     {
         return NULL;
@@ -197,6 +197,17 @@ IpcProcessEvent(
     return STATUS_SUCCESS;
 }
 
+PFUNC_IpcProcessEvent
+IpcGetEventFunction(
+    IN      PIPC_EVENT_CPU      CpuEvent
+    )
+{
+    ASSERT(NULL != CpuEvent);
+    ASSERT(NULL != CpuEvent->Event);
+
+    return CpuEvent->Event->Function;
+}
+
 static
 void
 _IpcFreeEvent(
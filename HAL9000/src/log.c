@@ -12,18 +12,23 @@
 
 #define LOG_BUF_MAX_SIZE            512
 
+typedef struct _LOG_SETTINGS
+{
+    BOOLEAN                     Enabled;
+    LOG_LEVEL                   LoggingLevel;
+    LOG_COMPONENT               LoggingComponents;
+} LOG_SETTINGS, *PLOG_SETTINGS;
+
 typedef struct _LOG_DATA
 {
     LOCK                        Lock;
 
-    _Interlocked_
-    volatile BOOLEAN            Enabled;
-
-    _Interlocked_
-    volatile LOG_LEVEL          LoggingLevel;
+    // read on each log call, the readers take a consistent copy without
+    // writing to shared memory
+    SEQLOCK                     SettingsLock;
 
-    _Interlocked_
-    volatile LOG_COMPONENT      LoggingComponents;
+    _Guarded_by_(SettingsLock)
+    LOG_SETTINGS                Settings;
 } LOG_DATA, *PLOG_DATA;
 
 static LOG_DATA m_logData;
@@ -44,6 +49,7 @@ LogSystemPreinit(
     memzero(&m_logData, sizeof(LOG_DATA));
 
     LockInit(&m_logData.Lock);
+    SeqlockInit(&m_logData.SettingsLock);
 }
 
 _No_competing_thread_
@@ -56,9 +62,9 @@ LogSystemInit(
     IN          BOOLEAN         Enable
     )
 {
-    m_logData.Enabled = Enable;
-    m_logData.LoggingComponents = LogComponenets;
-    m_logData.LoggingLevel = LogLevel;
+    m_logData.Settings.Enabled = Enable;
+    m_logData.Settings.LoggingComponents = LogComponenets;
+    m_logData.Settings.LoggingLevel = LogLevel;
 }
 
 void
@@ -76,13 +82,21 @@ LogEx(
     DWORD modifierLength;
     PFUNC_PrintFunction printFunction;
     va_list va;
+    LOG_SETTINGS settings;
+    DWORD sequence;
 
-    if (!m_logData.Enabled)
+    do
+    {
+        sequence = SeqlockReadBegin(&m_logData.SettingsLock);
+        settings = m_logData.Settings;
+    } while (SeqlockReadRetry(&m_logData.SettingsLock, sequence));
+
+    if (!settings.Enabled)
     {
         return;
     }
 
-    if (LogLevel < m_logData.LoggingLevel)
+    if (LogLevel < settings.LoggingLevel)
     {
         // logging is not activated for this level
         return;
@@ -96,7 +110,7 @@ LogEx(
 
 
     if (LogLevel == LogLevelTrace &&
-        !IsFlagOn(m_logData.LoggingComponents, LogComponent))
+        !IsFlagOn(settings.LoggingComponents, LogComponent))
     {
         // logging is not activated for this component
         return;
@@ -149,7 +163,15 @@ LogSetState(
     IN          BOOLEAN         Enable
     )
 {
-    return _InterlockedExchange8(&m_logData.Enabled, Enable );
+    INTR_STATE intrState;
+    BOOLEAN oldState;
+
+    SeqlockWriteAcquire(&m_logData.SettingsLock, &intrState);
+    oldState = m_logData.Settings.Enabled;
+    m_logData.Settings.Enabled = Enable;
+    SeqlockWriteRelease(&m_logData.SettingsLock, intrState);
+
+    return oldState;
 }
 
 LOG_LEVEL
@@ -157,7 +179,7 @@ LogGetLevel(
     void
     )
 {
-    return m_logData.LoggingLevel;
+    return *(volatile LOG_LEVEL*) &m_logData.Settings.LoggingLevel;
 }
 
 LOG_LEVEL
@@ -165,7 +187,15 @@ LogSetLevel(
     IN          LOG_LEVEL   NewLogLevel
     )
 {
-    return _InterlockedExchange(&m_logData.LoggingLevel, (DWORD) NewLogLevel);
+    INTR_STATE intrState;
+    LOG_LEVEL oldLevel;
+
+    SeqlockWriteAcquire(&m_logData.SettingsLock, &intrState);
+    oldLevel = m_logData.Settings.LoggingLevel;
+    m_logData.Settings.LoggingLevel = NewLogLevel;
+    SeqlockWriteRelease(&m_logData.SettingsLock, intrState);
+
+    return oldLevel;
 }
 
 LOG_COMPONENT
@@ -173,7 +203,7 @@ LogGetTracedComponents(
     void
     )
 {
-    return m_logData.LoggingComponents;
+    return *(volatile LOG_COMPONENT*) &m_logData.Settings.LoggingComponents;
 }
 
 LOG_COMPONENT
@@ -181,7 +211,15 @@ LogSetTracedComponents(
     IN          LOG_COMPONENT   Components
     )
 {
-    return _InterlockedExchange(&m_logData.LoggingComponents, (DWORD) Components);
+    INTR_STATE intrState;
+    LOG_COMPONENT oldComponents;
+
+    SeqlockWriteAcquire(&m_logData.SettingsLock, &intrState);
+    oldComponents = m_logData.Settings.LoggingComponents;
+    m_logData.Settings.LoggingComponents = Components;
+    SeqlockWriteRelease(&m_logData.SettingsLock, intrState);
+
+    return oldComponents;
 }
 
 static
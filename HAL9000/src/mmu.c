@@ -15,6 +15,8 @@
 #include "thread_internal.h"
 #include "io.h"
 #include "mdl.h"
+#include "swap.h"
+#include "interlocked_list.h"
 
 #define PAGING_STRUCTURES_BASE_MEMORY                           (128*KB_SIZE)
 
@@ -39,6 +41,9 @@
 #define PML4_OFFSET_OF_KERNEL_STRUCTURES                        (PAGE_SIZE / 2)
 #define PML4_NO_OF_KERNEL_ENTRIES                               (PAGE_SIZE - PML4_OFFSET_OF_KERNEL_STRUCTURES)
 
+#define UM_SPACE_START                                          PAGE_SIZE
+#define UM_SPACE_END                                            ((QWORD)1 << VA_HIGHEST_VALID_BIT)
+
 #pragma pack(push,1)
 
 // warning C4201: nonstandard extension used: nameless struct/union
@@ -65,9 +70,22 @@ STATIC_ASSERT( sizeof(PAGE_FAULT_ERR_CODE) == sizeof(DWORD));
 
 #pragma pack(pop)
 
+// The zero worker thread keeps aside up to MMU_ZERO_POOL_MAX_FRAMES frames
+// which are known to be zero, so page faults and eager commits don't need to
+// zero the memory they receive
+#define MMU_ZERO_POOL_MAX_RUNS                  64
+#define MMU_ZERO_POOL_MAX_FRAMES                1024
+
+// the worker is woken up to refill the pool when it drops below this
+#define MMU_ZERO_POOL_LOW_FRAMES                (MMU_ZERO_POOL_MAX_FRAMES / 2)
+
+// number of frames reserved and zeroed at once by the worker when there are
+// no freed frames to zero
+#define MMU_ZERO_POOL_REFILL_FRAMES             16
+
 typedef struct _MMU_ZERO_WORKER_ITEM
 {
-    LIST_ENTRY                      ListEntry;
+    CL_SLIST_ENTRY                  QueueEntry;
 
     PHYSICAL_ADDRESS                PhysicalAddress;
     DWORD                           NumberOfFrames;
@@ -77,17 +95,39 @@ typedef struct _MMU_ZERO_WORKER_THREAD_CTX
 {
     PEX_EVENT                       NewPagesEvent;
 
-    PLOCK                           PagesLock;
-    PLIST_ENTRY                     PagesToZeroList;
+    PCL_MPSC_QUEUE                  PagesToZeroQueue;
 } MMU_ZERO_WORKER_THREAD_CTX, *PMMU_ZERO_WORKER_THREAD_CTX;
 
+typedef struct _MMU_ZERO_FRAME_RUN
+{
+    PHYSICAL_ADDRESS                PhysicalAddress;
+    DWORD                           NumberOfFrames;
+} MMU_ZERO_FRAME_RUN, *PMMU_ZERO_FRAME_RUN;
+
+typedef struct _MMU_ZERO_POOL
+{
+    LOCK                            Lock;
+
+    _Guarded_by_(Lock)
+    DWORD                           NumberOfRuns;
+
+    _Guarded_by_(Lock)
+    DWORD                           NumberOfFrames;
+
+    _Guarded_by_(Lock)
+    MMU_ZERO_FRAME_RUN              Runs[MMU_ZERO_POOL_MAX_RUNS];
+} MMU_ZERO_POOL, *PMMU_ZERO_POOL;
+
 typedef struct _MMU_ZERO_THREAD_DATA
 {
     PTHREAD                         WorkerThread;
 
     EX_EVENT                        NewPagesEvent;
-    LOCK                            PagesLock;
-    LIST_ENTRY                      PagesToZeroList;
+
+    // any CPU releasing memory pushes, only the worker thread pops
+    CL_MPSC_QUEUE                   PagesToZeroQueue;
+
+    MMU_ZERO_POOL                   ZeroPool;
 } MMU_ZERO_THREAD_DATA, *PMMU_ZERO_THREAD_DATA;
 
 typedef struct _MMU_HEAP_DATA
@@ -159,7 +199,8 @@ STATUS
 _MmuMapPeInMemory(
     IN          PPAGING_DATA            PagingData,
     IN          PPE_NT_HEADER_INFO      HeaderInfo,
-    IN          PVOID                   AddressToMap
+    IN          PVOID                   AddressToMap,
+    IN          BOOLEAN                 SharedImage
     );
 
 static
@@ -225,6 +266,19 @@ _MmuDestroyPagingTables(
 
 static FUNC_ThreadStart                 _MmuZeroWorkerThreadFunction;
 
+static
+BOOLEAN
+_MmuAddToZeroPool(
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      DWORD                   NumberOfFrames
+    );
+
+static
+BOOLEAN
+_MmuRefillZeroPool(
+    void
+    );
+
 __forceinline
 static
 DWORD
@@ -252,13 +306,14 @@ MmuPreinitSystem(
 
     RecRwSpinlockInit(0, &m_mmuData.PagingData.Lock);
 
-    InitializeListHead(&m_mmuData.ZeroThreadData.PagesToZeroList);
-    LockInit(&m_mmuData.ZeroThreadData.PagesLock);
+    ClMpscQueueInit(&m_mmuData.ZeroThreadData.PagesToZeroQueue);
+    LockInit(&m_mmuData.ZeroThreadData.ZeroPool.Lock);
     //This is bad because it dereferences a NULL pointer.
     //DWORD z = *((PBYTE)NULL);z;
 
     PmmPreinitSystem();
     VmmPreinit();
+    TlbPreinit();
 }
 
 // We have the following virtual memory layout
@@ -474,6 +529,14 @@ MmuInitSystem(
     }
     LOG("_MmuInitializeHeap succeeded for special heap\n");
 
+    status = VmmInitZeroFrame();
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("VmmInitZeroFrame", status);
+        return status;
+    }
+    LOG("VmmInitZeroFrame succeeded\n");
+
     return status;
 }
 
@@ -518,8 +581,7 @@ MmuInitThreadingSystem(
         return STATUS_HEAP_INSUFFICIENT_RESOURCES;
     }
     pCtx->NewPagesEvent = &m_mmuData.ZeroThreadData.NewPagesEvent;
-    pCtx->PagesToZeroList = &m_mmuData.ZeroThreadData.PagesToZeroList;
-    pCtx->PagesLock = &m_mmuData.ZeroThreadData.PagesLock;
+    pCtx->PagesToZeroQueue = &m_mmuData.ZeroThreadData.PagesToZeroQueue;
 
     __try
     {
@@ -638,6 +700,7 @@ MmuMapMemoryInternal(
 {
     INTR_STATE oldState;
     PPAGING_LOCK_DATA pPagingData;
+    TLB_SHOOTDOWN_BATCH batch;
 
     ASSERT( 0 != Size );
     ASSERT( IsAddressAligned(Size, PAGE_SIZE));
@@ -647,6 +710,8 @@ MmuMapMemoryInternal(
 
     pPagingData = (PagingData == NULL) ? &m_mmuData.PagingData : PagingData;
 
+    TlbBatchInit(&batch, &pPagingData->Data);
+
     RecRwSpinlockAcquireExclusive(&pPagingData->Lock, &oldState );
     VmmMapMemoryInternal(&pPagingData->Data,
                          PhysicalAddress,
@@ -654,9 +719,58 @@ MmuMapMemoryInternal(
                          VirtualAddress,
                          PageRights,
                          Invalidate,
-                         Uncacheable
+                         Uncacheable,
+                         &batch
                          );
     RecRwSpinlockReleaseExclusive(&pPagingData->Lock, oldState);
+
+    // if existing translations were replaced the other CPUs must drop them
+    TlbBatchFlush(&batch);
+}
+
+void
+MmuMapCpuLocalPage(
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      PVOID                   VirtualAddress
+    )
+{
+    INTR_STATE oldState;
+
+    ASSERT(INTR_OFF == CpuIntrGetState());
+    ASSERT(IsAddressAligned(PhysicalAddress, PAGE_SIZE));
+    ASSERT(IsAddressAligned(VirtualAddress, PAGE_SIZE));
+
+    // without a batch the replaced translation is invalidated only on this
+    // CPU, the others never accessed the page
+    RecRwSpinlockAcquireExclusive(&m_mmuData.PagingData.Lock, &oldState);
+    VmmMapMemoryInternal(&m_mmuData.PagingData.Data,
+                         PhysicalAddress,
+                         PAGE_SIZE,
+                         VirtualAddress,
+                         PAGE_RIGHTS_READWRITE,
+                         TRUE,
+                         FALSE,
+                         NULL
+                         );
+    RecRwSpinlockReleaseExclusive(&m_mmuData.PagingData.Lock, oldState);
+}
+
+void
+MmuPreparePagingStructures(
+    IN      PVOID                   VirtualAddress,
+    IN      QWORD                   Size
+    )
+{
+    INTR_STATE oldState;
+
+    ASSERT(IsAddressAligned(VirtualAddress, PAGE_SIZE));
+    ASSERT(IsAddressAligned(Size, PAGE_SIZE));
+
+    RecRwSpinlockAcquireExclusive(&m_mmuData.PagingData.Lock, &oldState);
+    VmmPreparePagingStructures(&m_mmuData.PagingData.Data,
+                               VirtualAddress,
+                               Size);
+    RecRwSpinlockReleaseExclusive(&m_mmuData.PagingData.Lock, oldState);
 }
 
 void
@@ -669,10 +783,12 @@ MmuUnmapMemoryEx(
 {
     QWORD alignedVirtualAddress;
     DWORD alignmentDifferences;
-    DWORD alignedSize;
-    PML4 cr3;
+    QWORD alignedSize;
+    QWORD offset;
+    QWORD unmappedSize;
     INTR_STATE oldState;
     PPAGING_LOCK_DATA pPagingData;
+    TLB_SHOOTDOWN_BATCH batch;
 
     ASSERT(VirtualAddress != NULL);
     ASSERT(Size != 0);
@@ -683,14 +799,36 @@ MmuUnmapMemoryEx(
     alignmentDifferences = (DWORD)((QWORD)VirtualAddress - alignedVirtualAddress);
     alignedSize = AlignAddressUpper(Size + alignmentDifferences, PAGE_SIZE);
 
-    RecRwSpinlockAcquireExclusive(&pPagingData->Lock, &oldState);
-    cr3.Raw = (QWORD) pPagingData->Data.BasePhysicalAddress;
-    VmmUnmapMemoryEx(cr3,
-                    (PVOID) alignedVirtualAddress,
-                     alignedSize,
-                     ReleaseMemory
-                    );
-    RecRwSpinlockReleaseExclusive(&pPagingData->Lock, oldState);
+    TlbBatchInit(&batch, &pPagingData->Data);
+
+    // The other CPUs are notified and the frames released only after the
+    // paging lock is released. If the batch fills up before the whole
+    // region is unmapped we flush it and continue from where we stopped.
+    for (offset = 0; offset < alignedSize; offset = offset + unmappedSize)
+    {
+        RecRwSpinlockAcquireExclusive(&pPagingData->Lock, &oldState);
+        unmappedSize = VmmUnmapMemoryEx(&pPagingData->Data,
+                                        (PVOID) (alignedVirtualAddress + offset),
+                                        alignedSize - offset,
+                                        ReleaseMemory,
+                                        &batch
+                                        );
+        RecRwSpinlockReleaseExclusive(&pPagingData->Lock, oldState);
+
+        TlbBatchFlush(&batch);
+
+        if (NULL != batch.FreedPagingStructures)
+        {
+            RecRwSpinlockAcquireExclusive(&pPagingData->Lock, &oldState);
+            VmmReclaimPagingStructures(&pPagingData->Data, &batch);
+            RecRwSpinlockReleaseExclusive(&pPagingData->Lock, oldState);
+        }
+
+        if (0 == unmappedSize)
+        {
+            break;
+        }
+    }
 }
 
 void
@@ -699,8 +837,6 @@ MmuReleaseMemory(
     IN          DWORD                   NoOfFrames
     )
 {
-    BOOLEAN bListEmpty;
-    INTR_STATE oldState;
     PMMU_ZERO_WORKER_ITEM pItem;
 
     LOG_FUNC_START_CPU;
@@ -708,7 +844,6 @@ MmuReleaseMemory(
     ASSERT( IsAddressAligned(PhysicalAddr, PAGE_SIZE ) );
     ASSERT( 0 != NoOfFrames );
 
-    bListEmpty = FALSE;
     pItem = NULL;
 
     pItem = _MmuAllocateFromPoolWithTag(MmuHeapIndexSpecial,
@@ -722,9 +857,7 @@ MmuReleaseMemory(
     pItem->PhysicalAddress = PhysicalAddr;
     pItem->NumberOfFrames = NoOfFrames;
 
-    LockAcquire(&m_mmuData.ZeroThreadData.PagesLock, &oldState );
-    InsertTailList(&m_mmuData.ZeroThreadData.PagesToZeroList, &pItem->ListEntry );
-    LockRelease(&m_mmuData.ZeroThreadData.PagesLock, oldState);
+    ClMpscQueuePush(&m_mmuData.ZeroThreadData.PagesToZeroQueue, &pItem->QueueEntry);
     pItem = NULL;
 
     LOG_TRACE_MMU("About to signal worker thread\n");
@@ -733,6 +866,60 @@ MmuReleaseMemory(
     LOG_FUNC_END_CPU;
 }
 
+PTR_SUCCESS
+PHYSICAL_ADDRESS
+MmuReserveZeroedFrames(
+    IN          DWORD                   NoOfFrames
+    )
+{
+    PMMU_ZERO_POOL pPool;
+    PMMU_ZERO_FRAME_RUN pRun;
+    PHYSICAL_ADDRESS pa;
+    INTR_STATE oldState;
+    BOOLEAN bRefill;
+
+    ASSERT( 0 != NoOfFrames );
+
+    pPool = &m_mmuData.ZeroThreadData.ZeroPool;
+    pa = NULL;
+
+    LockAcquire(&pPool->Lock, &oldState);
+
+    for (DWORD i = 0; i < pPool->NumberOfRuns; ++i)
+    {
+        pRun = &pPool->Runs[i];
+        if (pRun->NumberOfFrames < NoOfFrames)
+        {
+            continue;
+        }
+
+        // take the frames from the end of the run => its start stays the same
+        pRun->NumberOfFrames = pRun->NumberOfFrames - NoOfFrames;
+        pa = PtrOffset(pRun->PhysicalAddress, (QWORD) pRun->NumberOfFrames * PAGE_SIZE);
+
+        if (0 == pRun->NumberOfFrames)
+        {
+            pPool->NumberOfRuns = pPool->NumberOfRuns - 1;
+            *pRun = pPool->Runs[pPool->NumberOfRuns];
+        }
+
+        pPool->NumberOfFrames = pPool->NumberOfFrames - NoOfFrames;
+        break;
+    }
+
+    bRefill = pPool->NumberOfFrames < MMU_ZERO_POOL_LOW_FRAMES;
+
+    LockRelease(&pPool->Lock, oldState);
+
+    // the event is initialized before the worker is created
+    if (bRefill && NULL != m_mmuData.ZeroThreadData.WorkerThread)
+    {
+        ExEventSignal(&m_mmuData.ZeroThreadData.NewPagesEvent);
+    }
+
+    return pa;
+}
+
 PTR_SUCCESS
 PHYSICAL_ADDRESS
 MmuGetPhysicalAddress(
@@ -853,6 +1040,8 @@ MmuSolvePageFault(
 {
     PAGE_RIGHTS rightsRequested;
     PAGE_FAULT_ERR_CODE pfErrCode;
+    PTHREAD pThread;
+    PPAGING_LOCK_DATA pPagingData;
 
     ASSERT( INTR_OFF == CpuIntrGetState() );
 
@@ -862,9 +1051,24 @@ MmuSolvePageFault(
     rightsRequested |= ( pfErrCode.Write ? PAGE_RIGHTS_WRITE : 0 );
     rightsRequested |= ( pfErrCode.Execution ? PAGE_RIGHTS_EXECUTE : 0 );
 
+    pPagingData = &m_mmuData.PagingData;
+
+    // The kernel writing to the buffer of a user process (e.g. a syscall
+    // filling a variable in the .data section of the image) may find its
+    // pages still mapped to the zero frame or shared copy-on-write, these
+    // must be solved against the paging structures of the process
+    if (pfErrCode.Usermode || (QWORD) FaultingAddress < UM_SPACE_END)
+    {
+        pThread = GetCurrentThread();
+        if (NULL != pThread && NULL != pThread->Process)
+        {
+            pPagingData = pThread->Process->PagingData;
+        }
+    }
+
     return VmmSolvePageFault(FaultingAddress,
                              rightsRequested,
-                             pfErrCode.Usermode ? GetCurrentThread()->Process->PagingData : &m_mmuData.PagingData
+                             pPagingData
                              );
 }
 
@@ -890,9 +1094,12 @@ MmuLoadPe(
     status = STATUS_SUCCESS;
 
     RecRwSpinlockAcquireExclusive(&PagingData->Lock, &oldState);
+    // the frames belong to the image cache and are shared by all the
+    // processes running the application
     status = _MmuMapPeInMemory(&PagingData->Data,
                                NtHeader,
-                               NtHeader->Preferred.ImageBase);
+                               NtHeader->Preferred.ImageBase,
+                               TRUE);
     RecRwSpinlockReleaseExclusive(&PagingData->Lock, oldState);
 
     return status;
@@ -967,18 +1174,20 @@ MmuDestroyAddressSpaceForProcess(
 
     if (Process->PagingData != NULL)
     {
-        // NOTE: from what I've realized nothing bad can happen if an interrupt
-        // occurs while we change our paging tables to those of another process
-        // this change does not modify the current's thread owner process or its
-        // paging structures so the original paging structures will be used in the
-        // interrupt handlers
-
-        // invalidate all PCID mappings => new processes can reuse
-        // PCID
-        ProcessActivatePagingTables(Process, TRUE);
-
-        // restore previous paging table
-        ProcessActivatePagingTables(GetCurrentThread()->Process, FALSE);
+        // The PCIDs are not tied to the process: the CPUs which still have
+        // translations of these tables cached will never find their context
+        // ID again and flush the PCID when they give it to another address
+        // space => there is nothing to invalidate here.
+
+        // The swap slots of the process are released, the pager forgets its
+        // frames and they are freed, including the private copies of the
+        // image pages. The image frames belong to the image cache and the
+        // zero frame to the VMM, they are left alone.
+        MmuUnmapMemoryEx((PVOID) UM_SPACE_START,
+                         UM_SPACE_END - UM_SPACE_START,
+                         TRUE,
+                         Process->PagingData);
+        SwapUnregisterAddressSpace(Process->PagingData);
 
         _MmuDestroyPagingTables(Process->PagingData);
         Process->PagingData = NULL;
@@ -1175,6 +1384,11 @@ MmuGetSystemVirtualAddressForUserBuffer(
     STATUS status;
     PMDL pMdl;
     PVOID pKernelAddress;
+    PVOID pFirstPage;
+    PVOID pEnd;
+    BOOLEAN bWritable;
+    BOOLEAN bPinned;
+    INTR_STATE oldState;
 
     if (UserAddress == NULL)
     {
@@ -1196,19 +1410,70 @@ MmuGetSystemVirtualAddressForUserBuffer(
         return STATUS_INVALID_PARAMETER4;
     }
 
+    // the pages are brought in by accessing them
+    if (Process != GetCurrentProcess())
+    {
+        return STATUS_INVALID_PARAMETER3;
+    }
+
     status = STATUS_SUCCESS;
     pKernelAddress = NULL;
     ASSERT(Size <= MAX_DWORD);
 
     pMdl = NULL;
+    pFirstPage = (PVOID) AlignAddressLower(UserAddress, PAGE_SIZE);
+    pEnd = PtrOffset(UserAddress, Size);
+    bWritable = IsBooleanFlagOn(PageRights, PAGE_RIGHTS_WRITE);
 
     __try
     {
+        status = MmuIsBufferValid(UserAddress, Size, PageRights, Process);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("MmuIsBufferValid", status);
+            __leave;
+        }
+
+        // The kernel mapping uses the same frames => each page must be
+        // resident with a frame of its own if it will be written, and the
+        // pager must not evict it from under the kernel mapping. Both are
+        // checked while the paging lock is held, the page is accessed and
+        // checked again until they hold: the pager or another thread may
+        // change the page before the lock is taken.
+        for (PVOID pPage = pFirstPage; pPage < pEnd; pPage = PtrOffset(pPage, PAGE_SIZE))
+        {
+            // warning C4127: conditional expression is constant
+#pragma warning(suppress:4127)
+            while (TRUE)
+            {
+                RecRwSpinlockAcquireExclusive(&Process->PagingData->Lock, &oldState);
+                bPinned = VmmPinPage(&Process->PagingData->Data, pPage, bWritable);
+                RecRwSpinlockReleaseExclusive(&Process->PagingData->Lock, oldState);
+
+                if (bPinned)
+                {
+                    break;
+                }
+
+                if (bWritable)
+                {
+                    // a write which leaves the contents unchanged even if
+                    // the process writes the page at the same time, it
+                    // gives the page its own frame
+                    _InterlockedOr8((volatile char*) pPage, 0);
+                }
+                else
+                {
+                    (void) *(volatile BYTE*) pPage;
+                }
+            }
+        }
+
         pMdl = MdlAllocateEx(UserAddress,
                              (DWORD)Size,
                              NULL,
                              Process->PagingData);
-        if (!SUCCEEDED(status))
+        if (pMdl == NULL)
         {
             LOG_FUNC_ERROR_ALLOC("MdlAllocateEx", Size);
             status = STATUS_UNSUCCESSFUL;
@@ -1549,12 +1814,34 @@ _MmuRemapStack(
     return status;
 }
 
+__forceinline
+static
+PAGE_RIGHTS
+_MmuRetrieveImagePageRights(
+    IN          PAGE_RIGHTS             SectionRights,
+    IN          BOOLEAN                 SharedImage
+    )
+{
+    if (!SharedImage)
+    {
+        return SectionRights;
+    }
+
+    // writable pages of a shared image are copied on the first write, the
+    // code and read-only data are used directly from the shared frames which
+    // belong to the image cache
+    return IsBooleanFlagOn(SectionRights, PAGE_RIGHTS_WRITE)
+        ? SectionRights | VMM_PAGE_RIGHTS_COPY_ON_WRITE | VMM_PAGE_RIGHTS_SHARED_FRAME
+        : SectionRights | VMM_PAGE_RIGHTS_SHARED_FRAME;
+}
+
 static
 STATUS
 _MmuMapPeInMemory(
     IN          PPAGING_DATA            PagingData,
     IN          PPE_NT_HEADER_INFO      HeaderInfo,
-    IN          PVOID                   AddressToMap
+    IN          PVOID                   AddressToMap,
+    IN          BOOLEAN                 SharedImage
     )
 {
     STATUS status;
@@ -1603,9 +1890,10 @@ _MmuMapPeInMemory(
                              MmuGetPhysicalAddress(PtrOffset(HeaderInfo->ImageBase, PtrDiff(pHeaderPage, AddressToMap))),
                              PAGE_SIZE,
                              pHeaderPage,
-                             PAGE_RIGHTS_READ,
+                             _MmuRetrieveImagePageRights(PAGE_RIGHTS_READ, SharedImage),
                              TRUE,
-                             FALSE
+                             FALSE,
+                             NULL
                              );
     }
 
@@ -1689,9 +1977,10 @@ _MmuMapPeInMemory(
                                  MmuGetPhysicalAddress(PtrOffset(HeaderInfo->ImageBase, PtrDiff(pAlignedAddress,AddressToMap))),
                                  PAGE_SIZE,
                                  pAlignedAddress,
-                                 prevSectionRequiredRights | curSectionRequiredRights,
+                                 _MmuRetrieveImagePageRights(prevSectionRequiredRights | curSectionRequiredRights, SharedImage),
                                  TRUE,
-                                 FALSE
+                                 FALSE,
+                                 NULL
                                  );
 
             // advance to next page
@@ -1718,9 +2007,10 @@ _MmuMapPeInMemory(
                                  MmuGetPhysicalAddress(PtrOffset(HeaderInfo->ImageBase, PtrDiff(pPage,AddressToMap))),
                                  PAGE_SIZE,
                                  pPage,
-                                 curSectionRequiredRights,
+                                 _MmuRetrieveImagePageRights(curSectionRequiredRights, SharedImage),
                                  TRUE,
-                                 FALSE
+                                 FALSE,
+                                 NULL
                                  );
         }
 
@@ -1749,9 +2039,10 @@ _MmuMapPeInMemory(
                              MmuGetPhysicalAddress(PtrOffset(HeaderInfo->ImageBase, PtrDiff(pAlignedAddress, AddressToMap))),
                              PAGE_SIZE,
                              pAlignedAddress,
-                             prevSectionRequiredRights,
+                             _MmuRetrieveImagePageRights(prevSectionRequiredRights, SharedImage),
                              TRUE,
-                             FALSE
+                             FALSE,
+                             NULL
         );
     }
 
@@ -1789,7 +2080,7 @@ _MmuMapKernelMemory(
         return STATUS_PHYSICAL_MEMORY_NOT_AVAILABLE;
     }
 
-    status = _MmuMapPeInMemory(PagingData, KernelInfo, KernelInfo->ImageBase);
+    status = _MmuMapPeInMemory(PagingData, KernelInfo, KernelInfo->ImageBase, FALSE);
     if (!SUCCEEDED(status))
     {
         LOG_FUNC_ERROR("_MmuMapPeInMemory", status);
@@ -1799,7 +2090,7 @@ _MmuMapKernelMemory(
 
     // Perform identity mapping - needed by APs
     // Will be discarded after all the APs get in 64-bit mode
-    status = _MmuMapPeInMemory(PagingData, KernelInfo, VA2PA(KernelInfo->ImageBase));
+    status = _MmuMapPeInMemory(PagingData, KernelInfo, VA2PA(KernelInfo->ImageBase), FALSE);
     if (!SUCCEEDED(status))
     {
         LOG_FUNC_ERROR("_MmuMapPeInMemory", status);
@@ -1850,7 +2141,8 @@ _MmuReserveAndMapMemory(
                          VirtualAddress,
                          AccessRights,
                          TRUE,
-                         FALSE
+                         FALSE,
+                         NULL
                          );
 
     return STATUS_SUCCESS;
@@ -1966,7 +2258,8 @@ _MmuRemapDisplay(
                          (PVOID) PA2VA(BASE_VIDEO_ADDRESS),
                          PAGE_RIGHTS_READWRITE,
                          TRUE,
-                         FALSE
+                         FALSE,
+                         NULL
                          );
 }
 
@@ -1976,12 +2269,11 @@ _MmuZeroWorkerThreadFunction(
     IN_OPT      PVOID           Context
     )
 {
-    PLIST_ENTRY pListHead;
+    PCL_MPSC_QUEUE pQueue;
     STATUS status;
     PMMU_ZERO_WORKER_THREAD_CTX pCtx;
     PEX_EVENT pEvent;
-    PLIST_ENTRY pCurrentEntry;
-    PLOCK pLock;
+    PCL_SLIST_ENTRY pCurrentEntry;
 
     LOG_FUNC_START;
 
@@ -1991,15 +2283,12 @@ _MmuZeroWorkerThreadFunction(
     pCtx = (PMMU_ZERO_WORKER_THREAD_CTX) Context;
     pCurrentEntry = NULL;
 
-    pListHead = pCtx->PagesToZeroList;
-    ASSERT( NULL != pListHead );
+    pQueue = pCtx->PagesToZeroQueue;
+    ASSERT( NULL != pQueue );
 
     pEvent = pCtx->NewPagesEvent;
     ASSERT( NULL != pEvent );
 
-    pLock = pCtx->PagesLock;
-    ASSERT( NULL != pLock );
-
     ExFreePoolWithTag(pCtx, HEAP_MMU_TAG);
     pCtx = NULL;
 
@@ -2008,7 +2297,6 @@ _MmuZeroWorkerThreadFunction(
     while (TRUE)
     {
         PMMU_ZERO_WORKER_ITEM pItem;
-        INTR_STATE oldState;
         DWORD noOfBytes;
         PVOID pAddr;
 
@@ -2019,20 +2307,22 @@ _MmuZeroWorkerThreadFunction(
         // may use executive timer in the future
         ExEventWaitForSignal(pEvent);
 
-        LockAcquire(pLock, &oldState);
-        pCurrentEntry = RemoveHeadList(pListHead);
-        LockRelease(pLock, oldState);
-
-        if (pCurrentEntry == pListHead)
+        pCurrentEntry = ClMpscQueuePop(pQueue);
+        if (NULL == pCurrentEntry)
         {
-            // list is empty :(
+            // list is empty :( use the time to fill the pool of zero frames
+            if (_MmuRefillZeroPool())
+            {
+                continue;
+            }
+
             ExEventClearSignal(pEvent);
 
             // wait for another signal
             continue;
         }
 
-        pItem = CONTAINING_RECORD(pCurrentEntry, MMU_ZERO_WORKER_ITEM, ListEntry);
+        pItem = CONTAINING_RECORD(pCurrentEntry, MMU_ZERO_WORKER_ITEM, QueueEntry);
 
         noOfBytes = pItem->NumberOfFrames * PAGE_SIZE;
         pAddr = MmuMapMemoryEx(pItem->PhysicalAddress,
@@ -2045,14 +2335,20 @@ _MmuZeroWorkerThreadFunction(
         ASSERT( NULL != pAddr );
 
         // zero the memory, that's our job :)
-        memzero(pAddr, noOfBytes);
-
-        // truly release physical addresses
-        PmmReleaseMemory(pItem->PhysicalAddress, pItem->NumberOfFrames );
+        // the frames will most likely not be accessed until a page fault
+        // hands them out => there is no reason to bring them in the caches
+        memzeront(pAddr, noOfBytes);
 
         // it's ok, this does not release memory => no oo loop
         MmuUnmapSystemMemory(pAddr, noOfBytes);
 
+        // keep the frames for the next page faults if there is room in the
+        // pool, else truly release physical addresses
+        if (!_MmuAddToZeroPool(pItem->PhysicalAddress, pItem->NumberOfFrames))
+        {
+            PmmReleaseMemory(pItem->PhysicalAddress, pItem->NumberOfFrames );
+        }
+
         LOG("It comes here\n");
         _MmuFreeFromPoolWithTag(MmuHeapIndexSpecial, pItem, HEAP_MMU_TAG );
         pItem = NULL;
@@ -2073,4 +2369,85 @@ MmuChangeProcessSpace(
     ASSERT(Process != NULL);
 
     ProcessActivatePagingTables(Process, !m_mmuData.PcidSupportAvailable);
+}
+
+static
+BOOLEAN
+_MmuAddToZeroPool(
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      DWORD                   NumberOfFrames
+    )
+{
+    PMMU_ZERO_POOL pPool;
+    INTR_STATE oldState;
+    BOOLEAN bAdded;
+
+    ASSERT( NULL != PhysicalAddress );
+    ASSERT( 0 != NumberOfFrames );
+
+    pPool = &m_mmuData.ZeroThreadData.ZeroPool;
+    bAdded = FALSE;
+
+    LockAcquire(&pPool->Lock, &oldState);
+
+    if (pPool->NumberOfRuns < MMU_ZERO_POOL_MAX_RUNS &&
+        pPool->NumberOfFrames + NumberOfFrames <= MMU_ZERO_POOL_MAX_FRAMES)
+    {
+        pPool->Runs[pPool->NumberOfRuns].PhysicalAddress = PhysicalAddress;
+        pPool->Runs[pPool->NumberOfRuns].NumberOfFrames = NumberOfFrames;
+
+        pPool->NumberOfRuns = pPool->NumberOfRuns + 1;
+        pPool->NumberOfFrames = pPool->NumberOfFrames + NumberOfFrames;
+
+        bAdded = TRUE;
+    }
+
+    LockRelease(&pPool->Lock, oldState);
+
+    return bAdded;
+}
+
+static
+BOOLEAN
+_MmuRefillZeroPool(
+    void
+    )
+{
+    PHYSICAL_ADDRESS pa;
+    PVOID pAddr;
+    INTR_STATE oldState;
+    BOOLEAN bFull;
+
+    LockAcquire(&m_mmuData.ZeroThreadData.ZeroPool.Lock, &oldState);
+    bFull = (m_mmuData.ZeroThreadData.ZeroPool.NumberOfRuns == MMU_ZERO_POOL_MAX_RUNS) ||
+            (m_mmuData.ZeroThreadData.ZeroPool.NumberOfFrames + MMU_ZERO_POOL_REFILL_FRAMES > MMU_ZERO_POOL_MAX_FRAMES);
+    LockRelease(&m_mmuData.ZeroThreadData.ZeroPool.Lock, oldState);
+
+    if (bFull)
+    {
+        return FALSE;
+    }
+
+    pa = PmmReserveMemory(MMU_ZERO_POOL_REFILL_FRAMES);
+    if (NULL == pa)
+    {
+        // there is no point in keeping the last frames of the system aside
+        return FALSE;
+    }
+
+    pAddr = MmuMapSystemMemory(pa, MMU_ZERO_POOL_REFILL_FRAMES * PAGE_SIZE);
+    ASSERT( NULL != pAddr );
+
+    memzeront(pAddr, MMU_ZERO_POOL_REFILL_FRAMES * PAGE_SIZE);
+
+    MmuUnmapSystemMemory(pAddr, MMU_ZERO_POOL_REFILL_FRAMES * PAGE_SIZE);
+
+    // only the worker adds frames to the pool => there is still room
+    if (!_MmuAddToZeroPool(pa, MMU_ZERO_POOL_REFILL_FRAMES))
+    {
+        ASSERT(FALSE);
+        PmmReleaseMemory(pa, MMU_ZERO_POOL_REFILL_FRAMES);
+    }
+
+    return TRUE;
 }
\ No newline at end of file
@@ -1,6 +1,21 @@
 #include "HAL9000.h"
 #include "network_utils.h"
 
+#define IP4_VERSION                                 4
+#define IP4_MINIMUM_HEADER_LENGTH                   (IP4_PACKET_SIZE / sizeof(DWORD))
+
+#pragma pack(push,1)
+typedef struct _IP4_PSEUDO_HEADER
+{
+    IP4_ADDRESS             Source;
+    IP4_ADDRESS             Destination;
+    BYTE                    Zero;
+    IP_PROTOCOL             Protocol;
+    WORD                    Length;
+} IP4_PSEUDO_HEADER, *PIP4_PSEUDO_HEADER;
+STATIC_ASSERT(sizeof(IP4_PSEUDO_HEADER) == 12);
+#pragma pack(pop)
+
 char*
 NetUtilMacAddressToText(
     IN                                                          MAC_ADDRESS         Address,
@@ -40,4 +55,125 @@ NetUtilIp4AddressToText(
              );
 
     return Buffer;
+}
+
+WORD
+NetUtilIp4HeaderChecksum(
+    IN                                                          PIP4_PACKET         Header
+    )
+{
+    WORD sum;
+
+    ASSERT(NULL != Header);
+
+    // the length of the rest of the header would underflow and we would sum
+    // way past its end
+    if (Header->InternetHeaderLength < IP4_MINIMUM_HEADER_LENGTH)
+    {
+        return 0;
+    }
+
+    // checksum everything around the Checksum field, this way we don't need
+    // to modify the header
+    sum = memchecksum(Header,
+                      (DWORD) FIELD_OFFSET(IP4_PACKET, Checksum),
+                      0);
+    sum = memchecksum(PtrOffset(Header, FIELD_OFFSET(IP4_PACKET, Source)),
+                      (DWORD) (Header->InternetHeaderLength * sizeof(DWORD) - FIELD_OFFSET(IP4_PACKET, Source)),
+                      sum);
+
+    return CHECKSUM_FINALIZE(sum);
+}
+
+STATUS
+NetUtilIp4ParseHeader(
+    IN_READS_BYTES(BufferSize)                                  PIP4_PACKET         Header,
+    IN                                                          DWORD               BufferSize,
+    OUT_OPT                                                     DWORD*              HeaderLength,
+    OUT_OPT                                                     DWORD*              PayloadLength
+    )
+{
+    DWORD headerLength;
+    DWORD totalLength;
+
+    if (NULL == Header)
+    {
+        return STATUS_INVALID_PARAMETER1;
+    }
+
+    if (BufferSize < sizeof(IP4_PACKET))
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    if (IP4_VERSION != Header->Version ||
+        Header->InternetHeaderLength < IP4_MINIMUM_HEADER_LENGTH)
+    {
+        return STATUS_INVALID_BUFFER;
+    }
+
+    headerLength = Header->InternetHeaderLength * (DWORD) sizeof(DWORD);
+    totalLength = ntohw(Header->Length);
+
+    if (totalLength < headerLength)
+    {
+        return STATUS_INVALID_BUFFER;
+    }
+
+    if (totalLength > BufferSize)
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    // the ones-complement sum of a header including its checksum is 0xFFFF
+    if (0 != CHECKSUM_FINALIZE(memchecksum(Header, headerLength, 0)))
+    {
+        return STATUS_INVALID_BUFFER;
+    }
+
+    if (NULL != HeaderLength)
+    {
+        *HeaderLength = headerLength;
+    }
+
+    if (NULL != PayloadLength)
+    {
+        *PayloadLength = totalLength - headerLength;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+WORD
+NetUtilUdpChecksum(
+    IN                                                          PIP4_PACKET         Ip4Header,
+    IN_READS_BYTES(DatagramLength)                              PUDP_DATAGRAM       Datagram,
+    IN                                                          WORD                DatagramLength
+    )
+{
+    IP4_PSEUDO_HEADER pseudoHeader;
+    WORD sum;
+    WORD checksum;
+
+    ASSERT(NULL != Ip4Header);
+    ASSERT(NULL != Datagram);
+    ASSERT(DatagramLength >= sizeof(UDP_DATAGRAM));
+
+    pseudoHeader.Source = Ip4Header->Source;
+    pseudoHeader.Destination = Ip4Header->Destination;
+    pseudoHeader.Zero = 0;
+    pseudoHeader.Protocol = IP_PROTOCOL_UDP;
+    pseudoHeader.Length = htonw(DatagramLength);
+
+    sum = memchecksum(&pseudoHeader, sizeof(IP4_PSEUDO_HEADER), 0);
+    sum = memchecksum(Datagram, (DWORD) FIELD_OFFSET(UDP_DATAGRAM, Checksum), sum);
+    sum = memchecksum(PtrOffset(Datagram, sizeof(UDP_DATAGRAM)),
+                      DatagramLength - (DWORD) sizeof(UDP_DATAGRAM),
+                      sum);
+
+    checksum = CHECKSUM_FINALIZE(sum);
+
+    // RFC 768: a computed checksum of zero is transmitted as all ones,
+    // zero meaning that no checksum was generated
+    return (0 == checksum) ? MAX_WORD : checksum;
 }
\ No newline at end of file
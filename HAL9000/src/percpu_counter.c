@@ -0,0 +1,159 @@
+#include "HAL9000.h"
+#include "percpu_counter.h"
+#include "cpumu.h"
+#include "smp.h"
+
+typedef struct _PERCPU_COUNTER_DATA
+{
+    // number of handles given out, including PERCPU_COUNTER_UNREGISTERED, may
+    // go above PERCPU_MAX_COUNTERS if registrations failed
+    volatile DWORD          NumberOfCounters;
+
+    // NULL for PERCPU_COUNTER_UNREGISTERED and for the counters whose
+    // registration did not yet publish the name
+    const char* volatile    Names[PERCPU_MAX_COUNTERS];
+
+    volatile BOOLEAN        Enabled;
+} PERCPU_COUNTER_DATA, *PPERCPU_COUNTER_DATA;
+
+// statically initialized, counters are registered before the memory managers
+// are up
+static PERCPU_COUNTER_DATA m_perCpuCounterData = { PERCPU_COUNTER_UNREGISTERED + 1 };
+
+STATUS
+PerCpuCounterRegister(
+    IN_Z    const char*             Name,
+    OUT     PERCPU_COUNTER*         Counter
+    )
+{
+    DWORD index;
+
+    ASSERT(NULL != Name);
+    ASSERT(NULL != Counter);
+
+    *Counter = PERCPU_COUNTER_UNREGISTERED;
+
+    index = _InterlockedIncrement(&m_perCpuCounterData.NumberOfCounters) - 1;
+    if (index >= PERCPU_MAX_COUNTERS)
+    {
+        LOG_ERROR("No room for counter [%s], there are already %u counters\n", Name, PERCPU_MAX_COUNTERS);
+        return STATUS_LIMIT_REACHED;
+    }
+
+    // the PCPU values start zeroed and the unregistered updates went to
+    // PERCPU_COUNTER_UNREGISTERED => there is nothing to reset
+    m_perCpuCounterData.Names[index] = Name;
+    *Counter = index;
+
+    return STATUS_SUCCESS;
+}
+
+void
+PerCpuCounterEnable(
+    void
+    )
+{
+    m_perCpuCounterData.Enabled = TRUE;
+}
+
+void
+PerCpuCounterAdd(
+    IN      PERCPU_COUNTER          Counter,
+    IN      QWORD                   Value
+    )
+{
+    ASSERT(Counter < PERCPU_MAX_COUNTERS);
+
+    // GS is 0 until the BSP installs its PCPU
+    if (!m_perCpuCounterData.Enabled)
+    {
+        return;
+    }
+
+    // a single instruction => the thread can't be moved to another CPU nor
+    // can an interrupt handler update the same value in the middle of it
+    __addgsqword((DWORD) (FIELD_OFFSET(PCPU, Counters.Values) + Counter * sizeof(QWORD)), Value);
+}
+
+QWORD
+PerCpuCounterRead(
+    IN      PERCPU_COUNTER          Counter
+    )
+{
+    PLIST_ENTRY pCpuList;
+    QWORD sum;
+
+    ASSERT(Counter < PERCPU_MAX_COUNTERS);
+
+    sum = 0;
+
+    SmpGetCpuList(&pCpuList);
+
+    for (PLIST_ENTRY pEntry = pCpuList->Flink; pEntry != pCpuList; pEntry = pEntry->Flink)
+    {
+        PPCPU pCpu = CONTAINING_RECORD(pEntry, PCPU, ListEntry);
+
+        sum += PerCpuCounterReadForCpu(Counter, pCpu);
+    }
+
+    return sum;
+}
+
+QWORD
+PerCpuCounterReadForCpu(
+    IN      PERCPU_COUNTER          Counter,
+    IN      struct _PCPU*           Cpu
+    )
+{
+    ASSERT(Counter < PERCPU_MAX_COUNTERS);
+    ASSERT(NULL != Cpu);
+
+    return *(volatile QWORD*) &Cpu->Counters.Values[Counter];
+}
+
+PERCPU_COUNTER
+PerCpuCounterLookup(
+    IN_Z    const char*             Name
+    )
+{
+    DWORD noOfCounters;
+
+    ASSERT(NULL != Name);
+
+    noOfCounters = min(m_perCpuCounterData.NumberOfCounters, PERCPU_MAX_COUNTERS);
+
+    for (DWORD i = PERCPU_COUNTER_UNREGISTERED + 1; i < noOfCounters; ++i)
+    {
+        const char* pName = m_perCpuCounterData.Names[i];
+
+        if (NULL != pName && 0 == strcmp(pName, Name))
+        {
+            return i;
+        }
+    }
+
+    return PERCPU_COUNTER_UNREGISTERED;
+}
+
+void
+PerCpuCounterForEach(
+    IN      PFUNC_PerCpuCounterVisit    Function,
+    IN_OPT  PVOID                       Context
+    )
+{
+    DWORD noOfCounters;
+
+    ASSERT(NULL != Function);
+
+    noOfCounters = min(m_perCpuCounterData.NumberOfCounters, PERCPU_MAX_COUNTERS);
+
+    for (DWORD i = PERCPU_COUNTER_UNREGISTERED + 1; i < noOfCounters; ++i)
+    {
+        const char* pName = m_perCpuCounterData.Names[i];
+
+        if (NULL != pName)
+        {
+            Function(i, pName, Context);
+        }
+    }
+}
\ No newline at end of file
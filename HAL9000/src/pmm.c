@@ -10,6 +10,11 @@ typedef struct _MEMORY_REGION_LIST
     DWORD               NumberOfEntries;
 } MEMORY_REGION_LIST, *PMEMORY_REGION_LIST;
 
+#pragma warning(push)
+
+// warning C4324: structure was padded due to alignment specifier
+#pragma warning(disable:4324)
+
 typedef struct _PMM_DATA
 {
     // Both of the highest physical address values are setup on initialization and
@@ -32,11 +37,27 @@ typedef struct _PMM_DATA
 
     MEMORY_REGION_LIST  MemoryRegionList[MemoryMapTypeMax];
 
+    // The fields above are only read after initialization, the ones below
+    // are written on each allocation. The CPUs waiting for the lock keep
+    // reading its line while the holder updates the bitmap in the next one.
+    __declspec(align(CACHE_LINE_SIZE))
     LOCK                AllocationLock;
 
+    __declspec(align(CACHE_LINE_SIZE))
     _Guarded_by_(AllocationLock)
     BITMAP              AllocationBitmap;
+
+    // updated with the bitmap, read without the lock by the pager to decide
+    // when frames must be evicted
+    _Guarded_by_(AllocationLock)
+    volatile QWORD      FreeFrames;
 } PMM_DATA, *PPMM_DATA;
+STATIC_ASSERT(FIELD_OFFSET(PMM_DATA, AllocationLock) % CACHE_LINE_SIZE == 0);
+STATIC_ASSERT(FIELD_OFFSET(PMM_DATA, AllocationBitmap) % CACHE_LINE_SIZE == 0);
+STATIC_ASSERT(FIELD_OFFSET(PMM_DATA, MemoryRegionList) + sizeof(MEMORY_REGION_LIST) * MemoryMapTypeMax <= FIELD_OFFSET(PMM_DATA, AllocationLock));
+STATIC_ASSERT(FIELD_OFFSET(PMM_DATA, AllocationLock) + sizeof(LOCK) <= FIELD_OFFSET(PMM_DATA, AllocationBitmap));
+STATIC_ASSERT(FIELD_OFFSET(PMM_DATA, FreeFrames) + sizeof(QWORD) <= FIELD_OFFSET(PMM_DATA, AllocationBitmap) + CACHE_LINE_SIZE);
+#pragma warning(pop)
 
 static PMM_DATA m_pmmData;
 
@@ -171,12 +192,13 @@ PmmReserveMemoryEx(
     }
 
     LockAcquire( &m_pmmData.AllocationLock, &oldState);
-    idx = BitmapScanFromAndFlip(&m_pmmData.AllocationBitmap, (DWORD) startIdx, NoOfFrames, FALSE );
+    idx = BitmapScanNextFitAndFlip(&m_pmmData.AllocationBitmap, (DWORD) startIdx, NoOfFrames, FALSE );
     if (MAX_DWORD == idx)
     {
         LockRelease( &m_pmmData.AllocationLock, oldState);
         return NULL;
     }
+    m_pmmData.FreeFrames = m_pmmData.FreeFrames - NoOfFrames;
 
     LockRelease( &m_pmmData.AllocationLock, oldState);
 
@@ -200,6 +222,7 @@ PmmReleaseMemory(
 
     LockAcquire( &m_pmmData.AllocationLock, &oldState);
     BitmapClearBits(&m_pmmData.AllocationBitmap, (DWORD) index, NoOfFrames);
+    m_pmmData.FreeFrames = m_pmmData.FreeFrames + NoOfFrames;
     LockRelease( &m_pmmData.AllocationLock, oldState);
 }
 
@@ -211,6 +234,14 @@ PmmGetTotalSystemMemory(
     return m_pmmData.PhysicalMemorySize;
 }
 
+QWORD
+PmmGetNumberOfFreeFrames(
+    void
+    )
+{
+    return m_pmmData.FreeFrames;
+}
+
 PHYSICAL_ADDRESS
 PmmGetHighestPhysicalMemoryAddressPresent(
     void
@@ -324,6 +355,9 @@ _PmmInitializeAllocationBitmap(
 
     *SizeReserved = bitmapSize;
 
+    // a newly initialized bitmap has all the frames free
+    m_pmmData.FreeFrames = BitmapGetMaxElementCount(Bitmap);
+
     // The idea here is to reserve all possible physical memory
     // PA 0 ----> HighestMemoryAddress
     // and then mark as free only only usable RAM memory over 1MB
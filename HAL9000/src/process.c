@@ -34,7 +34,7 @@ _ProcessSystemRetrieveNextPid(
     PID idx;
 
     MutexAcquire(&m_processData.PidBitmapLock);
-    idx = BitmapScanAndFlip(&m_processData.PidBitmap, 1, FALSE);
+    idx = BitmapScanNextFitAndFlip(&m_processData.PidBitmap, 0, 1, FALSE);
     MutexRelease(&m_processData.PidBitmapLock);
 
     ASSERT(PCID_IS_VALID(idx));
@@ -120,6 +120,8 @@ ProcessSystemPreinit(
 
     MutexInit(&m_processData.ProcessListLock, FALSE);
     InitializeListHead(&m_processData.ProcessList);
+
+    UmApplicationPreinit();
 }
 
 _No_competing_thread_
@@ -193,13 +195,16 @@ ProcessActivatePagingTables(
     IN      BOOLEAN             InvalidateAddressSpace
     )
 {
+    INTR_STATE oldState;
+
     ASSERT(Process != NULL);
 
-    ASSERT(PCID_IS_VALID(Process->Id));
+    // the PCID is chosen by the CPU which loads the tables
+    oldState = CpuIntrDisable();
+
+    TlbActivateAddressSpace(&Process->PagingData->Data, InvalidateAddressSpace);
 
-    VmmChangeCr3(Process->PagingData->Data.BasePhysicalAddress,
-                 (PCID)Process->Id,
-                 InvalidateAddressSpace);
+    CpuIntrSetState(oldState);
 }
 
 STATUS
@@ -247,7 +252,7 @@ ProcessCreate(
         // This function must be called before MmuCreateAddressSpaceForProcess to be able to
         // determine the address from which the VA allocations should start (so they'll not
         // conflict with the PE image)
-        status = UmApplicationRetrieveHeader(PathToExe, pProcess->HeaderInfo);
+        status = UmApplicationRetrieveHeader(PathToExe, pProcess->HeaderInfo, &pProcess->Image);
         if (!SUCCEEDED(status))
         {
             LOG_FUNC_ERROR("UmApplicationRetrieveHeader", status);
@@ -740,6 +745,13 @@ _ProcessDestroy(
     // these memory addresses unconditionally
     MmuDestroyAddressSpaceForProcess(Process);
 
+    // the image frames are no longer mapped in the process
+    if (NULL != Process->Image)
+    {
+        UmApplicationReleaseImage(Process->Image);
+        Process->Image = NULL;
+    }
+
     if (Process->Id != 0)
     {
         // This should be done only after MmuDestroyVirtualSpaceForProcess, that
@@ -552,6 +552,74 @@ SmpSendGenericIpiEx(
     return status;
 }
 
+STATUS
+SmpProcessPendingIpcEvents(
+    IN_OPT  PFUNC_IpcProcessEvent   Function
+    )
+{
+    PCPU* pCpu;
+    INTR_STATE dummy;
+    PLIST_ENTRY pListEntry;
+    PIPC_EVENT_CPU pCpuEvent;
+    STATUS status;
+    STATUS eventStatus;
+    STATUS funcStatus;
+
+    ASSERT(INTR_OFF == CpuIntrGetState());
+
+    status = STATUS_SUCCESS;
+
+    pCpu = GetCurrentPcpu();
+    ASSERT( NULL != pCpu );
+
+    do
+    {
+        pCpuEvent = NULL;
+
+        LockAcquire(&pCpu->EventListLock, &dummy);
+        for (pListEntry = pCpu->EventList.Flink;
+             pListEntry != &pCpu->EventList;
+             pListEntry = pListEntry->Flink)
+        {
+            PIPC_EVENT_CPU pCandidate = CONTAINING_RECORD(pListEntry, IPC_EVENT_CPU, ListEntry);
+
+            if (NULL == Function || IpcGetEventFunction(pCandidate) == Function)
+            {
+                LOG_TRACE_CPU("Will remove event 0x%X from list at 0x%X\n", pCandidate, &pCpu->EventList);
+
+                ASSERT( pCpu->NoOfEventsInList > 0 );
+                RemoveEntryList(pListEntry);
+                pCpu->NoOfEventsInList--;
+
+                pCpuEvent = pCandidate;
+                break;
+            }
+        }
+        LockRelease(&pCpu->EventListLock, INTR_OFF);
+
+        if (NULL != pCpuEvent)
+        {
+            eventStatus = IpcProcessEvent(pCpuEvent, &funcStatus);
+            if (!SUCCEEDED(eventStatus))
+            {
+                LOG_FUNC_ERROR("IpcProcessEvent", eventStatus);
+            }
+            else if (!SUCCEEDED(funcStatus))
+            {
+                LOG_FUNC_ERROR("Event processing failed", funcStatus);
+                eventStatus = funcStatus;
+            }
+
+            if (SUCCEEDED(status))
+            {
+                status = eventStatus;
+            }
+        }
+    } while (NULL != pCpuEvent);
+
+    return status;
+}
+
 SAL_SUCCESS
 STATUS
 SmpCpuInit(
@@ -757,61 +825,18 @@ BOOLEAN
     IN        PDEVICE_OBJECT           Device
     )
 {
-    PCPU* pCpu;
-    INTR_STATE dummy;
-    PLIST_ENTRY pListEntry;
-    PIPC_EVENT_CPU pCpuEvent;
     STATUS status;
-    STATUS funcStatus;
 
     ASSERT(NULL != Device);
 
     LOG_FUNC_START;
 
-    pListEntry = NULL;
-    status = STATUS_SUCCESS;
-    pCpuEvent = NULL;
-
-    pCpu = GetCurrentPcpu();
-    ASSERT( NULL != pCpu );
+    // the events for which this interrupt was sent may have already been
+    // processed by SmpProcessPendingIpcEvents or by a previous interrupt =>
+    // finding no events is not an error
+    status = SmpProcessPendingIpcEvents(NULL);
 
-    LockAcquire(&pCpu->EventListLock, &dummy);
-    if (pCpu->NoOfEventsInList > 0)
-    {
-        LOG_TRACE_CPU("Will remove event from list at 0x%X\n", &pCpu->EventList);
-        pListEntry = RemoveHeadList(&pCpu->EventList);
-        ASSERT( pListEntry != &pCpu->EventList );
-        pCpu->NoOfEventsInList--;
-    }
-    LockRelease(&pCpu->EventListLock, INTR_OFF);
-
-    ASSERT(NULL != pListEntry);
-
-    pCpuEvent = CONTAINING_RECORD(pListEntry, IPC_EVENT_CPU, ListEntry);
-    LOG_TRACE_CPU("Removed element at 0x%X\n", pCpuEvent);
-
-    __try
-    {
-        status = IpcProcessEvent(pCpuEvent, &funcStatus);
-        if (!SUCCEEDED(status))
-        {
-            LOG_FUNC_ERROR("IpcProcessEvent", status);
-            __leave;
-        }
-
-        status = funcStatus;
-        if (!SUCCEEDED(status))
-        {
-            LOG_FUNC_ERROR("Event processing failed", status);
-            __leave;
-        }
-
-        pListEntry = NULL;
-    }
-    __finally
-    {
-        LOG_FUNC_END;
-    }
+    LOG_FUNC_END;
 
     return SUCCEEDED(status);
 }
\ No newline at end of file
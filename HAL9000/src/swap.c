@@ -0,0 +1,1038 @@
+#include "HAL9000.h"
+#include "swap.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "tlb.h"
+#include "io.h"
+#include "iomu.h"
+#include "cpumu.h"
+#include "synch.h"
+#include "thread.h"
+#include "ex_event.h"
+#include "ex_timer.h"
+#include "bitmap.h"
+
+// the pager is woken when fewer frames than the low watermark are free and
+// evicts pages until the high watermark is reached
+#define SWAP_LOW_WATERMARK_DIVISOR              64
+#define SWAP_MIN_LOW_WATERMARK                  64
+#define SWAP_HIGH_WATERMARK_FACTOR              2
+
+// number of pages evicted with a single TLB shootdown
+#define SWAP_WRITE_BATCH_PAGES                  16
+
+// while enabled the zero page scan looks at this many frames each period
+#define SWAP_ZERO_SCAN_PERIOD_US                (1 * SEC_IN_US)
+#define SWAP_ZERO_SCAN_FRAMES                   512
+
+// each CPU reads and writes the frames through its own page, selected by
+// its APIC ID
+#define SWAP_NO_OF_IO_WINDOWS                   (MAX_BYTE + 1)
+
+typedef struct _SWAP_FRAME_OWNER
+{
+    PPAGING_LOCK_DATA       PagingData;
+    PVOID                   VirtualAddress;
+} SWAP_FRAME_OWNER, *PSWAP_FRAME_OWNER;
+
+typedef struct _SWAP_PENDING_SLOT
+{
+    DWORD                   Slot;
+
+    // SwapReleaseSlot was called while the page was being written, the slot
+    // is freed once the batch completes so it is not reused by the batch
+    BOOLEAN                 Released;
+} SWAP_PENDING_SLOT, *PSWAP_PENDING_SLOT;
+
+typedef struct _SWAP_PENDING_WRITE
+{
+    DWORD                   Slot;
+    PHYSICAL_ADDRESS        Frame;
+    PVOID                   VirtualAddress;
+
+    // put back if the page cannot be written
+    PT_ENTRY                OriginalEntry;
+} SWAP_PENDING_WRITE, *PSWAP_PENDING_WRITE;
+
+// pages evicted from a single address space, not yet written
+typedef struct _SWAP_EVICTION_BATCH
+{
+    PPAGING_LOCK_DATA       PagingData;
+    TLB_SHOOTDOWN_BATCH     TlbBatch;
+
+    // the pages are only looked at for zero contents, the others are mapped
+    // back instead of being written
+    BOOLEAN                 MergeOnly;
+
+    DWORD                   NumberOfWrites;
+    SWAP_PENDING_WRITE      Writes[SWAP_WRITE_BATCH_PAGES];
+} SWAP_EVICTION_BATCH, *PSWAP_EVICTION_BATCH;
+
+typedef struct _SWAP_DATA
+{
+    // NULL if paging is disabled
+    PFILE_OBJECT            SwapFile;
+
+    PVOID                   IoWindows;
+
+    LOCK                    FramesLock;
+
+    // indexed by frame number, the owner of each evictable frame
+    _Guarded_by_(FramesLock)
+    PSWAP_FRAME_OWNER       Frames;
+    DWORD                   NumberOfFrames;
+
+    _Guarded_by_(FramesLock)
+    volatile DWORD          EvictableFrames;
+
+    // the address space from which the pager is evicting, it must not be
+    // destroyed until the pager is done with it
+    volatile PPAGING_LOCK_DATA  EvictingPagingData;
+
+    DWORD                   ClockHand;
+
+    LOCK                    SlotsLock;
+
+    _Guarded_by_(SlotsLock)
+    BITMAP                  SlotsBitmap;
+
+    _Guarded_by_(SlotsLock)
+    volatile DWORD          SlotsInUse;
+    DWORD                   NumberOfSlots;
+
+    // slots reserved by the pager which are not yet written, at most one
+    // more than the writes in the batch
+    _Guarded_by_(SlotsLock)
+    SWAP_PENDING_SLOT       PendingSlots[SWAP_WRITE_BATCH_PAGES];
+
+    _Guarded_by_(SlotsLock)
+    volatile DWORD          NumberOfPendingSlots;
+
+    QWORD                   LowWatermark;
+    QWORD                   HighWatermark;
+
+    EX_EVENT                PagerEvent;
+    PTHREAD                 PagerThread;
+
+    // notification event, signaled while the scan is enabled
+    EX_EVENT                ScanEnabledEvent;
+    volatile BOOLEAN        ZeroPageScanning;
+    volatile BOOLEAN        ZeroPageScanRequested;
+    PTHREAD                 ScannerThread;
+
+    volatile QWORD          PagesWritten;
+    volatile QWORD          PagesRead;
+    volatile QWORD          WriteErrors;
+    volatile QWORD          SecondChances;
+    volatile QWORD          ZeroPagesMerged;
+    volatile QWORD          PagerWakeups;
+} SWAP_DATA, *PSWAP_DATA;
+
+static SWAP_DATA m_swapData;
+
+static FUNC_ListFunction        _SwapFindSwapVolume;
+static FUNC_ThreadStart         _SwapPagerThreadFunction;
+static FUNC_ThreadStart         _SwapScannerThreadFunction;
+
+static
+PVOID
+_SwapMapIoWindow(
+    IN      PHYSICAL_ADDRESS        Frame
+    );
+
+static
+DWORD
+_SwapReserveSlot(
+    void
+    );
+
+static
+void
+_SwapCancelSlot(
+    IN      DWORD                   Slot
+    );
+
+static
+BOOLEAN
+_SwapIsPageZero(
+    IN      PVOID                   Page
+    );
+
+//******************************************************************************
+// Function:     _SwapEvictPages
+// Description:  Runs the CLOCK algorithm over the evictable frames until
+//               enough frames are free, every frame is looked at most twice.
+// Returns:      void
+// Parameter:    IN BOOLEAN MergeOnly - if TRUE SWAP_ZERO_SCAN_FRAMES frames
+//               are looked at, only the zero pages are taken out of memory
+//******************************************************************************
+static
+void
+_SwapEvictPages(
+    IN      BOOLEAN                 MergeOnly
+    );
+
+//******************************************************************************
+// Function:     _SwapWriteBatch
+// Description:  Invalidates the translations of the evicted pages, writes
+//               them to their slots and releases their frames. The pages
+//               which are all zero are mapped to the shared zero frame
+//               instead, the ones which could not be written are mapped back.
+// Returns:      void
+// Parameter:    INOUT PSWAP_EVICTION_BATCH Batch
+//******************************************************************************
+static
+void
+_SwapWriteBatch(
+    INOUT   PSWAP_EVICTION_BATCH    Batch
+    );
+
+_No_competing_thread_
+void
+SwapPreinit(
+    void
+    )
+{
+    memzero(&m_swapData, sizeof(SWAP_DATA));
+
+    LockInit(&m_swapData.FramesLock);
+    LockInit(&m_swapData.SlotsLock);
+}
+
+_No_competing_thread_
+STATUS
+SwapInit(
+    void
+    )
+{
+    STATUS status;
+    char swapDrive[4];
+    PFILE_OBJECT pSwapFile;
+    DWORD bitmapSize;
+    PBYTE pBitmapBuffer;
+    QWORD framesSize;
+    PSWAP_FRAME_OWNER pFrames;
+    PVOID pIoWindows;
+    PTHREAD pThread;
+    QWORD totalFrames;
+
+    status = STATUS_SUCCESS;
+    memzero(swapDrive, sizeof(swapDrive));
+    pSwapFile = NULL;
+    pBitmapBuffer = NULL;
+    pFrames = NULL;
+    pIoWindows = NULL;
+    pThread = NULL;
+
+    IomuExecuteForEachVpb(_SwapFindSwapVolume, swapDrive, FALSE);
+    if (swapDrive[0] == '\0')
+    {
+        LOG("No swap partition found, user pages will not be paged out\n");
+        return STATUS_SUCCESS;
+    }
+
+    __try
+    {
+        status = IoCreateFile(&pSwapFile, swapDrive, FALSE, FALSE, FALSE);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("IoCreateFile", status);
+            __leave;
+        }
+
+        m_swapData.NumberOfSlots = (DWORD) min(pSwapFile->FileSize / PAGE_SIZE, MAX_DWORD - 1);
+        if (0 == m_swapData.NumberOfSlots)
+        {
+            LOG_ERROR("Swap partition %s is smaller than a page\n", swapDrive);
+            status = STATUS_DEVICE_NOT_SUPPORTED;
+            __leave;
+        }
+
+        bitmapSize = BitmapPreinit(&m_swapData.SlotsBitmap, m_swapData.NumberOfSlots);
+
+        pBitmapBuffer = ExAllocatePoolWithTag(0, bitmapSize, HEAP_SWAP_TAG, 0);
+        if (NULL == pBitmapBuffer)
+        {
+            LOG_FUNC_ERROR_ALLOC("ExAllocatePoolWithTag", bitmapSize);
+            status = STATUS_HEAP_INSUFFICIENT_RESOURCES;
+            __leave;
+        }
+
+        BitmapInit(&m_swapData.SlotsBitmap, pBitmapBuffer);
+
+        // the reverse map must never be paged out, it is allocated up front
+        m_swapData.NumberOfFrames = (DWORD) (PmmGetHighestPhysicalMemoryAddressAvailable() / PAGE_SIZE);
+        framesSize = (QWORD) m_swapData.NumberOfFrames * sizeof(SWAP_FRAME_OWNER);
+
+        pFrames = VmmAllocRegion(NULL,
+                                 framesSize,
+                                 VMM_ALLOC_TYPE_RESERVE | VMM_ALLOC_TYPE_COMMIT | VMM_ALLOC_TYPE_NOT_LAZY,
+                                 PAGE_RIGHTS_READWRITE);
+        if (NULL == pFrames)
+        {
+            LOG_FUNC_ERROR_ALLOC("VmmAllocRegion", framesSize);
+            status = STATUS_MEMORY_CANNOT_BE_COMMITED;
+            __leave;
+        }
+
+        pIoWindows = VmmAllocRegion(NULL,
+                                    SWAP_NO_OF_IO_WINDOWS * PAGE_SIZE,
+                                    VMM_ALLOC_TYPE_RESERVE,
+                                    PAGE_RIGHTS_READWRITE);
+        if (NULL == pIoWindows)
+        {
+            LOG_FUNC_ERROR_ALLOC("VmmAllocRegion", SWAP_NO_OF_IO_WINDOWS * PAGE_SIZE);
+            status = STATUS_MEMORY_CANNOT_BE_RESERVED;
+            __leave;
+        }
+
+        // build the page tables of the windows now, when a window is needed
+        // there may be no frame left for them, the windows themselves stay
+        // not present until they are used
+        MmuPreparePagingStructures(pIoWindows, SWAP_NO_OF_IO_WINDOWS * PAGE_SIZE);
+
+        totalFrames = PmmGetTotalSystemMemory() / PAGE_SIZE;
+        m_swapData.LowWatermark = max(totalFrames / SWAP_LOW_WATERMARK_DIVISOR, SWAP_MIN_LOW_WATERMARK);
+        m_swapData.HighWatermark = m_swapData.LowWatermark * SWAP_HIGH_WATERMARK_FACTOR;
+
+        status = ExEventInit(&m_swapData.PagerEvent, ExEventTypeSynchronization, FALSE);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("ExEventInit", status);
+            __leave;
+        }
+
+        status = ExEventInit(&m_swapData.ScanEnabledEvent, ExEventTypeNotification, FALSE);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("ExEventInit", status);
+            __leave;
+        }
+
+        m_swapData.Frames = pFrames;
+        m_swapData.IoWindows = pIoWindows;
+
+        status = ThreadCreate("Pager Thread",
+                              ThreadPriorityMaximum,
+                              _SwapPagerThreadFunction,
+                              NULL,
+                              &pThread
+        );
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("ThreadCreate", status);
+            __leave;
+        }
+
+        m_swapData.PagerThread = pThread;
+
+        status = ThreadCreate("Zero Page Scanner",
+                              ThreadPriorityLowest,
+                              _SwapScannerThreadFunction,
+                              NULL,
+                              &pThread
+        );
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("ThreadCreate", status);
+            __leave;
+        }
+
+        m_swapData.ScannerThread = pThread;
+
+        // from now on frames are registered
+        m_swapData.SwapFile = pSwapFile;
+
+        LOG("Paging to %s, %u slots, watermarks %U/%U frames\n",
+            swapDrive, m_swapData.NumberOfSlots, m_swapData.LowWatermark, m_swapData.HighWatermark);
+    }
+    __finally
+    {
+        if (!SUCCEEDED(status))
+        {
+            m_swapData.Frames = NULL;
+            m_swapData.IoWindows = NULL;
+
+            if (NULL != pIoWindows)
+            {
+                VmmFreeRegion(pIoWindows, 0, VMM_FREE_TYPE_RELEASE);
+                pIoWindows = NULL;
+            }
+
+            if (NULL != pFrames)
+            {
+                VmmFreeRegion(pFrames, 0, VMM_FREE_TYPE_RELEASE);
+                pFrames = NULL;
+            }
+
+            if (NULL != pBitmapBuffer)
+            {
+                ExFreePoolWithTag(pBitmapBuffer, HEAP_SWAP_TAG);
+                pBitmapBuffer = NULL;
+            }
+
+            if (NULL != pSwapFile)
+            {
+                IoCloseFile(pSwapFile);
+                pSwapFile = NULL;
+            }
+        }
+    }
+
+    return status;
+}
+
+void
+SwapRegisterFrame(
+    IN      PHYSICAL_ADDRESS        Frame,
+    IN      PPAGING_LOCK_DATA       PagingData,
+    IN      PVOID                   VirtualAddress
+    )
+{
+    QWORD index;
+    INTR_STATE oldState;
+
+    ASSERT(PagingData != NULL);
+    ASSERT(!PagingData->Data.KernelSpace);
+
+    if (NULL == m_swapData.SwapFile)
+    {
+        return;
+    }
+
+    index = (QWORD) Frame / PAGE_SIZE;
+    ASSERT(index < m_swapData.NumberOfFrames);
+
+    LockAcquire(&m_swapData.FramesLock, &oldState);
+    ASSERT(NULL == m_swapData.Frames[index].PagingData);
+
+    m_swapData.Frames[index].PagingData = PagingData;
+    m_swapData.Frames[index].VirtualAddress = VirtualAddress;
+    m_swapData.EvictableFrames++;
+    LockRelease(&m_swapData.FramesLock, oldState);
+}
+
+void
+SwapUnregisterFrame(
+    IN      PHYSICAL_ADDRESS        Frame
+    )
+{
+    QWORD index;
+    INTR_STATE oldState;
+
+    if (NULL == m_swapData.SwapFile)
+    {
+        return;
+    }
+
+    index = (QWORD) Frame / PAGE_SIZE;
+    if (index >= m_swapData.NumberOfFrames)
+    {
+        return;
+    }
+
+    LockAcquire(&m_swapData.FramesLock, &oldState);
+    if (NULL != m_swapData.Frames[index].PagingData)
+    {
+        m_swapData.Frames[index].PagingData = NULL;
+        m_swapData.Frames[index].VirtualAddress = NULL;
+        m_swapData.EvictableFrames--;
+    }
+    LockRelease(&m_swapData.FramesLock, oldState);
+}
+
+void
+SwapUnregisterAddressSpace(
+    IN      PPAGING_LOCK_DATA       PagingData
+    )
+{
+    ASSERT(PagingData != NULL);
+
+    while (m_swapData.EvictingPagingData == PagingData)
+    {
+        ThreadYield();
+    }
+}
+
+SAL_SUCCESS
+STATUS
+SwapReadPage(
+    IN      DWORD                   Slot,
+    IN      PHYSICAL_ADDRESS        Frame
+    )
+{
+    STATUS status;
+    INTR_STATE oldState;
+    BOOLEAN bPending;
+    QWORD offset;
+    QWORD bytesRead;
+    PVOID pWindow;
+
+    ASSERT(NULL != m_swapData.SwapFile);
+    ASSERT(Slot < m_swapData.NumberOfSlots);
+
+    bPending = FALSE;
+    offset = (QWORD) Slot * PAGE_SIZE;
+    bytesRead = 0;
+
+    LockAcquire(&m_swapData.SlotsLock, &oldState);
+    for (DWORD i = 0; i < m_swapData.NumberOfPendingSlots; ++i)
+    {
+        if (m_swapData.PendingSlots[i].Slot == Slot && !m_swapData.PendingSlots[i].Released)
+        {
+            bPending = TRUE;
+            break;
+        }
+    }
+    LockRelease(&m_swapData.SlotsLock, oldState);
+
+    if (bPending)
+    {
+        return STATUS_DEVICE_BUSY;
+    }
+
+    oldState = CpuIntrDisable();
+    pWindow = _SwapMapIoWindow(Frame);
+    status = IoReadFile(m_swapData.SwapFile, PAGE_SIZE, &offset, pWindow, &bytesRead);
+    CpuIntrSetState(oldState);
+
+    if (SUCCEEDED(status) && PAGE_SIZE != bytesRead)
+    {
+        status = STATUS_UNSUCCESSFUL;
+    }
+
+    if (SUCCEEDED(status))
+    {
+        _InterlockedIncrement64(&m_swapData.PagesRead);
+    }
+
+    return status;
+}
+
+void
+SwapReleaseSlot(
+    IN      DWORD                   Slot
+    )
+{
+    INTR_STATE oldState;
+    BOOLEAN bPending;
+
+    if (NULL == m_swapData.SwapFile)
+    {
+        return;
+    }
+
+    ASSERT(Slot < m_swapData.NumberOfSlots);
+
+    bPending = FALSE;
+
+    LockAcquire(&m_swapData.SlotsLock, &oldState);
+    for (DWORD i = 0; i < m_swapData.NumberOfPendingSlots; ++i)
+    {
+        if (m_swapData.PendingSlots[i].Slot == Slot)
+        {
+            ASSERT(!m_swapData.PendingSlots[i].Released);
+
+            m_swapData.PendingSlots[i].Released = TRUE;
+            bPending = TRUE;
+            break;
+        }
+    }
+
+    if (!bPending)
+    {
+        BitmapClearBit(&m_swapData.SlotsBitmap, Slot);
+        m_swapData.SlotsInUse--;
+    }
+    LockRelease(&m_swapData.SlotsLock, oldState);
+}
+
+void
+SwapNotifyFramesReserved(
+    void
+    )
+{
+    if (NULL == m_swapData.SwapFile)
+    {
+        return;
+    }
+
+    if (PmmGetNumberOfFreeFrames() < m_swapData.LowWatermark)
+    {
+        ExEventSignal(&m_swapData.PagerEvent);
+    }
+}
+
+BOOLEAN
+SwapRequestFrames(
+    void
+    )
+{
+    if (NULL == m_swapData.SwapFile)
+    {
+        return FALSE;
+    }
+
+    // the frames of the pages being written are released soon, else there
+    // must be something to evict and room to evict it to
+    if (0 == m_swapData.NumberOfPendingSlots &&
+        (0 == m_swapData.EvictableFrames || m_swapData.SlotsInUse >= m_swapData.NumberOfSlots))
+    {
+        return FALSE;
+    }
+
+    ExEventSignal(&m_swapData.PagerEvent);
+
+    return TRUE;
+}
+
+BOOLEAN
+SwapSetZeroPageScanning(
+    IN      BOOLEAN                 Enable
+    )
+{
+    BOOLEAN bPrevious;
+
+    bPrevious = (BOOLEAN) _InterlockedExchange8((volatile char*) &m_swapData.ZeroPageScanning, Enable);
+
+    if (NULL != m_swapData.SwapFile)
+    {
+        if (Enable)
+        {
+            ExEventSignal(&m_swapData.ScanEnabledEvent);
+        }
+        else
+        {
+            ExEventClearSignal(&m_swapData.ScanEnabledEvent);
+        }
+    }
+
+    return bPrevious;
+}
+
+void
+SwapGetStatistics(
+    OUT     PSWAP_STATISTICS        Statistics
+    )
+{
+    ASSERT(Statistics != NULL);
+
+    Statistics->Enabled = (NULL != m_swapData.SwapFile);
+    Statistics->NumberOfSlots = m_swapData.NumberOfSlots;
+    Statistics->SlotsInUse = m_swapData.SlotsInUse;
+    Statistics->EvictableFrames = m_swapData.EvictableFrames;
+    Statistics->PagesWritten = m_swapData.PagesWritten;
+    Statistics->PagesRead = m_swapData.PagesRead;
+    Statistics->WriteErrors = m_swapData.WriteErrors;
+    Statistics->SecondChances = m_swapData.SecondChances;
+    Statistics->ZeroPagesMerged = m_swapData.ZeroPagesMerged;
+    Statistics->PagerWakeups = m_swapData.PagerWakeups;
+}
+
+static
+STATUS
+(__cdecl _SwapFindSwapVolume)(
+    IN      PLIST_ENTRY     ListEntry,
+    IN_OPT  PVOID           FunctionContext
+    )
+{
+    PVPB pVpb;
+    char* swapDrive;
+
+    ASSERT(ListEntry != NULL);
+    ASSERT(FunctionContext != NULL);
+
+    pVpb = CONTAINING_RECORD(ListEntry, VPB, NextVpb);
+    swapDrive = (char*) FunctionContext;
+
+    if (swapDrive[0] == '\0' && pVpb->Flags.Mounted && pVpb->Flags.SwapSpace)
+    {
+        snprintf(swapDrive, 4, "%c:\\", pVpb->VolumeLetter);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+STATUS
+_SwapPagerThreadFunction(
+    IN_OPT      PVOID           Context
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    // warning C4127: conditional expression is constant
+#pragma warning(suppress:4127)
+    while (TRUE)
+    {
+        ExEventWaitForSignal(&m_swapData.PagerEvent);
+
+        _InterlockedIncrement64(&m_swapData.PagerWakeups);
+
+        // freeing memory always comes first, the zero pages are merged on
+        // the way
+        if (PmmGetNumberOfFreeFrames() < m_swapData.HighWatermark)
+        {
+            _SwapEvictPages(FALSE);
+        }
+        else if (_InterlockedExchange8((volatile char*) &m_swapData.ZeroPageScanRequested, FALSE))
+        {
+            _SwapEvictPages(TRUE);
+        }
+    }
+
+    NOT_REACHED;
+
+    return STATUS_SUCCESS;
+}
+
+static
+STATUS
+_SwapScannerThreadFunction(
+    IN_OPT      PVOID           Context
+    )
+{
+    EX_TIMER timer;
+    STATUS status;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    // warning C4127: conditional expression is constant
+#pragma warning(suppress:4127)
+    while (TRUE)
+    {
+        ExEventWaitForSignal(&m_swapData.ScanEnabledEvent);
+
+        status = ExTimerInit(&timer, ExTimerTypeRelativeOnce, SWAP_ZERO_SCAN_PERIOD_US);
+        ASSERT(SUCCEEDED(status));
+
+        ExTimerStart(&timer);
+        ExTimerWait(&timer);
+        ExTimerUninit(&timer);
+
+        if (m_swapData.ZeroPageScanning)
+        {
+            // the pager does the scan, it owns the pending slots
+            m_swapData.ZeroPageScanRequested = TRUE;
+            ExEventSignal(&m_swapData.PagerEvent);
+        }
+    }
+
+    NOT_REACHED;
+
+    return STATUS_SUCCESS;
+}
+
+static
+PVOID
+_SwapMapIoWindow(
+    IN      PHYSICAL_ADDRESS        Frame
+    )
+{
+    PVOID pWindow;
+
+    ASSERT(INTR_OFF == CpuIntrGetState());
+
+    pWindow = PtrOffset(m_swapData.IoWindows, (QWORD) GetCurrentPcpu()->ApicId * PAGE_SIZE);
+
+    MmuMapCpuLocalPage(Frame, pWindow);
+
+    return pWindow;
+}
+
+static
+BOOLEAN
+_SwapIsPageZero(
+    IN      PVOID                   Page
+    )
+{
+    QWORD* pQwords;
+
+    pQwords = (QWORD*) Page;
+
+    for (DWORD i = 0; i < PAGE_SIZE / sizeof(QWORD); ++i)
+    {
+        if (0 != pQwords[i])
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static
+DWORD
+_SwapReserveSlot(
+    void
+    )
+{
+    DWORD slot;
+    INTR_STATE oldState;
+
+    LockAcquire(&m_swapData.SlotsLock, &oldState);
+    ASSERT(m_swapData.NumberOfPendingSlots < SWAP_WRITE_BATCH_PAGES);
+
+    slot = BitmapScanNextFitAndFlip(&m_swapData.SlotsBitmap, 0, 1, FALSE);
+    if (MAX_DWORD != slot)
+    {
+        m_swapData.SlotsInUse++;
+
+        m_swapData.PendingSlots[m_swapData.NumberOfPendingSlots].Slot = slot;
+        m_swapData.PendingSlots[m_swapData.NumberOfPendingSlots].Released = FALSE;
+        m_swapData.NumberOfPendingSlots++;
+    }
+    LockRelease(&m_swapData.SlotsLock, oldState);
+
+    return (MAX_DWORD == slot) ? SWAP_INVALID_SLOT : slot;
+}
+
+static
+void
+_SwapCancelSlot(
+    IN      DWORD                   Slot
+    )
+{
+    INTR_STATE oldState;
+    DWORD last;
+
+    LockAcquire(&m_swapData.SlotsLock, &oldState);
+    ASSERT(m_swapData.NumberOfPendingSlots > 0);
+
+    // the page never referred to the slot, it is always the last one reserved
+    last = m_swapData.NumberOfPendingSlots - 1;
+    ASSERT(m_swapData.PendingSlots[last].Slot == Slot);
+    ASSERT(!m_swapData.PendingSlots[last].Released);
+
+    m_swapData.NumberOfPendingSlots = last;
+
+    BitmapClearBit(&m_swapData.SlotsBitmap, Slot);
+    m_swapData.SlotsInUse--;
+    LockRelease(&m_swapData.SlotsLock, oldState);
+}
+
+static
+void
+_SwapEvictPages(
+    IN      BOOLEAN                 MergeOnly
+    )
+{
+    SWAP_EVICTION_BATCH batch;
+    SWAP_FRAME_OWNER owner;
+    INTR_STATE oldState;
+    INTR_STATE framesState;
+    DWORD index;
+    DWORD slot;
+    PHYSICAL_ADDRESS frame;
+    VMM_EVICT_RESULT result;
+    PT_ENTRY originalEntry;
+
+    batch.PagingData = NULL;
+    batch.NumberOfWrites = 0;
+    batch.MergeOnly = MergeOnly;
+
+    for (QWORD framesScanned = 0;
+         MergeOnly ? (framesScanned < SWAP_ZERO_SCAN_FRAMES) :
+                     (framesScanned < 2 * (QWORD) m_swapData.NumberOfFrames &&
+                      PmmGetNumberOfFreeFrames() + batch.NumberOfWrites < m_swapData.HighWatermark);
+         ++framesScanned)
+    {
+        index = m_swapData.ClockHand;
+        m_swapData.ClockHand = (index + 1) % m_swapData.NumberOfFrames;
+
+        LockAcquire(&m_swapData.FramesLock, &oldState);
+        owner = m_swapData.Frames[index];
+        if (NULL != owner.PagingData && NULL == batch.PagingData)
+        {
+            // set while the frame is still registered, the address space
+            // cannot be destroyed until the batch is written
+            m_swapData.EvictingPagingData = owner.PagingData;
+        }
+        LockRelease(&m_swapData.FramesLock, oldState);
+
+        if (NULL == owner.PagingData)
+        {
+            continue;
+        }
+
+        if (NULL != batch.PagingData && owner.PagingData != batch.PagingData)
+        {
+            // a batch holds the pages of a single address space, the frame is
+            // looked at again once the batch is written
+            _SwapWriteBatch(&batch);
+            m_swapData.ClockHand = index;
+            continue;
+        }
+
+        if (NULL == batch.PagingData)
+        {
+            batch.PagingData = owner.PagingData;
+            TlbBatchInit(&batch.TlbBatch, &owner.PagingData->Data);
+        }
+
+        slot = _SwapReserveSlot();
+        if (SWAP_INVALID_SLOT == slot)
+        {
+            LOG_TRACE_MMU("No swap slot left\n");
+            break;
+        }
+
+        frame = (PHYSICAL_ADDRESS) ((QWORD) index * PAGE_SIZE);
+        result = VmmEvictStale;
+
+        RecRwSpinlockAcquireExclusive(&owner.PagingData->Lock, &oldState);
+        LockAcquire(&m_swapData.FramesLock, &framesState);
+        if (m_swapData.Frames[index].PagingData == owner.PagingData &&
+            m_swapData.Frames[index].VirtualAddress == owner.VirtualAddress)
+        {
+            result = VmmEvictPage(&owner.PagingData->Data,
+                                  owner.VirtualAddress,
+                                  frame,
+                                  slot,
+                                  &batch.TlbBatch,
+                                  &originalEntry);
+            if (VmmEvictReferenced != result)
+            {
+                m_swapData.Frames[index].PagingData = NULL;
+                m_swapData.Frames[index].VirtualAddress = NULL;
+                m_swapData.EvictableFrames--;
+            }
+        }
+        LockRelease(&m_swapData.FramesLock, framesState);
+        RecRwSpinlockReleaseExclusive(&owner.PagingData->Lock, oldState);
+
+        if (VmmEvictDone != result)
+        {
+            if (VmmEvictReferenced == result)
+            {
+                _InterlockedIncrement64(&m_swapData.SecondChances);
+            }
+
+            _SwapCancelSlot(slot);
+            continue;
+        }
+
+        batch.Writes[batch.NumberOfWrites].Slot = slot;
+        batch.Writes[batch.NumberOfWrites].Frame = frame;
+        batch.Writes[batch.NumberOfWrites].VirtualAddress = owner.VirtualAddress;
+        batch.Writes[batch.NumberOfWrites].OriginalEntry = originalEntry;
+        batch.NumberOfWrites++;
+
+        if (SWAP_WRITE_BATCH_PAGES == batch.NumberOfWrites)
+        {
+            _SwapWriteBatch(&batch);
+        }
+    }
+
+    if (NULL != batch.PagingData)
+    {
+        _SwapWriteBatch(&batch);
+    }
+    else
+    {
+        m_swapData.EvictingPagingData = NULL;
+    }
+}
+
+static
+void
+_SwapWriteBatch(
+    INOUT   PSWAP_EVICTION_BATCH    Batch
+    )
+{
+    STATUS status;
+    INTR_STATE oldState;
+    PSWAP_PENDING_WRITE pWrite;
+    QWORD offset;
+    QWORD bytesWritten;
+    PVOID pWindow;
+    BOOLEAN bZero;
+    BOOLEAN bRestored;
+
+    ASSERT(Batch != NULL);
+    ASSERT(Batch->PagingData != NULL);
+
+    // once the flush completes no CPU can modify the pages any longer
+    TlbBatchFlush(&Batch->TlbBatch);
+
+    for (DWORD i = 0; i < Batch->NumberOfWrites; ++i)
+    {
+        pWrite = &Batch->Writes[i];
+        offset = (QWORD) pWrite->Slot * PAGE_SIZE;
+        bytesWritten = 0;
+        status = STATUS_SUCCESS;
+
+        oldState = CpuIntrDisable();
+        pWindow = _SwapMapIoWindow(pWrite->Frame);
+        bZero = _SwapIsPageZero(pWindow);
+        if (!bZero && !Batch->MergeOnly)
+        {
+            status = IoWriteFile(m_swapData.SwapFile, PAGE_SIZE, &offset, pWindow, &bytesWritten);
+            if (SUCCEEDED(status) && PAGE_SIZE != bytesWritten)
+            {
+                status = STATUS_UNSUCCESSFUL;
+            }
+        }
+        CpuIntrSetState(oldState);
+
+        if (!bZero && !Batch->MergeOnly)
+        {
+            if (SUCCEEDED(status))
+            {
+                _InterlockedIncrement64(&m_swapData.PagesWritten);
+                PmmReleaseMemory(pWrite->Frame, 1);
+                continue;
+            }
+
+            LOG_FUNC_ERROR("IoWriteFile", status);
+            _InterlockedIncrement64(&m_swapData.WriteErrors);
+        }
+
+        // Zero pages need no slot, they go back to the zero frame. The frame
+        // of the other ones still holds the page, it is mapped back. Nothing
+        // is done if the page was unmapped in the meantime.
+        RecRwSpinlockAcquireExclusive(&Batch->PagingData->Lock, &oldState);
+        bRestored = VmmRestoreEvictedPage(&Batch->PagingData->Data,
+                                          pWrite->VirtualAddress,
+                                          pWrite->Slot,
+                                          pWrite->OriginalEntry,
+                                          bZero);
+        if (bRestored)
+        {
+            SwapReleaseSlot(pWrite->Slot);
+
+            if (!bZero)
+            {
+                SwapRegisterFrame(pWrite->Frame, Batch->PagingData, pWrite->VirtualAddress);
+            }
+        }
+        RecRwSpinlockReleaseExclusive(&Batch->PagingData->Lock, oldState);
+
+        if (bRestored && bZero)
+        {
+            _InterlockedIncrement64(&m_swapData.ZeroPagesMerged);
+        }
+
+        if (!bRestored || bZero)
+        {
+            PmmReleaseMemory(pWrite->Frame, 1);
+        }
+    }
+
+    LockAcquire(&m_swapData.SlotsLock, &oldState);
+    for (DWORD i = 0; i < m_swapData.NumberOfPendingSlots; ++i)
+    {
+        if (m_swapData.PendingSlots[i].Released)
+        {
+            BitmapClearBit(&m_swapData.SlotsBitmap, m_swapData.PendingSlots[i].Slot);
+            m_swapData.SlotsInUse--;
+        }
+    }
+    m_swapData.NumberOfPendingSlots = 0;
+    LockRelease(&m_swapData.SlotsLock, oldState);
+
+    Batch->PagingData = NULL;
+    Batch->NumberOfWrites = 0;
+
+    m_swapData.EvictingPagingData = NULL;
+}
\ No newline at end of file
@@ -21,6 +21,7 @@
 #include "ex_system.h"
 #include "process_internal.h"
 #include "boot_module.h"
+#include "swap.h"
 
 #define NO_OF_TSS_STACKS             7
 STATIC_ASSERT(NO_OF_TSS_STACKS <= NO_OF_IST);
@@ -50,6 +51,7 @@ SystemPreinit(
     LogSystemPreinit();
     OsInfoPreinit();
     MmuPreinitSystem();
+    SwapPreinit();
     IomuPreinitSystem();
     AcpiInterfacePreinit();
     SmpPreinit();
@@ -301,6 +303,16 @@ SystemInit(
 
     LOGL("IOMU late initialization successfully completed\n");
 
+    // the swap partition is known only after the file systems are mounted
+    status = SwapInit();
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("SwapInit", status);
+        return status;
+    }
+
+    LOGL("SwapInit succeeded\n");
+
     status = NetworkStackInit(FALSE);
     if (!SUCCEEDED(status))
     {
@@ -6,6 +6,7 @@
 #include "test_file_io.h"
 #include "test_dma.h"
 #include "test_thread.h"
+#include "test_net_stack.h"
 #include "smp.h"
 
 #define TEST_HEAP_ALLOCATION_SIZE           0x100
@@ -29,4 +30,9 @@ TestRunAllPerformance(
 {
     TestFileReadPerformance();
     TestDmaPerformance();
+    TestVmmTlbPerformance();
+    TestVmmReservationLookupPerformance();
+    TestVmmAddressSpaceSwitchPerformance();
+    TestThreadPerformance();
+    TestNetworkPerformance();
 }
\ No newline at end of file
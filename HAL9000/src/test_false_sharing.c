@@ -0,0 +1,144 @@
+#include "test_common.h"
+#include "test_thread.h"
+#include "test_false_sharing.h"
+#include "ex_event.h"
+#include "iomu.h"
+
+typedef struct _FALSE_SHARING_TEST_CTX
+{
+    // signaled after all the threads are created so they start together
+    EX_EVENT            StartEvent;
+
+    volatile DWORD      NextCounterIndex;
+    DWORD               NumberOfCounters;
+
+    // distance between two consecutive counters, in QWORDs
+    DWORD               CounterStride;
+    BOOLEAN             Padded;
+
+    QWORD               StartTimeUs;
+
+    // cache line aligned, each counter is written by a single thread
+    volatile QWORD*     Counters;
+} FALSE_SHARING_TEST_CTX, *PFALSE_SHARING_TEST_CTX;
+
+STATUS
+(__cdecl TestThreadFalseSharing)(
+    IN_OPT      PVOID       Context
+    )
+{
+    PFALSE_SHARING_TEST_CTX pCtx;
+    volatile QWORD* pCounter;
+    DWORD index;
+
+    pCtx = (PFALSE_SHARING_TEST_CTX) Context;
+
+    ASSERT(pCtx != NULL);
+
+    index = _InterlockedIncrement(&pCtx->NextCounterIndex) - 1;
+    ASSERT(index < pCtx->NumberOfCounters);
+
+    pCounter = &pCtx->Counters[(QWORD) index * pCtx->CounterStride];
+
+    ExEventWaitForSignal(&pCtx->StartEvent);
+
+    for (DWORD i = 0; i < FALSE_SHARING_TEST_NO_OF_INCREMENTS; ++i)
+    {
+        // no other thread writes this counter, but in the packed case the
+        // other threads write the same cache line
+        *pCounter = *pCounter + 1;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+void
+(__cdecl TestThreadFalseSharingPrepare)(
+    OUT_OPT_PTR     PVOID*              Context,
+    IN              DWORD               NumberOfThreads,
+    IN              PVOID               PrepareContext
+    )
+{
+    PFALSE_SHARING_TEST_CTX pCtx;
+    STATUS status;
+
+    ASSERT(Context != NULL);
+
+    pCtx = ExAllocatePoolWithTag(PoolAllocateZeroMemory | PoolAllocatePanicIfFail,
+                                 sizeof(FALSE_SHARING_TEST_CTX),
+                                 HEAP_TEST_TAG,
+                                 0);
+
+    status = ExEventInit(&pCtx->StartEvent, ExEventTypeNotification, FALSE);
+    ASSERT(SUCCEEDED(status));
+
+    // warning C4305: 'type cast': truncation from 'const PVOID' to 'BOOLEAN'
+#pragma warning(suppress:4305)
+    pCtx->Padded = (BOOLEAN) PrepareContext;
+
+    pCtx->NumberOfCounters = NumberOfThreads;
+    pCtx->CounterStride = pCtx->Padded ? CACHE_LINE_SIZE / sizeof(QWORD) : 1;
+
+    pCtx->Counters = ExAllocatePoolWithTag(PoolAllocateZeroMemory | PoolAllocatePanicIfFail,
+                                           sizeof(QWORD) * pCtx->CounterStride * NumberOfThreads,
+                                           HEAP_TEST_TAG,
+                                           CACHE_LINE_SIZE);
+
+    *Context = pCtx;
+}
+
+void
+(__cdecl TestThreadFalseSharingPostCreate)(
+    IN              PVOID               Context
+    )
+{
+    PFALSE_SHARING_TEST_CTX pCtx;
+
+    pCtx = (PFALSE_SHARING_TEST_CTX) Context;
+    ASSERT(pCtx != NULL);
+
+    pCtx->StartTimeUs = IomuGetSystemTimeUs();
+
+    ExEventSignal(&pCtx->StartEvent);
+}
+
+void
+(__cdecl TestThreadFalseSharingPostFinish)(
+    IN              PVOID               Context,
+    IN              DWORD               NumberOfThreads
+    )
+{
+    PFALSE_SHARING_TEST_CTX pCtx;
+    QWORD durationUs;
+    BOOLEAN bPassed;
+
+    pCtx = (PFALSE_SHARING_TEST_CTX) Context;
+    ASSERT(pCtx != NULL);
+    ASSERT(pCtx->NumberOfCounters == NumberOfThreads);
+
+    durationUs = IomuGetSystemTimeUs() - pCtx->StartTimeUs;
+    bPassed = TRUE;
+
+    for (DWORD i = 0; i < NumberOfThreads; ++i)
+    {
+        QWORD value = pCtx->Counters[(QWORD) i * pCtx->CounterStride];
+
+        if (value != FALSE_SHARING_TEST_NO_OF_INCREMENTS)
+        {
+            LOG_ERROR("Counter %u has value %U, expected %u\n", i, value, FALSE_SHARING_TEST_NO_OF_INCREMENTS);
+            bPassed = FALSE;
+        }
+    }
+
+    LOG_TEST_LOG("%u threads incremented %s counters %u times each in %U us\n",
+                 NumberOfThreads, pCtx->Padded ? "padded" : "packed",
+                 FALSE_SHARING_TEST_NO_OF_INCREMENTS, durationUs);
+
+    ExFreePoolWithTag((PVOID) pCtx->Counters, HEAP_TEST_TAG);
+    pCtx->Counters = NULL;
+
+    if (bPassed)
+    {
+        LOG_TEST_PASS;
+    }
+}
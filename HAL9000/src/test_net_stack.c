@@ -7,12 +7,30 @@
 #include "keyboard.h"
 #include "keyboard_utils.h"
 #include "cpu.h"
+#include "perf_framework.h"
+#include "iomu.h"
+#include "rtc.h"
+#include "net_loopback.h"
+#include "network_stack.h"
 
 #define RECEIVE_THREAD_INITIAL_BUFFER_SIZE                  sizeof(NET_RECEIVE_FRAME_OUTPUT)//64*KB_SIZE
 #define TRANSMIT_THREAD_BUFFER_SIZE                         1*KB_SIZE
 
 #define BUFFER_TO_SEND                                      "This is the c00le$t buffer ev4r made!!!!!"
 
+#define NET_PERF_RECEIVE_BUFFER_SIZE                        (16*KB_SIZE)
+#define NET_PERF_LATENCY_ITERATION_COUNT                    1000
+#define NET_PERF_THROUGHPUT_FRAME_COUNT                     20000
+
+// maximum number of frames in flight during the throughput test, it is further
+// limited so that the frames in flight never need more RX descriptors than the
+// loopback device has - a dropped frame would leave the receiver blocked
+#define NET_PERF_THROUGHPUT_WINDOW                          16
+
+// size of the RX and TX rings of the loopback device, used only the first
+// time the benchmark loads the loopback driver
+#define NET_PERF_LOOPBACK_NO_OF_DESCRIPTORS                 NET_LOOPBACK_DEFAULT_NO_OF_DESCRIPTORS
+
 typedef struct _NET_TRAFFIC_THREAD_CONTEXT
 {
     DEVICE_ID               NetworkDevice;
@@ -26,6 +44,30 @@ static FUNC_ThreadStart _TestReceivePacketsForAdapter;
 
 static FUNC_ThreadStart _TestTransmitPacketsForAdapter;
 
+typedef struct _NET_PERF_CTX
+{
+    DEVICE_ID               NetworkDevice;
+    MAC_ADDRESS             PhysicalAddress;
+
+    DWORD                   FrameSize;
+    PETHERNET_FRAME         TransmitFrame;
+    PETHERNET_FRAME         ReceiveFrame;
+} NET_PERF_CTX, *PNET_PERF_CTX;
+
+static FUNC_TestPerformance _TestNetworkRoundTrip;
+
+static
+void
+_TestNetworkThroughput(
+    INOUT   PNET_PERF_CTX       Context
+    );
+
+static const DWORD NET_PERF_FRAME_SIZES[] = { IEEE_802_3_MINIMUM_FRAME_SIZE, 512,
+                                              ETHERNET_MAXIMUM_FRAME_SIZE(ETHERNET_DEFAULT_MTU),
+                                              ETHERNET_MAXIMUM_FRAME_SIZE(ETHERNET_JUMBO_MTU) };
+static const DWORD NET_PERF_LATENCIES_US[] = { 0, 10, 100 };
+static const char* NET_PERF_STAT_NAMES[1] = { "ROUND TRIP (us)" };
+
 _No_competing_thread_
 BOOLEAN
 TestNetwork(
@@ -91,6 +133,13 @@ TestNetwork(
 
         for (i = 0; i < noOfDevices; ++i)
         {
+            if (NetLoopbackIsLoopbackDevice(&pNetDevices[i].PhysicalAddress))
+            {
+                // loaded by TestNetworkPerformance, there is no traffic on it
+                // except the one of the benchmark
+                continue;
+            }
+
             pThreadContexts[i].NetworkDevice = pNetDevices[i].DeviceId;
 
             // A variable which is accessed via an Interlocked function must always be accessed via an Interlocked function
@@ -125,6 +174,11 @@ TestNetwork(
 
         for (i = 0; i < noOfDevices; ++i)
         {
+            if (NULL == pThreads[i])
+            {
+                continue;
+            }
+
             LOG("Waiting for thread 0x%x termination\n", ThreadGetId(pThreads[i]));
             ThreadWaitForTermination(pThreads[i], &status);
             LOG("Thread 0x%x terminated with status 0x%x\n", ThreadGetId(pThreads[i]), status);
@@ -242,7 +296,26 @@ STATUS
                                   requiredBufferSize,
                                   MAC_BROADCAST
                                   );
-            if (STATUS_DEVICE_DISABLED == status)
+            while (STATUS_DEVICE_BUSY == status && !*pCtx->StopRequests)
+            {
+                // the port TX queue is full, let the transmit path drain it
+                ThreadYield();
+
+                status = NetSendFrame(FALSE,
+                                      pCtx->NetworkDevice,
+                                      pFrame,
+                                      requiredBufferSize,
+                                      MAC_BROADCAST
+                                      );
+            }
+
+            if (STATUS_DEVICE_BUSY == status)
+            {
+                // stop was requested while the queue was full, the frame is
+                // dropped
+                status = STATUS_SUCCESS;
+            }
+            else if (STATUS_DEVICE_DISABLED == status)
             {
                 LOG_WARNING("Could not send network frame because TX functionality is disabled! :(\n");
                 status = STATUS_SUCCESS;
@@ -299,7 +372,15 @@ STATUS
                               bufferSize,
                               pFrame->Destination
                               );
-        if (STATUS_DEVICE_DISABLED == status)
+        if (STATUS_DEVICE_BUSY == status)
+        {
+            // the port TX queue is full, retry the same frame after the
+            // transmit path drains it
+            status = STATUS_SUCCESS;
+            ThreadYield();
+            continue;
+        }
+        else if (STATUS_DEVICE_DISABLED == status)
         {
             status = STATUS_SUCCESS;
             LOG("Device TX has been disabled!\n");
@@ -326,4 +407,283 @@ STATUS
     LOG_FUNC_END_THREAD;
 
     return status;
+}
+
+void
+TestNetworkPerformance(
+    void
+    )
+{
+    STATUS status;
+    DWORD noOfDevices;
+    DWORD i;
+    DWORD j;
+    DWORD k;
+    PNETWORK_DEVICE_INFO pNetDevices;
+    PNETWORK_DEVICE_INFO pLoopbackDevice;
+    NET_PERF_CTX ctx;
+    PERFORMANCE_STATS perfStats;
+    DWORD previousLatency;
+
+    status = STATUS_SUCCESS;
+    noOfDevices = 0;
+    pNetDevices = NULL;
+    pLoopbackDevice = NULL;
+    memzero(&ctx, sizeof(NET_PERF_CTX));
+    previousLatency = NetLoopbackGetLatency();
+
+    // the loopback device exists only once a benchmark asks for it
+    status = NetLoopbackLoadDriver(NET_PERF_LOOPBACK_NO_OF_DESCRIPTORS, NET_PERF_LOOPBACK_NO_OF_DESCRIPTORS);
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("NetLoopbackLoadDriver", status);
+        return;
+    }
+
+    status = NetworkStackRescanDevices();
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("NetworkStackRescanDevices", status);
+        return;
+    }
+
+    status = NetGetNetworkDevices(NULL, &noOfDevices);
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("NetGetNetworkDevices", status);
+        return;
+    }
+
+    __try
+    {
+        if (0 != noOfDevices)
+        {
+            pNetDevices = ExAllocatePoolWithTag(PoolAllocateZeroMemory, sizeof(NETWORK_DEVICE_INFO) * noOfDevices, HEAP_TEST_TAG, 0);
+            ASSERT(NULL != pNetDevices);
+
+            status = NetGetNetworkDevices(pNetDevices, &noOfDevices);
+            if (!SUCCEEDED(status))
+            {
+                LOG_FUNC_ERROR("NetGetNetworkDevices", status);
+                __leave;
+            }
+        }
+
+        for (i = 0; i < noOfDevices; ++i)
+        {
+            if (NetLoopbackIsLoopbackDevice(&pNetDevices[i].PhysicalAddress))
+            {
+                pLoopbackDevice = &pNetDevices[i];
+                break;
+            }
+        }
+
+        if (NULL == pLoopbackDevice)
+        {
+            LOG_WARNING("No loopback network device found!\n");
+            __leave;
+        }
+
+        if (!pLoopbackDevice->DeviceStatus.RxEnabled || !pLoopbackDevice->DeviceStatus.TxEnabled)
+        {
+            LOG_WARNING("Loopback device 0x%x is disabled, networking must be enabled to run the benchmark\n",
+                        pLoopbackDevice->DeviceId);
+            __leave;
+        }
+
+        ctx.NetworkDevice = pLoopbackDevice->DeviceId;
+        ctx.PhysicalAddress = pLoopbackDevice->PhysicalAddress;
+
+        // jumbo frames are sent only if the MTU allows them
+        status = NetSetDeviceMtu(ctx.NetworkDevice, ETHERNET_JUMBO_MTU);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("NetSetDeviceMtu", status);
+            __leave;
+        }
+
+        ctx.TransmitFrame = ExAllocatePoolWithTag(PoolAllocateZeroMemory, NET_PERF_RECEIVE_BUFFER_SIZE, HEAP_TEST_TAG, 0);
+        ASSERT(NULL != ctx.TransmitFrame);
+
+        ctx.ReceiveFrame = ExAllocatePoolWithTag(PoolAllocateZeroMemory, NET_PERF_RECEIVE_BUFFER_SIZE, HEAP_TEST_TAG, 0);
+        ASSERT(NULL != ctx.ReceiveFrame);
+
+        ctx.TransmitFrame->Type = htonw(ETHERNET_FRAME_TYPE_IP4);
+        memcpy(ctx.TransmitFrame->Data, BUFFER_TO_SEND, sizeof(BUFFER_TO_SEND));
+
+        for (j = 0; j < ARRAYSIZE(NET_PERF_LATENCIES_US); ++j)
+        {
+            NetLoopbackSetLatency(NET_PERF_LATENCIES_US[j]);
+
+            for (k = 0; k < ARRAYSIZE(NET_PERF_FRAME_SIZES); ++k)
+            {
+                ctx.FrameSize = NET_PERF_FRAME_SIZES[k];
+                ASSERT(ctx.FrameSize <= NET_PERF_RECEIVE_BUFFER_SIZE);
+
+                LOGL("Loopback device 0x%x, injected latency %u us, frame size %u bytes\n",
+                     ctx.NetworkDevice, NET_PERF_LATENCIES_US[j], ctx.FrameSize);
+
+                RunPerformanceFunction(_TestNetworkRoundTrip,
+                                       &ctx,
+                                       NET_PERF_LATENCY_ITERATION_COUNT,
+                                       TRUE,
+                                       &perfStats
+                                       );
+                DisplayPerformanceStats(&perfStats, 1, NET_PERF_STAT_NAMES);
+
+                _TestNetworkThroughput(&ctx);
+            }
+        }
+    }
+    __finally
+    {
+        NetLoopbackSetLatency(previousLatency);
+
+        if (NULL != pLoopbackDevice)
+        {
+            NetSetDeviceMtu(pLoopbackDevice->DeviceId, pLoopbackDevice->Mtu);
+        }
+
+        if (NULL != ctx.ReceiveFrame)
+        {
+            ExFreePoolWithTag(ctx.ReceiveFrame, HEAP_TEST_TAG);
+            ctx.ReceiveFrame = NULL;
+        }
+
+        if (NULL != ctx.TransmitFrame)
+        {
+            ExFreePoolWithTag(ctx.TransmitFrame, HEAP_TEST_TAG);
+            ctx.TransmitFrame = NULL;
+        }
+
+        if (NULL != pNetDevices)
+        {
+            ExFreePoolWithTag(pNetDevices, HEAP_TEST_TAG);
+            pNetDevices = NULL;
+        }
+    }
+}
+
+static
+void
+(__cdecl _TestNetworkRoundTrip)(
+    IN_OPT  PVOID       Context
+    )
+{
+    PNET_PERF_CTX pCtx;
+    STATUS status;
+    DWORD bytesReceived;
+
+    ASSERT(NULL != Context);
+
+    pCtx = (PNET_PERF_CTX) Context;
+    bytesReceived = 0;
+
+    status = NetSendFrame(FALSE,
+                          pCtx->NetworkDevice,
+                          pCtx->TransmitFrame,
+                          pCtx->FrameSize,
+                          pCtx->PhysicalAddress
+                          );
+    ASSERT(SUCCEEDED(status));
+
+    status = NetReceiveFrame(pCtx->NetworkDevice,
+                             pCtx->ReceiveFrame,
+                             NET_PERF_RECEIVE_BUFFER_SIZE,
+                             &bytesReceived
+                             );
+    ASSERT(SUCCEEDED(status));
+    ASSERT(bytesReceived == pCtx->FrameSize);
+}
+
+static
+void
+_TestNetworkThroughput(
+    INOUT   PNET_PERF_CTX       Context
+    )
+{
+    STATUS status;
+    DWORD framesSent;
+    DWORD framesReceived;
+    DWORD bytesReceived;
+    QWORD startTick;
+    QWORD elapsedUs;
+    QWORD totalBytes;
+    NETWORK_DEVICE_STATS statsBefore;
+    NETWORK_DEVICE_STATS statsAfter;
+    BOOLEAN logState;
+    DWORD descriptorsPerFrame;
+    DWORD window;
+    QWORD descriptorsUsed;
+
+    ASSERT(NULL != Context);
+
+    framesSent = 0;
+    framesReceived = 0;
+    totalBytes = 0;
+
+    status = NetGetNetworkDeviceStatistics(Context->NetworkDevice, &statsBefore);
+    ASSERT(SUCCEEDED(status));
+
+    descriptorsPerFrame = (Context->FrameSize + statsBefore.RxStats.BufferSize - 1) / statsBefore.RxStats.BufferSize;
+    window = min(NET_PERF_THROUGHPUT_WINDOW, (statsBefore.RxStats.RingSize - 1) / descriptorsPerFrame);
+    ASSERT(0 != window);
+
+    logState = LogSetState(FALSE);
+    startTick = RtcGetTickCount();
+
+    // keep at most NET_PERF_THROUGHPUT_WINDOW frames in flight, both the
+    // transmit and the receive path are exercised by the same thread
+    while (framesReceived < NET_PERF_THROUGHPUT_FRAME_COUNT)
+    {
+        while (framesSent < NET_PERF_THROUGHPUT_FRAME_COUNT &&
+               framesSent - framesReceived < window)
+        {
+            status = NetSendFrame(FALSE,
+                                  Context->NetworkDevice,
+                                  Context->TransmitFrame,
+                                  Context->FrameSize,
+                                  Context->PhysicalAddress
+                                  );
+            if (STATUS_DEVICE_BUSY == status)
+            {
+                // the port TX queue is full, drain some frames first
+                break;
+            }
+            ASSERT(SUCCEEDED(status));
+
+            framesSent = framesSent + 1;
+        }
+
+        status = NetReceiveFrame(Context->NetworkDevice,
+                                 Context->ReceiveFrame,
+                                 NET_PERF_RECEIVE_BUFFER_SIZE,
+                                 &bytesReceived
+                                 );
+        ASSERT(SUCCEEDED(status));
+
+        framesReceived = framesReceived + 1;
+        totalBytes = totalBytes + bytesReceived;
+    }
+
+    elapsedUs = IomuTickCountToUs(RtcGetTickCount() - startTick);
+    LogSetState(logState);
+
+    status = NetGetNetworkDeviceStatistics(Context->NetworkDevice, &statsAfter);
+    ASSERT(SUCCEEDED(status));
+
+    elapsedUs = max(elapsedUs, 1);
+    descriptorsUsed = statsAfter.RxStats.NumberOfDescriptors - statsBefore.RxStats.NumberOfDescriptors;
+
+    LOGL("Throughput: %U frames/s, %U KB/s, %U frames per interrupt, %U frames dropped\n",
+         (QWORD) framesReceived * SEC_IN_US / elapsedUs,
+         totalBytes * SEC_IN_US / elapsedUs / KB_SIZE,
+         (QWORD) framesReceived / max(statsAfter.NumberOfInterrupts - statsBefore.NumberOfInterrupts, 1),
+         statsAfter.RxStats.DroppedFrames - statsBefore.RxStats.DroppedFrames
+         );
+    LOGL("RX: %U bytes per descriptor, %U bytes per interrupt, window of %u frames\n",
+         totalBytes / max(descriptorsUsed, 1),
+         totalBytes / max(statsAfter.NumberOfInterrupts - statsBefore.NumberOfInterrupts, 1),
+         window
+         );
 }
\ No newline at end of file
@@ -3,9 +3,25 @@
 #include "test_timer.h"
 #include "test_priority_scheduler.h"
 #include "test_priority_donation.h"
+#include "test_false_sharing.h"
+#include "perf_framework.h"
 
 #include "mutex.h"
 
+#define TEST_THREAD_PERF_ITERATION_COUNT        100
+
+static const char* TEST_THREAD_PERF_STAT_NAMES[2] = { "CREATE/WAIT/CLOSE", "WAIT/CLOSE" };
+
+typedef struct _TEST_THREAD_PERF_CTX
+{
+    // created before the wait/close run, consumed in order
+    PTHREAD*                    Threads;
+    DWORD                       NumberOfThreads;
+    DWORD                       NextThread;
+
+    STATUS                      Status;
+} TEST_THREAD_PERF_CTX, *PTEST_THREAD_PERF_CTX;
+
 
 FUNC_ThreadStart                TestThreadYield;
 
@@ -15,6 +31,10 @@ FUNC_ThreadStart                TestCpuIntense;
 
 static FUNC_ThreadPrepareTest   _ThreadTestPassContext;
 
+static FUNC_ThreadStart         _ThreadTestPerfEmpty;
+static FUNC_TestPerformance     _ThreadTestPerfCreateWaitClose;
+static FUNC_TestPerformance     _ThreadTestPerfWaitClose;
+
 const THREAD_TEST THREADS_TEST[] =
 {
     // Tests just for fun
@@ -22,6 +42,17 @@ const THREAD_TEST THREADS_TEST[] =
     { "Mutex", TestMutexes, TestPrepareMutex, (PVOID) FALSE, NULL, NULL, FALSE, FALSE },
     { "CpuIntense", TestCpuIntense, NULL, NULL, NULL, NULL, FALSE, FALSE },
 
+    // False sharing, compare the durations logged by the two tests
+    {   "FalseSharingPacked", TestThreadFalseSharing,
+        TestThreadFalseSharingPrepare, (PVOID) FALSE_SHARING_TEST_PACKED,
+        TestThreadFalseSharingPostCreate, TestThreadFalseSharingPostFinish,
+        ThreadPriorityDefault, FALSE, FALSE, FALSE},
+
+    {   "FalseSharingPadded", TestThreadFalseSharing,
+        TestThreadFalseSharingPrepare, (PVOID) FALSE_SHARING_TEST_PADDED,
+        TestThreadFalseSharingPostCreate, TestThreadFalseSharingPostFinish,
+        ThreadPriorityDefault, FALSE, FALSE, FALSE},
+
     // Actual tests used for validating the project
 
     // Timer
@@ -329,4 +360,142 @@ void
     memcpy(pNewContext, &PrepareContext, sizeof(PVOID));
 
     *Context = pNewContext;
+}
+
+void
+TestThreadPerformance(
+    void
+    )
+{
+    TEST_THREAD_PERF_CTX ctx;
+    PERFORMANCE_STATS perfStats[2];
+    STATUS exitStatus;
+
+    memzero(&ctx, sizeof(TEST_THREAD_PERF_CTX));
+    memzero(perfStats, sizeof(perfStats));
+
+    __try
+    {
+        // each iteration is the whole life of a thread
+        RunPerformanceFunction(_ThreadTestPerfCreateWaitClose,
+                               &ctx,
+                               TEST_THREAD_PERF_ITERATION_COUNT,
+                               TRUE,
+                               &perfStats[0]
+                               );
+        if (!SUCCEEDED(ctx.Status))
+        {
+            // the logging is disabled while the function is measured
+            LOG_FUNC_ERROR("ThreadCreate", ctx.Status);
+            __leave;
+        }
+
+        ctx.Threads = ExAllocatePoolWithTag(PoolAllocateZeroMemory | PoolAllocatePanicIfFail,
+                                            sizeof(PTHREAD) * TEST_THREAD_PERF_ITERATION_COUNT,
+                                            HEAP_TEST_TAG,
+                                            0);
+
+        for (DWORD i = 0; i < TEST_THREAD_PERF_ITERATION_COUNT; ++i)
+        {
+            ctx.Status = ThreadCreate("ThreadPerf",
+                                      ThreadPriorityDefault,
+                                      _ThreadTestPerfEmpty,
+                                      NULL,
+                                      &ctx.Threads[i]);
+            if (!SUCCEEDED(ctx.Status))
+            {
+                LOG_FUNC_ERROR("ThreadCreate", ctx.Status);
+                __leave;
+            }
+            ctx.NumberOfThreads++;
+        }
+
+        // the threads are most likely already dead, this measures the
+        // release of the last references and the destruction
+        RunPerformanceFunction(_ThreadTestPerfWaitClose,
+                               &ctx,
+                               TEST_THREAD_PERF_ITERATION_COUNT,
+                               TRUE,
+                               &perfStats[1]
+                               );
+
+        DisplayPerformanceStats(perfStats, 2, TEST_THREAD_PERF_STAT_NAMES);
+    }
+    __finally
+    {
+        if (NULL != ctx.Threads)
+        {
+            for (DWORD i = ctx.NextThread; i < ctx.NumberOfThreads; ++i)
+            {
+                ThreadWaitForTermination(ctx.Threads[i], &exitStatus);
+                ThreadCloseHandle(ctx.Threads[i]);
+            }
+
+            ExFreePoolWithTag(ctx.Threads, HEAP_TEST_TAG);
+            ctx.Threads = NULL;
+        }
+    }
+}
+
+static
+STATUS
+(__cdecl _ThreadTestPerfEmpty)(
+    IN_OPT      PVOID       Context
+    )
+{
+    ASSERT(NULL == Context);
+
+    return STATUS_SUCCESS;
+}
+
+static
+void
+(__cdecl _ThreadTestPerfCreateWaitClose)(
+    IN_OPT  PVOID       Context
+    )
+{
+    PTEST_THREAD_PERF_CTX pCtx;
+    PTHREAD pThread;
+    STATUS exitStatus;
+    STATUS status;
+
+    ASSERT(NULL != Context);
+
+    pCtx = (PTEST_THREAD_PERF_CTX) Context;
+
+    if (!SUCCEEDED(pCtx->Status))
+    {
+        return;
+    }
+
+    status = ThreadCreate("ThreadPerf", ThreadPriorityDefault, _ThreadTestPerfEmpty, NULL, &pThread);
+    if (!SUCCEEDED(status))
+    {
+        pCtx->Status = status;
+        return;
+    }
+
+    ThreadWaitForTermination(pThread, &exitStatus);
+    ThreadCloseHandle(pThread);
+}
+
+static
+void
+(__cdecl _ThreadTestPerfWaitClose)(
+    IN_OPT  PVOID       Context
+    )
+{
+    PTEST_THREAD_PERF_CTX pCtx;
+    PTHREAD pThread;
+    STATUS exitStatus;
+
+    ASSERT(NULL != Context);
+
+    pCtx = (PTEST_THREAD_PERF_CTX) Context;
+    ASSERT(pCtx->NextThread < pCtx->NumberOfThreads);
+
+    pThread = pCtx->Threads[pCtx->NextThread++];
+
+    ThreadWaitForTermination(pThread, &exitStatus);
+    ThreadCloseHandle(pThread);
 }
\ No newline at end of file
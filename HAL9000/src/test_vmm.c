@@ -1,9 +1,80 @@
 #include "test_common.h"
 #include "test_vmm.h"
+#include "perf_framework.h"
+#include "pmm.h"
+#include "process_internal.h"
+#include "thread_internal.h"
+#include "iomu.h"
 
 #define TST_VMM_MAGIC_VALUE_TO_WRITE                0xAC
 #define TST_VMM_VA_TO_REQUEST                       (PtrOffset(gVirtualToPhysicalOffset,32 * TB_SIZE))
 
+// must be a power of 2 number of pages, large enough to overflow the STLB
+// when mapped with 4KB pages
+#define TST_VMM_TLB_REGION_SIZE                     (32 * MB_SIZE)
+#define TST_VMM_TLB_ITERATION_COUNT                 20
+
+// odd => multiplying the page index by it modulo the power of 2 number of
+// pages generates a permutation which defeats the prefetchers
+#define TST_VMM_TLB_PAGE_STRIDE                     0x9E5
+
+#define TST_VMM_TLB_NO_OF_PAGES                     ((DWORD)(TST_VMM_TLB_REGION_SIZE / PAGE_SIZE))
+STATIC_ASSERT(0 == (TST_VMM_TLB_NO_OF_PAGES & (TST_VMM_TLB_NO_OF_PAGES - 1)));
+
+// enough reservations for a linear lookup to dominate the page fault cost
+#define TST_VMM_FAULT_NO_OF_RESERVATIONS            10000
+#define TST_VMM_FAULT_NO_OF_TARGETS                 100
+#define TST_VMM_FAULT_ITERATION_COUNT               20
+
+// the working set of each process fits in the TLB, what is measured is
+// whether it survives the switch to the other process
+#define TST_VMM_SWITCH_NO_OF_PAGES                  64
+#define TST_VMM_SWITCH_NO_OF_ROUND_TRIPS            1000
+#define TST_VMM_SWITCH_ITERATION_COUNT              20
+
+// the process exits right away, only its address space is used
+#define TST_VMM_SWITCH_PROCESS_NAME                 "Dummy"
+
+typedef struct _TST_VMM_TLB_CTX
+{
+    PBYTE               Buffer;
+    DWORD               NumberOfPages;
+
+    // keeps the compiler from discarding the reads
+    volatile QWORD      Sum;
+} TST_VMM_TLB_CTX, *PTST_VMM_TLB_CTX;
+
+typedef struct _TST_VMM_FAULT_CTX
+{
+    // each reservation is a single page committed lazily
+    PVOID*              Reservations;
+
+    // the reservations touched by an iteration
+    DWORD               FirstTarget;
+    DWORD               NumberOfTargets;
+
+    STATUS              Status;
+} TST_VMM_FAULT_CTX, *PTST_VMM_FAULT_CTX;
+
+typedef struct _TST_VMM_SWITCH_CTX
+{
+    PPROCESS            Processes[2];
+
+    // user memory mapped eagerly in each process
+    PBYTE               Buffers[2];
+
+    // keeps the compiler from discarding the reads
+    volatile QWORD      Sum;
+} TST_VMM_SWITCH_CTX, *PTST_VMM_SWITCH_CTX;
+
+static FUNC_TestPerformance     _TstVmmTouchPages;
+static FUNC_TestPerformance     _TstVmmFaultReservations;
+static FUNC_TestPerformance     _TstVmmSwitchAddressSpaces;
+
+static const char* TST_VMM_TLB_STAT_NAMES[2] = { "4KB PAGES", "LARGE PAGES" };
+static const char* TST_VMM_FAULT_STAT_NAMES[2] = { "OLDEST RESERVATIONS", "NEWEST RESERVATIONS" };
+static const char* TST_VMM_SWITCH_STAT_NAMES[2] = { "FLUSH ON SWITCH", "PCID PER CPU" };
+
 static const DWORD TST_VMM_ALLOCATION_SIZES[] =
 {
     PAGE_SIZE,
@@ -132,4 +203,346 @@ _TstVmmAllocationAndDeallocation(
                   );
 
     return status;
+}
+
+void
+TestVmmTlbPerformance(
+    void
+    )
+{
+    TST_VMM_TLB_CTX ctx;
+    PERFORMANCE_STATS perfStats[2];
+    PHYSICAL_ADDRESS pa;
+    DWORD noOfFrames;
+    BOOLEAN bPrevLargePageUsage;
+
+    memzero(&ctx, sizeof(TST_VMM_TLB_CTX));
+    memzero(perfStats, sizeof(perfStats));
+
+    noOfFrames = TST_VMM_TLB_NO_OF_PAGES;
+
+    pa = PmmReserveMemory(noOfFrames);
+    if (NULL == pa)
+    {
+        LOG_ERROR("PmmReserveMemory failed for %u frames, cannot run the TLB test\n", noOfFrames);
+        return;
+    }
+
+    ctx.NumberOfPages = noOfFrames;
+
+    for (DWORD i = 0; i < 2; ++i)
+    {
+        // the first run uses only 4KB pages, the second one allows large
+        // pages, the region is the same physical memory in both cases
+        bPrevLargePageUsage = VmmSetLargePageUsage((BOOLEAN) (0 != i));
+        ctx.Buffer = MmuMapSystemMemory(pa, TST_VMM_TLB_REGION_SIZE);
+        VmmSetLargePageUsage(bPrevLargePageUsage);
+
+        ASSERT(NULL != ctx.Buffer);
+
+        RunPerformanceFunction(_TstVmmTouchPages,
+                               &ctx,
+                               TST_VMM_TLB_ITERATION_COUNT,
+                               TRUE,
+                               &perfStats[i]
+                               );
+
+        MmuUnmapSystemMemory(ctx.Buffer, TST_VMM_TLB_REGION_SIZE);
+        ctx.Buffer = NULL;
+    }
+
+    LOGL("Touched %u pages in %U MB of memory (us)\n", noOfFrames, TST_VMM_TLB_REGION_SIZE / MB_SIZE);
+    DisplayPerformanceStats(perfStats, 2, TST_VMM_TLB_STAT_NAMES);
+
+    PmmReleaseMemory(pa, noOfFrames);
+}
+
+static
+void
+(__cdecl _TstVmmTouchPages)(
+    IN_OPT  PVOID       Context
+    )
+{
+    PTST_VMM_TLB_CTX pCtx;
+    QWORD sum;
+    DWORD pageIndex;
+
+    ASSERT(NULL != Context);
+
+    pCtx = (PTST_VMM_TLB_CTX) Context;
+    sum = 0;
+
+    for (DWORD i = 0; i < pCtx->NumberOfPages; ++i)
+    {
+        pageIndex = (i * TST_VMM_TLB_PAGE_STRIDE) & (pCtx->NumberOfPages - 1);
+
+        // use a different cache line in each page so we measure the TLB
+        // misses and not the cache set conflicts
+        sum += *(volatile QWORD*)PtrOffset(pCtx->Buffer,
+                                           (QWORD) pageIndex * PAGE_SIZE + AddressOffset(pageIndex * 64, PAGE_SIZE));
+    }
+
+    pCtx->Sum = pCtx->Sum + sum;
+}
+
+void
+TestVmmReservationLookupPerformance(
+    void
+    )
+{
+    TST_VMM_FAULT_CTX ctx;
+    PERFORMANCE_STATS perfStats[2];
+    DWORD noOfReservations;
+
+    memzero(&ctx, sizeof(TST_VMM_FAULT_CTX));
+    memzero(perfStats, sizeof(perfStats));
+
+    noOfReservations = 0;
+
+    ctx.Reservations = ExAllocatePoolWithTag(PoolAllocateZeroMemory,
+                                             sizeof(PVOID) * TST_VMM_FAULT_NO_OF_RESERVATIONS,
+                                             HEAP_TEST_TAG,
+                                             0);
+    if (NULL == ctx.Reservations)
+    {
+        LOG_FUNC_ERROR_ALLOC("ExAllocatePoolWithTag", sizeof(PVOID) * TST_VMM_FAULT_NO_OF_RESERVATIONS);
+        return;
+    }
+
+    __try
+    {
+        for (noOfReservations = 0; noOfReservations < TST_VMM_FAULT_NO_OF_RESERVATIONS; ++noOfReservations)
+        {
+            ctx.Reservations[noOfReservations] = VmmAllocRegion(NULL,
+                                                                PAGE_SIZE,
+                                                                VMM_ALLOC_TYPE_RESERVE | VMM_ALLOC_TYPE_COMMIT,
+                                                                PAGE_RIGHTS_READWRITE
+                                                                );
+            if (NULL == ctx.Reservations[noOfReservations])
+            {
+                LOG_ERROR("VmmAllocRegion failed for reservation %u\n", noOfReservations);
+                __leave;
+            }
+        }
+
+        ctx.NumberOfTargets = TST_VMM_FAULT_NO_OF_TARGETS;
+
+        // the oldest reservations were found first by a linear lookup, the
+        // newest ones last => the difference between the two is the cost
+        // of the lookup
+        for (DWORD i = 0; i < 2; ++i)
+        {
+            ctx.FirstTarget = (0 == i) ? 0 : TST_VMM_FAULT_NO_OF_RESERVATIONS - TST_VMM_FAULT_NO_OF_TARGETS;
+
+            RunPerformanceFunction(_TstVmmFaultReservations,
+                                   &ctx,
+                                   TST_VMM_FAULT_ITERATION_COUNT,
+                                   TRUE,
+                                   &perfStats[i]
+                                   );
+            if (!SUCCEEDED(ctx.Status))
+            {
+                LOG_FUNC_ERROR("_TstVmmFaultReservations", ctx.Status);
+                __leave;
+            }
+        }
+
+        LOGL("Solved %u page faults with %u reservations (us)\n", TST_VMM_FAULT_NO_OF_TARGETS, TST_VMM_FAULT_NO_OF_RESERVATIONS);
+        DisplayPerformanceStats(perfStats, 2, TST_VMM_FAULT_STAT_NAMES);
+    }
+    __finally
+    {
+        for (DWORD i = 0; i < noOfReservations; ++i)
+        {
+            VmmFreeRegion(ctx.Reservations[i], 0, VMM_FREE_TYPE_RELEASE);
+        }
+
+        ExFreePoolWithTag(ctx.Reservations, HEAP_TEST_TAG);
+        ctx.Reservations = NULL;
+    }
+}
+
+static
+void
+(__cdecl _TstVmmFaultReservations)(
+    IN_OPT  PVOID       Context
+    )
+{
+    PTST_VMM_FAULT_CTX pCtx;
+    PVOID pAddress;
+
+    ASSERT(NULL != Context);
+
+    pCtx = (PTST_VMM_FAULT_CTX) Context;
+
+    for (DWORD i = 0; i < pCtx->NumberOfTargets; ++i)
+    {
+        pAddress = pCtx->Reservations[pCtx->FirstTarget + i];
+
+        // the page is committed but not mapped => each write is solved by
+        // the page fault handler
+        *(volatile BYTE*)pAddress = TST_VMM_MAGIC_VALUE_TO_WRITE;
+
+        // unmap the page so the next iteration faults again
+        VmmFreeRegion(pAddress, PAGE_SIZE, VMM_FREE_TYPE_DECOMMIT);
+        if (NULL == VmmAllocRegion(pAddress, PAGE_SIZE, VMM_ALLOC_TYPE_COMMIT, PAGE_RIGHTS_READWRITE))
+        {
+            pCtx->Status = STATUS_MEMORY_CANNOT_BE_COMMITED;
+        }
+    }
+}
+
+void
+TestVmmAddressSpaceSwitchPerformance(
+    void
+    )
+{
+    TST_VMM_SWITCH_CTX ctx;
+    PERFORMANCE_STATS perfStats[2];
+    TLB_STATISTICS tlbStats[2];
+    STATUS status;
+    STATUS terminationStatus;
+    char fullPath[MAX_PATH];
+    const char* pSystemPartition;
+    BOOLEAN bPrevTagging;
+
+    memzero(&ctx, sizeof(TST_VMM_SWITCH_CTX));
+    memzero(perfStats, sizeof(perfStats));
+
+    pSystemPartition = IomuGetSystemPartitionPath();
+    if (NULL == pSystemPartition)
+    {
+        LOG_ERROR("Cannot create processes without knowing the system partition!\n");
+        return;
+    }
+
+    snprintf(fullPath, MAX_PATH,
+             "%s%s\\%s.exe", pSystemPartition, "APPLIC~1",
+             TST_VMM_SWITCH_PROCESS_NAME);
+
+    __try
+    {
+        for (DWORD i = 0; i < 2; ++i)
+        {
+            status = ProcessCreate(fullPath, NULL, &ctx.Processes[i]);
+            if (!SUCCEEDED(status))
+            {
+                LOG_FUNC_ERROR("ProcessCreate", status);
+                __leave;
+            }
+
+            // the address space lives for as long as we hold the handle
+            ProcessWaitForTermination(ctx.Processes[i], &terminationStatus);
+
+            // the pages are accessed with interrupts disabled, they must
+            // not fault
+            ctx.Buffers[i] = VmmAllocRegionEx(NULL,
+                                              TST_VMM_SWITCH_NO_OF_PAGES * PAGE_SIZE,
+                                              VMM_ALLOC_TYPE_RESERVE | VMM_ALLOC_TYPE_COMMIT | VMM_ALLOC_TYPE_NOT_LAZY,
+                                              PAGE_RIGHTS_READWRITE,
+                                              FALSE,
+                                              NULL,
+                                              ctx.Processes[i]->VaSpace,
+                                              ctx.Processes[i]->PagingData,
+                                              NULL
+                                              );
+            if (NULL == ctx.Buffers[i])
+            {
+                LOG_ERROR("VmmAllocRegionEx failed for process %u\n", i);
+                __leave;
+            }
+        }
+
+        for (DWORD i = 0; i < 2; ++i)
+        {
+            // the first run makes each switch flush the TLB as if the CPU
+            // had no PCIDs, the second one keeps the translations tagged
+            bPrevTagging = TlbSetAddressSpaceTagging((BOOLEAN) (0 != i));
+
+            TlbGetStatistics(&tlbStats[0]);
+
+            RunPerformanceFunction(_TstVmmSwitchAddressSpaces,
+                                   &ctx,
+                                   TST_VMM_SWITCH_ITERATION_COUNT,
+                                   TRUE,
+                                   &perfStats[i]
+                                   );
+
+            TlbGetStatistics(&tlbStats[1]);
+
+            TlbSetAddressSpaceTagging(bPrevTagging);
+
+            LOGL("%s: %U switches, %U kept the TLB\n",
+                 TST_VMM_SWITCH_STAT_NAMES[i],
+                 tlbStats[1].AddressSpaceSwitches - tlbStats[0].AddressSpaceSwitches,
+                 tlbStats[1].TaggedSwitches - tlbStats[0].TaggedSwitches);
+        }
+
+        LOGL("%u round trips between two processes touching %u pages each (us)\n",
+             TST_VMM_SWITCH_NO_OF_ROUND_TRIPS, TST_VMM_SWITCH_NO_OF_PAGES);
+        DisplayPerformanceStats(perfStats, 2, TST_VMM_SWITCH_STAT_NAMES);
+    }
+    __finally
+    {
+        for (DWORD i = 0; i < 2; ++i)
+        {
+            if (NULL != ctx.Buffers[i])
+            {
+                VmmFreeRegionEx(ctx.Buffers[i],
+                                0,
+                                VMM_FREE_TYPE_RELEASE,
+                                TRUE,
+                                ctx.Processes[i]->VaSpace,
+                                ctx.Processes[i]->PagingData
+                                );
+                ctx.Buffers[i] = NULL;
+            }
+
+            if (NULL != ctx.Processes[i])
+            {
+                ProcessCloseHandle(ctx.Processes[i]);
+                ctx.Processes[i] = NULL;
+            }
+        }
+    }
+}
+
+static
+void
+(__cdecl _TstVmmSwitchAddressSpaces)(
+    IN_OPT  PVOID       Context
+    )
+{
+    PTST_VMM_SWITCH_CTX pCtx;
+    INTR_STATE oldState;
+    QWORD sum;
+
+    ASSERT(NULL != Context);
+
+    pCtx = (PTST_VMM_SWITCH_CTX) Context;
+    sum = 0;
+
+    // the thread must not be scheduled out while the tables of another
+    // process are loaded
+    oldState = CpuIntrDisable();
+
+    for (DWORD i = 0; i < TST_VMM_SWITCH_NO_OF_ROUND_TRIPS; ++i)
+    {
+        for (DWORD j = 0; j < 2; ++j)
+        {
+            MmuChangeProcessSpace(pCtx->Processes[j]);
+
+            for (DWORD k = 0; k < TST_VMM_SWITCH_NO_OF_PAGES; ++k)
+            {
+                sum += *(volatile QWORD*)PtrOffset(pCtx->Buffers[j],
+                                                   (QWORD) k * PAGE_SIZE + AddressOffset(k * 64, PAGE_SIZE));
+            }
+        }
+    }
+
+    MmuChangeProcessSpace(GetCurrentThread()->Process);
+
+    CpuIntrSetState(oldState);
+
+    pCtx->Sum = pCtx->Sum + sum;
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include "isr.h"
 #include "gdtmu.h"
 #include "pe_exports.h"
+#include "ex_system.h"
 
 #define TID_INCREMENT               4
 
@@ -19,24 +20,41 @@ extern void ThreadStart();
 typedef
 void
 (__cdecl FUNC_ThreadSwitch)(
-    OUT_PTR         PVOID*          OldStack,
-    IN              PVOID           NewStack
+    OUT_PTR         PVOID*                  OldStack,
+    IN              PVOID                   NewStack,
+    OUT             PXSAVE_LEGACY_REGION    OldFpuState,
+    IN              PXSAVE_LEGACY_REGION    NewFpuState
     );
 
 extern FUNC_ThreadSwitch            ThreadSwitch;
 
+#pragma warning(push)
+
+// warning C4324: structure was padded due to alignment specifier
+#pragma warning(disable:4324)
+
+// The ready list is taken on each schedule while the list of all the threads
+// only on thread creation and termination, each lock and its list have their
+// own cache lines so the CPUs spinning on one lock do not slow down the other
 typedef struct _THREAD_SYSTEM_DATA
 {
+    __declspec(align(CACHE_LINE_SIZE))
     LOCK                AllThreadsLock;
 
     _Guarded_by_(AllThreadsLock)
     LIST_ENTRY          AllThreadsList;
 
+    __declspec(align(CACHE_LINE_SIZE))
     LOCK                ReadyThreadsLock;
 
     _Guarded_by_(ReadyThreadsLock)
     LIST_ENTRY          ReadyThreadsList;
 } THREAD_SYSTEM_DATA, *PTHREAD_SYSTEM_DATA;
+STATIC_ASSERT(FIELD_OFFSET(THREAD_SYSTEM_DATA, AllThreadsLock) % CACHE_LINE_SIZE == 0);
+STATIC_ASSERT(FIELD_OFFSET(THREAD_SYSTEM_DATA, ReadyThreadsLock) % CACHE_LINE_SIZE == 0);
+STATIC_ASSERT(FIELD_OFFSET(THREAD_SYSTEM_DATA, AllThreadsList) + sizeof(LIST_ENTRY) <= FIELD_OFFSET(THREAD_SYSTEM_DATA, ReadyThreadsLock));
+STATIC_ASSERT(sizeof(THREAD_SYSTEM_DATA) % CACHE_LINE_SIZE == 0);
+#pragma warning(pop)
 
 static THREAD_SYSTEM_DATA m_threadSystemData;
 
@@ -441,6 +459,9 @@ ThreadTick(
     }
     pThread->TickCountCompleted++;
 
+    // the interrupt was taken => no RCU reader is active on this CPU
+    ExRcuReportQuiescentState();
+
     if (++pCpu->ThreadData.RunningThreadTicks >= THREAD_TIME_SLICE)
     {
         LOG_TRACE_THREAD("Will yield on return\n");
@@ -745,10 +766,12 @@ _ThreadInit(
 
         RfcPreInit(&pThread->RefCnt);
 
-        status = RfcInit(&pThread->RefCnt, _ThreadDestroy, NULL);
+        // the creator and the thread itself usually release their
+        // references on the CPU on which the thread was created
+        status = RfcInitBiased(&pThread->RefCnt, _ThreadDestroy, NULL, &GetCurrentPcpuFast()->RfcOwner);
         if (!SUCCEEDED(status))
         {
-            LOG_FUNC_ERROR("RfcInit", status);
+            LOG_FUNC_ERROR("RfcInitBiased", status);
             __leave;
         }
 
@@ -783,6 +806,11 @@ _ThreadInit(
 
         strcpy(pThread->Name, Name);
 
+        // a new thread starts with the FPU and SSE exceptions masked, the
+        // running thread initialized here overwrites this on its first switch
+        pThread->FpuState.ControlWord = FPU_DEFAULT_CONTROL_WORD;
+        pThread->FpuState.MxCsr = FPU_DEFAULT_MXCSR;
+
         pThread->Id = _ThreadSystemGetNextTid();
         pThread->State = ThreadStateBlocked;
         pThread->Priority = Priority;
@@ -1014,7 +1042,7 @@ _ThreadSchedule(
 
         if (pCurrentThread->Process != pNextThread->Process)
         {
-            MmuChangeProcessSpace(pCurrentThread->Process);
+            MmuChangeProcessSpace(pNextThread->Process);
         }
 
         // Before any thread is scheduled it executes this function, thus if we set the current
@@ -1024,7 +1052,7 @@ _ThreadSchedule(
         pCurrentThread->UninterruptedTicks = 0;
 
         SetCurrentThread(pNextThread);
-        ThreadSwitch( &pCurrentThread->Stack, pNextThread->Stack);
+        ThreadSwitch( &pCurrentThread->Stack, pNextThread->Stack, &pCurrentThread->FpuState, &pNextThread->FpuState);
 
         ASSERT(INTR_OFF == CpuIntrGetState());
 
@@ -1095,6 +1123,10 @@ ThreadCleanupPostSchedule(
             GetCurrentPcpu()->ThreadData.PreviousThread = NULL;
         }
     }
+
+    // the threads biased towards this CPU and released by other CPUs are
+    // freed here, same as the dying threads above
+    RfcOwnerProcessMergeRequests(&GetCurrentPcpuFast()->RfcOwner);
 }
 
 static
@@ -1185,9 +1217,14 @@ _ThreadReference(
     INOUT   PTHREAD                 Thread
     )
 {
+    INTR_STATE oldState;
+
     ASSERT( NULL != Thread );
 
-    RfcReference(&Thread->RefCnt);
+    // the thread can't be moved to another CPU while it acts as the owner
+    oldState = CpuIntrDisable();
+    RfcReferenceEx(&Thread->RefCnt, &GetCurrentPcpuFast()->RfcOwner);
+    CpuIntrSetState(oldState);
 }
 
 static
@@ -1196,9 +1233,21 @@ _ThreadDereference(
     INOUT   PTHREAD                 Thread
     )
 {
+    INTR_STATE oldState;
+    BOOLEAN bLastReference;
+
     ASSERT( NULL != Thread );
 
-    RfcDereference(&Thread->RefCnt);
+    // only the owner check and the count update need interrupts disabled,
+    // _ThreadDestroy unmaps memory and must run in the state of the caller
+    oldState = CpuIntrDisable();
+    bLastReference = RfcDereferenceNoFree(&Thread->RefCnt, &GetCurrentPcpuFast()->RfcOwner);
+    CpuIntrSetState(oldState);
+
+    if (bLastReference)
+    {
+        RfcFree(&Thread->RefCnt);
+    }
 }
 
 static
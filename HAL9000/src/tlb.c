@@ -0,0 +1,671 @@
+#include "HAL9000.h"
+#include "tlb.h"
+#include "smp.h"
+#include "cpumu.h"
+#include "vmm.h"
+
+typedef struct _TLB_DATA
+{
+    // per-CPU counters, the flushes happen on all the CPUs
+    PERCPU_COUNTER          Shootdowns;
+    PERCPU_COUNTER          IpisSent;
+    PERCPU_COUNTER          FullFlushes;
+    PERCPU_COUNTER          PagesInvalidated;
+
+    volatile QWORD          NextContextId;
+
+    volatile BOOLEAN        TaggingDisabled;
+} TLB_DATA, *PTLB_DATA;
+
+static TLB_DATA m_tlbData;
+
+static FUNC_IpcProcessEvent     _TlbProcessShootdown;
+static FUNC_FreeFunction        _TlbSignalShootdownCompletion;
+
+static
+void
+_TlbInvalidateOnCurrentCpu(
+    IN      PTLB_SHOOTDOWN_BATCH    Batch
+    );
+
+static
+void
+_TlbFlushAllContexts(
+    void
+    );
+
+__forceinline
+static
+BYTE
+_TlbFindPcidSlot(
+    IN      PPCID_DATA              PcidData,
+    IN      QWORD                   ContextId
+    )
+{
+    BYTE i;
+
+    for (i = 0; i < CPU_NO_OF_PCID_SLOTS; ++i)
+    {
+        if (PcidData->Slots[i].ContextId == ContextId)
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+__forceinline
+static
+BYTE
+_TlbSelectVictimPcidSlot(
+    IN      PPCID_DATA              PcidData
+    )
+{
+    BYTE victim;
+
+    // the slots never used have the smallest LastUse
+    victim = 0;
+    for (BYTE i = 1; i < CPU_NO_OF_PCID_SLOTS; ++i)
+    {
+        if (PcidData->Slots[i].LastUse < PcidData->Slots[victim].LastUse)
+        {
+            victim = i;
+        }
+    }
+
+    return victim;
+}
+
+__forceinline
+static
+DWORD
+_TlbCountCpus(
+    IN      CPU_AFFINITY            Affinity
+    )
+{
+    DWORD noOfCpus;
+
+    for (noOfCpus = 0; Affinity != 0; Affinity = (CPU_AFFINITY) (Affinity & (Affinity - 1)))
+    {
+        noOfCpus++;
+    }
+
+    return noOfCpus;
+}
+
+_No_competing_thread_
+void
+TlbPreinit(
+    void
+    )
+{
+    PerCpuCounterRegister("tlb.shootdowns", &m_tlbData.Shootdowns);
+    PerCpuCounterRegister("tlb.ipis_sent", &m_tlbData.IpisSent);
+    PerCpuCounterRegister("tlb.full_flushes", &m_tlbData.FullFlushes);
+    PerCpuCounterRegister("tlb.pages_invalidated", &m_tlbData.PagesInvalidated);
+}
+
+void
+TlbBatchInit(
+    OUT     PTLB_SHOOTDOWN_BATCH    Batch,
+    IN      PPAGING_DATA            PagingData
+    )
+{
+    ASSERT(NULL != Batch);
+    ASSERT(NULL != PagingData);
+
+    Batch->PagingData = PagingData;
+    Batch->FlushAll = FALSE;
+    Batch->NumberOfPages = 0;
+    Batch->NumberOfRanges = 0;
+    Batch->NumberOfFrameRuns = 0;
+    Batch->Generation = 0;
+    Batch->FreedPagingStructures = NULL;
+}
+
+void
+TlbBatchAddRange(
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch,
+    IN      PVOID                   VirtualAddress,
+    IN      QWORD                   Size
+    )
+{
+    QWORD noOfPages;
+    PTLB_RANGE pLastRange;
+
+    ASSERT(NULL != Batch);
+    ASSERT(IsAddressAligned(VirtualAddress, PAGE_SIZE));
+    ASSERT(0 != Size && IsAddressAligned(Size, PAGE_SIZE));
+
+    noOfPages = Size / PAGE_SIZE;
+    Batch->NumberOfPages = Batch->NumberOfPages + noOfPages;
+
+    if (Batch->FlushAll)
+    {
+        return;
+    }
+
+    if (Batch->NumberOfPages > TLB_SHOOTDOWN_FULL_FLUSH_THRESHOLD)
+    {
+        Batch->FlushAll = TRUE;
+        return;
+    }
+
+    if (0 != Batch->NumberOfRanges)
+    {
+        pLastRange = &Batch->Ranges[Batch->NumberOfRanges - 1];
+
+        if (PtrOffset(pLastRange->BaseAddress, pLastRange->NumberOfPages * PAGE_SIZE) == VirtualAddress)
+        {
+            pLastRange->NumberOfPages = pLastRange->NumberOfPages + noOfPages;
+            return;
+        }
+    }
+
+    if (TLB_SHOOTDOWN_MAX_RANGES == Batch->NumberOfRanges)
+    {
+        Batch->FlushAll = TRUE;
+        return;
+    }
+
+    Batch->Ranges[Batch->NumberOfRanges].BaseAddress = VirtualAddress;
+    Batch->Ranges[Batch->NumberOfRanges].NumberOfPages = noOfPages;
+    Batch->NumberOfRanges++;
+}
+
+void
+TlbBatchAddFramesToRelease(
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      DWORD                   NumberOfFrames
+    )
+{
+    PTLB_FRAME_RUN pLastRun;
+
+    ASSERT(NULL != Batch);
+    ASSERT(IsAddressAligned(PhysicalAddress, PAGE_SIZE));
+    ASSERT(0 != NumberOfFrames);
+
+    if (0 != Batch->NumberOfFrameRuns)
+    {
+        pLastRun = &Batch->FrameRuns[Batch->NumberOfFrameRuns - 1];
+
+        // most unmapped regions were backed by contiguous frames
+        if (PtrOffset(pLastRun->BaseAddress, (QWORD) pLastRun->NumberOfFrames * PAGE_SIZE) == PhysicalAddress)
+        {
+            pLastRun->NumberOfFrames = pLastRun->NumberOfFrames + NumberOfFrames;
+            return;
+        }
+    }
+
+    ASSERT(!TlbBatchIsFull(Batch));
+
+    Batch->FrameRuns[Batch->NumberOfFrameRuns].BaseAddress = PhysicalAddress;
+    Batch->FrameRuns[Batch->NumberOfFrameRuns].NumberOfFrames = NumberOfFrames;
+    Batch->NumberOfFrameRuns++;
+}
+
+BOOLEAN
+TlbBatchIsFull(
+    IN      PTLB_SHOOTDOWN_BATCH    Batch
+    )
+{
+    ASSERT(NULL != Batch);
+
+    return TLB_SHOOTDOWN_MAX_FRAME_RUNS == Batch->NumberOfFrameRuns;
+}
+
+void
+TlbBatchFlush(
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch
+    )
+{
+    PPAGING_DATA pPagingData;
+    INTR_STATE oldState;
+    PPCPU pCpu;
+    CPU_AFFINITY targetCpus;
+    SMP_IPI_SEND_MODE sendMode;
+    SMP_DESTINATION destination = { 0 };
+    DWORD noOfTargetCpus;
+    volatile BOOLEAN bRemoteFlushDone;
+    STATUS status;
+
+    ASSERT(NULL != Batch);
+
+    if (0 == Batch->NumberOfPages)
+    {
+        ASSERT(0 == Batch->NumberOfFrameRuns);
+        return;
+    }
+
+    pPagingData = Batch->PagingData;
+    ASSERT(NULL != pPagingData);
+
+    noOfTargetCpus = 0;
+    sendMode = SmpIpiSendToAllExcludingSelf;
+    bRemoteFlushDone = FALSE;
+
+    // The thread must not move to another CPU between the moment we decide
+    // which CPUs to interrupt and the moment the IPIs are sent, else the CPU
+    // we started on would be excluded from the shootdown. The VMM invalidated
+    // the translations on the CPU which changed them, but that may not be the
+    // one we are running on now => the current CPU is always flushed.
+    oldState = CpuIntrDisable();
+
+    // The generation is incremented before the CPUs which have the tables
+    // loaded are read, TlbActivateAddressSpace does the opposite => a CPU
+    // switching to the address space either sees the new generation and
+    // flushes its PCID or is interrupted.
+    Batch->Generation = pPagingData->KernelSpace ? 0 : (QWORD) _InterlockedIncrement64(&pPagingData->TlbGeneration);
+
+    _TlbInvalidateOnCurrentCpu(Batch);
+
+    if (pPagingData->KernelSpace)
+    {
+        // kernel mappings are global and shared by all the address spaces
+        // => any CPU may have them cached
+        if (SmpGetNumberOfActiveCpus() > 1)
+        {
+            sendMode = SmpIpiSendToAllExcludingSelf;
+            noOfTargetCpus = SmpGetNumberOfActiveCpus() - 1;
+        }
+    }
+    else
+    {
+        pCpu = GetCurrentPcpu();
+
+        targetCpus = pPagingData->ActiveCpus;
+        if (NULL != pCpu)
+        {
+            targetCpus = (CPU_AFFINITY) (targetCpus & ~pCpu->LogicalApicId);
+        }
+
+        if (0 != targetCpus)
+        {
+            sendMode = SmpIpiSendToGroup;
+            destination.Group.Affinity = targetCpus;
+            noOfTargetCpus = _TlbCountCpus(targetCpus);
+        }
+    }
+
+    if (0 != noOfTargetCpus)
+    {
+        // we can't wait for handling with interrupts disabled: if another CPU
+        // is waiting for its own shootdown to be handled by us we would
+        // deadlock => we are signaled when the IPC event is freed, i.e. after
+        // all the CPUs processed it
+        status = SmpSendGenericIpiEx(_TlbProcessShootdown,
+                                     Batch,
+                                     _TlbSignalShootdownCompletion,
+                                     (PVOID) &bRemoteFlushDone,
+                                     FALSE,
+                                     sendMode,
+                                     destination);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("SmpSendGenericIpiEx", status);
+            noOfTargetCpus = 0;
+        }
+    }
+
+    CpuIntrSetState(oldState);
+
+    if (0 != noOfTargetCpus)
+    {
+        while (!bRemoteFlushDone)
+        {
+            if (INTR_OFF == oldState)
+            {
+                // we can't take the IPC interrupt, if a target CPU is waiting
+                // for its own shootdown to be processed by us neither of us
+                // would progress => process the shootdowns sent to us here,
+                // they touch only the TLB
+                SmpProcessPendingIpcEvents(_TlbProcessShootdown);
+            }
+
+            _mm_pause();
+        }
+
+        PerCpuCounterIncrement(m_tlbData.Shootdowns);
+        PerCpuCounterAdd(m_tlbData.IpisSent, noOfTargetCpus);
+    }
+
+    if (Batch->FlushAll)
+    {
+        PerCpuCounterIncrement(m_tlbData.FullFlushes);
+    }
+    PerCpuCounterAdd(m_tlbData.PagesInvalidated, Batch->NumberOfPages);
+
+    // no CPU can reach the frames any more
+    for (DWORD i = 0; i < Batch->NumberOfFrameRuns; ++i)
+    {
+        MmuReleaseMemory(Batch->FrameRuns[i].BaseAddress, Batch->FrameRuns[i].NumberOfFrames);
+    }
+
+    // the paging structures are reclaimed by the caller under the paging lock
+    Batch->FlushAll = FALSE;
+    Batch->NumberOfPages = 0;
+    Batch->NumberOfRanges = 0;
+    Batch->NumberOfFrameRuns = 0;
+}
+
+void
+TlbInitAddressSpace(
+    OUT     PPAGING_DATA            PagingData
+    )
+{
+    ASSERT(NULL != PagingData);
+
+    PagingData->ActiveCpus = 0;
+    PagingData->ContextId = (QWORD) _InterlockedIncrement64(&m_tlbData.NextContextId);
+    PagingData->TlbGeneration = 0;
+}
+
+void
+TlbActivateAddressSpace(
+    INOUT   PPAGING_DATA            PagingData,
+    IN      BOOLEAN                 Invalidate
+    )
+{
+    PPCPU pCpu;
+    PPCID_DATA pPcidData;
+    PPCID_SLOT pSlot;
+    PPAGING_DATA pPrevPagingData;
+    QWORD generation;
+    BYTE slotIndex;
+    BOOLEAN bInvalidate;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(INTR_OFF == CpuIntrGetState());
+
+    pCpu = GetCurrentPcpu();
+    if (NULL == pCpu)
+    {
+        // the CPU structures are not yet initialized => we're the only CPU
+        // running and there are no PCIDs to manage
+        VmmChangeCr3(PagingData->BasePhysicalAddress, PCID_FIRST_VALID_VALUE, TRUE);
+        return;
+    }
+
+    pPcidData = &pCpu->PcidData;
+    pPrevPagingData = pPcidData->ActivePagingData;
+
+    // The bit is set before CR3 is loaded so any change to the paging
+    // structures we may walk is followed by an IPI. The locked operation
+    // also orders the write before the read of the generation, see
+    // TlbBatchFlush. If the bit is already set the tables are loaded.
+    if (!IsBooleanFlagOn(PagingData->ActiveCpus, pCpu->LogicalApicId))
+    {
+        _InterlockedOr8((volatile char*) &PagingData->ActiveCpus, (char) pCpu->LogicalApicId);
+    }
+
+    if (pPrevPagingData != PagingData)
+    {
+        pPcidData->AddressSpaceSwitches++;
+    }
+
+    if (!IsBooleanFlagOn(__readcr4(), CR4_PCIDE))
+    {
+        // the CR3 load flushes the TLB anyway, the PCID bits have a different
+        // meaning and must remain clear
+        VmmChangeCr3(PagingData->BasePhysicalAddress, PCID_FIRST_VALID_VALUE, TRUE);
+    }
+    else
+    {
+        generation = PagingData->TlbGeneration;
+        bInvalidate = Invalidate || m_tlbData.TaggingDisabled;
+
+        slotIndex = _TlbFindPcidSlot(pPcidData, PagingData->ContextId);
+        if (CPU_NO_OF_PCID_SLOTS == slotIndex)
+        {
+            // The PCID of the least recently used address space is taken
+            // over, nothing needs to be done for its previous owner: when it
+            // is loaded again it will not find its context ID in the slot.
+            slotIndex = _TlbSelectVictimPcidSlot(pPcidData);
+            if (0 != pPcidData->Slots[slotIndex].ContextId)
+            {
+                pPcidData->PcidsRecycled++;
+            }
+
+            pPcidData->Slots[slotIndex].ContextId = PagingData->ContextId;
+            bInvalidate = TRUE;
+        }
+        else if (pPcidData->Slots[slotIndex].Generation != generation)
+        {
+            // translations were invalidated while the CPU was not using
+            // the tables and it was not interrupted
+            bInvalidate = TRUE;
+        }
+
+        pSlot = &pPcidData->Slots[slotIndex];
+        pSlot->Generation = generation;
+        pSlot->LastUse = pPcidData->AddressSpaceSwitches;
+        pPcidData->ActiveSlot = slotIndex;
+
+        if (pPrevPagingData != PagingData && !bInvalidate)
+        {
+            pPcidData->TaggedSwitches++;
+        }
+
+        VmmChangeCr3(PagingData->BasePhysicalAddress,
+                     (PCID) (PCID_FIRST_VALID_VALUE + slotIndex),
+                     bInvalidate);
+    }
+
+    pPcidData->ActivePagingData = PagingData;
+
+    if (NULL != pPrevPagingData && pPrevPagingData != PagingData)
+    {
+        // The translations of the previous tables remain tagged with their
+        // PCID, the CPU is no longer interrupted when they change and relies
+        // on the generation to find out if they must be flushed. The tables
+        // cannot be freed while loaded => they are still valid here.
+        _InterlockedAnd8((volatile char*) &pPrevPagingData->ActiveCpus, (char) ~pCpu->LogicalApicId);
+    }
+}
+
+BOOLEAN
+TlbSetAddressSpaceTagging(
+    IN      BOOLEAN                 Enable
+    )
+{
+    return !_InterlockedExchange8((volatile char*) &m_tlbData.TaggingDisabled, !Enable);
+}
+
+void
+TlbGetStatistics(
+    OUT     PTLB_STATISTICS         Statistics
+    )
+{
+    PLIST_ENTRY pCpuList;
+
+    ASSERT(NULL != Statistics);
+
+    Statistics->Shootdowns = PerCpuCounterRead(m_tlbData.Shootdowns);
+    Statistics->IpisSent = PerCpuCounterRead(m_tlbData.IpisSent);
+    Statistics->FullFlushes = PerCpuCounterRead(m_tlbData.FullFlushes);
+    Statistics->PagesInvalidated = PerCpuCounterRead(m_tlbData.PagesInvalidated);
+
+    Statistics->AddressSpaceSwitches = 0;
+    Statistics->TaggedSwitches = 0;
+    Statistics->PcidsRecycled = 0;
+
+    SmpGetCpuList(&pCpuList);
+
+    for (PLIST_ENTRY pEntry = pCpuList->Flink; pEntry != pCpuList; pEntry = pEntry->Flink)
+    {
+        PPCPU pCpu = CONTAINING_RECORD(pEntry, PCPU, ListEntry);
+
+        Statistics->AddressSpaceSwitches += pCpu->PcidData.AddressSpaceSwitches;
+        Statistics->TaggedSwitches += pCpu->PcidData.TaggedSwitches;
+        Statistics->PcidsRecycled += pCpu->PcidData.PcidsRecycled;
+    }
+}
+
+static
+STATUS
+(__cdecl _TlbProcessShootdown)(
+    IN_OPT  PVOID       Context
+    )
+{
+    ASSERT(NULL != Context);
+
+    _TlbInvalidateOnCurrentCpu(Context);
+
+    return STATUS_SUCCESS;
+}
+
+static
+void
+(__cdecl _TlbSignalShootdownCompletion)(
+    IN      PVOID       Object,
+    IN_OPT  PVOID       Context
+    )
+{
+    volatile BOOLEAN* pDone;
+
+    UNREFERENCED_PARAMETER(Object);
+    ASSERT(NULL != Context);
+
+    pDone = Context;
+
+    *pDone = TRUE;
+}
+
+static
+void
+_TlbInvalidateOnCurrentCpu(
+    IN      PTLB_SHOOTDOWN_BATCH    Batch
+    )
+{
+    PPAGING_DATA pPagingData;
+    PPCPU pCpu;
+    PPCID_SLOT pSlot;
+    INVPCID_DESCRIPTOR descriptor = { 0 };
+    BYTE slotIndex;
+
+    ASSERT(NULL != Batch);
+
+    pPagingData = Batch->PagingData;
+
+    if (pPagingData->KernelSpace)
+    {
+        // the kernel translations are global => they are not tagged with
+        // the PCIDs and INVLPG invalidates them
+        if (!Batch->FlushAll)
+        {
+            for (DWORD i = 0; i < Batch->NumberOfRanges; ++i)
+            {
+                for (QWORD j = 0; j < Batch->Ranges[i].NumberOfPages; ++j)
+                {
+                    __invlpg(PtrOffset(Batch->Ranges[i].BaseAddress, j * PAGE_SIZE));
+                }
+            }
+        }
+        else
+        {
+            _TlbFlushAllContexts();
+        }
+
+        return;
+    }
+
+    pCpu = GetCurrentPcpu();
+    slotIndex = (NULL != pCpu) ? _TlbFindPcidSlot(&pCpu->PcidData, pPagingData->ContextId) : CPU_NO_OF_PCID_SLOTS;
+
+    if (AlignAddressLower(__readcr3(), PAGE_SIZE) == (QWORD) pPagingData->BasePhysicalAddress)
+    {
+        if (!Batch->FlushAll)
+        {
+            for (DWORD i = 0; i < Batch->NumberOfRanges; ++i)
+            {
+                for (QWORD j = 0; j < Batch->Ranges[i].NumberOfPages; ++j)
+                {
+                    __invlpg(PtrOffset(Batch->Ranges[i].BaseAddress, j * PAGE_SIZE));
+                }
+            }
+        }
+        else
+        {
+            // Intel System Programming Manual Vol 3C
+            // Section 4.10.4.1 Operations that Invalidate TLBs and Paging-Structure Caches
+            // Reloading CR3 invalidates the non-global translations of the current PCID
+            __writecr3(__readcr3());
+        }
+    }
+    else if (CPU_NO_OF_PCID_SLOTS == slotIndex)
+    {
+        // none of the PCIDs of the CPU is tagged with the address space
+        return;
+    }
+    else if (CpuMuIsInvpcidSupported())
+    {
+        // the CPU switched away from the tables after the IPI was sent, the
+        // translations are invalidated now so the next switch back does not
+        // have to flush the whole PCID
+        descriptor.PCID = (PCID) (PCID_FIRST_VALID_VALUE + slotIndex);
+
+        if (Batch->FlushAll)
+        {
+            _invpcid(INVPCID_SINGLE_CONTEXT, &descriptor);
+        }
+        else
+        {
+            for (DWORD i = 0; i < Batch->NumberOfRanges; ++i)
+            {
+                for (QWORD j = 0; j < Batch->Ranges[i].NumberOfPages; ++j)
+                {
+                    descriptor.LinearAddress = (QWORD) PtrOffset(Batch->Ranges[i].BaseAddress, j * PAGE_SIZE);
+                    _invpcid(INVPCID_INDIVIDUAL_ADDRESS, &descriptor);
+                }
+            }
+        }
+    }
+    else
+    {
+        // the generation of the slot is older than the one of the batch =>
+        // the PCID is flushed when the CPU switches back to the tables
+        return;
+    }
+
+    if (CPU_NO_OF_PCID_SLOTS == slotIndex)
+    {
+        return;
+    }
+
+    // The cached translations reflect the changes of this batch, they also
+    // reflect the changes of all the previous ones only if the slot was up
+    // to date with the generation right before it. Batches of concurrent
+    // flushes may arrive out of order, in which case the slot is left behind
+    // and the PCID is flushed on the next switch.
+    pSlot = &pCpu->PcidData.Slots[slotIndex];
+    if (pSlot->Generation + 1 == Batch->Generation)
+    {
+        pSlot->Generation = Batch->Generation;
+    }
+}
+
+static
+void
+_TlbFlushAllContexts(
+    void
+    )
+{
+    INVPCID_DESCRIPTOR descriptor = { 0 };
+    QWORD cr4;
+
+    if (CpuMuIsInvpcidSupported())
+    {
+        _invpcid(INVPCID_ALL_CONTEXTS_INCLUDING_GLOBAL, &descriptor);
+        return;
+    }
+
+    // Intel System Programming Manual Vol 3C
+    // Section 4.10.4.1 Operations that Invalidate TLBs and Paging-Structure Caches
+    // A MOV to CR4 which modifies CR4.PGE invalidates all the TLB entries,
+    // including the global ones, for all the PCIDs
+    cr4 = __readcr4();
+    __writecr4(cr4 ^ CR4_PGE);
+    __writecr4(cr4);
+}
\ No newline at end of file
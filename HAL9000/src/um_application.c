@@ -5,6 +5,58 @@
 #include "vmm.h"
 #include "thread_internal.h"
 #include "process_internal.h"
+#include "mutex.h"
+
+// An image read from disk, its frames are shared by all the processes
+// running it
+typedef struct _UM_APPLICATION_IMAGE
+{
+    // ListEntry, ReferenceCount and Stale are protected by the ImageListLock
+    LIST_ENTRY              ListEntry;
+
+    // Number of processes created from the image, it is freed once the last
+    // one is destroyed if it was dropped from the cache in the meantime
+    DWORD                   ReferenceCount;
+    BOOLEAN                 Stale;
+
+    char*                   Path;
+
+    // Copied from the file when it was read, a cached image is used only
+    // while the file on disk still matches them
+    QWORD                   FileSize;
+    DATETIME                LastWriteTime;
+
+    // ImageBase is the kernel mapping of the file contents, its frames are
+    // mapped in the processes
+    PE_NT_HEADER_INFO       HeaderInfo;
+} UM_APPLICATION_IMAGE, *PUM_APPLICATION_IMAGE;
+
+typedef struct _UM_APPLICATION_DATA
+{
+    // Held while an image is read from disk so it is read only once even if
+    // several processes are created from it at the same time
+    MUTEX                   ImageListLock;
+
+    _Guarded_by_(ImageListLock)
+    LIST_ENTRY              ImageList;
+} UM_APPLICATION_DATA, *PUM_APPLICATION_DATA;
+
+static UM_APPLICATION_DATA m_umApplicationData;
+
+static
+STATUS
+_UmApplicationLoadImage(
+    IN_Z        char*                   Path,
+    IN          PFILE_INFORMATION       FileInformation,
+    OUT_PTR     PUM_APPLICATION_IMAGE*  Image
+    );
+
+static
+STATUS
+_UmApplicationQueryExecutableInformation(
+    IN_Z        char*                   FullPath,
+    OUT         PFILE_INFORMATION       FileInformation
+    );
 
 static
 STATUS
@@ -21,15 +73,35 @@ _UmApplicationDiscardKernelExecutableMapping(
     IN          PVOID       ApplicationBuffer
     );
 
+static
+void
+_UmApplicationFreeImage(
+    IN          PUM_APPLICATION_IMAGE   Image
+    );
+
+_No_competing_thread_
+void
+UmApplicationPreinit(
+    void
+    )
+{
+    memzero(&m_umApplicationData, sizeof(UM_APPLICATION_DATA));
+
+    MutexInit(&m_umApplicationData.ImageListLock, FALSE);
+    InitializeListHead(&m_umApplicationData.ImageList);
+}
+
 STATUS
 UmApplicationRetrieveHeader(
     IN_Z        char*                   Path,
-    OUT         PPE_NT_HEADER_INFO      NtHeaderInfo
+    OUT         PPE_NT_HEADER_INFO      NtHeaderInfo,
+    OUT_PTR     PUM_APPLICATION_IMAGE*  Image
     )
 {
     STATUS status;
-    QWORD peSize;
-    PVOID pBuffer;
+    PUM_APPLICATION_IMAGE pImage;
+    PUM_APPLICATION_IMAGE pStaleImage;
+    FILE_INFORMATION fileInfo;
 
     if (Path == NULL)
     {
@@ -41,57 +113,119 @@ UmApplicationRetrieveHeader(
         return STATUS_INVALID_PARAMETER2;
     }
 
+    if (Image == NULL)
+    {
+        return STATUS_INVALID_PARAMETER3;
+    }
+
     LOG_FUNC_START;
 
-    pBuffer = NULL;
     status = STATUS_SUCCESS;
-    peSize = 0;
+    pImage = NULL;
+    pStaleImage = NULL;
     memzero(NtHeaderInfo, sizeof(PE_NT_HEADER_INFO));
 
-    __try
+    MutexAcquire(&m_umApplicationData.ImageListLock);
+
+    status = _UmApplicationQueryExecutableInformation(Path, &fileInfo);
+    if (!SUCCEEDED(status))
     {
-        LOG_TRACE_USERMODE("Will open executable found at [%s]\n", Path);
+        LOG_FUNC_ERROR("_UmApplicationQueryExecutableInformation", status);
+    }
 
-        status = _UmApplicationReadExecutableContents(Path,
-                                                      &pBuffer,
-                                                      &peSize);
-        if (!SUCCEEDED(status))
+    for (PLIST_ENTRY pEntry = m_umApplicationData.ImageList.Flink;
+         SUCCEEDED(status) && pEntry != &m_umApplicationData.ImageList;
+         pEntry = pEntry->Flink)
+    {
+        PUM_APPLICATION_IMAGE pCurrentImage = CONTAINING_RECORD(pEntry, UM_APPLICATION_IMAGE, ListEntry);
+
+        if (0 != stricmp(pCurrentImage->Path, Path))
         {
-            LOG_FUNC_ERROR("_UmApplicationReadExecutableContents", status);
-            __leave;
+            continue;
         }
 
-        LOG_TRACE_USERMODE("Will parse NT header!\n");
-
-        ASSERT(peSize <= MAX_DWORD);
-        status = PeRetrieveNtHeader(pBuffer,
-                                    (DWORD)peSize,
-                                    NtHeaderInfo);
-        if (!SUCCEEDED(status))
+        if (pCurrentImage->FileSize != fileInfo.FileSize ||
+            0 != memcmp(&pCurrentImage->LastWriteTime, &fileInfo.LastWriteTime, sizeof(DATETIME)))
         {
-            LOG_FUNC_ERROR("PeRetrieveNtHeader", status);
-            __leave;
+            // The file changed since it was read: the stale image is dropped
+            // from the cache, it is freed by the last process started from
+            // it or right away if there is none
+            LOG_TRACE_USERMODE("Executable [%s] changed on disk, will read it again\n", Path);
+            RemoveEntryList(&pCurrentImage->ListEntry);
+            pCurrentImage->Stale = TRUE;
+            if (0 == pCurrentImage->ReferenceCount)
+            {
+                pStaleImage = pCurrentImage;
+            }
+            break;
         }
 
-        LOG_TRACE_USERMODE("Successfully parsed NT header!\n");
+        LOG_TRACE_USERMODE("Executable [%s] is already loaded at 0x%X\n", Path, pCurrentImage->HeaderInfo.ImageBase);
+        pImage = pCurrentImage;
+        break;
     }
-    __finally
+
+    if (SUCCEEDED(status) && NULL == pImage)
     {
-        if (!SUCCEEDED(status))
+        status = _UmApplicationLoadImage(Path, &fileInfo, &pImage);
+        if (SUCCEEDED(status))
         {
-            if (pBuffer != NULL)
-            {
-                _UmApplicationDiscardKernelExecutableMapping(pBuffer);
-                pBuffer = NULL;
-            }
+            InsertTailList(&m_umApplicationData.ImageList, &pImage->ListEntry);
+        }
+        else
+        {
+            LOG_FUNC_ERROR("_UmApplicationLoadImage", status);
         }
     }
 
+    if (SUCCEEDED(status))
+    {
+        // keeps the image alive after the lock is released, its header is
+        // never modified once it is cached
+        pImage->ReferenceCount++;
+    }
+    MutexRelease(&m_umApplicationData.ImageListLock);
+
+    if (NULL != pStaleImage)
+    {
+        _UmApplicationFreeImage(pStaleImage);
+        pStaleImage = NULL;
+    }
+
+    if (SUCCEEDED(status))
+    {
+        memcpy(NtHeaderInfo, &pImage->HeaderInfo, sizeof(PE_NT_HEADER_INFO));
+        *Image = pImage;
+    }
+
     LOG_FUNC_END;
 
     return status;
 }
 
+void
+UmApplicationReleaseImage(
+    IN          PUM_APPLICATION_IMAGE   Image
+    )
+{
+    BOOLEAN bFree;
+
+    ASSERT(Image != NULL);
+
+    MutexAcquire(&m_umApplicationData.ImageListLock);
+    ASSERT(Image->ReferenceCount > 0);
+    Image->ReferenceCount--;
+
+    // a cached image is kept for the next processes even if none uses it
+    bFree = Image->Stale && (0 == Image->ReferenceCount);
+    MutexRelease(&m_umApplicationData.ImageListLock);
+
+    if (bFree)
+    {
+        _UmApplicationFreeImage(Image);
+    }
+}
+
 STATUS
 UmApplicationRun(
     IN          PPROCESS                Process,
@@ -123,9 +257,6 @@ UmApplicationRun(
 
         LOG_TRACE_USERMODE("Successfully loaded PE file!\n");
 
-        // After we loaded the PE into the appropriate process there is no need to keep the kernel mapping
-        _UmApplicationDiscardKernelExecutableMapping(Process->HeaderInfo->ImageBase);
-
         LOG_TRACE_USERMODE("Will create thread with entry point at 0x%X\n", Process->HeaderInfo->Preferred.AddressOfEntryPoint);
 
         status = ThreadCreateEx("Test",
@@ -161,6 +292,147 @@ UmApplicationRun(
     return status;
 }
 
+static
+STATUS
+_UmApplicationLoadImage(
+    IN_Z        char*                   Path,
+    IN          PFILE_INFORMATION       FileInformation,
+    OUT_PTR     PUM_APPLICATION_IMAGE*  Image
+    )
+{
+    STATUS status;
+    QWORD peSize;
+    PVOID pBuffer;
+    DWORD pathLength;
+    PUM_APPLICATION_IMAGE pImage;
+
+    ASSERT(Path != NULL);
+    ASSERT(FileInformation != NULL);
+    ASSERT(Image != NULL);
+
+    status = STATUS_SUCCESS;
+    peSize = 0;
+    pBuffer = NULL;
+    pathLength = strlen(Path);
+    pImage = NULL;
+
+    __try
+    {
+        pImage = ExAllocatePoolWithTag(PoolAllocateZeroMemory, sizeof(UM_APPLICATION_IMAGE) + pathLength + 1, HEAP_PROCESS_TAG, 0);
+        if (pImage == NULL)
+        {
+            status = STATUS_HEAP_INSUFFICIENT_RESOURCES;
+            LOG_FUNC_ERROR_ALLOC("ExAllocatePoolWithTag", sizeof(UM_APPLICATION_IMAGE) + pathLength + 1);
+            __leave;
+        }
+
+        pImage->Path = (char*) PtrOffset(pImage, sizeof(UM_APPLICATION_IMAGE));
+        strcpy(pImage->Path, Path);
+
+        // If the file changes before it is read below the image will be
+        // found stale on the next lookup and read again
+        pImage->FileSize = FileInformation->FileSize;
+        pImage->LastWriteTime = FileInformation->LastWriteTime;
+
+        LOG_TRACE_USERMODE("Will open executable found at [%s]\n", Path);
+
+        status = _UmApplicationReadExecutableContents(Path,
+                                                      &pBuffer,
+                                                      &peSize);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("_UmApplicationReadExecutableContents", status);
+            __leave;
+        }
+
+        LOG_TRACE_USERMODE("Will parse NT header!\n");
+
+        ASSERT(peSize <= MAX_DWORD);
+        status = PeRetrieveNtHeader(pBuffer,
+                                    (DWORD)peSize,
+                                    &pImage->HeaderInfo);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("PeRetrieveNtHeader", status);
+            __leave;
+        }
+
+        LOG_TRACE_USERMODE("Successfully parsed NT header!\n");
+    }
+    __finally
+    {
+        if (SUCCEEDED(status))
+        {
+            *Image = pImage;
+        }
+        else
+        {
+            if (pBuffer != NULL)
+            {
+                _UmApplicationDiscardKernelExecutableMapping(pBuffer);
+                pBuffer = NULL;
+            }
+
+            if (pImage != NULL)
+            {
+                ExFreePoolWithTag(pImage, HEAP_PROCESS_TAG);
+                pImage = NULL;
+            }
+        }
+    }
+
+    return status;
+}
+
+static
+STATUS
+_UmApplicationQueryExecutableInformation(
+    IN_Z        char*                   FullPath,
+    OUT         PFILE_INFORMATION       FileInformation
+    )
+{
+    PFILE_OBJECT pExecutableFile;
+    STATUS status;
+
+    ASSERT(FullPath != NULL);
+    ASSERT(FileInformation != NULL);
+
+    pExecutableFile = NULL;
+    memzero(FileInformation, sizeof(FILE_INFORMATION));
+
+    __try
+    {
+        status = IoCreateFile(&pExecutableFile,
+                              FullPath,
+                              FALSE,
+                              FALSE,
+                              FALSE);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("IoCreateFile", status);
+            __leave;
+        }
+
+        status = IoQueryInformationFile(pExecutableFile,
+                                        FileInformation);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("IoQueryInformationFile", status);
+            __leave;
+        }
+    }
+    __finally
+    {
+        if (pExecutableFile != NULL)
+        {
+            IoCloseFile(pExecutableFile);
+            pExecutableFile = NULL;
+        }
+    }
+
+    return status;
+}
+
 static
 STATUS
 _UmApplicationReadExecutableContents(
@@ -222,6 +494,7 @@ _UmApplicationReadExecutableContents(
                                    NULL);
         if (pBuffer == NULL)
         {
+            status = STATUS_INSUFFICIENT_MEMORY;
             LOG_FUNC_ERROR_ALLOC("VmmAllocRegionEx", fileInfo.FileSize);
             __leave;
         }
@@ -260,7 +533,22 @@ _UmApplicationDiscardKernelExecutableMapping(
 
     LOG_TRACE_USERMODE("Will free memory region at 0x%X\n", ApplicationBuffer);
 
-    // We don't want to release the physical frames because they will still be used by
-    // the user-mode application
-    VmmFreeRegionEx(ApplicationBuffer, 0, VMM_FREE_TYPE_RELEASE, FALSE, NULL, NULL);
+    VmmFreeRegionEx(ApplicationBuffer, 0, VMM_FREE_TYPE_RELEASE, TRUE, NULL, NULL);
+}
+
+static
+void
+_UmApplicationFreeImage(
+    IN          PUM_APPLICATION_IMAGE   Image
+    )
+{
+    ASSERT(Image != NULL);
+    ASSERT(0 == Image->ReferenceCount);
+
+    LOG_TRACE_USERMODE("Will free image of [%s]\n", Image->Path);
+
+    // no process maps the frames any longer
+    _UmApplicationDiscardKernelExecutableMapping(Image->HeaderInfo.ImageBase);
+
+    ExFreePoolWithTag(Image, HEAP_PROCESS_TAG);
 }
\ No newline at end of file
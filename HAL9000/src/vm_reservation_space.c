@@ -9,7 +9,6 @@ typedef enum _VMM_RESERVATION_STATE
 {
     VmmReservationStateFree     = 0x0,
     VmmReservationStateUsed     = 0x1,
-    VmmReservationStateLast     = 0x2,
 } VMM_RESERVATION_STATE;
 
 typedef struct _VMM_RESERVATION
@@ -28,23 +27,64 @@ typedef struct _VMM_RESERVATION
     BITMAP                  CommitBitmap;
 } VMM_RESERVATION, *PVMM_RESERVATION;
 
-// 20% Will go for the list of reservations
+// 20% Will go for the list of reservations and their sorted index
 // 80% Will go for the bitmaps describing the memory committed by those reservations
 #define RESERVATION_LIST_PERCENTAGE_IN_HUNDREDS     (20 * 100)
 
 //******************************************************************************
-// Function:     _VmFindFirstFreeReservation
-// Description:  Returns the first free reservation entry or NULL if the whole
-//               region was exhausted.
-// Returns:      PVMM_RESERVATION
-// Parameter:    void
+// Function:     _VmFindReservationPosition
+// Description:  Binary searches the sorted index for the position of the first
+//               reservation starting after Address. The reservation which may
+//               contain Address is the one right before this position.
+// Returns:      DWORD - a value between 0 and NumberOfReservations
+// Parameter:    IN PVMM_RESERVATION_SPACE ReservationSpace
+// Parameter:    IN PVOID Address
 //******************************************************************************
 REQUIRES_SHARED_LOCK(ReservationSpace->ReservationLock)
 static
-PTR_SUCCESS
-PVMM_RESERVATION
-_VmFindFirstFreeReservation(
-    INOUT    PVMM_RESERVATION_SPACE  ReservationSpace
+DWORD
+_VmFindReservationPosition(
+    IN      PVMM_RESERVATION_SPACE  ReservationSpace,
+    IN      PVOID                   Address
+    );
+
+//******************************************************************************
+// Function:     _VmInsertReservation
+// Description:  Takes a free reservation entry for the range received as input
+//               and places it in the sorted index. The range must not overlap
+//               any existing reservation.
+// Returns:      STATUS - STATUS_MEMORY_ALREADY_RESERVED if the range overlaps
+//               another reservation, STATUS_LIMIT_REACHED if there are no more
+//               free entries
+// Parameter:    INOUT PVMM_RESERVATION_SPACE ReservationSpace
+// Parameter:    IN PVOID Address
+// Parameter:    IN QWORD Size
+// Parameter:    OUT_PTR PVMM_RESERVATION* Reservation
+//******************************************************************************
+REQUIRES_EXCL_LOCK(ReservationSpace->ReservationLock)
+static
+STATUS
+_VmInsertReservation(
+    INOUT       PVMM_RESERVATION_SPACE  ReservationSpace,
+    IN          PVOID                   Address,
+    IN          QWORD                   Size,
+    OUT_PTR     PVMM_RESERVATION*       Reservation
+    );
+
+//******************************************************************************
+// Function:     _VmRemoveReservation
+// Description:  Removes a reservation from the sorted index, its entry can be
+//               reused by a following _VmInsertReservation call.
+// Returns:      void
+// Parameter:    INOUT PVMM_RESERVATION_SPACE ReservationSpace
+// Parameter:    IN PVMM_RESERVATION Reservation
+//******************************************************************************
+REQUIRES_EXCL_LOCK(ReservationSpace->ReservationLock)
+static
+void
+_VmRemoveReservation(
+    INOUT       PVMM_RESERVATION_SPACE  ReservationSpace,
+    IN          PVMM_RESERVATION        Reservation
     );
 
 //******************************************************************************
@@ -169,13 +209,13 @@ _VmIsVaCommited(
 
 
 // We have the following virtual memory layout
-// --------------------------------------------------------------------------------------------------------------
-// |          ReservationMetadataBaseAddress  | + ReservationMetadataSize or at ReservationBaseAddress          |
-// --------------------------------------------------------------------------------------------------------------
-// | ReservationList | Commit Bitmap Buffers  | VmmAllocRegionEx allocates Virtual Addresses starting from here |
-// --------------------------------------------------------------------------------------------------------------
-// |       20%       |          80%           |                                                                 |
-// --------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------------------
+// |                    ReservationMetadataBaseAddress         | + ReservationMetadataSize or at ReservationBaseAddress          |
+// ---------------------------------------------------------------------------------------------------------------------------------
+// | ReservationList | SortedReservations | Commit Bitmap Buffers | VmmAllocRegionEx allocates Virtual Addresses starting from here |
+// ---------------------------------------------------------------------------------------------------------------------------------
+// |                20%                   |          80%          |                                                                 |
+// ---------------------------------------------------------------------------------------------------------------------------------
 _No_competing_thread_
 void
 VmReservationSpaceInit(
@@ -186,6 +226,7 @@ VmReservationSpaceInit(
     )
 {
     QWORD sizeForReservationList;
+    QWORD maxNumberOfReservations;
 
     ASSERT(NULL != ReservationMetadataBaseAddress );
     ASSERT(IsAddressAligned(ReservationMetadataBaseAddress, PAGE_SIZE));
@@ -196,7 +237,13 @@ VmReservationSpaceInit(
 
     sizeForReservationList = CalculatePercentage(ReservationMetadataSize, RESERVATION_LIST_PERCENTAGE_IN_HUNDREDS);
 
+    // each reservation needs an entry in the list and one in the sorted index
+    maxNumberOfReservations = min(sizeForReservationList / (sizeof(VMM_RESERVATION) + sizeof(DWORD)), MAX_DWORD);
+    ASSERT(0 != maxNumberOfReservations);
+
     ReservationSpace->ReservationList = (PVMM_RESERVATION) ReservationMetadataBaseAddress;
+    ReservationSpace->MaxNumberOfReservations = (DWORD) maxNumberOfReservations;
+    ReservationSpace->SortedReservations = (DWORD*) (ReservationSpace->ReservationList + maxNumberOfReservations);
     ReservationSpace->BitmapAddressStart = PtrOffset(ReservationMetadataBaseAddress, sizeForReservationList);
     ReservationSpace->FreeBitmapAddress = ReservationSpace->BitmapAddressStart;
 
@@ -225,7 +272,10 @@ VmReservationSpaceFinishInit(
 {
     ASSERT(ReservationSpace != NULL);
 
-    ReservationSpace->ReservationList[0].State = VmmReservationStateLast;
+    // the list and the index are never walked past these counters => there
+    // is no need to touch the metadata before the first reservation is made
+    ReservationSpace->NumberOfReservations = 0;
+    ReservationSpace->NumberOfReservationSlots = 0;
 }
 
 REQUIRES_SHARED_LOCK(ReservationSpace->ReservationLock)
@@ -240,6 +290,7 @@ _VmFindReservation(
 {
     STATUS status;
     PVMM_RESERVATION pCurrentReservation;
+    DWORD position;
     BOOLEAN bFound;
 
     ASSERT(ReservationSpace != NULL);
@@ -248,25 +299,18 @@ _VmFindReservation(
     ASSERT(Reservation != NULL);
 
     status = STATUS_SUCCESS;
+    pCurrentReservation = NULL;
     bFound = FALSE;
 
-    for(pCurrentReservation = ReservationSpace->ReservationList;
-            VmmReservationStateLast != pCurrentReservation->State &&
-            (PVOID) pCurrentReservation < ReservationSpace->BitmapAddressStart;
-        pCurrentReservation = pCurrentReservation + 1
-        )
+    // the reservations don't overlap => only the last one starting at or
+    // before Address may contain the range
+    position = _VmFindReservationPosition(ReservationSpace, Address);
+    if (0 != position)
     {
-        if (VmmReservationStateFree == pCurrentReservation->State)
-        {
-            // skip free entries
-            continue;
-        }
+        pCurrentReservation = &ReservationSpace->ReservationList[ReservationSpace->SortedReservations[position - 1]];
+        ASSERT(VmmReservationStateUsed == pCurrentReservation->State);
 
-        if (CHECK_BOUNDS(Address, Size, pCurrentReservation->StartVa, pCurrentReservation->Size))
-        {
-            bFound = TRUE;
-            break;
-        }
+        bFound = CHECK_BOUNDS(Address, Size, pCurrentReservation->StartVa, pCurrentReservation->Size);
     }
 
     if (!bFound)
@@ -410,8 +454,16 @@ _VmChangeVaReservationState(
     switch (AllocationType)
     {
     case VMM_ALLOC_TYPE_RESERVE:
-        pReservation = _VmFindFirstFreeReservation(ReservationSpace);
-        ASSERT( NULL != pReservation );
+        status = _VmInsertReservation(ReservationSpace,
+                                      Address,
+                                      Size,
+                                      &pReservation
+                                      );
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("_VmInsertReservation", status );
+            return status;
+        }
 
         // _VmChangeVaReservationState is called with the lock taken exclusively and no function to release
         // the lock is called
@@ -461,44 +513,140 @@ _VmChangeVaReservationState(
 
 REQUIRES_SHARED_LOCK(ReservationSpace->ReservationLock)
 static
-PTR_SUCCESS
-PVMM_RESERVATION
-_VmFindFirstFreeReservation(
-    INOUT       PVMM_RESERVATION_SPACE  ReservationSpace
+DWORD
+_VmFindReservationPosition(
+    IN      PVMM_RESERVATION_SPACE  ReservationSpace,
+    IN      PVOID                   Address
     )
 {
-    PVMM_RESERVATION pResult;
+    DWORD left;
+    DWORD right;
+    DWORD middle;
 
     ASSERT(ReservationSpace != NULL);
 
-    pResult = NULL;
+    left = 0;
+    right = ReservationSpace->NumberOfReservations;
 
-    for (PVMM_RESERVATION pCurrentReservation = ReservationSpace->ReservationList;
-        (PVOID)pCurrentReservation < ReservationSpace->BitmapAddressStart;
-         pCurrentReservation = pCurrentReservation + 1
-         )
+    while (left < right)
     {
-        if (VmmReservationStateFree == pCurrentReservation->State)
-        {
-            pResult = pCurrentReservation;
+        middle = left + (right - left) / 2;
 
-            break;
+        if (ReservationSpace->ReservationList[ReservationSpace->SortedReservations[middle]].StartVa <= Address)
+        {
+            left = middle + 1;
         }
-
-        if (VmmReservationStateLast == pCurrentReservation->State)
+        else
         {
-            pCurrentReservation->State = VmmReservationStateFree;
+            right = middle;
+        }
+    }
+
+    return left;
+}
+
+REQUIRES_EXCL_LOCK(ReservationSpace->ReservationLock)
+static
+STATUS
+_VmInsertReservation(
+    INOUT       PVMM_RESERVATION_SPACE  ReservationSpace,
+    IN          PVOID                   Address,
+    IN          QWORD                   Size,
+    OUT_PTR     PVMM_RESERVATION*       Reservation
+    )
+{
+    PVMM_RESERVATION pNeighbour;
+    DWORD position;
+    DWORD index;
+
+    ASSERT(ReservationSpace != NULL);
+    ASSERT(NULL != Address);
+    ASSERT(0 != Size);
+    ASSERT(Reservation != NULL);
 
-            // set the next reservation as the last one
-            (pCurrentReservation + 1)->State = VmmReservationStateLast;
+    position = _VmFindReservationPosition(ReservationSpace, Address);
+
+    // the range must end before the next reservation starts and the previous
+    // reservation must end before the range starts
+    if (position < ReservationSpace->NumberOfReservations)
+    {
+        pNeighbour = &ReservationSpace->ReservationList[ReservationSpace->SortedReservations[position]];
+        if ((QWORD) Address + Size > (QWORD) pNeighbour->StartVa)
+        {
+            LOG_ERROR("Range 0x%X of size 0x%X overlaps reservation at 0x%X\n", Address, Size, pNeighbour->StartVa);
+            return STATUS_MEMORY_ALREADY_RESERVED;
+        }
+    }
 
-            pResult = pCurrentReservation;
+    if (0 != position)
+    {
+        pNeighbour = &ReservationSpace->ReservationList[ReservationSpace->SortedReservations[position - 1]];
+        if ((QWORD) pNeighbour->StartVa + pNeighbour->Size > (QWORD) Address)
+        {
+            LOG_ERROR("Range 0x%X of size 0x%X overlaps reservation at 0x%X\n", Address, Size, pNeighbour->StartVa);
+            return STATUS_MEMORY_ALREADY_RESERVED;
+        }
+    }
 
-            break;
+    if (ReservationSpace->NumberOfReservations == ReservationSpace->NumberOfReservationSlots)
+    {
+        // all the entries used until now are taken, use a new one
+        if (ReservationSpace->NumberOfReservationSlots == ReservationSpace->MaxNumberOfReservations)
+        {
+            LOG_ERROR("All the %u reservation entries are used\n", ReservationSpace->MaxNumberOfReservations);
+            return STATUS_LIMIT_REACHED;
         }
+
+        index = ReservationSpace->NumberOfReservationSlots;
+        ReservationSpace->NumberOfReservationSlots = ReservationSpace->NumberOfReservationSlots + 1;
+    }
+    else
+    {
+        // the free entries are kept right after the used ones
+        index = ReservationSpace->SortedReservations[ReservationSpace->NumberOfReservations];
+        ASSERT(VmmReservationStateFree == ReservationSpace->ReservationList[index].State);
     }
 
-    return pResult;
+    memmove(&ReservationSpace->SortedReservations[position + 1],
+            &ReservationSpace->SortedReservations[position],
+            (ReservationSpace->NumberOfReservations - position) * sizeof(DWORD));
+    ReservationSpace->SortedReservations[position] = index;
+    ReservationSpace->NumberOfReservations = ReservationSpace->NumberOfReservations + 1;
+
+    *Reservation = &ReservationSpace->ReservationList[index];
+
+    return STATUS_SUCCESS;
+}
+
+REQUIRES_EXCL_LOCK(ReservationSpace->ReservationLock)
+static
+void
+_VmRemoveReservation(
+    INOUT       PVMM_RESERVATION_SPACE  ReservationSpace,
+    IN          PVMM_RESERVATION        Reservation
+    )
+{
+    DWORD position;
+    DWORD index;
+
+    ASSERT(ReservationSpace != NULL);
+    ASSERT(Reservation != NULL);
+
+    index = (DWORD) (Reservation - ReservationSpace->ReservationList);
+
+    position = _VmFindReservationPosition(ReservationSpace, Reservation->StartVa);
+    ASSERT(0 != position);
+
+    position = position - 1;
+    ASSERT(ReservationSpace->SortedReservations[position] == index);
+
+    ReservationSpace->NumberOfReservations = ReservationSpace->NumberOfReservations - 1;
+    memmove(&ReservationSpace->SortedReservations[position],
+            &ReservationSpace->SortedReservations[position + 1],
+            (ReservationSpace->NumberOfReservations - position) * sizeof(DWORD));
+
+    // the entry becomes the first free one
+    ReservationSpace->SortedReservations[ReservationSpace->NumberOfReservations] = index;
 }
 
 static
@@ -616,7 +764,10 @@ VmReservationCanAddressBeAccessed(
     OUT                     PAGE_RIGHTS*            MemoryRights,
     OUT                     BOOLEAN*                Uncacheable,
     OUT_PTR_MAYBE_NULL      PFILE_OBJECT*           BackingFile,
-    OUT                     QWORD*                  FileOffset
+    OUT                     QWORD*                  FileOffset,
+    IN                      DWORD                   WindowPages,
+    OUT                     PVOID*                  RangeStart,
+    OUT                     DWORD*                  RangePages
     )
 {
     BOOLEAN bSolvedPageFault;
@@ -626,6 +777,8 @@ VmReservationCanAddressBeAccessed(
     BOOLEAN uncacheable;
     PFILE_OBJECT pBackingFile;
     QWORD fileOffset;
+    PVOID rangeStart;
+    PVOID rangeEnd;
     PCPU* pCpu;
     STATUS status;
 
@@ -634,6 +787,9 @@ VmReservationCanAddressBeAccessed(
     ASSERT(Uncacheable != NULL);
     ASSERT(BackingFile != NULL);
     ASSERT(FileOffset != NULL);
+    ASSERT(0 != WindowPages && 0 == (WindowPages & (WindowPages - 1)));
+    ASSERT(RangeStart != NULL);
+    ASSERT(RangePages != NULL);
     ASSERT(INTR_OFF == CpuIntrGetState());
 
     if (NULL == FaultingAddress)
@@ -647,6 +803,8 @@ VmReservationCanAddressBeAccessed(
     uncacheable = FALSE;
     pBackingFile = NULL;
     fileOffset = 0;
+    rangeStart = (PVOID) AlignAddressLower(FaultingAddress, PAGE_SIZE);
+    rangeEnd = PtrOffset(rangeStart, PAGE_SIZE);
     pCpu = GetCurrentPcpu();
     status = STATUS_SUCCESS;
 
@@ -709,6 +867,26 @@ VmReservationCanAddressBeAccessed(
             // and the page rights which were requested must be included in the
             // reservation rights
             bSolvedPageFault = bIsVaCommited && (IsBooleanFlagOn(pageRights, RightsRequested));
+            if (!bSolvedPageFault)
+            {
+                __leave;
+            }
+
+            // extend the range over the committed neighbours from the window,
+            // without leaving the reservation
+            while (rangeStart > pReservation->StartVa &&
+                   !IsAddressAligned(rangeStart, (QWORD) WindowPages * PAGE_SIZE) &&
+                   _VmIsVaCommited(pReservation, (PBYTE) rangeStart - PAGE_SIZE))
+            {
+                rangeStart = (PBYTE) rangeStart - PAGE_SIZE;
+            }
+
+            while (rangeEnd < PtrOffset(pReservation->StartVa, pReservation->Size) &&
+                   !IsAddressAligned(rangeEnd, (QWORD) WindowPages * PAGE_SIZE) &&
+                   _VmIsVaCommited(pReservation, rangeEnd))
+            {
+                rangeEnd = PtrOffset(rangeEnd, PAGE_SIZE);
+            }
 
             __leave;
         }
@@ -730,6 +908,11 @@ VmReservationCanAddressBeAccessed(
 
             *BackingFile = pBackingFile;
             *FileOffset = fileOffset;
+
+            ASSERT((QWORD) PtrDiff(rangeEnd, rangeStart) / PAGE_SIZE <= WindowPages);
+
+            *RangeStart = rangeStart;
+            *RangePages = (DWORD) ((QWORD) PtrDiff(rangeEnd, rangeStart) / PAGE_SIZE);
         }
     }
 
@@ -905,6 +1088,7 @@ VmReservationSpaceFreeRegion(
         VMM_RESERVATION reservationCopy;
 
         // remove reservation
+        _VmRemoveReservation(ReservationSpace, pReservation);
         memcpy( &reservationCopy, pReservation, sizeof(VMM_RESERVATION));
         memzero( pReservation, sizeof(VMM_RESERVATION));
         pReservation->State = VmmReservationStateFree;
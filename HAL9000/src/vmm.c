@@ -10,9 +10,32 @@
 #include "thread_internal.h"
 #include "process_internal.h"
 #include "mdl.h"
+#include "swap.h"
 
 #define VMM_SIZE_FOR_RESERVATION_METADATA            (5*TB_SIZE)
 
+#define VMM_2MB_PAGE_SIZE                            (PAGE_2MB_OFFSET + 1)
+#define VMM_1GB_PAGE_SIZE                            (PAGE_1GB_OFFSET + 1)
+
+// a page fault in lazily committed memory also maps the committed and
+// unmapped pages around it from a window of this many pages
+#define VMM_DEFAULT_FAULT_AROUND_PAGES               16
+
+#define VMM_ENTRIES_PER_PAGING_STRUCTURE             (PAGE_SIZE / sizeof(QWORD))
+
+// the paging structures are walked from the PML4 (level 3) down to the
+// page tables (level 0)
+#define VMM_PAGING_LEVEL_PT                          0
+#define VMM_PAGING_LEVEL_PD                          1
+#define VMM_PAGING_LEVEL_PDPT                        2
+#define VMM_PAGING_LEVEL_PML4                        3
+
+#define VMM_BITS_PER_PAGING_LEVEL                    9
+
+// size of the region described by an entry of a paging structure at Level
+#define VMM_ENTRY_COVERAGE(Level)                    ((QWORD)PAGE_SIZE << (VMM_BITS_PER_PAGING_LEVEL * (Level)))
+#define VMM_ENTRY_INDEX(Va,Level)                    ((((QWORD)(Va)) >> (PAGE_SHIFT + VMM_BITS_PER_PAGING_LEVEL * (Level))) & (VMM_ENTRIES_PER_PAGING_STRUCTURE - 1))
+
 typedef struct _VMM_DATA
 {
     VMM_RESERVATION_SPACE   VmmReservationSpace;
@@ -22,6 +45,20 @@ typedef struct _VMM_DATA
     // No matter what CR3 we're using the same WB and UC indexes will be used
     BYTE                    WriteBackIndex;
     BYTE                    UncacheableIndex;
+
+    // 2MB pages are always available in long mode, 1GB pages only if
+    // CPUID reports them
+    volatile BOOLEAN        LargePagesEnabled;
+    BOOLEAN                 GigabytePagesSupported;
+
+    volatile DWORD          FaultAroundPages;
+
+    // Never written and never released, the user pages which were only read
+    // map it copy-on-write
+    PHYSICAL_ADDRESS        ZeroFrame;
+
+    // page faults solved
+    PERCPU_COUNTER          PageFaultsCounter;
 } VMM_DATA, *PVMM_DATA;
 
 static VMM_DATA m_vmmData;
@@ -42,6 +79,245 @@ _VmDeterminePatIndices(
     OUT     PBYTE                   UcIndex
     );
 
+static
+void
+_VmSplitLargePage(
+    IN      PPAGING_DATA            PagingData,
+    INOUT   PVOID                   LargePageEntry,
+    IN      PVOID                   VirtualAddress,
+    IN      QWORD                   LargePageSize
+    );
+
+static
+QWORD
+_VmMapLargePage(
+    IN      PPAGING_DATA            PagingData,
+    INOUT   PVOID                   Entry,
+    IN      PVOID                   VirtualAddress,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      QWORD                   RemainingSize,
+    IN      QWORD                   LargePageSize,
+    IN      PTE_MAP_FLAGS           Flags,
+    IN      BOOLEAN                 Invalidate,
+    INOUT_OPT
+            PTLB_SHOOTDOWN_BATCH    Batch
+    );
+
+static
+QWORD
+_VmUnmapLargePage(
+    IN      PPAGING_DATA            PagingData,
+    INOUT   PVOID                   Entry,
+    IN      PVOID                   VirtualAddress,
+    IN      QWORD                   RemainingSize,
+    IN      QWORD                   LargePageSize,
+    IN      BOOLEAN                 ReleaseMemory,
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch
+    );
+
+static
+void
+_VmMapRange(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   PagingStructure,
+    IN      DWORD                   Level,
+    IN      PVOID                   BaseAddress,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      QWORD                   Size,
+    IN      PTE_MAP_FLAGS           Flags,
+    IN      BOOLEAN                 Invalidate,
+    INOUT_OPT
+            PTLB_SHOOTDOWN_BATCH    Batch
+    );
+
+static
+QWORD
+_VmUnmapRange(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   PagingStructure,
+    IN      DWORD                   Level,
+    IN      PVOID                   BaseAddress,
+    IN      QWORD                   Size,
+    IN      BOOLEAN                 ReleaseMemory,
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch
+    );
+
+//******************************************************************************
+// Function:     _VmTrimFaultAroundRange
+// Description:  Shrinks the range to the faulting page and its neighbours
+//               which are not in use. The paging lock must be held.
+// Returns:      void
+// Parameter:    IN PVOID FaultingPage
+// Parameter:    IN PPAGING_DATA PagingData
+// Parameter:    INOUT PVOID* RangeStart
+// Parameter:    INOUT DWORD* RangePages
+//******************************************************************************
+static
+void
+_VmTrimFaultAroundRange(
+    IN      PVOID                   FaultingPage,
+    IN      PPAGING_DATA            PagingData,
+    INOUT   PVOID*                  RangeStart,
+    INOUT   DWORD*                  RangePages
+    );
+
+//******************************************************************************
+// Function:     _VmMapFaultAroundRange
+// Description:  Maps the range trimmed by _VmTrimFaultAroundRange, the
+//               neighbours mapped since then are left out and their frames
+//               released.
+// Returns:      BOOLEAN - FALSE if the faulting page was mapped by another CPU
+//               in the meantime, all the frames are then released
+// Parameter:    IN PVOID FaultingPage
+// Parameter:    IN PPAGING_LOCK_DATA PagingData
+// Parameter:    IN PAGE_RIGHTS PageRights
+// Parameter:    IN BOOLEAN Uncacheable
+// Parameter:    INOUT PHYSICAL_ADDRESS* PhysicalAddress - frames reserved for
+//               the whole range
+// Parameter:    INOUT PVOID* RangeStart
+// Parameter:    INOUT DWORD* RangePages
+//******************************************************************************
+static
+BOOLEAN
+_VmMapFaultAroundRange(
+    IN      PVOID                   FaultingPage,
+    IN      PPAGING_LOCK_DATA       PagingData,
+    IN      PAGE_RIGHTS             PageRights,
+    IN      BOOLEAN                 Uncacheable,
+    INOUT   PHYSICAL_ADDRESS*       PhysicalAddress,
+    INOUT   PVOID*                  RangeStart,
+    INOUT   DWORD*                  RangePages
+    );
+
+//******************************************************************************
+// Function:     _VmMapZeroFrame
+// Description:  Maps the shared zero frame at the pages of the range which
+//               are not in use, copy-on-write if they are writable.
+// Returns:      void
+// Parameter:    IN PPAGING_LOCK_DATA PagingData
+// Parameter:    IN PAGE_RIGHTS PageRights
+// Parameter:    IN PVOID RangeStart
+// Parameter:    IN DWORD RangePages
+//******************************************************************************
+static
+void
+_VmMapZeroFrame(
+    IN      PPAGING_LOCK_DATA       PagingData,
+    IN      PAGE_RIGHTS             PageRights,
+    IN      PVOID                   RangeStart,
+    IN      DWORD                   RangePages
+    );
+
+//******************************************************************************
+// Function:     _VmRegisterEvictablePages
+// Description:  Lets the pager evict the pages of the range which are still
+//               mapped to the frames starting at PhysicalAddress.
+// Returns:      void
+// Parameter:    IN PPAGING_LOCK_DATA PagingData
+// Parameter:    IN PVOID BaseAddress
+// Parameter:    IN PHYSICAL_ADDRESS PhysicalAddress
+// Parameter:    IN DWORD NumberOfPages
+//******************************************************************************
+static
+void
+_VmRegisterEvictablePages(
+    IN      PPAGING_LOCK_DATA       PagingData,
+    IN      PVOID                   BaseAddress,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      DWORD                   NumberOfPages
+    );
+
+//******************************************************************************
+// Function:     _VmReserveFrames
+// Description:  Reserves NoOfFrames contiguous frames, the ones already zeroed
+//               by the MMU zero worker are used first.
+// Returns:      PHYSICAL_ADDRESS
+// Parameter:    IN DWORD NoOfFrames
+// Parameter:    OUT BOOLEAN* Zeroed - TRUE if the frames are known to be zero
+//******************************************************************************
+static
+PTR_SUCCESS
+PHYSICAL_ADDRESS
+_VmReserveFrames(
+    IN      DWORD                   NoOfFrames,
+    OUT     BOOLEAN*                Zeroed
+    );
+
+//******************************************************************************
+// Function:     _VmRetrievePageTableEntry
+// Description:  Walks the paging structures down to the page table entry
+//               describing VirtualAddress, the entry itself may not be
+//               present.
+// Returns:      PT_ENTRY* - NULL if there is no page table for the address or
+//               it is mapped with a large page
+// Parameter:    IN PPAGING_DATA PagingData
+// Parameter:    IN PVOID VirtualAddress
+//******************************************************************************
+static
+PT_ENTRY*
+_VmRetrievePageTableEntry(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress
+    );
+
+//******************************************************************************
+// Function:     _VmIsPageInUse
+// Description:  Checks if VirtualAddress is mapped or swapped out.
+// Returns:      BOOLEAN
+// Parameter:    IN PPAGING_DATA PagingData
+// Parameter:    IN PVOID VirtualAddress
+//******************************************************************************
+static
+BOOLEAN
+_VmIsPageInUse(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress
+    );
+
+static
+DWORD
+_VmRetrieveSwapSlot(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress
+    );
+
+//******************************************************************************
+// Function:     _VmSolveCopyOnWriteFault
+// Description:  Gives the address space its own writable copy of FaultingPage
+//               if the page is mapped copy-on-write.
+// Returns:      BOOLEAN - FALSE if the page is not mapped copy-on-write
+// Parameter:    IN PVOID FaultingPage
+// Parameter:    IN PPAGING_LOCK_DATA PagingData
+//******************************************************************************
+static
+BOOLEAN
+_VmSolveCopyOnWriteFault(
+    IN      PVOID                   FaultingPage,
+    IN      PPAGING_LOCK_DATA       PagingData
+    );
+
+//******************************************************************************
+// Function:     _VmSolveSwappedOutFault
+// Description:  Reads FaultingPage back from the swap space if the pager
+//               evicted it.
+// Returns:      BOOLEAN - FALSE if the page is not swapped out
+// Parameter:    IN PVOID FaultingPage
+// Parameter:    IN PAGE_RIGHTS PageRights
+// Parameter:    IN BOOLEAN Uncacheable
+// Parameter:    IN PPAGING_LOCK_DATA PagingData
+// Parameter:    OUT BOOLEAN* Solved - TRUE if the page was mapped or the
+//               access must be retried later, FALSE if it cannot be read
+//******************************************************************************
+static
+BOOLEAN
+_VmSolveSwappedOutFault(
+    IN      PVOID                   FaultingPage,
+    IN      PAGE_RIGHTS             PageRights,
+    IN      BOOLEAN                 Uncacheable,
+    IN      PPAGING_LOCK_DATA       PagingData,
+    OUT     BOOLEAN*                Solved
+    );
+
 __forceinline
 static
 PHYSICAL_ADDRESS
@@ -54,6 +330,15 @@ _VmRetrieveNextPhysicalAddressForPagingStructure(
 
     ASSERT( NULL != PagingData );
 
+    // structures freed by previous unmaps are reused first
+    if (NULL != PagingData->FreePagingStructures)
+    {
+        nextAddress = (QWORD) PagingData->FreePagingStructures;
+        PagingData->FreePagingStructures = *((PHYSICAL_ADDRESS*)PA2VA(nextAddress));
+
+        return (PHYSICAL_ADDRESS) nextAddress;
+    }
+
     currentIndex = PagingData->CurrentIndex;
 
     ASSERT( currentIndex < PagingData->NumberOfFrames );
@@ -88,6 +373,83 @@ _VmIsKernelRange(
     return _VmIsKernelAddress(Address) || _VmIsKernelAddress(PtrOffset(Address, RangeSize - 1));
 }
 
+__forceinline
+static
+BOOLEAN
+_VmIsLargePageEntry(
+    IN      PVOID                   Entry
+    )
+{
+    return PteIsPresent(Entry) && (1 == ((PD_ENTRY_2MB*)Entry)->PageSize);
+}
+
+__forceinline
+static
+BOOLEAN
+_VmIsPagingStructureEmpty(
+    IN      PVOID                   PagingStructure
+    )
+{
+    // a page table entry which is not present may still hold the slot of a
+    // swapped out page
+    for (DWORD i = 0; i < VMM_ENTRIES_PER_PAGING_STRUCTURE; ++i)
+    {
+        if (0 != *((QWORD*)PtrOffset(PagingStructure, i * sizeof(QWORD))))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+__forceinline
+static
+void
+_VmInvalidateTranslation(
+    IN      PVOID                   VirtualAddress,
+    IN      QWORD                   Size,
+    INOUT_OPT
+            PTLB_SHOOTDOWN_BATCH    Batch
+    )
+{
+    if (NULL != Batch)
+    {
+        // TlbBatchFlush invalidates the translations on the current CPU too,
+        // and it may decide a full flush is cheaper
+        TlbBatchAddRange(Batch, VirtualAddress, Size);
+        return;
+    }
+
+    // invalidating any address of a large page flushes the whole TLB entry
+    __invlpg(VirtualAddress);
+}
+
+__forceinline
+static
+BOOLEAN
+_VmCanUseLargePage(
+    IN      PVOID                   VirtualAddress,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      QWORD                   RemainingSize,
+    IN      QWORD                   LargePageSize
+    )
+{
+    if (!m_vmmData.LargePagesEnabled)
+    {
+        return FALSE;
+    }
+
+    if (VMM_1GB_PAGE_SIZE == LargePageSize && !m_vmmData.GigabytePagesSupported)
+    {
+        return FALSE;
+    }
+
+    return IsAddressAligned(VirtualAddress, LargePageSize)
+        && IsAddressAligned(PhysicalAddress, LargePageSize)
+        && (RemainingSize >= LargePageSize);
+}
+
 __forceinline
 static
 PTR_SUCCESS
@@ -123,6 +485,11 @@ VmmPreinit(
     )
 {
     memzero(&m_vmmData, sizeof(VMM_DATA));
+
+    m_vmmData.LargePagesEnabled = TRUE;
+    m_vmmData.FaultAroundPages = VMM_DEFAULT_FAULT_AROUND_PAGES;
+
+    PerCpuCounterRegister(VMM_PAGE_FAULTS_COUNTER_NAME, &m_vmmData.PageFaultsCounter);
 }
 
 _No_competing_thread_
@@ -172,7 +539,22 @@ VmmMapMemoryEx(
         return NULL;
     }
 
-    pVirtualAddress = VmReservationSpaceDetermineNextFreeVirtualAddress(&m_vmmData.VmmReservationSpace, Size);
+    if (Size >= VMM_2MB_PAGE_SIZE)
+    {
+        // The VA space is never reused, so we can afford to waste up to 2MB
+        // of it to have the VA at the same offset inside a 2MB page as the PA.
+        // This allows the 2MB aligned part of the range to be mapped with
+        // large pages.
+        pVirtualAddress = VmReservationSpaceDetermineNextFreeVirtualAddress(&m_vmmData.VmmReservationSpace,
+                                                                            Size + VMM_2MB_PAGE_SIZE);
+        pVirtualAddress = PtrOffset(pVirtualAddress,
+                                    (AddressOffset(PhysicalAddress, VMM_2MB_PAGE_SIZE) - AddressOffset(pVirtualAddress, VMM_2MB_PAGE_SIZE))
+                                    & PAGE_2MB_OFFSET);
+    }
+    else
+    {
+        pVirtualAddress = VmReservationSpaceDetermineNextFreeVirtualAddress(&m_vmmData.VmmReservationSpace, Size);
+    }
     LOG_TRACE_VMM("Virtual address: 0x%X\n", pVirtualAddress);
     ASSERT(IsAddressAligned(pVirtualAddress, PAGE_SIZE));
 
@@ -182,7 +564,8 @@ VmmMapMemoryEx(
                          pVirtualAddress,
                          PageRights,
                          Invalidate,
-                         Uncacheable
+                         Uncacheable,
+                         NULL
                          );
 
     return pVirtualAddress;
@@ -196,214 +579,248 @@ VmmMapMemoryInternal(
     IN      PVOID                   BaseAddress,
     IN      PAGE_RIGHTS             PageRights,
     IN      BOOLEAN                 Invalidate,
-    IN      BOOLEAN                 Uncacheable
+    IN      BOOLEAN                 Uncacheable,
+    INOUT_OPT
+            PTLB_SHOOTDOWN_BATCH    Batch
     )
 {
-    PML4_ENTRY* pml4Entries;
-    PDPT_ENTRY_PD* pdptEntries;
-    PD_ENTRY_PT* pdEntries;
-    PT_ENTRY* ptEntries;
-
-    WORD pageOffset;
-    WORD pteOffset;
-    WORD pdeOffset;
-    WORD pdpteOffset;
-    WORD pml4Offset;
-
-    QWORD offset;
-    PVOID tempAddress;
+    PTE_MAP_FLAGS flags = { 0 };
 
     ASSERT(PagingData != NULL);
     ASSERT(IsAddressAligned(PhysicalAddress, PAGE_SIZE));
     ASSERT(0 != Size && IsAddressAligned(Size, PAGE_SIZE));
 
-    // we may need to map multiple pages => we iterate until we map all the
-    // addresses
-    for(offset = 0;
-        offset < Size;
-        offset = offset + PAGE_SIZE)
-    {
-        // address to map
-        tempAddress = (PBYTE)BaseAddress + offset;
-
-        // these are the offsets to the corresponding structures
-        pml4Offset = MASK_PML4_OFFSET(tempAddress);
-        pdpteOffset = MASK_PDPTE_OFFSET(tempAddress);
-        pdeOffset = MASK_PDE_OFFSET(tempAddress);
-        pteOffset = MASK_PTE_OFFSET(tempAddress);
-        pageOffset = MASK_PAGE_OFFSET(tempAddress);
-
-        pml4Entries = (PML4_ENTRY*)PA2VA(PagingData->BasePhysicalAddress);
-        pml4Entries = &(pml4Entries[pml4Offset]);
-
-        if (!PteIsPresent(pml4Entries))
-        {
-            _VmSetupPagingStructure(PagingData, pml4Entries);
-        }
-
-        tempAddress = PteGetPhysicalAddress(pml4Entries);
-        pdptEntries = (PDPT_ENTRY_PD*)PA2VA(tempAddress);
-
-        pdptEntries = &(pdptEntries[pdpteOffset]);
-
-        if (!PteIsPresent(pdptEntries))
-        {
-            _VmSetupPagingStructure(PagingData, pdptEntries);
-        }
-
-        ASSERT(0 == pdptEntries->PageSize);
-
-        tempAddress = PteGetPhysicalAddress(pdptEntries);
-        pdEntries = (PD_ENTRY_PT*)PA2VA(tempAddress);
-
-        pdEntries = &(pdEntries[pdeOffset]);
-        if (!PteIsPresent(pdEntries))
-        {
-            _VmSetupPagingStructure(PagingData, pdEntries);
-        }
+    flags.Executable = IsBooleanFlagOn(PageRights, PAGE_RIGHTS_EXECUTE);
+    flags.CopyOnWrite = IsBooleanFlagOn(PageRights, VMM_PAGE_RIGHTS_COPY_ON_WRITE);
+    flags.SharedFrame = IsBooleanFlagOn(PageRights, VMM_PAGE_RIGHTS_SHARED_FRAME);
+    flags.Writable = IsBooleanFlagOn(PageRights, PAGE_RIGHTS_WRITE) && !flags.CopyOnWrite;
+    flags.PatIndex = Uncacheable ? m_vmmData.UncacheableIndex : m_vmmData.WriteBackIndex;
+    flags.GlobalPage = PagingData->KernelSpace;
+    flags.UserAccess = !PagingData->KernelSpace;
 
-        ASSERT(0 == pdEntries->PageSize);
+    _VmMapRange(PagingData,
+                (PVOID) PA2VA(PagingData->BasePhysicalAddress),
+                VMM_PAGING_LEVEL_PML4,
+                BaseAddress,
+                PhysicalAddress,
+                Size,
+                flags,
+                Invalidate,
+                Batch);
+}
 
-        tempAddress = PteGetPhysicalAddress(pdEntries);
-        ptEntries = (PT_ENTRY*)PA2VA(tempAddress);
+void
+VmmPreparePagingStructures(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   BaseAddress,
+    IN      QWORD                   Size
+    )
+{
+    QWORD offset;
+    PVOID currentAddress;
+    PVOID pStructure;
+    PVOID pEntry;
 
+    ASSERT(PagingData != NULL);
+    ASSERT(IsAddressAligned(BaseAddress, PAGE_SIZE));
+    ASSERT(0 != Size && IsAddressAligned(Size, PAGE_SIZE));
 
-        ptEntries = &(ptEntries[pteOffset]);
+    for (offset = 0; offset < Size; offset = offset + PAGE_SIZE)
+    {
+        currentAddress = PtrOffset(BaseAddress, offset);
+        pStructure = (PVOID) PA2VA(PagingData->BasePhysicalAddress);
 
-        // if we must invalidate the entry or the entry is not present, map it
-        if (Invalidate || (!PteIsPresent(ptEntries)))
+        // only the structures above the PT entries are created, the entries
+        // themselves are left untouched
+        for (DWORD level = VMM_PAGING_LEVEL_PML4; level > VMM_PAGING_LEVEL_PT; --level)
         {
-            PHYSICAL_ADDRESS physAddr = (PHYSICAL_ADDRESS)((PBYTE)PhysicalAddress + offset);
-            PTE_MAP_FLAGS flags = { 0 };
+            pEntry = PtrOffset(pStructure, VMM_ENTRY_INDEX(currentAddress, level) * sizeof(QWORD));
 
-            flags.Executable = IsBooleanFlagOn(PageRights, PAGE_RIGHTS_EXECUTE);
-            flags.Writable = IsBooleanFlagOn(PageRights, PAGE_RIGHTS_WRITE);
-            flags.PatIndex = Uncacheable ? m_vmmData.UncacheableIndex : m_vmmData.WriteBackIndex;
-            flags.GlobalPage = PagingData->KernelSpace;
-            flags.UserAccess = !PagingData->KernelSpace;
+            if (!PteIsPresent(pEntry))
+            {
+                _VmSetupPagingStructure(PagingData, pEntry);
+            }
 
-            PteMap(ptEntries, physAddr, flags );
+            // the range must not be covered by a large page, its
+            // translation would be replaced by the one of the PT
+            ASSERT(!_VmIsLargePageEntry(pEntry));
 
-            __invlpg((PBYTE) BaseAddress + offset );
+            pStructure = (PVOID) PA2VA(PteGetPhysicalAddress(pEntry));
         }
     }
 }
 
-void
+QWORD
 VmmUnmapMemoryEx(
-    IN      PML4                    Cr3,
+    IN      PPAGING_DATA            PagingData,
     IN      PVOID                   VirtualAddress,
     IN      QWORD                   Size,
-    IN      BOOLEAN                 ReleaseMemory
+    IN      BOOLEAN                 ReleaseMemory,
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch
     )
 {
-    PML4_ENTRY* pml4Entries;
-    PDPT_ENTRY_PD* pdptEntries;
-    PD_ENTRY_PT* pdEntries;
-    PT_ENTRY* ptEntries;
-
-    WORD pageOffset;
-    WORD pteOffset;
-    WORD pdeOffset;
-    WORD pdpteOffset;
-    WORD pml4Offset;
-
-    QWORD offset;
-    PVOID tempAddress;
+    ASSERT(PagingData != NULL);
+    ASSERT(Batch != NULL);
+    ASSERT(Batch->PagingData == PagingData);
 
     if ((NULL == VirtualAddress) || (!IsAddressAligned(VirtualAddress, PAGE_SIZE)))
     {
-        return;
+        return 0;
     }
 
     if ((0 == Size) || (!IsAddressAligned(Size, PAGE_SIZE)))
     {
-        return;
+        return 0;
     }
 
-    offset = 0;
-
-    // we may need to map multiple pages => we iterate until we map all the
-    // addresses
-    for(offset = 0;
-        offset < Size;
-        offset = offset + PAGE_SIZE)
-    {
-        // address to ummap
-        tempAddress = (PVOID)((BYTE*)VirtualAddress + offset);
-
-        // these are the offsets to the corresponding structures
-        pml4Offset = MASK_PML4_OFFSET(tempAddress);
-        pdpteOffset = MASK_PDPTE_OFFSET(tempAddress);
-        pdeOffset = MASK_PDE_OFFSET(tempAddress);
-        pteOffset = MASK_PTE_OFFSET(tempAddress);
-        pageOffset = MASK_PAGE_OFFSET(tempAddress);
+    return _VmUnmapRange(PagingData,
+                         (PVOID) PA2VA(PagingData->BasePhysicalAddress),
+                         VMM_PAGING_LEVEL_PML4,
+                         VirtualAddress,
+                         Size,
+                         ReleaseMemory,
+                         Batch);
+}
 
-        pml4Entries = (PML4_ENTRY*)PA2VA(Cr3.Pcide.PhysicalAddress << SHIFT_FOR_PHYSICAL_ADDR);
-        pml4Entries = &(pml4Entries[pml4Offset]);
+void
+VmmReclaimPagingStructures(
+    IN      PPAGING_DATA            PagingData,
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch
+    )
+{
+    PHYSICAL_ADDRESS pa;
 
-        if (!PteIsPresent(pml4Entries))
-        {
-            // it was never allocated
-            // go to next PAGE
-            continue;
-        }
+    ASSERT(PagingData != NULL);
+    ASSERT(Batch != NULL);
+    ASSERT(Batch->PagingData == PagingData);
 
-        tempAddress = PteGetPhysicalAddress(pml4Entries);
-        pdptEntries = (PDPT_ENTRY_PD*)PA2VA(tempAddress);
+    while (NULL != Batch->FreedPagingStructures)
+    {
+        pa = Batch->FreedPagingStructures;
+        Batch->FreedPagingStructures = *((PHYSICAL_ADDRESS*)PA2VA(pa));
 
-        pdptEntries = &(pdptEntries[pdpteOffset]);
+        *((PHYSICAL_ADDRESS*)PA2VA(pa)) = PagingData->FreePagingStructures;
+        PagingData->FreePagingStructures = pa;
+    }
+}
 
-        if (!PteIsPresent(pdptEntries))
-        {
-            // it was never allocated
-            // go to next PAGE
-            continue;
-        }
+VMM_EVICT_RESULT
+VmmEvictPage(
+    INOUT   PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      DWORD                   Slot,
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch,
+    OUT     PT_ENTRY*               OriginalEntry
+    )
+{
+    PT_ENTRY* pEntry;
 
-        ASSERT(0 == pdptEntries->PageSize);
+    ASSERT(PagingData != NULL);
+    ASSERT(!PagingData->KernelSpace);
+    ASSERT(Batch != NULL);
+    ASSERT(Batch->PagingData == PagingData);
+    ASSERT(SWAP_INVALID_SLOT != Slot);
+    ASSERT(OriginalEntry != NULL);
+
+    pEntry = _VmRetrievePageTableEntry(PagingData, VirtualAddress);
+    if (NULL == pEntry || !PteIsPresent(pEntry) || PhysicalAddress != PteGetPhysicalAddress(pEntry))
+    {
+        return VmmEvictStale;
+    }
 
-        tempAddress = PteGetPhysicalAddress(pdptEntries);
-        pdEntries = (PD_ENTRY_PT*)PA2VA(tempAddress);
+    if (pEntry->Accessed)
+    {
+        // Second chance: the CPUs which still have the translation cached
+        // won't set the bit again, which only makes the page look older than
+        // it is
+        pEntry->Accessed = 0;
+        return VmmEvictReferenced;
+    }
 
-        pdEntries = &(pdEntries[pdeOffset]);
-        if (!PteIsPresent(pdEntries))
-        {
-            // it was never allocated
-            // go to next PAGE
-            continue;
-        }
+    *OriginalEntry = *pEntry;
 
-        ASSERT(0 == pdEntries->PageSize);
+    PteUnmap(pEntry);
+    pEntry->SwappedOut = 1;
+    pEntry->PhysicalAddress = Slot;
 
-        tempAddress = PteGetPhysicalAddress(pdEntries);
-        ptEntries = (PT_ENTRY*)PA2VA(tempAddress);
+    _VmInvalidateTranslation(VirtualAddress, PAGE_SIZE, Batch);
 
+    return VmmEvictDone;
+}
 
-        ptEntries = &(ptEntries[pteOffset]);
+BOOLEAN
+VmmRestoreEvictedPage(
+    INOUT   PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress,
+    IN      DWORD                   Slot,
+    IN      PT_ENTRY                OriginalEntry,
+    IN      BOOLEAN                 MapZeroFrame
+    )
+{
+    PT_ENTRY* pEntry;
+
+    ASSERT(PagingData != NULL);
+    ASSERT(!PagingData->KernelSpace);
+    ASSERT(PteIsPresent(&OriginalEntry));
+
+    if (Slot != _VmRetrieveSwapSlot(PagingData, VirtualAddress))
+    {
+        return FALSE;
+    }
+
+    pEntry = _VmRetrievePageTableEntry(PagingData, VirtualAddress);
+    ASSERT(pEntry != NULL);
+
+    if (MapZeroFrame)
+    {
+        OriginalEntry.PhysicalAddress = (QWORD) m_vmmData.ZeroFrame >> SHIFT_FOR_PHYSICAL_ADDR;
+        OriginalEntry.Accessed = 0;
+        OriginalEntry.Dirty = 0;
 
-        if (!PteIsPresent(ptEntries))
+        if (OriginalEntry.ReadWrite)
         {
-            // it was never allocated
-            // go to next PAGE
-            continue;
+            OriginalEntry.ReadWrite = 0;
+            OriginalEntry.CopyOnWrite = 1;
         }
-        else
-        {
-            PHYSICAL_ADDRESS pa = PteGetPhysicalAddress(ptEntries);
+    }
 
-            PteUnmap(ptEntries);
+    // no CPU may have cached a translation for a non-present entry
+    *pEntry = OriginalEntry;
 
-            __invlpg((QWORD)VirtualAddress + offset);
+    return TRUE;
+}
 
-            if (ReleaseMemory)
-            {
-                MmuReleaseMemory(pa, 1);
-            }
+BOOLEAN
+VmmPinPage(
+    INOUT   PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress,
+    IN      BOOLEAN                 Writable
+    )
+{
+    PT_ENTRY* pEntry;
 
-            /// TODO: signal other processors to invalidate the mapping
-        }
+    ASSERT(PagingData != NULL);
+    ASSERT(!PagingData->KernelSpace);
+
+    pEntry = _VmRetrievePageTableEntry(PagingData, VirtualAddress);
+    if (NULL == pEntry || !PteIsPresent(pEntry))
+    {
+        return FALSE;
+    }
+
+    // a copy on write page still maps a frame shared with other pages, the
+    // zero frame or an image frame
+    if (Writable && !pEntry->ReadWrite)
+    {
+        return FALSE;
     }
+
+    // the pager checks the frame is still registered while holding the
+    // paging lock before evicting it
+    SwapUnregisterFrame(PteGetPhysicalAddress(pEntry));
+
+    return TRUE;
 }
 
 PTR_SUCCESS
@@ -458,7 +875,11 @@ VmmGetPhysicalAddress(
         return NULL;
     }
 
-    ASSERT(0 == pdptEntries->PageSize);
+    if (pdptEntries->PageSize)
+    {
+        // Large 1GB page
+        return PtrOffset(PteLargePageGetPhysicalAddress(pdptEntries), AddressOffset(VirtualAddress, VMM_1GB_PAGE_SIZE));
+    }
 
     tempAddress = PteGetPhysicalAddress(pdptEntries);
     pdEntries = (PD_ENTRY_PT*)PA2VA(tempAddress);
@@ -519,6 +940,9 @@ VmmPreparePagingData(
     LOG("WbIndex: %u\n", m_vmmData.WriteBackIndex);
     LOG("UcIndex: %u\n", m_vmmData.UncacheableIndex);
 
+    m_vmmData.GigabytePagesSupported = CpuMuIsGigabytePageSupported();
+    LOG("1GB pages supported: %u\n", m_vmmData.GigabytePagesSupported);
+
     return STATUS_SUCCESS;
 }
 
@@ -549,6 +973,8 @@ VmmSetupPageTables(
     PagingData->NumberOfFrames = FramesReserved;
     PagingData->BasePhysicalAddress = BasePhysicalAddress;
     PagingData->KernelSpace = KernelStructures;
+    PagingData->FreePagingStructures = NULL;
+    TlbInitAddressSpace(PagingData);
 
     sizeReservedForPagingStructures = FramesReserved * PAGE_SIZE;
 
@@ -569,7 +995,8 @@ VmmSetupPageTables(
                          pBaseVirtualAddress,
                          PAGE_RIGHTS_READWRITE,
                          TRUE,
-                         FALSE
+                         FALSE,
+                         NULL
                          );
     LOG_TRACE_VMM("VmmMapMemoryInternal finished\n");
 
@@ -605,8 +1032,6 @@ VmmChangeCr3(
     // If CR4.PCIDE = 1 and bit 63 of the instructions source operand is 1, the instruction is not required to
     // invalidate any TLB entries or entries in paging - structure caches.
     __writecr3((Invalidate ? 0 : MOV_TO_CR3_DO_NOT_INVALIDATE_PCID_MAPPINGS) | (QWORD)Pml4Base | Pcid);
-
-    /// TODO: This should be broadcast on all CPUs to invalidate their mappings for PCID Pcid
 }
 
 _No_competing_thread_
@@ -618,6 +1043,58 @@ VmmInitReservationSystem(
     VmReservationSpaceFinishInit(&m_vmmData.VmmReservationSpace);
 }
 
+_No_competing_thread_
+STATUS
+VmmInitZeroFrame(
+    void
+    )
+{
+    PHYSICAL_ADDRESS pa;
+    PVOID pFrame;
+
+    pa = PmmReserveMemory(1);
+    if (NULL == pa)
+    {
+        LOG_FUNC_ERROR_ALLOC("PmmReserveMemory", 1);
+        return STATUS_PHYSICAL_MEMORY_NOT_AVAILABLE;
+    }
+
+    pFrame = MmuMapSystemMemory(pa, PAGE_SIZE);
+    if (NULL == pFrame)
+    {
+        LOG_FUNC_ERROR_ALLOC("MmuMapSystemMemory", PAGE_SIZE);
+        PmmReleaseMemory(pa, 1);
+        return STATUS_MEMORY_CANNOT_BE_COMMITED;
+    }
+
+    memzero(pFrame, PAGE_SIZE);
+
+    MmuUnmapSystemMemory(pFrame, PAGE_SIZE);
+
+    m_vmmData.ZeroFrame = pa;
+
+    return STATUS_SUCCESS;
+}
+
+BOOLEAN
+VmmSetLargePageUsage(
+    IN      BOOLEAN                 Enable
+    )
+{
+    return (BOOLEAN) _InterlockedExchange8((volatile char*) &m_vmmData.LargePagesEnabled, Enable);
+}
+
+DWORD
+VmmSetFaultAroundPages(
+    IN      DWORD                   NumberOfPages
+    )
+{
+    ASSERT(0 != NumberOfPages && 0 == (NumberOfPages & (NumberOfPages - 1)));
+    ASSERT(NumberOfPages <= VMM_MAX_FAULT_AROUND_PAGES);
+
+    return (DWORD) _InterlockedExchange((volatile long*) &m_vmmData.FaultAroundPages, NumberOfPages);
+}
+
 static
 void
 _VmmMapDescribedRegion(
@@ -678,6 +1155,7 @@ VmmAllocRegionEx(
     STATUS status;
     PVMM_RESERVATION_SPACE pVaSpace;
     PHYSICAL_ADDRESS pa;
+    BOOLEAN bZeroedFrames;
 
     ASSERT(Size != 0);
 
@@ -696,6 +1174,7 @@ VmmAllocRegionEx(
     pBaseAddress = NULL;
     pa = NULL;
     alignedSize = 0;
+    bZeroedFrames = FALSE;
 
     pVaSpace = (VaSpace == NULL) ? &m_vmmData.VmmReservationSpace : VaSpace;
     ASSERT(pVaSpace != NULL);
@@ -741,7 +1220,7 @@ VmmAllocRegionEx(
                 ASSERT(alignedSize / PAGE_SIZE <= MAX_DWORD);
                 DWORD noOfFrames = (DWORD)(alignedSize / PAGE_SIZE);
 
-                pa = PmmReserveMemory(noOfFrames);
+                pa = _VmReserveFrames(noOfFrames, &bZeroedFrames);
                 if (NULL == pa)
                 {
                     LOG_ERROR("PmmReserverMemory failed!\n");
@@ -784,7 +1263,10 @@ VmmAllocRegionEx(
 
                     // memzero the rest of the allocation (in case the size of the allocation is greater than the
                     // size of the file)
-                    memzero(PtrOffset(pBaseAddress, bytesRead), (DWORD)(alignedSize - bytesRead));
+                    if (!bZeroedFrames)
+                    {
+                        memzero(PtrOffset(pBaseAddress, bytesRead), (DWORD)(alignedSize - bytesRead));
+                    }
                 }
             }
         }
@@ -887,13 +1369,14 @@ VmmSolvePageFault(
     BOOLEAN bSolvedPageFault;
     BOOLEAN bAccessValid;
     STATUS status;
-    PPCPU pCpu;
     PAGE_RIGHTS pageRights;
     BOOLEAN uncacheable;
     PFILE_OBJECT pBackingFile;
     QWORD fileOffset;
     BOOLEAN bKernelAddress;
     QWORD bytesReadFromFile;
+    PVOID rangeStart;
+    DWORD rangePages;
 
     ASSERT(INTR_OFF == CpuIntrGetState());
     ASSERT(PagingData != NULL);
@@ -920,12 +1403,22 @@ VmmSolvePageFault(
     bSolvedPageFault = FALSE;
     bAccessValid = FALSE;
     status = STATUS_SUCCESS;
-    pCpu = GetCurrentPcpu();
     pageRights = 0;
     uncacheable = FALSE;
     pBackingFile = NULL;
     fileOffset = 0;
     bytesReadFromFile = 0;
+    rangeStart = NULL;
+    rangePages = 0;
+
+    // Writes to shared pages don't need a reservation, the page is already
+    // mapped and only its frame changes
+    if (IsBooleanFlagOn(RightsRequested, PAGE_RIGHTS_WRITE) &&
+        _VmSolveCopyOnWriteFault((PVOID)AlignAddressLower(FaultingAddress, PAGE_SIZE), PagingData))
+    {
+        PerCpuCounterIncrement(m_vmmData.PageFaultsCounter);
+        return TRUE;
+    }
 
     // See if the VA is already committed and retrieve its description (the page rights with which it was mapped,
     // cacheability and for memory backed by files the FILE_OBJECT and corresponding offset in file)
@@ -935,7 +1428,10 @@ VmmSolvePageFault(
                                                      &pageRights,
                                                      &uncacheable,
                                                      &pBackingFile,
-                                                     &fileOffset);
+                                                     &fileOffset,
+                                                     m_vmmData.FaultAroundPages,
+                                                     &rangeStart,
+                                                     &rangePages);
 
     __try
     {
@@ -943,34 +1439,93 @@ VmmSolvePageFault(
         {
             PHYSICAL_ADDRESS pa;
             PVOID alignedAddress;
+            QWORD rangeSize;
+            BOOLEAN bZeroedFrames;
+            INTR_STATE oldState;
 
             // solve #PF
+            alignedAddress = (PVOID)AlignAddressLower(FaultingAddress, PAGE_SIZE);
 
-            // 1. Reserve one frame of physical memory
-            pa = PmmReserveMemory(1);
-            ASSERT(NULL != pa);
+            // 1. Pages evicted by the pager are read back from the swap space
+            if (_VmSolveSwappedOutFault(alignedAddress, pageRights, uncacheable, PagingData, &bSolvedPageFault))
+            {
+                if (bSolvedPageFault)
+                {
+                    PerCpuCounterIncrement(m_vmmData.PageFaultsCounter);
+                }
+                __leave;
+            }
 
-            alignedAddress = (PVOID)AlignAddressLower(FaultingAddress, PAGE_SIZE);
+            // 2. Keep only the neighbours which are not yet mapped, we must not
+            // replace memory which may have already been written
+            RecRwSpinlockAcquireShared(&PagingData->Lock, &oldState);
+            _VmTrimFaultAroundRange(alignedAddress, &PagingData->Data, &rangeStart, &rangePages);
+            RecRwSpinlockReleaseShared(&PagingData->Lock, oldState);
+
+            // 3. Reads of anonymous user memory need no frame of their own
+            // until the first write, the whole range maps the zero frame
+            if (PAGE_RIGHTS_READ == RightsRequested &&
+                NULL == pBackingFile &&
+                !uncacheable &&
+                !PagingData->Data.KernelSpace)
+            {
+                _VmMapZeroFrame(PagingData, pageRights, rangeStart, rangePages);
 
-            // 2. Map the aligned faulting address to the newly acquired physical frame
-            MmuMapMemoryInternal(pa,
-                                 PAGE_SIZE,
-                                 pageRights,
-                                 alignedAddress,
-                                 TRUE,
-                                 uncacheable,
-                                 PagingData
-                                 );
-
-            // 3. If the virtual address is backed by a file read its contents
+                PerCpuCounterIncrement(m_vmmData.PageFaultsCounter);
+                bSolvedPageFault = TRUE;
+                __leave;
+            }
+
+            // 4. Reserve the frames of physical memory for the whole range, if
+            // there is no contiguous run available fall back to a single frame
+            pa = _VmReserveFrames(rangePages, &bZeroedFrames);
+            if (NULL == pa && 1 != rangePages)
+            {
+                rangeStart = alignedAddress;
+                rangePages = 1;
+
+                pa = _VmReserveFrames(1, &bZeroedFrames);
+            }
+
+            if (NULL == pa)
+            {
+                // Kernel memory can't wait for the pager, user accesses are
+                // retried once it freed some frames, or fail if it has
+                // nothing left to evict
+                bSolvedPageFault = !PagingData->Data.KernelSpace && SwapRequestFrames();
+                __leave;
+            }
+
+            // 5. Map the range to the newly acquired physical frames, if
+            // another CPU already mapped the faulting page the access is
+            // simply retried
+            if (!_VmMapFaultAroundRange(alignedAddress,
+                                        PagingData,
+                                        pageRights,
+                                        uncacheable,
+                                        &pa,
+                                        &rangeStart,
+                                        &rangePages))
+            {
+                bSolvedPageFault = TRUE;
+                __leave;
+            }
+
+            rangeSize = (QWORD) rangePages * PAGE_SIZE;
+
+            // 6. If the virtual address is backed by a file read the contents
+            // of the whole range at once
             if (pBackingFile != NULL)
             {
+                ASSERT(fileOffset >= (QWORD) PtrDiff(alignedAddress, rangeStart));
+                fileOffset = fileOffset - (QWORD) PtrDiff(alignedAddress, rangeStart);
+
                 LOGL("Will read data from file 0x%X and offset 0x%X\n", pBackingFile, fileOffset);
 
                 status = IoReadFile(pBackingFile,
-                                    PAGE_SIZE,
+                                    rangeSize,
                                     &fileOffset,
-                                    alignedAddress,
+                                    rangeStart,
                                     &bytesReadFromFile);
                 if (!SUCCEEDED(status))
                 {
@@ -979,27 +1534,31 @@ VmmSolvePageFault(
                 }
 
                 LOGL("Bytes read 0x%X\n", bytesReadFromFile);
-                ASSERT(bytesReadFromFile <= PAGE_SIZE);
+                ASSERT(bytesReadFromFile <= rangeSize);
             }
 
-            // 4. Zero the rest of the memory (in case the remaining file size was smaller than a page
-            /// TODO: check if this is really necessary (we have a ZERO worker thread already!)
-            if (bytesReadFromFile != PAGE_SIZE)
+            // 7. Zero the rest of the memory (in case the remaining file size was smaller than the range),
+            // the frames taken from the pool of the zero worker thread are already zero
+            if (!bZeroedFrames && bytesReadFromFile != rangeSize)
             {
                 /// TODO: Check if we really need to remove the WP (I'd rather not do this)
                 /// According to the Intel manual the WP flag has nothing to do with accessing UM pages
                 /// It is more generic, if WP is set => supervisor accesses can write to any virtual address
                 /// even if it is read-only
                 __writecr0(__readcr0() & ~CR0_WP);
-                memzero(PtrOffset(alignedAddress, bytesReadFromFile), PAGE_SIZE - (DWORD)bytesReadFromFile);
+                memzero(PtrOffset(rangeStart, bytesReadFromFile), (DWORD)(rangeSize - bytesReadFromFile));
                 __writecr0(__readcr0() | CR0_WP);
             }
 
-            if (NULL != pCpu)
+            // 8. Now that their contents are valid the pages of user address
+            // spaces may be evicted, the kernel memory always stays resident
+            if (!PagingData->Data.KernelSpace)
             {
-                // solved another page fault :)
-                pCpu->PageFaults = pCpu->PageFaults + 1;
+                _VmRegisterEvictablePages(PagingData, rangeStart, pa, rangePages);
             }
+
+            // solved another page fault :)
+            PerCpuCounterIncrement(m_vmmData.PageFaultsCounter);
             bSolvedPageFault = TRUE;
         }
     }
@@ -1190,13 +1749,12 @@ _VmSetupPagingStructure(
     flags.PagingStructure = TRUE;
     flags.UserAccess = !PagingData->KernelSpace;
 
+    // Zero the paging structure before linking it => we cannot get stray
+    // memory accesses, reused structures still contain the free list link
     // for paging structure PA2VA can always be used :)
-    PteMap(PagingStructure, physicalAddr, flags);
-
-    __invlpg((PVOID)PA2VA(physicalAddr));
-
-    // Zero the current paging structure entry => we cannot get stray memory accesses
     memzero((PVOID)PA2VA(physicalAddr), PAGE_SIZE);
+
+    PteMap(PagingStructure, physicalAddr, flags);
 }
 
 static
@@ -1239,4 +1797,926 @@ _VmDeterminePatIndices(
     }
 
     return bFoundWb && bFoundUc;
+}
+
+static
+void
+_VmSplitLargePage(
+    IN      PPAGING_DATA            PagingData,
+    INOUT   PVOID                   LargePageEntry,
+    IN      PVOID                   VirtualAddress,
+    IN      QWORD                   LargePageSize
+    )
+{
+    PD_ENTRY_2MB* pLargeEntry;
+    PHYSICAL_ADDRESS largePagePa;
+    PHYSICAL_ADDRESS tablePa;
+    PVOID pTable;
+    QWORD childSize;
+    PTE_MAP_FLAGS flags = { 0 };
+    PTE_MAP_FLAGS tableFlags = { 0 };
+
+    ASSERT(NULL != PagingData);
+    ASSERT(NULL != LargePageEntry);
+    ASSERT(_VmIsLargePageEntry(LargePageEntry));
+    ASSERT(VMM_2MB_PAGE_SIZE == LargePageSize || VMM_1GB_PAGE_SIZE == LargePageSize);
+
+    pLargeEntry = LargePageEntry;
+    largePagePa = PteLargePageGetPhysicalAddress(pLargeEntry);
+
+    // the new entries keep the rights and caching of the large page
+    flags.Writable = (WORD) pLargeEntry->ReadWrite;
+    flags.Executable = (WORD) !pLargeEntry->XD;
+    flags.UserAccess = (WORD) pLargeEntry->UserSupervisor;
+    flags.PatIndex = (WORD) ((pLargeEntry->PAT << 2) | (pLargeEntry->PCD << 1) | pLargeEntry->PWT);
+    flags.GlobalPage = (WORD) pLargeEntry->Global;
+
+    // a 1GB page is split into 2MB pages, a 2MB page into 4KB pages
+    childSize = (VMM_1GB_PAGE_SIZE == LargePageSize) ? VMM_2MB_PAGE_SIZE : PAGE_SIZE;
+
+    tablePa = _VmRetrieveNextPhysicalAddressForPagingStructure(PagingData);
+    pTable = (PVOID) PA2VA(tablePa);
+
+    for (DWORD i = 0; i < VMM_ENTRIES_PER_PAGING_STRUCTURE; ++i)
+    {
+        PHYSICAL_ADDRESS childPa = (PHYSICAL_ADDRESS) PtrOffset(largePagePa, i * childSize);
+
+        if (VMM_2MB_PAGE_SIZE == childSize)
+        {
+            PteMapLargePage(&((PD_ENTRY_2MB*)pTable)[i], childPa, flags);
+        }
+        else
+        {
+            PteMap(&((PT_ENTRY*)pTable)[i], childPa, flags);
+        }
+    }
+
+    tableFlags.Writable = TRUE;
+    tableFlags.Executable = TRUE;
+    tableFlags.PagingStructure = TRUE;
+    tableFlags.UserAccess = !PagingData->KernelSpace;
+
+    // the table is fully populated before it is linked => the translations
+    // for the range never disappear while we split
+    PteMap(LargePageEntry, tablePa, tableFlags);
+
+    // invalidating any address of the large page flushes the whole TLB entry
+    __invlpg((PVOID)AlignAddressLower(VirtualAddress, LargePageSize));
+}
+
+static
+QWORD
+_VmMapLargePage(
+    IN      PPAGING_DATA            PagingData,
+    INOUT   PVOID                   Entry,
+    IN      PVOID                   VirtualAddress,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      QWORD                   RemainingSize,
+    IN      QWORD                   LargePageSize,
+    IN      PTE_MAP_FLAGS           Flags,
+    IN      BOOLEAN                 Invalidate,
+    INOUT_OPT
+            PTLB_SHOOTDOWN_BATCH    Batch
+    )
+{
+    BOOLEAN bCanUseLargePage;
+    BOOLEAN bReplaced;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(NULL != Entry);
+
+    bReplaced = FALSE;
+
+    // user pages are tracked one by one by the pager and by the copy on
+    // write logic, which retrieve their 4KB page table entries => only kernel
+    // mappings may use large pages
+    bCanUseLargePage = PagingData->KernelSpace
+        && !Flags.CopyOnWrite
+        && !Flags.SharedFrame
+        && _VmCanUseLargePage(VirtualAddress, PhysicalAddress, RemainingSize, LargePageSize);
+
+    if (_VmIsLargePageEntry(Entry))
+    {
+        if (!Invalidate)
+        {
+            // same as for 4KB pages, an existing mapping is left untouched
+            return min(RemainingSize, LargePageSize - AddressOffset(VirtualAddress, LargePageSize));
+        }
+
+        if (!bCanUseLargePage)
+        {
+            // only a part of the large page changes its translation or its
+            // rights => we need a finer granularity
+            _VmSplitLargePage(PagingData, Entry, VirtualAddress, LargePageSize);
+            return 0;
+        }
+
+        bReplaced = TRUE;
+    }
+    else if (PteIsPresent(Entry))
+    {
+        // the entry references a paging structure which may contain other
+        // mappings, we don't replace it
+        return 0;
+    }
+    else if (!bCanUseLargePage)
+    {
+        _VmSetupPagingStructure(PagingData, Entry);
+        return 0;
+    }
+
+    ASSERT(bCanUseLargePage);
+
+    PteMapLargePage(Entry, PhysicalAddress, Flags);
+
+    // translations which were not present can't be cached
+    if (bReplaced)
+    {
+        _VmInvalidateTranslation(VirtualAddress, LargePageSize, Batch);
+    }
+
+    return LargePageSize;
+}
+
+static
+QWORD
+_VmUnmapLargePage(
+    IN      PPAGING_DATA            PagingData,
+    INOUT   PVOID                   Entry,
+    IN      PVOID                   VirtualAddress,
+    IN      QWORD                   RemainingSize,
+    IN      QWORD                   LargePageSize,
+    IN      BOOLEAN                 ReleaseMemory,
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch
+    )
+{
+    PHYSICAL_ADDRESS pa;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(_VmIsLargePageEntry(Entry));
+
+    if (!IsAddressAligned(VirtualAddress, LargePageSize) || (RemainingSize < LargePageSize))
+    {
+        // partial unmap => split the page and let the caller unmap the
+        // smaller pages
+        _VmSplitLargePage(PagingData, Entry, VirtualAddress, LargePageSize);
+        return 0;
+    }
+
+    pa = PteLargePageGetPhysicalAddress(Entry);
+
+    PteUnmap(Entry);
+
+    _VmInvalidateTranslation(VirtualAddress, LargePageSize, Batch);
+
+    if (ReleaseMemory)
+    {
+        TlbBatchAddFramesToRelease(Batch, pa, (DWORD) (LargePageSize / PAGE_SIZE));
+    }
+
+    return LargePageSize;
+}
+
+static
+void
+_VmMapRange(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   PagingStructure,
+    IN      DWORD                   Level,
+    IN      PVOID                   BaseAddress,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      QWORD                   Size,
+    IN      PTE_MAP_FLAGS           Flags,
+    IN      BOOLEAN                 Invalidate,
+    INOUT_OPT
+            PTLB_SHOOTDOWN_BATCH    Batch
+    )
+{
+    QWORD entrySize;
+    QWORD offset;
+    QWORD chunkSize;
+    QWORD mappedSize;
+    PVOID currentAddress;
+    PHYSICAL_ADDRESS physAddr;
+    PVOID pEntry;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(NULL != PagingStructure);
+    ASSERT(Level <= VMM_PAGING_LEVEL_PML4);
+
+    entrySize = VMM_ENTRY_COVERAGE(Level);
+
+    // The range is entirely described by PagingStructure => we fill its
+    // consecutive entries and descend into the next level only once for
+    // each entry, instead of walking from the PML4 for each page.
+    for (offset = 0; offset < Size; offset = offset + chunkSize)
+    {
+        currentAddress = PtrOffset(BaseAddress, offset);
+        physAddr = (PHYSICAL_ADDRESS) PtrOffset(PhysicalAddress, offset);
+        pEntry = PtrOffset(PagingStructure, VMM_ENTRY_INDEX(currentAddress, Level) * sizeof(QWORD));
+
+        // the part of the range described by the current entry
+        chunkSize = min(Size - offset, entrySize - AddressOffset(currentAddress, entrySize));
+
+        if (VMM_PAGING_LEVEL_PT == Level)
+        {
+            // if we must invalidate the entry or the entry is not present, map it
+            if (Invalidate || (!PteIsPresent(pEntry)))
+            {
+                BOOLEAN bReplaced = PteIsPresent(pEntry);
+
+                PteMap(pEntry, physAddr, Flags);
+
+                // translations which were not present can't be cached
+                if (bReplaced)
+                {
+                    _VmInvalidateTranslation(currentAddress, PAGE_SIZE, Batch);
+                }
+            }
+
+            continue;
+        }
+
+        if (VMM_PAGING_LEVEL_PML4 == Level)
+        {
+            if (!PteIsPresent(pEntry))
+            {
+                _VmSetupPagingStructure(PagingData, pEntry);
+            }
+        }
+        else
+        {
+            // whenever the VA, the PA and the remaining size allow it a 1GB
+            // or 2MB page is used, else the next level structure is created
+            // or an existing large page is split
+            mappedSize = _VmMapLargePage(PagingData,
+                                         pEntry,
+                                         currentAddress,
+                                         physAddr,
+                                         Size - offset,
+                                         entrySize,
+                                         Flags,
+                                         Invalidate,
+                                         Batch);
+            if (0 != mappedSize)
+            {
+                ASSERT(mappedSize == chunkSize);
+                continue;
+            }
+        }
+
+        ASSERT(!_VmIsLargePageEntry(pEntry));
+
+        _VmMapRange(PagingData,
+                    (PVOID) PA2VA(PteGetPhysicalAddress(pEntry)),
+                    Level - 1,
+                    currentAddress,
+                    physAddr,
+                    chunkSize,
+                    Flags,
+                    Invalidate,
+                    Batch);
+    }
+}
+
+static
+QWORD
+_VmUnmapRange(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   PagingStructure,
+    IN      DWORD                   Level,
+    IN      PVOID                   BaseAddress,
+    IN      QWORD                   Size,
+    IN      BOOLEAN                 ReleaseMemory,
+    INOUT   PTLB_SHOOTDOWN_BATCH    Batch
+    )
+{
+    QWORD entrySize;
+    QWORD offset;
+    QWORD chunkSize;
+    QWORD unmappedSize;
+    QWORD noOfPagesBefore;
+    PVOID currentAddress;
+    PVOID pEntry;
+    PHYSICAL_ADDRESS pa;
+    BOOLEAN bSharedFrame;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(NULL != PagingStructure);
+    ASSERT(Level <= VMM_PAGING_LEVEL_PML4);
+    ASSERT(NULL != Batch);
+
+    entrySize = VMM_ENTRY_COVERAGE(Level);
+
+    for (offset = 0; offset < Size; offset = offset + chunkSize)
+    {
+        currentAddress = PtrOffset(BaseAddress, offset);
+        pEntry = PtrOffset(PagingStructure, VMM_ENTRY_INDEX(currentAddress, Level) * sizeof(QWORD));
+
+        chunkSize = min(Size - offset, entrySize - AddressOffset(currentAddress, entrySize));
+
+        if (!PteIsPresent(pEntry))
+        {
+            if ((VMM_PAGING_LEVEL_PT == Level) && ((PT_ENTRY*)pEntry)->SwappedOut)
+            {
+                // the contents of the page are only in the swap space
+                SwapReleaseSlot((DWORD) ((PT_ENTRY*)pEntry)->PhysicalAddress);
+                PteUnmap(pEntry);
+            }
+
+            // nothing is mapped in the whole region described by the entry
+            continue;
+        }
+
+        if ((VMM_PAGING_LEVEL_PT == Level) || _VmIsLargePageEntry(pEntry))
+        {
+            if (ReleaseMemory && TlbBatchIsFull(Batch))
+            {
+                // the frames can't be released before the other CPUs flush
+                // their TLBs, let the caller do that and call us again
+                return offset;
+            }
+        }
+
+        if (VMM_PAGING_LEVEL_PT == Level)
+        {
+            pa = PteGetPhysicalAddress(pEntry);
+            bSharedFrame = ((PT_ENTRY*)pEntry)->SharedFrame;
+
+            PteUnmap(pEntry);
+
+            _VmInvalidateTranslation(currentAddress, PAGE_SIZE, Batch);
+
+            if (!PagingData->KernelSpace)
+            {
+                // the pager must not evict a page which is no longer mapped
+                SwapUnregisterFrame(pa);
+            }
+
+            // the zero frame is shared by all the address spaces and the
+            // other shared frames are released by their owners
+            if (ReleaseMemory && pa != m_vmmData.ZeroFrame && !bSharedFrame)
+            {
+                TlbBatchAddFramesToRelease(Batch, pa, 1);
+            }
+
+            continue;
+        }
+
+        if (_VmIsLargePageEntry(pEntry))
+        {
+            // large pages fully contained in the range are unmapped at once
+            // while the ones only partially contained are first split
+            unmappedSize = _VmUnmapLargePage(PagingData,
+                                             pEntry,
+                                             currentAddress,
+                                             Size - offset,
+                                             entrySize,
+                                             ReleaseMemory,
+                                             Batch);
+            if (0 != unmappedSize)
+            {
+                ASSERT(unmappedSize == chunkSize);
+                continue;
+            }
+        }
+
+        pa = PteGetPhysicalAddress(pEntry);
+        noOfPagesBefore = Batch->NumberOfPages;
+
+        unmappedSize = _VmUnmapRange(PagingData,
+                                     (PVOID) PA2VA(pa),
+                                     Level - 1,
+                                     currentAddress,
+                                     chunkSize,
+                                     ReleaseMemory,
+                                     Batch);
+
+        // The PDPTs are never freed, and neither are the structures of the
+        // kernel: they are shared by all the address spaces.
+        if ((VMM_PAGING_LEVEL_PML4 != Level) &&
+            !PagingData->KernelSpace &&
+            (noOfPagesBefore != Batch->NumberOfPages) &&
+            _VmIsPagingStructureEmpty((PVOID) PA2VA(pa)))
+        {
+            PteUnmap(pEntry);
+
+            // Other CPUs may still walk the structure through their
+            // paging-structure caches until the batch is flushed, it is
+            // made available for reuse only after that by
+            // VmmReclaimPagingStructures. The link written in its first
+            // entry is page aligned => it is not present.
+            *((PHYSICAL_ADDRESS*)PA2VA(pa)) = Batch->FreedPagingStructures;
+            Batch->FreedPagingStructures = pa;
+        }
+
+        if (unmappedSize != chunkSize)
+        {
+            return offset + unmappedSize;
+        }
+    }
+
+    return Size;
+}
+
+static
+void
+_VmTrimFaultAroundRange(
+    IN      PVOID                   FaultingPage,
+    IN      PPAGING_DATA            PagingData,
+    INOUT   PVOID*                  RangeStart,
+    INOUT   DWORD*                  RangePages
+    )
+{
+    PVOID rangeStart;
+    PVOID rangeEnd;
+    PVOID windowEnd;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(NULL != RangeStart);
+    ASSERT(NULL != RangePages);
+    ASSERT(CHECK_BOUNDS(FaultingPage, PAGE_SIZE, *RangeStart, (QWORD) *RangePages * PAGE_SIZE));
+
+    rangeStart = FaultingPage;
+    rangeEnd = PtrOffset(FaultingPage, PAGE_SIZE);
+    windowEnd = PtrOffset(*RangeStart, (QWORD) *RangePages * PAGE_SIZE);
+
+    // the faulting page itself is checked by the caller, its neighbours are
+    // mapped only if nobody mapped them yet and they were not swapped out
+    while (rangeStart > *RangeStart &&
+           !_VmIsPageInUse(PagingData, (PBYTE) rangeStart - PAGE_SIZE))
+    {
+        rangeStart = (PBYTE) rangeStart - PAGE_SIZE;
+    }
+
+    while (rangeEnd < windowEnd &&
+           !_VmIsPageInUse(PagingData, rangeEnd))
+    {
+        rangeEnd = PtrOffset(rangeEnd, PAGE_SIZE);
+    }
+
+    *RangeStart = rangeStart;
+    *RangePages = (DWORD) ((QWORD) PtrDiff(rangeEnd, rangeStart) / PAGE_SIZE);
+}
+
+static
+PTR_SUCCESS
+PHYSICAL_ADDRESS
+_VmReserveFrames(
+    IN      DWORD                   NoOfFrames,
+    OUT     BOOLEAN*                Zeroed
+    )
+{
+    PHYSICAL_ADDRESS pa;
+
+    ASSERT(0 != NoOfFrames);
+    ASSERT(NULL != Zeroed);
+
+    pa = MmuReserveZeroedFrames(NoOfFrames);
+    *Zeroed = (NULL != pa);
+
+    if (NULL == pa)
+    {
+        pa = PmmReserveMemory(NoOfFrames);
+    }
+
+    if (NULL != pa)
+    {
+        // wakes the pager if the free memory runs low
+        SwapNotifyFramesReserved();
+    }
+
+    return pa;
+}
+
+static
+PT_ENTRY*
+_VmRetrievePageTableEntry(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress
+    )
+{
+    PVOID pPagingStructure;
+    PVOID pEntry;
+
+    ASSERT(NULL != PagingData);
+
+    pPagingStructure = (PVOID) PA2VA(PagingData->BasePhysicalAddress);
+
+    for (DWORD level = VMM_PAGING_LEVEL_PML4; level > VMM_PAGING_LEVEL_PT; --level)
+    {
+        pEntry = PtrOffset(pPagingStructure, VMM_ENTRY_INDEX(VirtualAddress, level) * sizeof(QWORD));
+
+        // large pages are never mapped copy-on-write nor swapped out
+        if (!PteIsPresent(pEntry) || _VmIsLargePageEntry(pEntry))
+        {
+            return NULL;
+        }
+
+        pPagingStructure = (PVOID) PA2VA(PteGetPhysicalAddress(pEntry));
+    }
+
+    return PtrOffset(pPagingStructure, VMM_ENTRY_INDEX(VirtualAddress, VMM_PAGING_LEVEL_PT) * sizeof(QWORD));
+}
+
+static
+BOOLEAN
+_VmSolveCopyOnWriteFault(
+    IN      PVOID                   FaultingPage,
+    IN      PPAGING_LOCK_DATA       PagingData
+    )
+{
+    INTR_STATE oldState;
+    PT_ENTRY* pEntry;
+    BOOLEAN bCopyOnWrite;
+    BOOLEAN bWritable;
+    BOOLEAN bZeroed;
+    PHYSICAL_ADDRESS pa;
+    PHYSICAL_ADDRESS sharedFrame;
+    PVOID pCopy;
+    TLB_SHOOTDOWN_BATCH batch;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(IsAddressAligned(FaultingPage, PAGE_SIZE));
+
+    sharedFrame = NULL;
+
+    RecRwSpinlockAcquireShared(&PagingData->Lock, &oldState);
+    pEntry = _VmRetrievePageTableEntry(&PagingData->Data, FaultingPage);
+    bCopyOnWrite = (NULL != pEntry) && PteIsPresent(pEntry) && pEntry->CopyOnWrite;
+    bWritable = (NULL != pEntry) && PteIsPresent(pEntry) && pEntry->ReadWrite;
+    if (bCopyOnWrite)
+    {
+        sharedFrame = PteGetPhysicalAddress(pEntry);
+    }
+    RecRwSpinlockReleaseShared(&PagingData->Lock, oldState);
+
+    if (bWritable)
+    {
+        // Another CPU already copied the page, this CPU still had the
+        // read-only translation cached
+        __invlpg(FaultingPage);
+        return TRUE;
+    }
+
+    if (!bCopyOnWrite)
+    {
+        return FALSE;
+    }
+
+    // 1. Copy the page in a new frame, the shared frame is still mapped
+    // read-only at FaultingPage
+    pa = _VmReserveFrames(1, &bZeroed);
+    if (NULL == pa)
+    {
+        // the write is retried once the pager freed some frames
+        ASSERT(!PagingData->Data.KernelSpace);
+
+        return SwapRequestFrames();
+    }
+
+    // a frame taken from the pool of the zero worker is already a copy of
+    // the zero frame
+    if (sharedFrame != m_vmmData.ZeroFrame || !bZeroed)
+    {
+        pCopy = MmuMapSystemMemory(pa, PAGE_SIZE);
+        ASSERT(NULL != pCopy);
+
+        if (sharedFrame == m_vmmData.ZeroFrame)
+        {
+            memzero(pCopy, PAGE_SIZE);
+        }
+        else
+        {
+            memcpy(pCopy, FaultingPage, PAGE_SIZE);
+        }
+
+        MmuUnmapSystemMemory(pCopy, PAGE_SIZE);
+    }
+
+    TlbBatchInit(&batch, &PagingData->Data);
+
+    // 2. Replace the shared frame, unless another CPU was faster
+    RecRwSpinlockAcquireExclusive(&PagingData->Lock, &oldState);
+    pEntry = _VmRetrievePageTableEntry(&PagingData->Data, FaultingPage);
+    bCopyOnWrite = (NULL != pEntry) && PteIsPresent(pEntry) && pEntry->CopyOnWrite;
+    if (bCopyOnWrite)
+    {
+        pEntry->PhysicalAddress = (QWORD) pa >> SHIFT_FOR_PHYSICAL_ADDR;
+        pEntry->CopyOnWrite = 0;
+        pEntry->SharedFrame = 0;
+        pEntry->ReadWrite = 1;
+
+        // The other CPUs running threads of the process may still have the
+        // translation to the shared frame cached, an image frame or the zero
+        // frame, they would keep reading it after the private copy is
+        // written: reads never fault, so they would never see the writes
+        TlbBatchAddRange(&batch, FaultingPage, PAGE_SIZE);
+
+        // the private copy is ordinary anonymous memory
+        SwapRegisterFrame(pa, PagingData, FaultingPage);
+    }
+    RecRwSpinlockReleaseExclusive(&PagingData->Lock, oldState);
+
+    TlbBatchFlush(&batch);
+
+    if (!bCopyOnWrite)
+    {
+        PmmReleaseMemory(pa, 1);
+    }
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+_VmIsPageInUse(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress
+    )
+{
+    PVOID pPagingStructure;
+    PVOID pEntry;
+
+    ASSERT(NULL != PagingData);
+
+    pPagingStructure = (PVOID) PA2VA(PagingData->BasePhysicalAddress);
+
+    for (DWORD level = VMM_PAGING_LEVEL_PML4; level > VMM_PAGING_LEVEL_PT; --level)
+    {
+        pEntry = PtrOffset(pPagingStructure, VMM_ENTRY_INDEX(VirtualAddress, level) * sizeof(QWORD));
+
+        if (!PteIsPresent(pEntry))
+        {
+            return FALSE;
+        }
+
+        if (_VmIsLargePageEntry(pEntry))
+        {
+            return TRUE;
+        }
+
+        pPagingStructure = (PVOID) PA2VA(PteGetPhysicalAddress(pEntry));
+    }
+
+    pEntry = PtrOffset(pPagingStructure, VMM_ENTRY_INDEX(VirtualAddress, VMM_PAGING_LEVEL_PT) * sizeof(QWORD));
+
+    // an entry which is not present may still hold the slot of a swapped out
+    // page
+    return 0 != *((QWORD*)pEntry);
+}
+
+static
+DWORD
+_VmRetrieveSwapSlot(
+    IN      PPAGING_DATA            PagingData,
+    IN      PVOID                   VirtualAddress
+    )
+{
+    PT_ENTRY* pEntry;
+
+    pEntry = _VmRetrievePageTableEntry(PagingData, VirtualAddress);
+    if (NULL == pEntry || PteIsPresent(pEntry) || !pEntry->SwappedOut)
+    {
+        return SWAP_INVALID_SLOT;
+    }
+
+    return (DWORD) pEntry->PhysicalAddress;
+}
+
+static
+BOOLEAN
+_VmSolveSwappedOutFault(
+    IN      PVOID                   FaultingPage,
+    IN      PAGE_RIGHTS             PageRights,
+    IN      BOOLEAN                 Uncacheable,
+    IN      PPAGING_LOCK_DATA       PagingData,
+    OUT     BOOLEAN*                Solved
+    )
+{
+    INTR_STATE oldState;
+    STATUS status;
+    DWORD slot;
+    BOOLEAN bZeroed;
+    BOOLEAN bMapped;
+    PHYSICAL_ADDRESS pa;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(NULL != Solved);
+    ASSERT(IsAddressAligned(FaultingPage, PAGE_SIZE));
+
+    *Solved = FALSE;
+
+    RecRwSpinlockAcquireShared(&PagingData->Lock, &oldState);
+    slot = _VmRetrieveSwapSlot(&PagingData->Data, FaultingPage);
+    RecRwSpinlockReleaseShared(&PagingData->Lock, oldState);
+
+    if (SWAP_INVALID_SLOT == slot)
+    {
+        return FALSE;
+    }
+
+    pa = _VmReserveFrames(1, &bZeroed);
+    if (NULL == pa)
+    {
+        *Solved = SwapRequestFrames();
+        return TRUE;
+    }
+
+    // 1. Read the page in the new frame, it is not yet visible to anybody
+    status = SwapReadPage(slot, pa);
+    if (!SUCCEEDED(status))
+    {
+        PmmReleaseMemory(pa, 1);
+
+        // the pager has not finished writing the page, the access is
+        // retried
+        *Solved = (STATUS_DEVICE_BUSY == status);
+        if (!*Solved)
+        {
+            LOG_FUNC_ERROR("SwapReadPage", status);
+        }
+
+        return TRUE;
+    }
+
+    // 2. Map it, unless it was unmapped or read by another CPU meanwhile
+    RecRwSpinlockAcquireExclusive(&PagingData->Lock, &oldState);
+    bMapped = (slot == _VmRetrieveSwapSlot(&PagingData->Data, FaultingPage));
+    if (bMapped)
+    {
+        // the entry is not present => there is no translation to invalidate
+        VmmMapMemoryInternal(&PagingData->Data,
+                             pa,
+                             PAGE_SIZE,
+                             FaultingPage,
+                             PageRights,
+                             FALSE,
+                             Uncacheable,
+                             NULL);
+
+        SwapReleaseSlot(slot);
+        SwapRegisterFrame(pa, PagingData, FaultingPage);
+    }
+    RecRwSpinlockReleaseExclusive(&PagingData->Lock, oldState);
+
+    if (!bMapped)
+    {
+        PmmReleaseMemory(pa, 1);
+    }
+
+    *Solved = TRUE;
+
+    return TRUE;
+}
+
+static
+BOOLEAN
+_VmMapFaultAroundRange(
+    IN      PVOID                   FaultingPage,
+    IN      PPAGING_LOCK_DATA       PagingData,
+    IN      PAGE_RIGHTS             PageRights,
+    IN      BOOLEAN                 Uncacheable,
+    INOUT   PHYSICAL_ADDRESS*       PhysicalAddress,
+    INOUT   PVOID*                  RangeStart,
+    INOUT   DWORD*                  RangePages
+    )
+{
+    INTR_STATE oldState;
+    BOOLEAN bMapped;
+    PVOID rangeStart;
+    DWORD rangePages;
+    DWORD pagesBefore;
+    DWORD pagesAfter;
+    PHYSICAL_ADDRESS pa;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(NULL != PhysicalAddress);
+    ASSERT(NULL != RangeStart);
+    ASSERT(NULL != RangePages);
+
+    rangeStart = *RangeStart;
+    rangePages = *RangePages;
+    pa = *PhysicalAddress;
+
+    RecRwSpinlockAcquireExclusive(&PagingData->Lock, &oldState);
+    bMapped = !_VmIsPageInUse(&PagingData->Data, FaultingPage);
+    if (bMapped)
+    {
+        _VmTrimFaultAroundRange(FaultingPage, &PagingData->Data, &rangeStart, &rangePages);
+        pa = (PHYSICAL_ADDRESS) PtrOffset(*PhysicalAddress, (QWORD) PtrDiff(rangeStart, *RangeStart));
+
+        // none of the entries is present => there is nothing to invalidate
+        VmmMapMemoryInternal(&PagingData->Data,
+                             pa,
+                             (QWORD) rangePages * PAGE_SIZE,
+                             rangeStart,
+                             PageRights,
+                             FALSE,
+                             Uncacheable,
+                             NULL);
+    }
+    RecRwSpinlockReleaseExclusive(&PagingData->Lock, oldState);
+
+    if (!bMapped)
+    {
+        PmmReleaseMemory(*PhysicalAddress, *RangePages);
+        return FALSE;
+    }
+
+    // give back the frames of the neighbours mapped meanwhile
+    pagesBefore = (DWORD) ((QWORD) PtrDiff(rangeStart, *RangeStart) / PAGE_SIZE);
+    pagesAfter = *RangePages - pagesBefore - rangePages;
+
+    if (0 != pagesBefore)
+    {
+        PmmReleaseMemory(*PhysicalAddress, pagesBefore);
+    }
+
+    if (0 != pagesAfter)
+    {
+        PmmReleaseMemory((PHYSICAL_ADDRESS) PtrOffset(pa, (QWORD) rangePages * PAGE_SIZE), pagesAfter);
+    }
+
+    *PhysicalAddress = pa;
+    *RangeStart = rangeStart;
+    *RangePages = rangePages;
+
+    return TRUE;
+}
+
+static
+void
+_VmMapZeroFrame(
+    IN      PPAGING_LOCK_DATA       PagingData,
+    IN      PAGE_RIGHTS             PageRights,
+    IN      PVOID                   RangeStart,
+    IN      DWORD                   RangePages
+    )
+{
+    INTR_STATE oldState;
+    PAGE_RIGHTS rights;
+    PVOID pCurrentPage;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(!PagingData->Data.KernelSpace);
+    ASSERT(NULL != m_vmmData.ZeroFrame);
+
+    rights = IsBooleanFlagOn(PageRights, PAGE_RIGHTS_WRITE) ? (PageRights | VMM_PAGE_RIGHTS_COPY_ON_WRITE) : PageRights;
+
+    // the pages mapped by other CPUs in the meantime are left alone, if the
+    // faulting page is one of them the access is simply retried
+    RecRwSpinlockAcquireExclusive(&PagingData->Lock, &oldState);
+    for (DWORD i = 0; i < RangePages; ++i)
+    {
+        pCurrentPage = PtrOffset(RangeStart, (QWORD) i * PAGE_SIZE);
+
+        if (!_VmIsPageInUse(&PagingData->Data, pCurrentPage))
+        {
+            VmmMapMemoryInternal(&PagingData->Data,
+                                 m_vmmData.ZeroFrame,
+                                 PAGE_SIZE,
+                                 pCurrentPage,
+                                 rights,
+                                 FALSE,
+                                 FALSE,
+                                 NULL);
+        }
+    }
+    RecRwSpinlockReleaseExclusive(&PagingData->Lock, oldState);
+}
+
+static
+void
+_VmRegisterEvictablePages(
+    IN      PPAGING_LOCK_DATA       PagingData,
+    IN      PVOID                   BaseAddress,
+    IN      PHYSICAL_ADDRESS        PhysicalAddress,
+    IN      DWORD                   NumberOfPages
+    )
+{
+    INTR_STATE oldState;
+    PT_ENTRY* pEntry;
+    PVOID pCurrentPage;
+    PHYSICAL_ADDRESS pa;
+
+    ASSERT(NULL != PagingData);
+    ASSERT(!PagingData->Data.KernelSpace);
+
+    // The pages may have been unmapped since they were mapped, the frames
+    // are registered only if they are still in use. Pages mapped with large
+    // pages are never evicted.
+    RecRwSpinlockAcquireShared(&PagingData->Lock, &oldState);
+    for (DWORD i = 0; i < NumberOfPages; ++i)
+    {
+        pCurrentPage = PtrOffset(BaseAddress, (QWORD) i * PAGE_SIZE);
+        pa = (PHYSICAL_ADDRESS) PtrOffset(PhysicalAddress, (QWORD) i * PAGE_SIZE);
+
+        pEntry = _VmRetrievePageTableEntry(&PagingData->Data, pCurrentPage);
+        if (NULL != pEntry && PteIsPresent(pEntry) && pa == PteGetPhysicalAddress(pEntry))
+        {
+            SwapRegisterFrame(pa, PagingData, pCurrentPage);
+        }
+    }
+    RecRwSpinlockReleaseShared(&PagingData->Lock, oldState);
 }
\ No newline at end of file
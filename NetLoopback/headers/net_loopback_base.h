@@ -0,0 +1,10 @@
+#pragma once
+
+#include "common_lib.h"
+#include "io.h"
+#include "log.h"
+#include "ex.h"
+#include "thread.h"
+#include "network.h"
+#include "network_utils.h"
+#include "net_loopback_structures.h"
\ No newline at end of file
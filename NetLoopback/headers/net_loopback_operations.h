@@ -0,0 +1,45 @@
+#pragma once
+
+SAL_SUCCESS
+STATUS
+NetLoopbackInitializeDevice(
+    INOUT                           PLOOPBACK_DEVICE        Device
+    );
+
+void
+NetLoopbackUninitializeDevice(
+    INOUT                           PLOOPBACK_DEVICE        Device
+    );
+
+_No_competing_thread_
+STATUS
+NetLoopbackReceiveFrame(
+    IN                              PLOOPBACK_DEVICE        Device
+    );
+
+_No_competing_thread_
+STATUS
+NetLoopbackSendFrame(
+    IN                              PLOOPBACK_DEVICE        Device,
+    IN                              WORD                    DescriptorIndex,
+    IN                              WORD                    Length,
+    IN                              BOOLEAN                 EndOfPacket
+    );
+
+_No_competing_thread_
+BOOLEAN
+NetLoopbackHandleInterrupt(
+    IN                              PLOOPBACK_DEVICE        Device
+    );
+
+_No_competing_thread_
+void
+NetLoopbackChangeDeviceStatus(
+    IN                              PLOOPBACK_DEVICE        Device,
+    IN                              PNETWORK_DEVICE_STATUS  DeviceStatus
+    );
+
+QWORD
+NetLoopbackGetLatencyInTicks(
+    void
+    );
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "lock_common.h"
+#include "ex_event.h"
+
+#define NET_LOOPBACK_NO_OF_DEVICES              1
+
+#define NET_LOOPBACK_DRIVER_NAME                "netloop.sys"
+
+#define NET_LOOPBACK_DESCRIPTOR_SIZE            16
+
+#define NET_LOOPBACK_BUFFER_SIZE                (2*KB_SIZE)
+
+#define NET_LOOPBACK_DEFAULT_LATENCY_US         0
+
+// locally administered unicast addresses: 02:4C:4F:4F:50:xx
+#define NET_LOOPBACK_MAC_PREFIX                 { 0x02, 'L', 'O', 'O', 'P' }
+#define NET_LOOPBACK_MAC_PREFIX_SIZE            5
+
+#define NET_LOOPBACK_INT_CAUSE_RX               0x1
+#define NET_LOOPBACK_INT_CAUSE_TX               0x2
+
+#pragma pack(push,1)
+
+// Both rings use the same descriptor format and the same ownership rules as
+// the 82574L: the hardware owns the RX descriptors in [Head, Tail) and the TX
+// descriptors in [Head, Tail), it sets DescriptorDone when it is done with one.
+typedef struct _LOOPBACK_DESCRIPTOR_SHADOW
+{
+    PHYSICAL_ADDRESS                        BufferAddress;
+    WORD                                    Length;
+    BYTE                                    DescriptorDone;
+    BYTE                                    EOP;
+    DWORD                                   __Reserved0;
+} LOOPBACK_DESCRIPTOR_SHADOW, *PLOOPBACK_DESCRIPTOR_SHADOW;
+typedef volatile LOOPBACK_DESCRIPTOR_SHADOW LOOPBACK_DESCRIPTOR, *PLOOPBACK_DESCRIPTOR;
+STATIC_ASSERT(sizeof(LOOPBACK_DESCRIPTOR_SHADOW) == NET_LOOPBACK_DESCRIPTOR_SIZE);
+
+#pragma pack(pop)
+
+// the registers of the emulated device
+typedef struct _LOOPBACK_REGISTERS
+{
+    volatile DWORD                          RxHead;
+    volatile DWORD                          RxTail;
+    volatile DWORD                          TxHead;
+    volatile DWORD                          TxTail;
+
+    // NET_LOOPBACK_INT_CAUSE_*, cleared on read
+    volatile DWORD                          InterruptCause;
+
+    volatile BOOLEAN                        RxEnabled;
+    volatile BOOLEAN                        TxEnabled;
+} LOOPBACK_REGISTERS, *PLOOPBACK_REGISTERS;
+
+typedef struct _LOOPBACK_BUFFERS
+{
+    PLOOPBACK_DESCRIPTOR                    Descriptors;
+    PVOID*                                  Buffers;
+    WORD                                    NumberOfDescriptors;
+    WORD                                    CurrentDescriptor;
+    WORD                                    BufferSize;
+} LOOPBACK_BUFFERS, *PLOOPBACK_BUFFERS;
+
+typedef struct _LOOPBACK_TX_DATA
+{
+    LOOPBACK_BUFFERS                        Buffers;
+    LOCK                                    TxInterruptLock;
+} LOOPBACK_TX_DATA, *PLOOPBACK_TX_DATA;
+
+// state private to the emulated hardware
+typedef struct _LOOPBACK_HARDWARE
+{
+    PTHREAD                                 Thread;
+    volatile BOOLEAN                        StopRequested;
+
+    // written by software each time TxTail changes, the hardware
+    // thread blocks on it while it has nothing to do
+    EX_EVENT                                TxDoorbell;
+
+    // descriptors in [TxHead, TxFetched) were seen by the hardware
+    // and are 'on the wire', TxFetchTicks[i] is the RtcGetTickCount
+    // value at which descriptor i was fetched
+    DWORD                                   TxFetched;
+    QWORD*                                  TxFetchTicks;
+} LOOPBACK_HARDWARE, *PLOOPBACK_HARDWARE;
+
+typedef struct _LOOPBACK_DEVICE
+{
+    struct _MINIPORT_DEVICE*                MiniportDevice;
+
+    DWORD                                   DeviceIndex;
+
+    LOOPBACK_REGISTERS                      Registers;
+
+    LOOPBACK_BUFFERS                        RxData;
+    LOOPBACK_TX_DATA                        TxData;
+
+    LOOPBACK_HARDWARE                       Hardware;
+} LOOPBACK_DEVICE, *PLOOPBACK_DEVICE;
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+// the emulated hardware owns [Head, Tail) => a ring needs at least one
+// descriptor more than it can have in flight
+#define NET_LOOPBACK_MINIMUM_NO_OF_DESCRIPTORS      2
+#define NET_LOOPBACK_DEFAULT_NO_OF_DESCRIPTORS      32
+
+//******************************************************************************
+// Function:     NetLoopbackLoadDriver
+// Description:  Loads the loopback driver, its devices are created with the
+//               given number of RX and TX descriptors. The driver is not
+//               loaded at boot so the loopback devices are not listed among
+//               the network devices unless someone asks for them.
+// Returns:      STATUS - STATUS_ALREADY_INITIALIZED_HINT if the driver was
+//               already loaded, the rings keep the sizes they were created
+//               with
+// Parameter:    IN WORD NumberOfRxDescriptors
+// Parameter:    IN WORD NumberOfTxDescriptors
+// NOTE:         Drivers can't be unloaded, the devices exist until reboot.
+//               NetworkStackRescanDevices must be called for the network
+//               stack to see them.
+//******************************************************************************
+STATUS
+NetLoopbackLoadDriver(
+    IN      WORD                NumberOfRxDescriptors,
+    IN      WORD                NumberOfTxDescriptors
+    );
+
+//******************************************************************************
+// Function:     NetLoopbackSetLatency
+// Description:  Sets the time each frame spends 'on the wire' between the
+//               moment the emulated hardware fetches it from the TX ring and
+//               the moment it is written in the RX ring. Applies to all
+//               loopback devices, including frames already in flight.
+// Returns:      void
+// Parameter:    IN DWORD Microseconds
+//******************************************************************************
+void
+NetLoopbackSetLatency(
+    IN      DWORD               Microseconds
+    );
+
+DWORD
+NetLoopbackGetLatency(
+    void
+    );
+
+//******************************************************************************
+// Function:     NetLoopbackIsLoopbackDevice
+// Description:  Checks if a network device is a loopback device based on its
+//               physical address.
+// Returns:      BOOLEAN
+// Parameter:    IN PMAC_ADDRESS PhysicalAddress
+//******************************************************************************
+BOOLEAN
+NetLoopbackIsLoopbackDevice(
+    IN      PMAC_ADDRESS        PhysicalAddress
+    );
\ No newline at end of file
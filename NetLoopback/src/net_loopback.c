@@ -0,0 +1,319 @@
+#include "net_loopback_base.h"
+#include "net_loopback.h"
+#include "net_loopback_operations.h"
+#include "network_port.h"
+
+typedef struct _NET_LOOPBACK_DATA
+{
+    volatile DWORD          LatencyUs;
+
+    // RtcGetTickCount ticks in a microsecond
+    QWORD                   TicksPerUs;
+
+    volatile DWORD          NumberOfDevices;
+
+    // set by NetLoopbackLoadDriver before the driver entry runs
+    volatile BOOLEAN        DriverLoaded;
+    WORD                    NumberOfRxDescriptors;
+    WORD                    NumberOfTxDescriptors;
+} NET_LOOPBACK_DATA, *PNET_LOOPBACK_DATA;
+
+static NET_LOOPBACK_DATA m_netLoopbackData;
+
+static const BYTE NET_LOOPBACK_MAC_PREFIX_BYTES[NET_LOOPBACK_MAC_PREFIX_SIZE] = NET_LOOPBACK_MAC_PREFIX;
+
+static FUNC_DriverEntry                         _NetLoopbackDriverEntry;
+
+static FUNC_NetworkMiniportInitializeDevice     _NetLoopbackInitializeMiniport;
+static FUNC_NetworkMiniportUninitializeDevice   _NetLoopbackUninitializeMiniport;
+static FUNC_NetworkMiniportSendBuffer           _NetLoopbackSendBuffer;
+static FUNC_NetworkMiniportInterruptHandler     _NetLoopbackInterrupt;
+static FUNC_NetworkMiniportChangeDeviceStatus   _NetLoopbackChangeDeviceStatus;
+
+__forceinline
+void
+_NetLoopbackInitializeBuffers(
+    IN          PMINIPORT_BUFFER_INITIALIZATION     BufferInit,
+    OUT         PLOOPBACK_BUFFERS                   Buffers,
+    IN          BOOLEAN                             TransmitBuffers
+    )
+{
+    PLOOPBACK_DESCRIPTOR pDescriptors;
+    DWORD i;
+
+    ASSERT( NULL != BufferInit );
+    ASSERT( NULL != Buffers );
+
+    ASSERT( BufferInit->NumberOfBuffers <= MAX_WORD );
+    Buffers->NumberOfDescriptors = (WORD) BufferInit->NumberOfBuffers;
+
+    pDescriptors = BufferInit->RingBuffer;
+
+    memzero(BufferInit->RingBuffer, Buffers->NumberOfDescriptors * sizeof(LOOPBACK_DESCRIPTOR_SHADOW));
+    for (i = 0; i < BufferInit->NumberOfBuffers; ++i)
+    {
+        pDescriptors[i].BufferAddress = BufferInit->Buffers[i];
+
+        // TX descriptors are initially available for software
+        pDescriptors[i].DescriptorDone = TransmitBuffers;
+    }
+
+    Buffers->Descriptors = pDescriptors;
+    Buffers->Buffers = BufferInit->BufferVirtualAddresses;
+    Buffers->CurrentDescriptor = 0;
+    Buffers->BufferSize = BufferInit->BufferSize;
+}
+
+STATUS
+NetLoopbackLoadDriver(
+    IN      WORD                NumberOfRxDescriptors,
+    IN      WORD                NumberOfTxDescriptors
+    )
+{
+    PDRIVER_OBJECT pDriver;
+
+    if (NumberOfRxDescriptors < NET_LOOPBACK_MINIMUM_NO_OF_DESCRIPTORS)
+    {
+        return STATUS_INVALID_PARAMETER1;
+    }
+
+    if (NumberOfTxDescriptors < NET_LOOPBACK_MINIMUM_NO_OF_DESCRIPTORS)
+    {
+        return STATUS_INVALID_PARAMETER2;
+    }
+
+    if (FALSE != _InterlockedCompareExchange8(&m_netLoopbackData.DriverLoaded, TRUE, FALSE))
+    {
+        return STATUS_ALREADY_INITIALIZED_HINT;
+    }
+
+    m_netLoopbackData.NumberOfRxDescriptors = NumberOfRxDescriptors;
+    m_netLoopbackData.NumberOfTxDescriptors = NumberOfTxDescriptors;
+
+    pDriver = IoCreateDriver(NET_LOOPBACK_DRIVER_NAME, _NetLoopbackDriverEntry);
+    if (NULL == pDriver)
+    {
+        LOG_ERROR("Driver %s could not be loaded\n", NET_LOOPBACK_DRIVER_NAME);
+
+        _InterlockedExchange8(&m_netLoopbackData.DriverLoaded, FALSE);
+        return STATUS_DEVICE_DRIVER_COULD_NOT_BE_CREATED;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+SAL_SUCCESS
+STATUS
+(__cdecl _NetLoopbackDriverEntry)(
+    INOUT       PDRIVER_OBJECT      DriverObject
+    )
+{
+    STATUS status;
+    MINIPORT_REGISTRATION registration;
+    SYSTEM_INFORMATION sysInfo;
+
+    ASSERT( NULL != DriverObject );
+
+    LOG_FUNC_START;
+
+    status = STATUS_SUCCESS;
+
+    memzero(&registration, sizeof(MINIPORT_REGISTRATION));
+
+    ExGetSystemInformation(&sysInfo);
+    m_netLoopbackData.TicksPerUs = max(sysInfo.CpuFrequency / SEC_IN_US, 1);
+    m_netLoopbackData.LatencyUs = NET_LOOPBACK_DEFAULT_LATENCY_US;
+    m_netLoopbackData.NumberOfDevices = 0;
+
+    registration.NumberOfVirtualDevices = NET_LOOPBACK_NO_OF_DEVICES;
+    registration.DeviceContextSize = sizeof(LOOPBACK_DEVICE);
+    registration.MaximumMtu = ETHERNET_JUMBO_MTU;
+
+    registration.RxBuffers.BufferSize = NET_LOOPBACK_BUFFER_SIZE;
+    registration.RxBuffers.DescriptorSize = NET_LOOPBACK_DESCRIPTOR_SIZE;
+    registration.RxBuffers.NumberOfBuffers = m_netLoopbackData.NumberOfRxDescriptors;
+
+    registration.TxBuffers.BufferSize = NET_LOOPBACK_BUFFER_SIZE;
+    registration.TxBuffers.DescriptorSize = NET_LOOPBACK_DESCRIPTOR_SIZE;
+    registration.TxBuffers.NumberOfBuffers = m_netLoopbackData.NumberOfTxDescriptors;
+
+    registration.MiniportFunctions.MiniportInitializeDevice = _NetLoopbackInitializeMiniport;
+    registration.MiniportFunctions.MiniportUninitializeDevice = _NetLoopbackUninitializeMiniport;
+    registration.MiniportFunctions.MiniportSendBuffer = _NetLoopbackSendBuffer;
+    registration.MiniportFunctions.MiniportInterruptHandler = _NetLoopbackInterrupt;
+    registration.MiniportFunctions.MiniportChangeDeviceStatus = _NetLoopbackChangeDeviceStatus;
+
+    status = NetworkPortRegisterMiniportDriver(DriverObject,
+                                               &registration
+                                               );
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("NetworkPortRegisterMiniportDriver", status );
+        return status;
+    }
+
+    LOG_FUNC_END;
+
+    return status;
+}
+
+void
+NetLoopbackSetLatency(
+    IN      DWORD               Microseconds
+    )
+{
+    _InterlockedExchange(&m_netLoopbackData.LatencyUs, Microseconds);
+}
+
+DWORD
+NetLoopbackGetLatency(
+    void
+    )
+{
+    return m_netLoopbackData.LatencyUs;
+}
+
+BOOLEAN
+NetLoopbackIsLoopbackDevice(
+    IN      PMAC_ADDRESS        PhysicalAddress
+    )
+{
+    ASSERT( NULL != PhysicalAddress );
+
+    return 0 == memcmp(PhysicalAddress->Value, NET_LOOPBACK_MAC_PREFIX_BYTES, NET_LOOPBACK_MAC_PREFIX_SIZE);
+}
+
+QWORD
+NetLoopbackGetLatencyInTicks(
+    void
+    )
+{
+    return m_netLoopbackData.LatencyUs * m_netLoopbackData.TicksPerUs;
+}
+
+static
+STATUS
+(__cdecl _NetLoopbackInitializeMiniport)(
+    INOUT                           PMINIPORT_DEVICE                    MiniportDevice,
+    IN                              PMINIPORT_DEVICE_INITIALIZATION     MiniportInitialization
+    )
+{
+    STATUS status;
+    PLOOPBACK_DEVICE pDevice;
+
+    ASSERT( NULL != MiniportDevice );
+    ASSERT( NULL != MiniportInitialization );
+
+    // there is no hardware behind us
+    ASSERT( NULL == MiniportInitialization->PciBar );
+
+    ASSERT( 0 != MiniportInitialization->RxBuffers.NumberOfBuffers );
+    ASSERT( NULL != MiniportInitialization->RxBuffers.BufferVirtualAddresses );
+    ASSERT( NULL != MiniportInitialization->RxBuffers.RingBuffer );
+    ASSERT( NET_LOOPBACK_BUFFER_SIZE == MiniportInitialization->RxBuffers.BufferSize );
+
+    ASSERT( 0 != MiniportInitialization->TxBuffers.NumberOfBuffers );
+    ASSERT( NULL != MiniportInitialization->TxBuffers.BufferVirtualAddresses );
+    ASSERT( NULL != MiniportInitialization->TxBuffers.RingBuffer );
+    ASSERT( NET_LOOPBACK_BUFFER_SIZE == MiniportInitialization->TxBuffers.BufferSize );
+
+    LOG_FUNC_START;
+
+    status = STATUS_SUCCESS;
+
+    pDevice = NetworkPortGetMiniportExtension(MiniportDevice);
+    ASSERT( NULL != pDevice );
+
+    _NetLoopbackInitializeBuffers(&MiniportInitialization->RxBuffers, &pDevice->RxData, FALSE);
+    _NetLoopbackInitializeBuffers(&MiniportInitialization->TxBuffers, &pDevice->TxData.Buffers, TRUE);
+
+    pDevice->MiniportDevice = MiniportDevice;
+    pDevice->DeviceIndex = _InterlockedIncrement(&m_netLoopbackData.NumberOfDevices) - 1;
+
+    ASSERT( pDevice->DeviceIndex <= MAX_BYTE );
+    memcpy(MiniportDevice->PhysicalAddress.Value, NET_LOOPBACK_MAC_PREFIX_BYTES, NET_LOOPBACK_MAC_PREFIX_SIZE);
+    MiniportDevice->PhysicalAddress.Value[NET_LOOPBACK_MAC_PREFIX_SIZE] = (BYTE) pDevice->DeviceIndex;
+
+    status = NetLoopbackInitializeDevice(pDevice);
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("NetLoopbackInitializeDevice", status);
+        return status;
+    }
+
+    LOG_FUNC_END;
+
+    return status;
+}
+
+static
+STATUS
+(__cdecl _NetLoopbackUninitializeMiniport)(
+    INOUT                           PMINIPORT_DEVICE            MiniportDevice
+    )
+{
+    PLOOPBACK_DEVICE pDevice;
+
+    ASSERT( NULL != MiniportDevice );
+
+    pDevice = NetworkPortGetMiniportExtension(MiniportDevice);
+    ASSERT( NULL != pDevice );
+
+    NetLoopbackUninitializeDevice(pDevice);
+
+    return STATUS_SUCCESS;
+}
+
+static
+STATUS
+(__cdecl _NetLoopbackSendBuffer)(
+    IN  PMINIPORT_DEVICE            MiniportDevice,
+    IN  WORD                        DescriptorIndex,
+    IN  WORD                        Length,
+    IN  BOOLEAN                     EndOfPacket
+    )
+{
+    PLOOPBACK_DEVICE pDevice;
+
+    ASSERT( NULL != MiniportDevice );
+
+    pDevice = NetworkPortGetMiniportExtension(MiniportDevice);
+    ASSERT( NULL != pDevice );
+
+    return NetLoopbackSendFrame(pDevice, DescriptorIndex, Length, EndOfPacket);
+}
+
+static
+BOOLEAN
+(__cdecl _NetLoopbackInterrupt)(
+    IN  PMINIPORT_DEVICE            MiniportDevice
+    )
+{
+    PLOOPBACK_DEVICE pDevice;
+
+    ASSERT( NULL != MiniportDevice );
+
+    pDevice = NetworkPortGetMiniportExtension(MiniportDevice);
+    ASSERT( NULL != pDevice );
+
+    return NetLoopbackHandleInterrupt(pDevice);
+}
+
+static
+void
+(__cdecl _NetLoopbackChangeDeviceStatus)(
+    IN  PMINIPORT_DEVICE            MiniportDevice,
+    IN  PNETWORK_DEVICE_STATUS      DeviceStatus
+    )
+{
+    PLOOPBACK_DEVICE pDevice;
+
+    ASSERT( NULL != MiniportDevice );
+    ASSERT( NULL != DeviceStatus );
+
+    pDevice = NetworkPortGetMiniportExtension(MiniportDevice);
+    ASSERT( NULL != pDevice );
+
+    NetLoopbackChangeDeviceStatus(pDevice, DeviceStatus);
+}
\ No newline at end of file
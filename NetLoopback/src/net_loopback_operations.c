@@ -0,0 +1,646 @@
+#include "net_loopback_base.h"
+#include "net_loopback_operations.h"
+#include "network_port.h"
+#include "rtc.h"
+
+static FUNC_ThreadStart     _NetLoopbackHardwareThread;
+
+static
+void
+_NetLoopbackRxInit(
+    IN      PLOOPBACK_DEVICE    Device
+    );
+
+static
+void
+_NetLoopbackTxInit(
+    IN      PLOOPBACK_DEVICE    Device
+    );
+
+static
+BOOLEAN
+_NetLoopbackGetReceivedFrame(
+    IN      PLOOPBACK_DEVICE    Device,
+    IN      WORD                FirstDescriptorIndex,
+    OUT     WORD*               NumberOfDescriptors,
+    OUT     DWORD*              FrameLength
+    );
+
+static
+DWORD
+_NetLoopbackGetFetchedFrameDescriptors(
+    IN      PLOOPBACK_DEVICE    Device,
+    IN      DWORD               TxIndex
+    );
+
+static
+BOOLEAN
+_NetLoopbackTransferFrame(
+    IN      PLOOPBACK_DEVICE    Device,
+    IN      DWORD               TxIndex,
+    IN      DWORD               NumberOfTxDescriptors
+    );
+
+static
+void
+_NetLoopbackSignalTxQueueFullIfNecessary(
+    IN      PLOOPBACK_DEVICE    Device
+    );
+
+SAL_SUCCESS
+STATUS
+NetLoopbackInitializeDevice(
+    INOUT                           PLOOPBACK_DEVICE        Device
+    )
+{
+    STATUS status;
+    char threadName[MAX_PATH];
+
+    ASSERT( NULL != Device );
+    ASSERT( NULL != Device->MiniportDevice );
+
+    LOG_FUNC_START;
+
+    status = STATUS_SUCCESS;
+
+    __try
+    {
+        Device->Hardware.TxFetchTicks = ExAllocatePoolWithTag(PoolAllocateZeroMemory,
+                                                              sizeof(QWORD) * Device->TxData.Buffers.NumberOfDescriptors,
+                                                              HEAP_LOOPBACK_TAG,
+                                                              0
+        );
+        if (NULL == Device->Hardware.TxFetchTicks)
+        {
+            LOG_FUNC_ERROR_ALLOC("ExAllocatePoolWithTag", sizeof(QWORD) * Device->TxData.Buffers.NumberOfDescriptors);
+            status = STATUS_HEAP_INSUFFICIENT_RESOURCES;
+            __leave;
+        }
+
+        status = ExEventInit(&Device->Hardware.TxDoorbell, ExEventTypeSynchronization, FALSE);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("ExEventInit", status);
+            __leave;
+        }
+
+        _NetLoopbackRxInit(Device);
+        Device->MiniportDevice->DeviceStatus.RxEnabled = TRUE;
+
+        _NetLoopbackTxInit(Device);
+        Device->MiniportDevice->DeviceStatus.TxEnabled = TRUE;
+
+        snprintf(threadName, MAX_PATH, "NetLoopback-%02x", Device->DeviceIndex);
+
+        status = ThreadCreate(threadName,
+                              ThreadPriorityDefault,
+                              _NetLoopbackHardwareThread,
+                              Device,
+                              &Device->Hardware.Thread
+        );
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("ThreadCreate", status);
+            __leave;
+        }
+
+        // there is no cable to unplug
+        Device->MiniportDevice->LinkUp = TRUE;
+    }
+    __finally
+    {
+        if (!SUCCEEDED(status))
+        {
+            if (NULL != Device->Hardware.TxFetchTicks)
+            {
+                ExFreePoolWithTag(Device->Hardware.TxFetchTicks, HEAP_LOOPBACK_TAG);
+                Device->Hardware.TxFetchTicks = NULL;
+            }
+        }
+
+        LOG_FUNC_END;
+    }
+
+    return status;
+}
+
+void
+NetLoopbackUninitializeDevice(
+    INOUT                           PLOOPBACK_DEVICE        Device
+    )
+{
+    STATUS exitStatus;
+
+    ASSERT( NULL != Device );
+
+    LOG_FUNC_START;
+
+    if (NULL != Device->Hardware.Thread)
+    {
+        _InterlockedExchange8(&Device->Hardware.StopRequested, TRUE);
+        ExEventSignal(&Device->Hardware.TxDoorbell);
+
+        ThreadWaitForTermination(Device->Hardware.Thread, &exitStatus);
+        ThreadCloseHandle(Device->Hardware.Thread);
+        Device->Hardware.Thread = NULL;
+    }
+
+    if (NULL != Device->Hardware.TxFetchTicks)
+    {
+        ExFreePoolWithTag(Device->Hardware.TxFetchTicks, HEAP_LOOPBACK_TAG);
+        Device->Hardware.TxFetchTicks = NULL;
+    }
+
+    LOG_FUNC_END;
+}
+
+_No_competing_thread_
+STATUS
+NetLoopbackReceiveFrame(
+    IN                              PLOOPBACK_DEVICE        Device
+    )
+{
+    WORD curRxIndex;
+    WORD prevRxIndex;
+
+    ASSERT( NULL != Device );
+
+    curRxIndex = Device->RxData.CurrentDescriptor;
+    ASSERT( curRxIndex < Device->RxData.NumberOfDescriptors );
+
+    // descriptors written back by the hardware which we haven't processed yet
+    NetworkPortUpdateRingHighWaterMark(&Device->MiniportDevice->Statistics.RxRingHighWaterMark,
+                                       (Device->Registers.RxHead + Device->RxData.NumberOfDescriptors - curRxIndex) % Device->RxData.NumberOfDescriptors
+                                       );
+
+    while (Device->RxData.Descriptors[curRxIndex].DescriptorDone)
+    {
+        WORD noOfDescriptors;
+        DWORD frameLength;
+        STATUS notifyStatus;
+
+        if (!_NetLoopbackGetReceivedFrame(Device, curRxIndex, &noOfDescriptors, &frameLength))
+        {
+            // the rest of the frame will be written back later
+            break;
+        }
+
+        notifyStatus = NetworkPortNotifyReceiveFrame(Device->MiniportDevice, curRxIndex, noOfDescriptors, frameLength);
+        if (!SUCCEEDED(notifyStatus))
+        {
+            LOG_TRACE_NETWORK("NetworkPortNotifyReceiveFrame failed with status 0x%x\n", notifyStatus);
+        }
+
+        for (WORD i = 0; i < noOfDescriptors; ++i)
+        {
+            Device->RxData.Descriptors[curRxIndex].DescriptorDone = 0;
+            prevRxIndex = curRxIndex;
+            curRxIndex = (curRxIndex + 1) % Device->RxData.NumberOfDescriptors;
+        }
+        Device->Registers.RxTail = prevRxIndex;
+    }
+
+    Device->RxData.CurrentDescriptor = curRxIndex;
+
+    return STATUS_SUCCESS;
+}
+
+_No_competing_thread_
+STATUS
+NetLoopbackSendFrame(
+    IN                              PLOOPBACK_DEVICE        Device,
+    IN                              WORD                    DescriptorIndex,
+    IN                              WORD                    Length,
+    IN                              BOOLEAN                 EndOfPacket
+    )
+{
+    WORD curTxIndex;
+    PLOOPBACK_DESCRIPTOR pDescriptor;
+
+    ASSERT( NULL != Device );
+    ASSERT( Length <= Device->TxData.Buffers.BufferSize );
+
+    curTxIndex = DescriptorIndex;
+    ASSERT( curTxIndex == Device->TxData.Buffers.CurrentDescriptor );
+    ASSERT( curTxIndex < Device->TxData.Buffers.NumberOfDescriptors );
+    pDescriptor = &Device->TxData.Buffers.Descriptors[curTxIndex];
+    ASSERT( pDescriptor->DescriptorDone );
+
+    pDescriptor->EOP = EndOfPacket;
+    pDescriptor->Length = Length;
+    pDescriptor->DescriptorDone = 0;
+
+    curTxIndex = (curTxIndex + 1) % Device->TxData.Buffers.NumberOfDescriptors;
+    Device->TxData.Buffers.CurrentDescriptor = curTxIndex;
+
+    // descriptors handed to the hardware which were not yet transmitted
+    NetworkPortUpdateRingHighWaterMark(&Device->MiniportDevice->Statistics.TxRingHighWaterMark,
+                                       (curTxIndex + Device->TxData.Buffers.NumberOfDescriptors - Device->Registers.TxHead) % Device->TxData.Buffers.NumberOfDescriptors
+                                       );
+
+    _NetLoopbackSignalTxQueueFullIfNecessary(Device);
+
+    Device->Registers.TxTail = curTxIndex;
+    ExEventSignal(&Device->Hardware.TxDoorbell);
+
+    return STATUS_SUCCESS;
+}
+
+_No_competing_thread_
+BOOLEAN
+NetLoopbackHandleInterrupt(
+    IN                              PLOOPBACK_DEVICE        Device
+    )
+{
+    DWORD intCause;
+    STATUS status;
+
+    ASSERT( NULL != Device );
+
+    intCause = _InterlockedExchange(&Device->Registers.InterruptCause, 0);
+    LOG_TRACE_COMP(LogComponentNetwork | LogComponentInterrupt,
+                   "intCause: 0x%x on device 0x%X\n", intCause, Device);
+
+    if (0 == intCause)
+    {
+        return FALSE;
+    }
+
+    if (IsFlagOn(intCause, NET_LOOPBACK_INT_CAUSE_RX))
+    {
+        status = NetLoopbackReceiveFrame(Device);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("NetLoopbackReceiveFrame", status);
+            return FALSE;
+        }
+    }
+
+    if (IsFlagOn(intCause, NET_LOOPBACK_INT_CAUSE_TX))
+    {
+        INTR_STATE dummyState;
+
+        LockAcquire(&Device->TxData.TxInterruptLock, &dummyState);
+
+        // notify port driver we have free descriptors
+        NetworkPortNotifyTxDescriptorAvailable(Device->MiniportDevice);
+
+        LockRelease(&Device->TxData.TxInterruptLock, INTR_OFF);
+    }
+
+    return TRUE;
+}
+
+_No_competing_thread_
+void
+NetLoopbackChangeDeviceStatus(
+    IN                              PLOOPBACK_DEVICE        Device,
+    IN                              PNETWORK_DEVICE_STATUS  DeviceStatus
+    )
+{
+    ASSERT( NULL != Device );
+    ASSERT( NULL != DeviceStatus );
+
+    LOG_FUNC_START;
+
+    _InterlockedExchange8(&Device->Registers.RxEnabled, DeviceStatus->RxEnabled);
+    _InterlockedExchange8(&Device->Registers.TxEnabled, DeviceStatus->TxEnabled);
+
+    // the hardware may be blocked waiting for TX to be enabled
+    ExEventSignal(&Device->Hardware.TxDoorbell);
+
+    LOG_FUNC_END;
+}
+
+static
+void
+_NetLoopbackRxInit(
+    IN      PLOOPBACK_DEVICE    Device
+    )
+{
+    ASSERT( NULL != Device );
+
+    Device->Registers.RxHead = 0;
+
+    // same as for the 82574L: the last descriptor is not made available
+    // to the hardware until the first frame is processed
+    Device->Registers.RxTail = Device->RxData.NumberOfDescriptors - 1;
+
+    Device->Registers.RxEnabled = TRUE;
+}
+
+static
+void
+_NetLoopbackTxInit(
+    IN      PLOOPBACK_DEVICE    Device
+    )
+{
+    ASSERT( NULL != Device );
+
+    Device->Registers.TxHead = 0;
+    Device->Registers.TxTail = 0;
+    Device->Hardware.TxFetched = 0;
+
+    LockInit(&Device->TxData.TxInterruptLock);
+
+    Device->Registers.TxEnabled = TRUE;
+}
+
+static
+STATUS
+(__cdecl _NetLoopbackHardwareThread)(
+    IN_OPT      PVOID       Context
+    )
+{
+    PLOOPBACK_DEVICE pDevice;
+    PLOOPBACK_REGISTERS pRegisters;
+    PLOOPBACK_HARDWARE pHardware;
+    DWORD noOfDescriptors;
+    DWORD noOfFrameDescriptors;
+    DWORD txHead;
+    DWORD txTail;
+    DWORD intCause;
+    QWORD now;
+    QWORD latency;
+
+    ASSERT( NULL != Context );
+
+    pDevice = (PLOOPBACK_DEVICE) Context;
+    pRegisters = &pDevice->Registers;
+    pHardware = &pDevice->Hardware;
+    noOfDescriptors = pDevice->TxData.Buffers.NumberOfDescriptors;
+
+    while (!pHardware->StopRequested)
+    {
+        txHead = pRegisters->TxHead;
+        txTail = pRegisters->TxTail;
+
+        if (txHead == txTail || !pRegisters->TxEnabled)
+        {
+            // nothing to transmit, wait for software to ring the doorbell
+            ExEventWaitForSignal(&pHardware->TxDoorbell);
+            continue;
+        }
+
+        // fetch the descriptors posted since the last iteration,
+        // their time on the wire starts now
+        now = RtcGetTickCount();
+        while (pHardware->TxFetched != txTail)
+        {
+            pHardware->TxFetchTicks[pHardware->TxFetched] = now;
+            pHardware->TxFetched = (pHardware->TxFetched + 1) % noOfDescriptors;
+        }
+
+        latency = NetLoopbackGetLatencyInTicks();
+        intCause = 0;
+
+        // deliver all the frames which spent enough time on the wire,
+        // frames arrive in the order in which they were sent
+        while (txHead != pHardware->TxFetched &&
+               now - pHardware->TxFetchTicks[txHead] >= latency)
+        {
+            // a frame leaves the wire only after its last descriptor was fetched
+            noOfFrameDescriptors = _NetLoopbackGetFetchedFrameDescriptors(pDevice, txHead);
+            if (0 == noOfFrameDescriptors)
+            {
+                break;
+            }
+
+            if (_NetLoopbackTransferFrame(pDevice, txHead, noOfFrameDescriptors))
+            {
+                intCause = intCause | NET_LOOPBACK_INT_CAUSE_RX;
+            }
+
+            for (DWORD i = 0; i < noOfFrameDescriptors; ++i)
+            {
+                pDevice->TxData.Buffers.Descriptors[txHead].DescriptorDone = 1;
+                txHead = (txHead + 1) % noOfDescriptors;
+            }
+            pRegisters->TxHead = txHead;
+
+            intCause = intCause | NET_LOOPBACK_INT_CAUSE_TX;
+        }
+
+        if (0 != intCause)
+        {
+            _InterlockedOr(&pRegisters->InterruptCause, intCause);
+            NetworkPortNotifyInterrupt(pDevice->MiniportDevice);
+        }
+        else
+        {
+            // the oldest frame is still on the wire
+            ThreadYield();
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+BOOLEAN
+_NetLoopbackGetReceivedFrame(
+    IN      PLOOPBACK_DEVICE    Device,
+    IN      WORD                FirstDescriptorIndex,
+    OUT     WORD*               NumberOfDescriptors,
+    OUT     DWORD*              FrameLength
+    )
+{
+    WORD curRxIndex;
+    WORD noOfDescriptors;
+    DWORD frameLength;
+
+    ASSERT( NULL != Device );
+    ASSERT( NULL != NumberOfDescriptors );
+    ASSERT( NULL != FrameLength );
+
+    curRxIndex = FirstDescriptorIndex;
+    noOfDescriptors = 1;
+    frameLength = 0;
+
+    ASSERT( Device->RxData.Descriptors[curRxIndex].DescriptorDone );
+
+    // same layout as for the 82574L: all the descriptors before the
+    // one with EOP set are completely filled
+    while (!Device->RxData.Descriptors[curRxIndex].EOP)
+    {
+        ASSERT( Device->RxData.Descriptors[curRxIndex].Length == Device->RxData.BufferSize );
+        frameLength = frameLength + Device->RxData.Descriptors[curRxIndex].Length;
+
+        curRxIndex = (curRxIndex + 1) % Device->RxData.NumberOfDescriptors;
+        if (!Device->RxData.Descriptors[curRxIndex].DescriptorDone)
+        {
+            return FALSE;
+        }
+
+        noOfDescriptors = noOfDescriptors + 1;
+    }
+
+    ASSERT( Device->RxData.Descriptors[curRxIndex].Length <= Device->RxData.BufferSize );
+    frameLength = frameLength + Device->RxData.Descriptors[curRxIndex].Length;
+
+    *NumberOfDescriptors = noOfDescriptors;
+    *FrameLength = frameLength;
+
+    return TRUE;
+}
+
+static
+DWORD
+_NetLoopbackGetFetchedFrameDescriptors(
+    IN      PLOOPBACK_DEVICE    Device,
+    IN      DWORD               TxIndex
+    )
+{
+    DWORD curTxIndex;
+    DWORD noOfDescriptors;
+
+    ASSERT( NULL != Device );
+    ASSERT( TxIndex != Device->Hardware.TxFetched );
+
+    curTxIndex = TxIndex;
+    noOfDescriptors = 1;
+
+    while (!Device->TxData.Buffers.Descriptors[curTxIndex].EOP)
+    {
+        curTxIndex = (curTxIndex + 1) % Device->TxData.Buffers.NumberOfDescriptors;
+        if (curTxIndex == Device->Hardware.TxFetched)
+        {
+            // software is still posting the frame
+            return 0;
+        }
+
+        noOfDescriptors = noOfDescriptors + 1;
+    }
+
+    return noOfDescriptors;
+}
+
+static
+BOOLEAN
+_NetLoopbackTransferFrame(
+    IN      PLOOPBACK_DEVICE    Device,
+    IN      DWORD               TxIndex,
+    IN      DWORD               NumberOfTxDescriptors
+    )
+{
+    PLOOPBACK_REGISTERS pRegisters;
+    PLOOPBACK_DESCRIPTOR pTxDescriptor;
+    DWORD rxHead;
+    DWORD rxIndex;
+    DWORD txIndex;
+    DWORD frameLength;
+    DWORD rxDescriptorsAvailable;
+    DWORD rxDescriptorsRequired;
+    PBYTE pTxData;
+    WORD txBytesLeft;
+    WORD rxLength;
+    WORD bytesToCopy;
+
+    ASSERT( NULL != Device );
+    ASSERT( 0 != NumberOfTxDescriptors );
+
+    pRegisters = &Device->Registers;
+    rxHead = pRegisters->RxHead;
+
+    frameLength = 0;
+    txIndex = TxIndex;
+    for (DWORD i = 0; i < NumberOfTxDescriptors; ++i)
+    {
+        frameLength = frameLength + Device->TxData.Buffers.Descriptors[txIndex].Length;
+        txIndex = (txIndex + 1) % Device->TxData.Buffers.NumberOfDescriptors;
+    }
+
+    rxDescriptorsAvailable = (pRegisters->RxTail + Device->RxData.NumberOfDescriptors - rxHead) % Device->RxData.NumberOfDescriptors;
+    ASSERT( 0 != frameLength );
+    rxDescriptorsRequired = (frameLength + Device->RxData.BufferSize - 1) / Device->RxData.BufferSize;
+
+    if (!pRegisters->RxEnabled || rxDescriptorsAvailable < rxDescriptorsRequired)
+    {
+        // RX disabled or software did not give us enough descriptors
+        _InterlockedIncrement64(&Device->MiniportDevice->Statistics.RxMissedFrames);
+        return FALSE;
+    }
+
+    // fill each RX buffer completely before moving to the next one,
+    // the frame is scattered exactly as the 82574L would do it
+    rxIndex = rxHead;
+    rxLength = 0;
+    txIndex = TxIndex;
+    for (DWORD i = 0; i < NumberOfTxDescriptors; ++i)
+    {
+        pTxDescriptor = &Device->TxData.Buffers.Descriptors[txIndex];
+        pTxData = Device->TxData.Buffers.Buffers[txIndex];
+
+        for (txBytesLeft = pTxDescriptor->Length; txBytesLeft != 0; txBytesLeft = txBytesLeft - bytesToCopy)
+        {
+            if (rxLength == Device->RxData.BufferSize)
+            {
+                ASSERT( !Device->RxData.Descriptors[rxIndex].DescriptorDone );
+                Device->RxData.Descriptors[rxIndex].Length = rxLength;
+                Device->RxData.Descriptors[rxIndex].EOP = 0;
+
+                rxIndex = (rxIndex + 1) % Device->RxData.NumberOfDescriptors;
+                rxLength = 0;
+            }
+
+            bytesToCopy = (WORD) min(txBytesLeft, Device->RxData.BufferSize - rxLength);
+
+            memcpy((PBYTE) Device->RxData.Buffers[rxIndex] + rxLength,
+                   pTxData,
+                   bytesToCopy
+                   );
+
+            pTxData = pTxData + bytesToCopy;
+            rxLength = rxLength + bytesToCopy;
+        }
+
+        txIndex = (txIndex + 1) % Device->TxData.Buffers.NumberOfDescriptors;
+    }
+
+    ASSERT( !Device->RxData.Descriptors[rxIndex].DescriptorDone );
+    Device->RxData.Descriptors[rxIndex].Length = rxLength;
+    Device->RxData.Descriptors[rxIndex].EOP = 1;
+
+    ASSERT( (rxIndex + Device->RxData.NumberOfDescriptors - rxHead) % Device->RxData.NumberOfDescriptors + 1 == rxDescriptorsRequired );
+
+    // the descriptors are written back in order only after the whole
+    // frame was stored
+    for (DWORD i = 0; i < rxDescriptorsRequired; ++i)
+    {
+        Device->RxData.Descriptors[rxHead].DescriptorDone = 1;
+        rxHead = (rxHead + 1) % Device->RxData.NumberOfDescriptors;
+    }
+
+    pRegisters->RxHead = rxHead;
+
+    return TRUE;
+}
+
+static
+void
+_NetLoopbackSignalTxQueueFullIfNecessary(
+    IN      PLOOPBACK_DEVICE    Device
+    )
+{
+    WORD nextTxIndex;
+    INTR_STATE intrState;
+
+    ASSERT( NULL != Device );
+
+    nextTxIndex = ( Device->TxData.Buffers.CurrentDescriptor + 1 ) % Device->TxData.Buffers.NumberOfDescriptors;
+
+    // the check is done twice so that the interrupt lock is taken
+    // only when the queue is close to being full
+    if (nextTxIndex == Device->Registers.TxHead)
+    {
+        LockAcquire(&Device->TxData.TxInterruptLock, &intrState);
+
+        if (nextTxIndex == Device->Registers.TxHead)
+        {
+            LOG_TRACE_NETWORK("Queue is full\n");
+            NetworkPortNotifyTxQueueFull(Device->MiniportDevice);
+        }
+
+        LockRelease(&Device->TxData.TxInterruptLock, intrState);
+    }
+}
\ No newline at end of file
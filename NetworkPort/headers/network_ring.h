@@ -0,0 +1,140 @@
+#pragma once
+
+#include "ex_event.h"
+
+#define FRAME_RING_CACHE_LINE_SIZE                  CACHE_LINE_SIZE
+
+struct _FRAME_DESCRIPTOR_ENTRY;
+
+// Fixed capacity single-producer/single-consumer ring of frame descriptors.
+// The producer is the miniport interrupt routine and the consumer is the
+// thread currently receiving frames from the port device, neither of them
+// takes a lock to transfer frames.
+typedef struct _FRAME_RING
+{
+    // read-only after initialization
+    DWORD                               Capacity;
+    DWORD                               Mask;
+    struct _FRAME_DESCRIPTOR_ENTRY**    Frames;
+
+    // signaled by the producer only if the consumer announced
+    // it is going to block
+    EX_EVENT                            NotEmptyEvent;
+    volatile BOOLEAN                    ConsumerWaiting;
+
+    BYTE                                __SharedPadding[FRAME_RING_CACHE_LINE_SIZE];
+
+    // written only by the producer
+    volatile DWORD                      Head;
+    DWORD                               HighWaterMark;
+
+    BYTE                                __ProducerPadding[FRAME_RING_CACHE_LINE_SIZE - 2 * sizeof(DWORD)];
+
+    // written only by the consumer
+    volatile DWORD                      Tail;
+} FRAME_RING, *PFRAME_RING;
+
+//******************************************************************************
+// Function:     NetworkRingInit
+// Description:  Initializes an empty ring which can hold at least
+//               MinimumCapacity frames. The capacity is rounded up to the
+//               next power of 2.
+// Returns:      STATUS
+// Parameter:    OUT PFRAME_RING Ring
+// Parameter:    IN DWORD MinimumCapacity
+//******************************************************************************
+STATUS
+NetworkRingInit(
+    OUT         PFRAME_RING                     Ring,
+    IN          DWORD                           MinimumCapacity
+    );
+
+//******************************************************************************
+// Function:     NetworkRingUninit
+// Description:  Frees the frames still present in the ring and the ring
+//               storage. Neither the producer nor the consumer may be active.
+// Returns:      void
+// Parameter:    INOUT PFRAME_RING Ring
+//******************************************************************************
+void
+NetworkRingUninit(
+    INOUT       PFRAME_RING                     Ring
+    );
+
+//******************************************************************************
+// Function:     NetworkRingProduce
+// Description:  Called by the producer to place a frame in the ring, wakes
+//               the consumer if it is blocked waiting for frames.
+// Returns:      BOOLEAN - FALSE if the ring is full, in which case the caller
+//               still owns the frame.
+// Parameter:    INOUT PFRAME_RING Ring
+// Parameter:    IN struct _FRAME_DESCRIPTOR_ENTRY * Frame
+//******************************************************************************
+BOOLEAN
+NetworkRingProduce(
+    INOUT       PFRAME_RING                     Ring,
+    IN          struct _FRAME_DESCRIPTOR_ENTRY* Frame
+    );
+
+//******************************************************************************
+// Function:     NetworkRingPeek
+// Description:  Called by the consumer to retrieve the oldest frame in the
+//               ring without removing it.
+// Returns:      struct _FRAME_DESCRIPTOR_ENTRY* - NULL if the ring is empty
+// Parameter:    IN PFRAME_RING Ring
+//******************************************************************************
+PTR_SUCCESS
+struct _FRAME_DESCRIPTOR_ENTRY*
+NetworkRingPeek(
+    IN          PFRAME_RING                     Ring
+    );
+
+//******************************************************************************
+// Function:     NetworkRingConsume
+// Description:  Called by the consumer to remove the frame previously
+//               returned by NetworkRingPeek. The frame is now owned by the
+//               consumer.
+// Returns:      void
+// Parameter:    INOUT PFRAME_RING Ring
+//******************************************************************************
+void
+NetworkRingConsume(
+    INOUT       PFRAME_RING                     Ring
+    );
+
+//******************************************************************************
+// Function:     NetworkRingWaitForFrames
+// Description:  Called by the consumer to block until the ring is not empty
+//               or until NetworkRingWakeConsumer is called. May return
+//               spuriously, the caller must peek again and re-check the
+//               conditions for which it may be woken.
+// Returns:      void
+// Parameter:    INOUT PFRAME_RING Ring
+//******************************************************************************
+void
+NetworkRingWaitForFrames(
+    INOUT       PFRAME_RING                     Ring
+    );
+
+//******************************************************************************
+// Function:     NetworkRingWakeConsumer
+// Description:  Wakes the consumer even if the ring is empty, used when the
+//               state it waits on changes, e.g. the link goes down. If the
+//               consumer is not blocked its next wait returns immediately.
+// Returns:      void
+// Parameter:    INOUT PFRAME_RING Ring
+//******************************************************************************
+void
+NetworkRingWakeConsumer(
+    INOUT       PFRAME_RING                     Ring
+    );
+
+__forceinline
+DWORD
+NetworkRingGetCount(
+    IN          PFRAME_RING                     Ring
+    )
+{
+    // Head and Tail are free running counters
+    return Ring->Head - Ring->Tail;
+}
\ No newline at end of file
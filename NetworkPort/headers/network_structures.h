@@ -2,6 +2,7 @@
 
 #include "lock_common.h"
 #include "ex_event.h"
+#include "network_ring.h"
 
 // warning C4200: nonstandard extension used: zero-sized array in struct/union
 #pragma warning(disable: 4200)
@@ -17,22 +18,51 @@ typedef struct _PORT_BUFFERS
 
     PVOID*                      Buffers;
 
-    LOCK                        FramesLock;
-    LIST_ENTRY                  FramesList;
-    EX_EVENT                    FramesListNotEmptyEvent;
+    // frames are dropped once the queue reaches this size
+    DWORD                       MaximumQueuedFrames;
 
     volatile QWORD              NumberOfFramesTransferred;
+    volatile QWORD              NumberOfBytesTransferred;
+    volatile QWORD              NumberOfDescriptorsTransferred;
+    volatile QWORD              NumberOfFramesDropped;
+
+    // updated only by the single producer (RX) or consumer (TX)
+    DWORD                       SmallestFrame;
+    DWORD                       LargestFrame;
 } PORT_BUFFERS, *PPORT_BUFFERS;
 
 typedef struct _RX_DATA
 {
     PORT_BUFFERS                Buffers;
+
+    // produced by the interrupt routine, consumed by the reader
+    FRAME_RING                  FramesRing;
+
+    // synchronization event used to allow only one reader at a
+    // time to consume from the ring
+    EX_EVENT                    ReaderEvent;
+
+    // set when the device is torn down, no more frames will be received
+    volatile BOOLEAN            Stopped;
 } RX_DATA, *PRX_DATA;
 
 typedef struct _TX_DATA
 {
     PORT_BUFFERS                Buffers;
 
+    LOCK                        FramesLock;
+
+    _Guarded_by_(FramesLock)
+    LIST_ENTRY                  FramesList;
+
+    _Guarded_by_(FramesLock)
+    DWORD                       NumberOfQueuedFrames;
+
+    _Guarded_by_(FramesLock)
+    DWORD                       QueueHighWaterMark;
+
+    EX_EVENT                    FramesListNotEmptyEvent;
+
     EX_EVENT                    DescriptorsAvailable;
 
     struct _THREAD*             TransmitWorkerThread;
@@ -45,6 +75,14 @@ typedef struct _NETWORK_PORT_DEVICE
 
     RX_DATA                     RxData;
     TX_DATA                     TxData;
+
+    // frames larger than ETHERNET_MAXIMUM_FRAME_SIZE(Mtu) are not sent,
+    // the MTU may be changed up to MaximumMtu
+    volatile DWORD              Mtu;
+    DWORD                       MaximumMtu;
+
+    volatile QWORD              NumberOfInterrupts;
+    volatile QWORD              NumberOfRxInterrupts;
 } NETWORK_PORT_DEVICE, *PNETWORK_PORT_DEVICE;
 
 typedef struct _FRAME_DESCRIPTOR
@@ -66,6 +104,10 @@ STATIC_ASSERT_INFO(sizeof(FRAME_DESCRIPTOR_ENTRY) - sizeof(FRAME_DESCRIPTOR) ==
 
 #pragma warning(default:4200)
 
+// the port queue may hold at most this many frames for each
+// descriptor in the miniport ring
+#define PORT_MAX_QUEUED_FRAMES_PER_DESCRIPTOR       8
+
 void
 NetworkPortDevicePreinit(
     OUT         PNETWORK_PORT_DEVICE    PortDevice
@@ -97,4 +139,17 @@ NetworkPortAllocateFrameDescriptor(
 void
 NetworkPortFreeFrameDescriptor(
     IN          PFRAME_DESCRIPTOR_ENTRY Descriptor                
+    );
+
+void
+NetworkPortAccountFrame(
+    INOUT       PPORT_BUFFERS           Buffers,
+    IN          DWORD                   FrameSize,
+    IN          DWORD                   NumberOfDescriptors
+    );
+
+void
+NetworkPortGetDeviceStatistics(
+    IN          PNETWORK_PORT_DEVICE    PortDevice,
+    OUT         PNETWORK_DEVICE_STATS   Statistics
     );
\ No newline at end of file
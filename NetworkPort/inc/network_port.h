@@ -1,5 +1,20 @@
 #pragma once
 
+typedef struct _MINIPORT_STATISTICS
+{
+    // maximum number of occupied descriptors at once, updated
+    // by the miniport driver: for RX the descriptors written
+    // back by the hardware and not yet processed by the driver,
+    // for TX the descriptors handed to the hardware and not yet
+    // transmitted
+    volatile DWORD                  RxRingHighWaterMark;
+    volatile DWORD                  TxRingHighWaterMark;
+
+    // frames the hardware could not store because no RX
+    // descriptor was available
+    volatile QWORD                  RxMissedFrames;
+} MINIPORT_STATISTICS, *PMINIPORT_STATISTICS;
+
 typedef struct _MINIPORT_DEVICE
 {
     // IN - completed by NetworkPortRegisterMiniportDriver
@@ -12,18 +27,26 @@ typedef struct _MINIPORT_DEVICE
 
     NETWORK_DEVICE_STATUS           DeviceStatus;
     volatile BOOLEAN                LinkUp;
+
+    // maintained by the miniport driver
+    MINIPORT_STATISTICS             Statistics;
 } MINIPORT_DEVICE, *PMINIPORT_DEVICE;
 
 typedef struct _MINIPORT_BUFFER_INITIALIZATION
 {
     DWORD                           NumberOfBuffers;
     PHYSICAL_ADDRESS*               Buffers;
+
+    // virtual addresses of the same buffers, used by miniports
+    // which have no DMA capable hardware behind them
+    PVOID*                          BufferVirtualAddresses;
     PVOID                           RingBuffer;
     WORD                            BufferSize;
 } MINIPORT_BUFFER_INITIALIZATION, *PMINIPORT_BUFFER_INITIALIZATION;
 
 typedef struct _MINIPORT_DEVICE_INITIALIZATION
 {
+    // NULL for virtual devices
     PPCI_BAR                        PciBar;
 
     MINIPORT_BUFFER_INITIALIZATION  RxBuffers;
@@ -47,12 +70,16 @@ STATUS
 
 typedef FUNC_NetworkMiniportUninitializeDevice* PFUNC_NetworkMiniportUninitializeDevice;
 
+// Frames larger than a TX buffer are spread over consecutive descriptors,
+// the function is called once for each of them and EndOfPacket is set only
+// for the last one.
 typedef
 STATUS
 (__cdecl FUNC_NetworkMiniportSendBuffer)(
     IN  PMINIPORT_DEVICE            MiniportDevice,
     IN  WORD                        DesccriptorIndex,
-    IN  WORD                        Length
+    IN  WORD                        Length,
+    IN  BOOLEAN                     EndOfPacket
     );
 
 typedef FUNC_NetworkMiniportSendBuffer*         PFUNC_NetworkMiniportSendBuffer;
@@ -98,8 +125,20 @@ typedef struct _MINIPORT_REGISTRATION
 {
     PCI_SPEC                                    Specification;
 
+    // if non-zero no PCI devices are enumerated, instead this many
+    // devices without any hardware behind them are created. These
+    // devices have no interrupt registered, the miniport driver
+    // must call NetworkPortNotifyInterrupt to emulate one.
+    DWORD                                       NumberOfVirtualDevices;
+
     DWORD                                       DeviceContextSize;
 
+    // largest MTU the device can be configured with, if 0 the device
+    // supports only ETHERNET_DEFAULT_MTU. Frames which do not fit in a
+    // single buffer are spread over multiple descriptors, the rings must
+    // be large enough to hold a frame of the maximum size.
+    DWORD                                       MaximumMtu;
+
     MINIPORT_BUFFER_DESCRIPTION                 RxBuffers;
     MINIPORT_BUFFER_DESCRIPTION                 TxBuffers;
 
@@ -118,11 +157,26 @@ NetworkPortGetMiniportExtension(
     IN      PMINIPORT_DEVICE        Device
     );
 
+//******************************************************************************
+// Function:     NetworkPortNotifyReceiveFrame
+// Description:  Called by the miniport driver for each frame received. The
+//               frame occupies NumberOfDescriptors consecutive RX descriptors
+//               starting with FirstDescriptorIndex, all the buffers except
+//               the last one must be completely filled.
+// Returns:      STATUS - STATUS_SUCCESS if the frame was taken or dropped by
+//               the port driver, the descriptors may be given back to the
+//               hardware regardless of the result.
+// Parameter:    IN PMINIPORT_DEVICE Device
+// Parameter:    IN DWORD FirstDescriptorIndex
+// Parameter:    IN DWORD NumberOfDescriptors
+// Parameter:    IN DWORD FrameLength
+//******************************************************************************
 STATUS
-NetworkPortNotifyReceiveBuffer(
+NetworkPortNotifyReceiveFrame(
     IN                          PMINIPORT_DEVICE        Device,
-    IN                          DWORD                   DesciptorIndex,
-    IN                          DWORD                   BufferSize
+    IN                          DWORD                   FirstDescriptorIndex,
+    IN                          DWORD                   NumberOfDescriptors,
+    IN                          DWORD                   FrameLength
     );
 
 void
@@ -135,6 +189,44 @@ NetworkPortNotifyTxQueueFull(
     IN                          PMINIPORT_DEVICE        Device
     );
 
+//******************************************************************************
+// Function:     NetworkPortUpdateRingHighWaterMark
+// Description:  Called by the miniport driver to record the number of
+//               descriptors currently occupied in one of its rings: RX
+//               descriptors filled by the hardware which were not yet
+//               processed or TX descriptors which were not yet transmitted.
+// Returns:      void
+// Parameter:    INOUT volatile DWORD * HighWaterMark - RxRingHighWaterMark or
+//               TxRingHighWaterMark from the miniport statistics.
+// Parameter:    IN DWORD DescriptorsInUse
+//******************************************************************************
+__forceinline
+void
+NetworkPortUpdateRingHighWaterMark(
+    INOUT                       volatile DWORD*         HighWaterMark,
+    IN                          DWORD                   DescriptorsInUse
+    )
+{
+    // each ring has a single writer, no interlocked operation required
+    if (DescriptorsInUse > *HighWaterMark)
+    {
+        *HighWaterMark = DescriptorsInUse;
+    }
+}
+
+//******************************************************************************
+// Function:     NetworkPortNotifyInterrupt
+// Description:  Called by the miniport driver of a virtual device to run the
+//               interrupt handling path of the port driver, exactly as if the
+//               device had generated an interrupt.
+// Returns:      BOOLEAN - the value returned by MiniportInterruptHandler
+// Parameter:    IN PMINIPORT_DEVICE Device
+//******************************************************************************
+BOOLEAN
+NetworkPortNotifyInterrupt(
+    IN                          PMINIPORT_DEVICE        Device
+    );
+
 void
 NetworkPortNotifyLinkStatusChange(
     IN                          PMINIPORT_DEVICE        Device,
@@ -26,6 +26,13 @@ _NetDispatchChangeDeviceStatus(
     IN                                      PNET_GET_SET_DEVICE_STATUS  DeviceStatus
     );
 
+static
+STATUS
+_NetDispatchSetMtu(
+    INOUT                                   PNETWORK_PORT_DEVICE        Device,
+    IN                                      PNET_GET_SET_MTU            Mtu
+    );
+
 SAL_SUCCESS
 STATUS
 NetPortDeviceControl(
@@ -120,6 +127,47 @@ NetPortDeviceControl(
             pLinkStatus->LinkUp = pPortDevice->Miniport->LinkUp;
         }
         break;
+    case IOCTL_NET_GET_DEVICE_STATISTICS:
+        {
+            PNET_GET_DEVICE_STATISTICS pStatistics = (PNET_GET_DEVICE_STATISTICS) pStackLocation->Parameters.DeviceControl.OutputBuffer;
+
+            information = sizeof(NET_GET_DEVICE_STATISTICS);
+
+            if (pStackLocation->Parameters.DeviceControl.OutputBufferLength < information)
+            {
+                status = STATUS_BUFFER_TOO_SMALL;
+                break;
+            }
+
+            NetworkPortGetDeviceStatistics(pPortDevice, &pStatistics->Statistics);
+        }
+        break;
+    case IOCTL_NET_GET_MTU:
+        {
+            PNET_GET_SET_MTU pMtu = (PNET_GET_SET_MTU) pStackLocation->Parameters.DeviceControl.OutputBuffer;
+
+            information = sizeof(NET_GET_SET_MTU);
+
+            if (pStackLocation->Parameters.DeviceControl.OutputBufferLength < information)
+            {
+                status = STATUS_BUFFER_TOO_SMALL;
+                break;
+            }
+
+            pMtu->Mtu = pPortDevice->Mtu;
+        }
+        break;
+    case IOCTL_NET_SET_MTU:
+        information = sizeof(NET_GET_SET_MTU);
+
+        if (pStackLocation->Parameters.DeviceControl.InputBufferLength < information)
+        {
+            status = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+
+        status = _NetDispatchSetMtu(pPortDevice, Irp->Buffer);
+        break;
     default:
         status = STATUS_UNSUPPORTED;
     }
@@ -146,6 +194,10 @@ STATUS
     PFRAME_DESCRIPTOR_ENTRY pDescriptorEntry;
     STATUS status;
     WORD curTxIndex;
+    PBYTE pFrameData;
+    DWORD bytesLeft;
+    WORD bytesToCopy;
+    DWORD noOfDescriptors;
 
     ASSERT( NULL != Context );
 
@@ -166,18 +218,23 @@ STATUS
         pDescriptorEntry = NULL;
 
         // wait to have actual data to send
-        ExEventWaitForSignal(&pPortDevice->TxData.Buffers.FramesListNotEmptyEvent);
+        ExEventWaitForSignal(&pPortDevice->TxData.FramesListNotEmptyEvent);
 
-        LockAcquire(&pPortDevice->TxData.Buffers.FramesLock, &intrState);
-        pEntry = RemoveHeadList(&pPortDevice->TxData.Buffers.FramesList);
-        bListEmpty = ( pEntry == &pPortDevice->TxData.Buffers.FramesList );
+        LockAcquire(&pPortDevice->TxData.FramesLock, &intrState);
+        pEntry = RemoveHeadList(&pPortDevice->TxData.FramesList);
+        bListEmpty = ( pEntry == &pPortDevice->TxData.FramesList );
 
         if (bListEmpty)
         {
-            ExEventClearSignal(&pPortDevice->TxData.Buffers.FramesListNotEmptyEvent);
+            ExEventClearSignal(&pPortDevice->TxData.FramesListNotEmptyEvent);
+        }
+        else
+        {
+            ASSERT( 0 != pPortDevice->TxData.NumberOfQueuedFrames );
+            pPortDevice->TxData.NumberOfQueuedFrames--;
         }
 
-        LockRelease(&pPortDevice->TxData.Buffers.FramesLock, intrState );
+        LockRelease(&pPortDevice->TxData.FramesLock, intrState );
 
         if (bListEmpty)
         {
@@ -188,16 +245,30 @@ STATUS
         pDescriptorEntry = CONTAINING_RECORD(pEntry, FRAME_DESCRIPTOR_ENTRY, ListEntry );
         curTxIndex = pPortDevice->TxData.CurrentTxIndex;
 
-        ExEventWaitForSignal(&pPortDevice->TxData.DescriptorsAvailable);
+        // frames larger than a TX buffer are spread over consecutive
+        // descriptors, only the last one ends the packet
+        pFrameData = pDescriptorEntry->Frame.Buffer;
+        bytesLeft = pDescriptorEntry->Frame.BufferSize;
+        noOfDescriptors = 0;
+        do
+        {
+            bytesToCopy = (WORD) min(bytesLeft, pPortDevice->TxData.Buffers.BufferSize);
+
+            ExEventWaitForSignal(&pPortDevice->TxData.DescriptorsAvailable);
 
-        ASSERT( pDescriptorEntry->Frame.BufferSize <= MAX_WORD );
-        memcpy( pPortDevice->TxData.Buffers.Buffers[curTxIndex], pDescriptorEntry->Frame.Buffer, pDescriptorEntry->Frame.BufferSize );
+            memcpy( pPortDevice->TxData.Buffers.Buffers[curTxIndex], pFrameData, bytesToCopy );
 
-        status = pDriverExtension->MiniportFunctions.MiniportSendBuffer( pPortDevice->Miniport, curTxIndex, (WORD) pDescriptorEntry->Frame.BufferSize );
-        ASSERT(SUCCEEDED(status));
+            pFrameData = pFrameData + bytesToCopy;
+            bytesLeft = bytesLeft - bytesToCopy;
 
-        curTxIndex = ( curTxIndex + 1 ) % pPortDevice->TxData.Buffers.NumberOfBuffers;
-        _InterlockedIncrement64(&pPortDevice->TxData.Buffers.NumberOfFramesTransferred);
+            status = pDriverExtension->MiniportFunctions.MiniportSendBuffer( pPortDevice->Miniport, curTxIndex, bytesToCopy, 0 == bytesLeft );
+            ASSERT(SUCCEEDED(status));
+
+            curTxIndex = ( curTxIndex + 1 ) % pPortDevice->TxData.Buffers.NumberOfBuffers;
+            noOfDescriptors = noOfDescriptors + 1;
+        } while (0 != bytesLeft);
+
+        NetworkPortAccountFrame(&pPortDevice->TxData.Buffers, pDescriptorEntry->Frame.BufferSize, noOfDescriptors);
         pPortDevice->TxData.CurrentTxIndex = curTxIndex;
 
         NetworkPortFreeFrameDescriptor(pDescriptorEntry);
@@ -219,9 +290,6 @@ _NetDispatchReceiveFrame(
     )
 {
     STATUS status;
-    INTR_STATE oldState;
-    PLIST_ENTRY pListEntry;
-    BOOLEAN bListEmpty;
     PFRAME_DESCRIPTOR_ENTRY pFrame;
     DWORD bufferSize;
 
@@ -231,85 +299,73 @@ _NetDispatchReceiveFrame(
     ASSERT( NULL != Information );
 
     status = STATUS_SUCCESS;
-    pListEntry = NULL;
-    bListEmpty = FALSE;
     pFrame = NULL;
     bufferSize = 0;
 
+    // the ring has a single consumer => only one reader may be active
+    ExEventWaitForSignal(&Device->RxData.ReaderEvent);
+
 // warning C4127: conditional expression is constant
 #pragma warning(suppress:4127)
     while (TRUE)
     {
-        LockAcquire(&Device->RxData.Buffers.FramesLock, &oldState);
-
-        pListEntry = Device->RxData.Buffers.FramesList.Flink;
-        bListEmpty = (pListEntry == &Device->RxData.Buffers.FramesList);
-
-        if (!bListEmpty)
+        pFrame = NetworkRingPeek(&Device->RxData.FramesRing);
+        if (NULL != pFrame)
         {
-            pFrame = CONTAINING_RECORD(pListEntry, FRAME_DESCRIPTOR_ENTRY, ListEntry);
             bufferSize = pFrame->Frame.BufferSize;
 
             if (bufferSize > OutputBufferSize)
             {
+                // leave the frame in the ring, the caller may retry with
+                // a larger buffer
                 LOGL("Buffer received of size %u is too small. Required: %u\n", OutputBufferSize, bufferSize );
                 status = STATUS_BUFFER_TOO_SMALL;
+                pFrame = NULL;
             }
             else
             {
-                // actually remove element from list
-                RemoveEntryList(pListEntry);
+                // the frame is ours from now on
+                NetworkRingConsume(&Device->RxData.FramesRing);
             }
-        }
-        else
-        {
-            // list empty clear event
-            ExEventClearSignal(&Device->RxData.Buffers.FramesListNotEmptyEvent);
-        }
-
-        LockRelease(&Device->RxData.Buffers.FramesLock, oldState);
 
+            break;
+        }
 
-        if (STATUS_BUFFER_TOO_SMALL == status)
+        // if ring is empty we need to check if the device is going away, if
+        // the link is down or if the device RX functionality is disabled,
+        // each of them wakes a blocked reader
+        if (Device->RxData.Stopped)
         {
+            LOG_WARNING("Device is being stopped\n");
+            status = STATUS_DEVICE_DISABLED;
             break;
         }
 
-        ASSERT(SUCCEEDED(status));
-
-        if (bListEmpty)
+        if (!Device->Miniport->LinkUp)
         {
-            // if list is empty we need to check if the link is down or if the device RX
-            // functionality is disabled
-            if (!Device->Miniport->LinkUp)
-            {
-                LOG_WARNING("Device is not linked\n");
-                status = STATUS_DEVICE_NOT_CONNECTED;
-                break;
-            }
-
-            if (!Device->Miniport->DeviceStatus.RxEnabled)
-            {
-                LOG_WARNING("Can no longer receive packets because device RX is disabled! :(\n");
-                status = STATUS_DEVICE_DISABLED;
-                break;
-            }
-
-            ExEventWaitForSignal(&Device->RxData.Buffers.FramesListNotEmptyEvent);
+            LOG_WARNING("Device is not linked\n");
+            status = STATUS_DEVICE_NOT_CONNECTED;
+            break;
         }
-        else
+
+        if (!Device->Miniport->DeviceStatus.RxEnabled)
         {
+            LOG_WARNING("Can no longer receive packets because device RX is disabled! :(\n");
+            status = STATUS_DEVICE_DISABLED;
             break;
         }
+
+        NetworkRingWaitForFrames(&Device->RxData.FramesRing);
     }
 
+    ExEventSignal(&Device->RxData.ReaderEvent);
+
     // set output buffer size written/required
     *Information = bufferSize;
 
     if (SUCCEEDED(status))
     {
         ASSERT(NULL != pFrame);
-        ASSERT(!bListEmpty);
 
         memcpy( &ReceiveOutput->Buffer,pFrame->Frame.Buffer, pFrame->Frame.BufferSize);
 
@@ -333,6 +389,7 @@ _NetDispatchSendFrame(
     PFRAME_DESCRIPTOR_ENTRY pFrameDescriptor;
     INTR_STATE intrState;
     BOOLEAN bListWasEmpty;
+    BOOLEAN bQueueFull;
 
     ASSERT(NULL != Device);
     ASSERT(0 != InputBufferSize);
@@ -350,36 +407,59 @@ _NetDispatchSendFrame(
         return STATUS_DEVICE_DISABLED;
     }
 
-    if (InputBufferSize > Device->TxData.Buffers.BufferSize)
+    if (InputBufferSize > ETHERNET_MAXIMUM_FRAME_SIZE(Device->Mtu))
     {
-        LOG_ERROR("Transmit buffer size %u bytes too large for device buffer size of %u bytes\n",
-             InputBufferSize, Device->TxData.Buffers.BufferSize );
+        LOG_ERROR("Transmit buffer size %u bytes too large for device MTU of %u bytes\n",
+             InputBufferSize, Device->Mtu );
         return STATUS_BUFFER_TOO_LARGE;
     }
 
     status = STATUS_SUCCESS;
     pFrameDescriptor = NULL;
     bListWasEmpty = FALSE;
+    bQueueFull = FALSE;
 
     pFrameDescriptor = NetworkPortAllocateFrameDescriptor(InputBufferSize);
     if (NULL == pFrameDescriptor)
     {
         LOG_FUNC_ERROR_ALLOC("NetworkPortAllocateFrameDescriptor", InputBufferSize);
+        _InterlockedIncrement64(&Device->TxData.Buffers.NumberOfFramesDropped);
         return STATUS_HEAP_INSUFFICIENT_RESOURCES;
     }
 
     pFrameDescriptor->Frame.BufferSize = InputBufferSize;
     memcpy( pFrameDescriptor->Frame.Buffer, SendBuffer, InputBufferSize);
 
-    LockAcquire(&Device->TxData.Buffers.FramesLock, &intrState);
-    bListWasEmpty = IsListEmpty(&Device->TxData.Buffers.FramesList);
-    InsertTailList(&Device->TxData.Buffers.FramesList, &pFrameDescriptor->ListEntry);
-    LockRelease(&Device->TxData.Buffers.FramesLock, intrState);
-    pFrameDescriptor = NULL;
+    LockAcquire(&Device->TxData.FramesLock, &intrState);
+    bQueueFull = (Device->TxData.NumberOfQueuedFrames >= Device->TxData.Buffers.MaximumQueuedFrames);
+    if (!bQueueFull)
+    {
+        bListWasEmpty = IsListEmpty(&Device->TxData.FramesList);
+        InsertTailList(&Device->TxData.FramesList, &pFrameDescriptor->ListEntry);
+
+        Device->TxData.NumberOfQueuedFrames++;
+        if (Device->TxData.NumberOfQueuedFrames > Device->TxData.QueueHighWaterMark)
+        {
+            Device->TxData.QueueHighWaterMark = Device->TxData.NumberOfQueuedFrames;
+        }
+        pFrameDescriptor = NULL;
+    }
+    LockRelease(&Device->TxData.FramesLock, intrState);
+
+    if (bQueueFull)
+    {
+        LOG_WARNING("TX queue is full, frame of %u bytes dropped\n", InputBufferSize);
+
+        NetworkPortFreeFrameDescriptor(pFrameDescriptor);
+        pFrameDescriptor = NULL;
+
+        _InterlockedIncrement64(&Device->TxData.Buffers.NumberOfFramesDropped);
+        return STATUS_DEVICE_BUSY;
+    }
 
     if (bListWasEmpty)
     {
-        ExEventSignal(&Device->TxData.Buffers.FramesListNotEmptyEvent);
+        ExEventSignal(&Device->TxData.FramesListNotEmptyEvent);
     }
 
     return status;
@@ -413,7 +493,39 @@ _NetDispatchChangeDeviceStatus(
 
     memcpy(&Device->Miniport->DeviceStatus, &DeviceStatus->DeviceStatus, sizeof(NETWORK_DEVICE_STATUS));
 
+    if (!Device->Miniport->DeviceStatus.RxEnabled)
+    {
+        // no more frames will be produced, a blocked reader must notice
+        NetworkRingWakeConsumer(&Device->RxData.FramesRing);
+    }
+
     LOG_FUNC_END;
 
     return status;
+}
+
+static
+STATUS
+_NetDispatchSetMtu(
+    INOUT                                   PNETWORK_PORT_DEVICE        Device,
+    IN                                      PNET_GET_SET_MTU            Mtu
+    )
+{
+    ASSERT(NULL != Device);
+    ASSERT(NULL != Mtu);
+
+    if (Mtu->Mtu < ETHERNET_MINIMUM_MTU || Mtu->Mtu > Device->MaximumMtu)
+    {
+        LOG_WARNING("MTU %u is not in the supported range [%u, %u]\n",
+                    Mtu->Mtu, ETHERNET_MINIMUM_MTU, Device->MaximumMtu);
+        return STATUS_INVALID_PARAMETER2;
+    }
+
+    // frames already queued were validated against the previous MTU,
+    // they will still be sent
+    _InterlockedExchange(&Device->Mtu, Mtu->Mtu);
+
+    LOGL("MTU changed to %u bytes\n", Mtu->Mtu);
+
+    return STATUS_SUCCESS;
 }
\ No newline at end of file
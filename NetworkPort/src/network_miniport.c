@@ -2,30 +2,31 @@
 #include "ex.h"
 
 STATUS
-NetworkPortNotifyReceiveBuffer(
+NetworkPortNotifyReceiveFrame(
     IN                          PMINIPORT_DEVICE        Device,
-    IN                          DWORD                   DesciptorIndex,
-    IN                          DWORD                   BufferSize
+    IN                          DWORD                   FirstDescriptorIndex,
+    IN                          DWORD                   NumberOfDescriptors,
+    IN                          DWORD                   FrameLength
     )
 {
     STATUS status;
     PDEVICE_OBJECT pDevObject;
     PNETWORK_PORT_DEVICE pPortDevice;
-    INTR_STATE oldState;
-    PLIST_ENTRY pListEntry;
     PFRAME_DESCRIPTOR_ENTRY pFrameDescriptor;
-    BOOLEAN bListWasEmpty;
     PVOID pReceiveBuffer;
+    PBYTE pFrameData;
+    DWORD descriptorIndex;
+    DWORD bytesLeft;
+    DWORD bytesToCopy;
+    DWORD bufferSize;
 
     ASSERT( NULL != Device );
-    ASSERT( 0 != BufferSize );
+    ASSERT( 0 != FrameLength );
 
     status = STATUS_SUCCESS;
-    pListEntry = NULL;
     pDevObject = NULL;
     pPortDevice = NULL;
     pFrameDescriptor = NULL;
-    bListWasEmpty = FALSE;
     pReceiveBuffer = NULL;
 
     pDevObject = Device->DeviceObject;
@@ -34,43 +35,62 @@ NetworkPortNotifyReceiveBuffer(
     pPortDevice = IoGetDeviceExtension(pDevObject);
     ASSERT( NULL != pPortDevice );
 
-    if (DesciptorIndex >= pPortDevice->RxData.Buffers.NumberOfBuffers)
+    bufferSize = pPortDevice->RxData.Buffers.BufferSize;
+
+    if (FirstDescriptorIndex >= pPortDevice->RxData.Buffers.NumberOfBuffers)
     {
         return STATUS_INVALID_PARAMETER2;
     }
 
-    if (BufferSize > pPortDevice->RxData.Buffers.BufferSize)
+    if (0 == NumberOfDescriptors || NumberOfDescriptors >= pPortDevice->RxData.Buffers.NumberOfBuffers)
     {
         return STATUS_INVALID_PARAMETER3;
     }
 
-    pFrameDescriptor = NetworkPortAllocateFrameDescriptor(BufferSize);
+    // only the last buffer may be partially filled
+    if (FrameLength > NumberOfDescriptors * bufferSize ||
+        FrameLength <= ( NumberOfDescriptors - 1 ) * bufferSize)
+    {
+        return STATUS_INVALID_PARAMETER4;
+    }
+
+    pFrameDescriptor = NetworkPortAllocateFrameDescriptor(FrameLength);
     if (NULL == pFrameDescriptor)
     {
-        LOG_FUNC_ERROR_ALLOC("NetworkPortAllocateFrameDescriptor", BufferSize);
+        LOG_FUNC_ERROR_ALLOC("NetworkPortAllocateFrameDescriptor", FrameLength);
+        _InterlockedIncrement64(&pPortDevice->RxData.Buffers.NumberOfFramesDropped);
         return STATUS_HEAP_INSUFFICIENT_RESOURCES;
     }
 
-    pFrameDescriptor->Frame.BufferSize = BufferSize;
-    pReceiveBuffer = pPortDevice->RxData.Buffers.Buffers[DesciptorIndex];
-    ASSERT( NULL != pReceiveBuffer );
+    pFrameDescriptor->Frame.BufferSize = FrameLength;
 
-    memcpy( pFrameDescriptor->Frame.Buffer, pReceiveBuffer, BufferSize );
-
-    LockAcquire(&pPortDevice->RxData.Buffers.FramesLock, &oldState);
+    // gather the frame from the descriptor buffers
+    pFrameData = pFrameDescriptor->Frame.Buffer;
+    descriptorIndex = FirstDescriptorIndex;
+    for (bytesLeft = FrameLength; bytesLeft != 0; bytesLeft = bytesLeft - bytesToCopy)
+    {
+        pReceiveBuffer = pPortDevice->RxData.Buffers.Buffers[descriptorIndex];
+        ASSERT( NULL != pReceiveBuffer );
 
-    bListWasEmpty = IsListEmpty(&pPortDevice->RxData.Buffers.FramesList);
-    InsertTailList(&pPortDevice->RxData.Buffers.FramesList, &pFrameDescriptor->ListEntry);
+        bytesToCopy = min(bytesLeft, bufferSize);
+        memcpy( pFrameData, pReceiveBuffer, bytesToCopy );
 
-    LockRelease(&pPortDevice->RxData.Buffers.FramesLock, oldState);
+        pFrameData = pFrameData + bytesToCopy;
+        descriptorIndex = ( descriptorIndex + 1 ) % pPortDevice->RxData.Buffers.NumberOfBuffers;
+    }
 
-    if (bListWasEmpty)
+    if (!NetworkRingProduce(&pPortDevice->RxData.FramesRing, pFrameDescriptor))
     {
-        // signal event
-        ExEventSignal(&pPortDevice->RxData.Buffers.FramesListNotEmptyEvent);
+        // nobody is consuming the frames fast enough, the hardware
+        // descriptors must be recycled => drop the frame
+        NetworkPortFreeFrameDescriptor(pFrameDescriptor);
+        pFrameDescriptor = NULL;
+
+        _InterlockedIncrement64(&pPortDevice->RxData.Buffers.NumberOfFramesDropped);
+        return STATUS_SUCCESS;
     }
 
-    _InterlockedIncrement64(&pPortDevice->RxData.Buffers.NumberOfFramesTransferred);
+    NetworkPortAccountFrame(&pPortDevice->RxData.Buffers, FrameLength, NumberOfDescriptors);
 
     return status;
 }
@@ -127,11 +147,27 @@ NetworkPortNotifyLinkStatusChange(
     IN                          BOOLEAN                 LinkUp
     )
 {
+    PNETWORK_PORT_DEVICE pPortDevice;
+    PDEVICE_OBJECT pDevObject;
+
     ASSERT(NULL != Device);
 
     LOG_FUNC_START;
 
     _InterlockedExchange8(&Device->LinkUp, LinkUp);
 
+    if (!LinkUp)
+    {
+        pDevObject = Device->DeviceObject;
+        ASSERT(NULL != pDevObject);
+
+        pPortDevice = IoGetDeviceExtension(pDevObject);
+        ASSERT(NULL != pPortDevice);
+
+        // a reader blocked on an empty ring would otherwise wait for frames
+        // which will not come
+        NetworkRingWakeConsumer(&pPortDevice->RxData.FramesRing);
+    }
+
     LOG_FUNC_END;
 }
\ No newline at end of file
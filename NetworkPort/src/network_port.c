@@ -25,10 +25,22 @@ _NetworkPortValidateMiniportFunctions(
     return TRUE;
 }
 
+__forceinline
+DWORD
+_NetworkPortGetMaximumMtu(
+    IN      PMINIPORT_REGISTRATION          MiniportRegistration
+    )
+{
+    ASSERT( NULL != MiniportRegistration );
+
+    return 0 != MiniportRegistration->MaximumMtu ? MiniportRegistration->MaximumMtu : ETHERNET_DEFAULT_MTU;
+}
+
 __forceinline
 BOOLEAN
 _NetworkPortValidateBufferDescription(
-    IN      PMINIPORT_BUFFER_DESCRIPTION    BufferDescription
+    IN      PMINIPORT_BUFFER_DESCRIPTION    BufferDescription,
+    IN      DWORD                           MaximumFrameSize
     )
 {
     ASSERT( NULL != BufferDescription );
@@ -41,6 +53,13 @@ _NetworkPortValidateBufferDescription(
         return FALSE;
     }
 
+    // a frame may not occupy the whole ring, the hardware would not be
+    // able to release any descriptor before the last one is posted
+    if ((BufferDescription->NumberOfBuffers - 1) * BufferDescription->BufferSize < MaximumFrameSize)
+    {
+        return FALSE;
+    }
+
     return TRUE;
 }
 
@@ -49,7 +68,7 @@ STATUS
 _NetworkPortConfigureDevice(
     IN                          PDRIVER_OBJECT          DriverObject,
     IN                          PMINIPORT_REGISTRATION  MiniportRegistration,
-    IN                          PPCI_DEVICE_DESCRIPTION PciDevice,
+    IN_OPT                      PPCI_DEVICE_DESCRIPTION PciDevice,
     OUT_WRITES_ALL(MiniportRegistration->RxBuffers.NumberOfBuffers)
                                 PHYSICAL_ADDRESS*       RxPhysicalAddresses,
     OUT_WRITES_ALL(MiniportRegistration->TxBuffers.NumberOfBuffers)
@@ -92,12 +111,20 @@ NetworkPortRegisterMiniportDriver(
         return STATUS_INVALID_PARAMETER2;
     }
 
-    if (!_NetworkPortValidateBufferDescription(&MiniportRegistration->RxBuffers))
+    if (_NetworkPortGetMaximumMtu(MiniportRegistration) < ETHERNET_DEFAULT_MTU ||
+        _NetworkPortGetMaximumMtu(MiniportRegistration) > ETHERNET_JUMBO_MTU)
+    {
+        return STATUS_INVALID_PARAMETER2;
+    }
+
+    if (!_NetworkPortValidateBufferDescription(&MiniportRegistration->RxBuffers,
+                                               ETHERNET_MAXIMUM_FRAME_SIZE(_NetworkPortGetMaximumMtu(MiniportRegistration))))
     {
         return STATUS_INVALID_BUFFER;
     }
 
-    if (!_NetworkPortValidateBufferDescription(&MiniportRegistration->TxBuffers))
+    if (!_NetworkPortValidateBufferDescription(&MiniportRegistration->TxBuffers,
+                                               ETHERNET_MAXIMUM_FRAME_SIZE(_NetworkPortGetMaximumMtu(MiniportRegistration))))
     {
         return STATUS_INVALID_BUFFER;
     }
@@ -123,14 +150,22 @@ NetworkPortRegisterMiniportDriver(
 
     __try
     {
-        status = IoGetPciDevicesMatchingSpecification(MiniportRegistration->Specification,
-                                                      &pPciDevices,
-                                                      &noOfDevices
-        );
-        if (!SUCCEEDED(status))
+        if (0 != MiniportRegistration->NumberOfVirtualDevices)
         {
-            LOG_FUNC_ERROR("IoGetPciDevicesMatchingSpecification", status);
-            __leave;
+            // there is no hardware to look for
+            noOfDevices = MiniportRegistration->NumberOfVirtualDevices;
+        }
+        else
+        {
+            status = IoGetPciDevicesMatchingSpecification(MiniportRegistration->Specification,
+                                                          &pPciDevices,
+                                                          &noOfDevices
+            );
+            if (!SUCCEEDED(status))
+            {
+                LOG_FUNC_ERROR("IoGetPciDevicesMatchingSpecification", status);
+                __leave;
+            }
         }
 
         ASSERT(NULL == DriverObject->DriverExtension);
@@ -176,7 +211,7 @@ NetworkPortRegisterMiniportDriver(
             // configure current PCI device
             status = _NetworkPortConfigureDevice(DriverObject,
                                                  MiniportRegistration,
-                                                 pPciDevices[i],
+                                                 NULL != pPciDevices ? pPciDevices[i] : NULL,
                                                  pRxPhysicalAddresses,
                                                  pTxPhysicalAddresses
             );
@@ -186,11 +221,18 @@ NetworkPortRegisterMiniportDriver(
                 continue;
             }
 
-            LOGL("Successfully configured network device found on PCI location (%u.%u.%u)\n",
-                 pPciDevices[i]->DeviceLocation.Bus,
-                 pPciDevices[i]->DeviceLocation.Device,
-                 pPciDevices[i]->DeviceLocation.Function
-            );
+            if (NULL != pPciDevices)
+            {
+                LOGL("Successfully configured network device found on PCI location (%u.%u.%u)\n",
+                     pPciDevices[i]->DeviceLocation.Bus,
+                     pPciDevices[i]->DeviceLocation.Device,
+                     pPciDevices[i]->DeviceLocation.Function
+                );
+            }
+            else
+            {
+                LOGL("Successfully configured virtual network device %u\n", i);
+            }
 
             // if we're here => we successfully initialized the device
             noOfDevicesInitialized = noOfDevicesInitialized + 1;
@@ -242,7 +284,7 @@ NetworkPortRegisterMiniportDriver(
         }
 
         // if we initialized at least a device we can say we did our job :)
-        status = noOfDevicesInitialized > 1 ? STATUS_SUCCESS : STATUS_DEVICE_DOES_NOT_EXIST;
+        status = noOfDevicesInitialized >= 1 ? STATUS_SUCCESS : STATUS_DEVICE_DOES_NOT_EXIST;
 
         if (!SUCCEEDED(status))
         {
@@ -270,12 +312,33 @@ NetworkPortGetMiniportExtension(
     return Device->DeviceExtension;
 }
 
+BOOLEAN
+NetworkPortNotifyInterrupt(
+    IN      PMINIPORT_DEVICE        Device
+    )
+{
+    INTR_STATE intrState;
+    BOOLEAN bSolvedInterrupt;
+
+    ASSERT( NULL != Device );
+    ASSERT( NULL != Device->DeviceObject );
+
+    // the miniport interrupt handlers expect to run with interrupts disabled
+    intrState = CpuIntrDisable();
+
+    bSolvedInterrupt = _NetworkPortGenericInterrupt(Device->DeviceObject);
+
+    CpuIntrSetState(intrState);
+
+    return bSolvedInterrupt;
+}
+
 static
 STATUS
 _NetworkPortConfigureDevice(
     IN                          PDRIVER_OBJECT          DriverObject,
     IN                          PMINIPORT_REGISTRATION  MiniportRegistration,
-    IN                          PPCI_DEVICE_DESCRIPTION PciDevice,
+    IN_OPT                      PPCI_DEVICE_DESCRIPTION PciDevice,
     OUT_WRITES_ALL(MiniportRegistration->RxBuffers.NumberOfBuffers)
                                 PHYSICAL_ADDRESS*       RxPhysicalAddresses,
     OUT_WRITES_ALL(MiniportRegistration->TxBuffers.NumberOfBuffers)
@@ -294,7 +357,7 @@ _NetworkPortConfigureDevice(
 
     ASSERT( NULL != DriverObject );
     ASSERT( NULL != MiniportRegistration );
-    ASSERT( NULL != PciDevice );
+    ASSERT( (NULL != PciDevice) ^ (0 != MiniportRegistration->NumberOfVirtualDevices) );
 
     status = STATUS_SUCCESS;
     memzero(&initialization, sizeof(MINIPORT_DEVICE_INITIALIZATION));
@@ -366,15 +429,17 @@ _NetworkPortConfigureDevice(
             __leave;
         }
 
-        initialization.PciBar = PciDevice->DeviceData->Header.Device.Bar;
+        initialization.PciBar = NULL != PciDevice ? PciDevice->DeviceData->Header.Device.Bar : NULL;
 
         initialization.RxBuffers.NumberOfBuffers = MiniportRegistration->RxBuffers.NumberOfBuffers;
         initialization.RxBuffers.Buffers = RxPhysicalAddresses;
+        initialization.RxBuffers.BufferVirtualAddresses = pRxBuffers;
         initialization.RxBuffers.BufferSize = MiniportRegistration->RxBuffers.BufferSize;
 
         initialization.TxBuffers.NumberOfBuffers = MiniportRegistration->TxBuffers.NumberOfBuffers;
         initialization.TxBuffers.Buffers = TxPhysicalAddresses;
-        initialization.TxBuffers.BufferSize = MiniportRegistration->RxBuffers.BufferSize;
+        initialization.TxBuffers.BufferVirtualAddresses = pTxBuffers;
+        initialization.TxBuffers.BufferSize = MiniportRegistration->TxBuffers.BufferSize;
 
         // initialize miniport device
         status = MiniportRegistration->MiniportFunctions.MiniportInitializeDevice(pMiniportDevice,
@@ -404,6 +469,17 @@ _NetworkPortConfigureDevice(
             __leave;
         }
 
+        // jumbo frames must be explicitly enabled
+        pPortDevice->MaximumMtu = _NetworkPortGetMaximumMtu(MiniportRegistration);
+        pPortDevice->Mtu = ETHERNET_DEFAULT_MTU;
+
+        if (NULL == PciDevice)
+        {
+            // virtual devices notify their interrupts through
+            // NetworkPortNotifyInterrupt
+            __leave;
+        }
+
         // register interrupt
         ioInterrupt.Type = IoInterruptTypePci;
         ioInterrupt.Irql = IrqlNetworkLevel;
@@ -579,6 +655,8 @@ BOOLEAN
     PNETWORK_PORT_DEVICE pPortDevice;
     PMINIPORT_DEVICE pMiniportDevice;
     PNETWORK_PORT_DRIVER_DATA pDriverExtension;
+    QWORD noOfFramesBefore;
+    BOOLEAN bSolvedInterrupt;
 
     ASSERT(NULL != Device);
 
@@ -593,5 +671,20 @@ BOOLEAN
 
     ASSERT( NULL != pDriverExtension->MiniportFunctions.MiniportInterruptHandler);
 
-    return pDriverExtension->MiniportFunctions.MiniportInterruptHandler( pMiniportDevice );
+    // the interrupt handler is the only RX producer => no other frames
+    // can be received between these two reads
+    noOfFramesBefore = pPortDevice->RxData.Buffers.NumberOfFramesTransferred + pPortDevice->RxData.Buffers.NumberOfFramesDropped;
+
+    bSolvedInterrupt = pDriverExtension->MiniportFunctions.MiniportInterruptHandler( pMiniportDevice );
+    if (bSolvedInterrupt)
+    {
+        _InterlockedIncrement64(&pPortDevice->NumberOfInterrupts);
+
+        if (noOfFramesBefore != pPortDevice->RxData.Buffers.NumberOfFramesTransferred + pPortDevice->RxData.Buffers.NumberOfFramesDropped)
+        {
+            _InterlockedIncrement64(&pPortDevice->NumberOfRxInterrupts);
+        }
+    }
+
+    return bSolvedInterrupt;
 }
\ No newline at end of file
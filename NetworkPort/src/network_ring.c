@@ -0,0 +1,201 @@
+#include "network_port_base.h"
+#include "ex.h"
+
+STATUS
+NetworkRingInit(
+    OUT         PFRAME_RING                     Ring,
+    IN          DWORD                           MinimumCapacity
+    )
+{
+    STATUS status;
+    DWORD capacity;
+
+    if (NULL == Ring)
+    {
+        return STATUS_INVALID_PARAMETER1;
+    }
+
+    if (0 == MinimumCapacity || MinimumCapacity > (MAX_DWORD >> 1) + 1)
+    {
+        return STATUS_INVALID_PARAMETER2;
+    }
+
+    memzero(Ring, sizeof(FRAME_RING));
+
+    capacity = 1;
+    while (capacity < MinimumCapacity)
+    {
+        capacity = capacity << 1;
+    }
+
+    status = ExEventInit(&Ring->NotEmptyEvent, ExEventTypeNotification, FALSE);
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("ExEventInit", status);
+        return status;
+    }
+
+    Ring->Frames = ExAllocatePoolWithTag(PoolAllocateZeroMemory, sizeof(PFRAME_DESCRIPTOR_ENTRY) * capacity, HEAP_PORT_TAG, 0);
+    if (NULL == Ring->Frames)
+    {
+        LOG_FUNC_ERROR_ALLOC("ExAllocatePoolWithTag", sizeof(PFRAME_DESCRIPTOR_ENTRY) * capacity);
+        return STATUS_HEAP_INSUFFICIENT_RESOURCES;
+    }
+
+    Ring->Capacity = capacity;
+    Ring->Mask = capacity - 1;
+
+    return status;
+}
+
+void
+NetworkRingUninit(
+    INOUT       PFRAME_RING                     Ring
+    )
+{
+    PFRAME_DESCRIPTOR_ENTRY pFrame;
+
+    ASSERT( NULL != Ring );
+
+    if (NULL == Ring->Frames)
+    {
+        return;
+    }
+
+    for (pFrame = NetworkRingPeek(Ring);
+         pFrame != NULL;
+         pFrame = NetworkRingPeek(Ring))
+    {
+        NetworkRingConsume(Ring);
+        NetworkPortFreeFrameDescriptor(pFrame);
+    }
+
+    ExFreePoolWithTag(Ring->Frames, HEAP_PORT_TAG);
+    Ring->Frames = NULL;
+}
+
+BOOLEAN
+NetworkRingProduce(
+    INOUT       PFRAME_RING                     Ring,
+    IN          PFRAME_DESCRIPTOR_ENTRY         Frame
+    )
+{
+    DWORD head;
+    DWORD count;
+
+    ASSERT( NULL != Ring );
+    ASSERT( NULL != Frame );
+
+    head = Ring->Head;
+    count = head - Ring->Tail;
+    ASSERT( count <= Ring->Capacity );
+
+    if (count == Ring->Capacity)
+    {
+        return FALSE;
+    }
+
+    Ring->Frames[head & Ring->Mask] = Frame;
+
+    // volatile store => the frame is visible before the new head
+    Ring->Head = head + 1;
+
+    if (count + 1 > Ring->HighWaterMark)
+    {
+        Ring->HighWaterMark = count + 1;
+    }
+
+    // the consumer sets ConsumerWaiting and then checks Head, we store Head
+    // and then check ConsumerWaiting => a full barrier is required so that
+    // at least one of us observes the other's store
+    _mm_mfence();
+
+    if (Ring->ConsumerWaiting)
+    {
+        if (TRUE == _InterlockedCompareExchange8(&Ring->ConsumerWaiting, FALSE, TRUE))
+        {
+            ExEventSignal(&Ring->NotEmptyEvent);
+        }
+    }
+
+    return TRUE;
+}
+
+PTR_SUCCESS
+PFRAME_DESCRIPTOR_ENTRY
+NetworkRingPeek(
+    IN          PFRAME_RING                     Ring
+    )
+{
+    DWORD tail;
+
+    ASSERT( NULL != Ring );
+
+    tail = Ring->Tail;
+
+    // volatile load of Head => the frame is read after it
+    if (tail == Ring->Head)
+    {
+        return NULL;
+    }
+
+    return Ring->Frames[tail & Ring->Mask];
+}
+
+void
+NetworkRingConsume(
+    INOUT       PFRAME_RING                     Ring
+    )
+{
+    DWORD tail;
+
+    ASSERT( NULL != Ring );
+
+    tail = Ring->Tail;
+    ASSERT( tail != Ring->Head );
+
+    Ring->Frames[tail & Ring->Mask] = NULL;
+    Ring->Tail = tail + 1;
+}
+
+void
+NetworkRingWaitForFrames(
+    INOUT       PFRAME_RING                     Ring
+    )
+{
+    ASSERT( NULL != Ring );
+
+    // the event is cleared only after a wait returns, so a wakeup requested
+    // by NetworkRingWakeConsumer before we got here is not lost
+    _InterlockedExchange8(&Ring->ConsumerWaiting, TRUE);
+
+    if (0 != NetworkRingGetCount(Ring))
+    {
+        // a frame was produced before the producer could see our flag
+        _InterlockedExchange8(&Ring->ConsumerWaiting, FALSE);
+        return;
+    }
+
+    ExEventWaitForSignal(&Ring->NotEmptyEvent);
+
+    // the consumer checks the ring and its wakeup conditions after we
+    // return, any signal from now on is for a later wait
+    ExEventClearSignal(&Ring->NotEmptyEvent);
+}
+
+void
+NetworkRingWakeConsumer(
+    INOUT       PFRAME_RING                     Ring
+    )
+{
+    ASSERT( NULL != Ring );
+
+    if (NULL == Ring->Frames)
+    {
+        // the ring was never initialized, there is no consumer
+        return;
+    }
+
+    _InterlockedExchange8(&Ring->ConsumerWaiting, FALSE);
+    ExEventSignal(&Ring->NotEmptyEvent);
+}
\ No newline at end of file
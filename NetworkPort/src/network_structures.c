@@ -9,9 +9,6 @@ _NetworkPortPreinitBuffers(
     )
 {
     memzero(Buffers, sizeof(PORT_BUFFERS));
-
-    LockInit(&Buffers->FramesLock);
-    InitializeListHead(&Buffers->FramesList);
 }
 
 __forceinline
@@ -31,8 +28,18 @@ _NetworkPortDeviceInitBuffers(
     PortBuffers->NumberOfBuffers = NumberOfBuffers;
     PortBuffers->Buffers = (PVOID*)Buffers;
     PortBuffers->BufferSize = BufferSize;
+    PortBuffers->MaximumQueuedFrames = NumberOfBuffers * PORT_MAX_QUEUED_FRAMES_PER_DESCRIPTOR;
+    PortBuffers->SmallestFrame = MAX_DWORD;
 }
 
+static
+void
+_NetworkPortFillFrameStats(
+    IN          PPORT_BUFFERS           Buffers,
+    IN          DWORD                   RingHighWaterMark,
+    OUT         PNETWORK_FRAME_STATS    Stats
+    );
+
 static
 STATUS
 _NetworkPortDeviceInitRx(
@@ -63,6 +70,9 @@ NetworkPortDevicePreinit(
 
     _NetworkPortPreinitBuffers(&PortDevice->RxData.Buffers);
     _NetworkPortPreinitBuffers(&PortDevice->TxData.Buffers);
+
+    LockInit(&PortDevice->TxData.FramesLock);
+    InitializeListHead(&PortDevice->TxData.FramesList);
 }
 
 STATUS
@@ -159,6 +169,16 @@ NetworkPortDeviceUninit(
 
     ASSERT( NULL != PortDevice );
 
+    if (NULL != PortDevice->RxData.FramesRing.Frames)
+    {
+        // a reader blocked on the ring must leave before the device goes
+        // away, it sees Stopped once woken and releases the reader event
+        _InterlockedExchange8(&PortDevice->RxData.Stopped, TRUE);
+        NetworkRingWakeConsumer(&PortDevice->RxData.FramesRing);
+
+        ExEventWaitForSignal(&PortDevice->RxData.ReaderEvent);
+    }
+
     pMiniportDevice = PortDevice->Miniport;
 
     if (NULL != pMiniportDevice)
@@ -185,6 +205,8 @@ NetworkPortDeviceUninit(
         pMiniportDevice = NULL;
     }
 
+    NetworkRingUninit(&PortDevice->RxData.FramesRing);
+
     if (NULL != PortDevice->RxData.Buffers.Buffers)
     {
         ExFreePoolWithTag(PortDevice->RxData.Buffers.Buffers, HEAP_PORT_TAG);
@@ -221,6 +243,91 @@ NetworkPortFreeFrameDescriptor(
     ExFreePoolWithTag(Descriptor, HEAP_PORT_TAG);
 }
 
+void
+NetworkPortAccountFrame(
+    INOUT       PPORT_BUFFERS           Buffers,
+    IN          DWORD                   FrameSize,
+    IN          DWORD                   NumberOfDescriptors
+    )
+{
+    ASSERT( NULL != Buffers );
+
+    if (FrameSize < Buffers->SmallestFrame)
+    {
+        Buffers->SmallestFrame = FrameSize;
+    }
+
+    if (FrameSize > Buffers->LargestFrame)
+    {
+        Buffers->LargestFrame = FrameSize;
+    }
+
+    _InterlockedExchangeAdd64(&Buffers->NumberOfBytesTransferred, FrameSize);
+    _InterlockedExchangeAdd64(&Buffers->NumberOfDescriptorsTransferred, NumberOfDescriptors);
+    _InterlockedIncrement64(&Buffers->NumberOfFramesTransferred);
+}
+
+void
+NetworkPortGetDeviceStatistics(
+    IN          PNETWORK_PORT_DEVICE    PortDevice,
+    OUT         PNETWORK_DEVICE_STATS   Statistics
+    )
+{
+    INTR_STATE intrState;
+
+    ASSERT( NULL != PortDevice );
+    ASSERT( NULL != Statistics );
+    ASSERT( NULL != PortDevice->Miniport );
+
+    memzero(Statistics, sizeof(NETWORK_DEVICE_STATS));
+
+    _NetworkPortFillFrameStats(&PortDevice->RxData.Buffers,
+                               PortDevice->Miniport->Statistics.RxRingHighWaterMark,
+                               &Statistics->RxStats
+                               );
+    _NetworkPortFillFrameStats(&PortDevice->TxData.Buffers,
+                               PortDevice->Miniport->Statistics.TxRingHighWaterMark,
+                               &Statistics->TxStats
+                               );
+
+    Statistics->RxStats.DroppedFrames += PortDevice->Miniport->Statistics.RxMissedFrames;
+
+    Statistics->RxStats.QueuedFrames = NetworkRingGetCount(&PortDevice->RxData.FramesRing);
+    Statistics->RxStats.QueueHighWaterMark = PortDevice->RxData.FramesRing.HighWaterMark;
+
+    LockAcquire(&PortDevice->TxData.FramesLock, &intrState);
+    Statistics->TxStats.QueuedFrames = PortDevice->TxData.NumberOfQueuedFrames;
+    Statistics->TxStats.QueueHighWaterMark = PortDevice->TxData.QueueHighWaterMark;
+    LockRelease(&PortDevice->TxData.FramesLock, intrState);
+
+    Statistics->NumberOfInterrupts = PortDevice->NumberOfInterrupts;
+    Statistics->NumberOfRxInterrupts = PortDevice->NumberOfRxInterrupts;
+}
+
+static
+void
+_NetworkPortFillFrameStats(
+    IN          PPORT_BUFFERS           Buffers,
+    IN          DWORD                   RingHighWaterMark,
+    OUT         PNETWORK_FRAME_STATS    Stats
+    )
+{
+    ASSERT( NULL != Buffers );
+    ASSERT( NULL != Stats );
+
+    Stats->NumberOfFrames = Buffers->NumberOfFramesTransferred;
+    Stats->TotalBytes = Buffers->NumberOfBytesTransferred;
+    Stats->SmallestPacket = 0 != Stats->NumberOfFrames ? Buffers->SmallestFrame : 0;
+    Stats->LargestPacket = Buffers->LargestFrame;
+    Stats->DroppedFrames = Buffers->NumberOfFramesDropped;
+
+    Stats->NumberOfDescriptors = Buffers->NumberOfDescriptorsTransferred;
+    Stats->BufferSize = Buffers->BufferSize;
+
+    Stats->RingSize = Buffers->NumberOfBuffers;
+    Stats->RingHighWaterMark = RingHighWaterMark;
+}
+
 static
 STATUS
 _NetworkPortDeviceInitRx(
@@ -242,13 +349,25 @@ _NetworkPortDeviceInitRx(
                                   ReceiveBufferSize
                                   );
 
-    status = ExEventInit(&RxData->Buffers.FramesListNotEmptyEvent, ExEventTypeNotification, FALSE);
+    // initialized before the ring, NetworkPortDeviceUninit waits for the
+    // reader only if the ring storage was allocated
+    status = ExEventInit(&RxData->ReaderEvent, ExEventTypeSynchronization, TRUE);
     if (!SUCCEEDED(status))
     {
         LOG_FUNC_ERROR("ExEventInit", status);
         return status;
     }
 
+    status = NetworkRingInit(&RxData->FramesRing, RxData->Buffers.MaximumQueuedFrames);
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("NetworkRingInit", status);
+        return status;
+    }
+
+    // the ring capacity is rounded up to a power of 2
+    RxData->Buffers.MaximumQueuedFrames = RxData->FramesRing.Capacity;
+
     return status;
 }
 
@@ -274,7 +393,7 @@ _NetworkPortDeviceInitTx(
                                   TransmitBufferSize
                                   );
 
-    status = ExEventInit(&TxData->Buffers.FramesListNotEmptyEvent, ExEventTypeNotification, FALSE);
+    status = ExEventInit(&TxData->FramesListNotEmptyEvent, ExEventTypeNotification, FALSE);
     if (!SUCCEEDED(status))
     {
         LOG_FUNC_ERROR("ExEventInit", status);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "lock_common.h"
+#include "ex_rcu.h"
 #include "network_device.h"
 
 typedef struct _NETWORK_DEVICE
@@ -16,7 +17,9 @@ typedef struct _NETWORK_STACK_DATA
     BOOLEAN                     NetworkingEnabled;
 
     /// should be executive synch mechanism
-    RW_SPINLOCK                 DeviceLock;
+    // serializes the writers, the lookups traverse the list under
+    // ExRcuReadLock, the devices are never removed
+    LOCK                        DeviceLock;
 
     _Guarded_by_(DeviceLock)
     DWORD                       NumberOfDevices;
@@ -25,7 +28,6 @@ typedef struct _NETWORK_STACK_DATA
     LIST_ENTRY                  NetworkDeviceList;             
 } NETWORK_STACK_DATA, *PNETWORK_STACK_DATA;
 
-_No_competing_thread_
 void
 NetworkDevicePreinit(
     OUT     PNETWORK_DEVICE     Device,
@@ -33,7 +35,6 @@ NetworkDevicePreinit(
     IN      DEVICE_ID           DeviceId
     );
 
-_No_competing_thread_
 STATUS
 NetworkDeviceInitialize(
     INOUT    PNETWORK_DEVICE    Device
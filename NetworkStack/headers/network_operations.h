@@ -28,4 +28,22 @@ STATUS
 NetOpGetLinkStatus(
     IN          PDEVICE_OBJECT          DeviceObject,
     OUT         BOOLEAN*                LinkStatus
+    );
+
+STATUS
+NetOpGetDeviceStatistics(
+    IN          PDEVICE_OBJECT          DeviceObject,
+    OUT         PNETWORK_DEVICE_STATS   Statistics
+    );
+
+STATUS
+NetOpGetMtu(
+    IN          PDEVICE_OBJECT          DeviceObject,
+    OUT         DWORD*                  Mtu
+    );
+
+STATUS
+NetOpSetMtu(
+    IN          PDEVICE_OBJECT          DeviceObject,
+    IN          DWORD                   Mtu
     );
\ No newline at end of file
@@ -16,4 +16,18 @@ _No_competing_thread_
 STATUS
 NetworkStackSetState(
     IN  BOOLEAN     EnableNetworking
+    );
+
+//******************************************************************************
+// Function:     NetworkStackRescanDevices
+// Description:  Adds the network devices created after NetworkStackInit,
+//               e.g. by a driver loaded on demand. The new devices are
+//               enabled or disabled according to the current networking
+//               state.
+// Returns:      STATUS
+// Parameter:    void
+//******************************************************************************
+STATUS
+NetworkStackRescanDevices(
+    void
     );
\ No newline at end of file
@@ -2,7 +2,6 @@
 #include "network_internal.h"
 #include "network_operations.h"
 
-_No_competing_thread_
 void
 NetworkDevicePreinit(
     OUT     PNETWORK_DEVICE     Device,
@@ -17,7 +16,6 @@ NetworkDevicePreinit(
     Device->Info.DeviceId = DeviceId;
 }
 
-_No_competing_thread_
 STATUS
 NetworkDeviceInitialize(
     INOUT    PNETWORK_DEVICE    Device
@@ -49,6 +47,15 @@ NetworkDeviceInitialize(
         return status;
     }
 
+    status = NetOpGetMtu(Device->PhysicalDevice,
+                         &Device->Info.Mtu
+                         );
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("NetOpGetMtu", status);
+        return status;
+    }
+
     LOG_FUNC_END;
 
     return status;
@@ -192,7 +192,8 @@ NetGetNetworkDevices(
     status = STATUS_SUCCESS;
     i = 0;
 
-    RwSpinlockAcquireShared(&m_netStackData.DeviceLock, &intrState);
+    // exclusive, the status of each device is updated in its Info
+    LockAcquire(&m_netStackData.DeviceLock, &intrState);
     
     __try
     {
@@ -241,7 +242,7 @@ NetGetNetworkDevices(
     }
     __finally
     {
-        RwSpinlockReleaseShared(&m_netStackData.DeviceLock, intrState);
+        LockRelease(&m_netStackData.DeviceLock, intrState);
     }
 
     return status;
@@ -276,5 +277,66 @@ NetChangeDeviceStatus(
         return status;
     }
 
+    return status;
+}
+
+STATUS
+NetGetNetworkDeviceStatistics(
+    IN              DEVICE_ID                       DeviceId,
+    OUT             PNETWORK_DEVICE_STATS           Statistics
+    )
+{
+    STATUS status;
+    PNETWORK_DEVICE pNetDevice;
+
+    if (NULL == Statistics)
+    {
+        return STATUS_INVALID_PARAMETER2;
+    }
+
+    pNetDevice = NetOpGetDeviceById(DeviceId);
+    if (NULL == pNetDevice)
+    {
+        return STATUS_DEVICE_DOES_NOT_EXIST;
+    }
+
+    status = NetOpGetDeviceStatistics(pNetDevice->PhysicalDevice,
+                                      Statistics
+                                      );
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("NetOpGetDeviceStatistics", status );
+        return status;
+    }
+
+    return status;
+}
+
+STATUS
+NetSetDeviceMtu(
+    IN              DEVICE_ID                       DeviceId,
+    IN              DWORD                           Mtu
+    )
+{
+    STATUS status;
+    PNETWORK_DEVICE pNetDevice;
+
+    pNetDevice = NetOpGetDeviceById(DeviceId);
+    if (NULL == pNetDevice)
+    {
+        return STATUS_DEVICE_DOES_NOT_EXIST;
+    }
+
+    status = NetOpSetMtu(pNetDevice->PhysicalDevice,
+                         Mtu
+                         );
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("NetOpSetMtu", status );
+        return status;
+    }
+
+    _InterlockedExchange(&pNetDevice->Info.Mtu, Mtu);
+
     return status;
 }
\ No newline at end of file
@@ -77,11 +77,11 @@ NetOpGetDeviceById(
     pEntry = NULL;
     pResult = NULL;
 
-    RwSpinlockAcquireShared(&m_netStackData.DeviceLock, &intrState);
+    ExRcuReadLock(&intrState);
 
-    for (pEntry = m_netStackData.NetworkDeviceList.Flink;
+    for (pEntry = ExRcuListNext(&m_netStackData.NetworkDeviceList);
         pEntry != &m_netStackData.NetworkDeviceList;
-        pEntry = pEntry->Flink)
+        pEntry = ExRcuListNext(pEntry))
     {
         PNETWORK_DEVICE pNetDevice = CONTAINING_RECORD(pEntry, NETWORK_DEVICE, NextDevice );
 
@@ -92,7 +92,7 @@ NetOpGetDeviceById(
         }
     }
 
-    RwSpinlockReleaseShared(&m_netStackData.DeviceLock, intrState );
+    ExRcuReadUnlock(intrState);
 
     return pResult;
 }
@@ -279,5 +279,189 @@ NetOpGetLinkStatus(
         LOG_FUNC_END;
     }
 
+    return status;
+}
+
+STATUS
+NetOpGetDeviceStatistics(
+    IN          PDEVICE_OBJECT          DeviceObject,
+    OUT         PNETWORK_DEVICE_STATS   Statistics
+    )
+{
+    STATUS status;
+    PIRP pIrp;
+    NET_GET_DEVICE_STATISTICS devStatistics;
+
+    LOG_FUNC_START;
+
+    ASSERT(NULL != DeviceObject);
+    ASSERT(NULL != Statistics);
+
+    status = STATUS_SUCCESS;
+    pIrp = NULL;
+    memzero(&devStatistics, sizeof(NET_GET_DEVICE_STATISTICS));
+
+    __try
+    {
+        pIrp = IoBuildDeviceIoControlRequest(IOCTL_NET_GET_DEVICE_STATISTICS,
+                                             DeviceObject,
+                                             NULL,
+                                             0,
+                                             &devStatistics,
+                                             sizeof(NET_GET_DEVICE_STATISTICS)
+        );
+        ASSERT(NULL != pIrp);
+
+        status = IoCallDriver(DeviceObject,
+                              pIrp
+        );
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("IoCallDriver", status);
+            __leave;
+        }
+
+        status = pIrp->IoStatus.Status;
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("IoCallDriver", status);
+            __leave;
+        }
+
+        memcpy(Statistics, &devStatistics.Statistics, sizeof(NETWORK_DEVICE_STATS));
+    }
+    __finally
+    {
+        if (NULL != pIrp)
+        {
+            IoFreeIrp(pIrp);
+            pIrp = NULL;
+        }
+
+        LOG_FUNC_END;
+    }
+
+    return status;
+}
+
+STATUS
+NetOpGetMtu(
+    IN          PDEVICE_OBJECT          DeviceObject,
+    OUT         DWORD*                  Mtu
+    )
+{
+    STATUS status;
+    PIRP pIrp;
+    NET_GET_SET_MTU devMtu;
+
+    LOG_FUNC_START;
+
+    ASSERT(NULL != DeviceObject);
+    ASSERT(NULL != Mtu);
+
+    status = STATUS_SUCCESS;
+    pIrp = NULL;
+    memzero(&devMtu, sizeof(NET_GET_SET_MTU));
+
+    __try
+    {
+        pIrp = IoBuildDeviceIoControlRequest(IOCTL_NET_GET_MTU,
+                                             DeviceObject,
+                                             NULL,
+                                             0,
+                                             &devMtu,
+                                             sizeof(NET_GET_SET_MTU)
+        );
+        ASSERT(NULL != pIrp);
+
+        status = IoCallDriver(DeviceObject,
+                              pIrp
+        );
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("IoCallDriver", status);
+            __leave;
+        }
+
+        status = pIrp->IoStatus.Status;
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("IoCallDriver", status);
+            __leave;
+        }
+
+        *Mtu = devMtu.Mtu;
+    }
+    __finally
+    {
+        if (NULL != pIrp)
+        {
+            IoFreeIrp(pIrp);
+            pIrp = NULL;
+        }
+
+        LOG_FUNC_END;
+    }
+
+    return status;
+}
+
+STATUS
+NetOpSetMtu(
+    IN          PDEVICE_OBJECT          DeviceObject,
+    IN          DWORD                   Mtu
+    )
+{
+    STATUS status;
+    PIRP pIrp;
+    NET_GET_SET_MTU devMtu;
+
+    LOG_FUNC_START;
+
+    ASSERT(NULL != DeviceObject);
+
+    status = STATUS_SUCCESS;
+    pIrp = NULL;
+    memzero(&devMtu, sizeof(NET_GET_SET_MTU));
+    devMtu.Mtu = Mtu;
+
+    __try
+    {
+        pIrp = IoBuildDeviceIoControlRequest(IOCTL_NET_SET_MTU,
+                                             DeviceObject,
+                                             &devMtu,
+                                             sizeof(NET_GET_SET_MTU),
+                                             NULL,
+                                             0
+        );
+        ASSERT(NULL != pIrp);
+
+        status = IoCallDriver(DeviceObject,
+                              pIrp
+        );
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("IoCallDriver", status);
+            __leave;
+        }
+
+        status = pIrp->IoStatus.Status;
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("IoCallDriver", status);
+            __leave;
+        }
+    }
+    __finally
+    {
+        if (NULL != pIrp)
+        {
+            IoFreeIrp(pIrp);
+            pIrp = NULL;
+        }
+
+        LOG_FUNC_END;
+    }
+
     return status;
 }
\ No newline at end of file
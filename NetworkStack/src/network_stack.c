@@ -7,7 +7,6 @@ NETWORK_STACK_DATA m_netStackData;
 
 const MAC_ADDRESS MAC_BROADCAST = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
 
-_No_competing_thread_
 __forceinline
 static
 DEVICE_ID
@@ -15,11 +14,25 @@ _NetworkStackGetNextDeviceId(
     void
     )
 {
-    static DEVICE_ID __nextDeviceId = 0;
+    static volatile DEVICE_ID __nextDeviceId = 0;
 
-    return __nextDeviceId++;
+    // devices may be added after initialization, see NetworkStackRescanDevices
+    return _InterlockedIncrement(&__nextDeviceId) - 1;
 }
 
+static
+STATUS
+_NetworkStackAddNewDevices(
+    IN  BOOLEAN     ApplyNetworkingState
+    );
+
+REQUIRES_EXCL_LOCK(m_netStackData.DeviceLock)
+static
+BOOLEAN
+_NetworkStackIsDeviceRegistered(
+    IN  PDEVICE_OBJECT  DeviceObject
+    );
+
 _No_competing_thread_
 void
 NetworkStackPreinit(
@@ -29,7 +42,7 @@ NetworkStackPreinit(
     memzero(&m_netStackData, sizeof(NETWORK_STACK_DATA));
 
     InitializeListHead(&m_netStackData.NetworkDeviceList);
-    RwSpinlockInit(&m_netStackData.DeviceLock);
+    LockInit(&m_netStackData.DeviceLock);
 
     m_netStackData.NetworkingEnabled = TRUE;
 }
@@ -41,12 +54,112 @@ NetworkStackInit(
     )
 {
     STATUS status;
+
+    LOG_FUNC_START;
+
+    status = _NetworkStackAddNewDevices(FALSE);
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("_NetworkStackAddNewDevices", status);
+        return status;
+    }
+
+    status = NetworkStackSetState(EnableNetworking);
+    if (!SUCCEEDED(status))
+    {
+        LOG_FUNC_ERROR("NetworkStackSetState", status);
+        return status;
+    }
+
+    LOG_FUNC_END;
+
+    return status;
+}
+
+STATUS
+NetworkStackRescanDevices(
+    void
+    )
+{
+    return _NetworkStackAddNewDevices(TRUE);
+}
+
+_No_competing_thread_
+STATUS
+NetworkStackSetState(
+    IN  BOOLEAN     EnableNetworking
+    )
+{
+    STATUS status;
+    PLIST_ENTRY pCurEntry;
+    NETWORK_DEVICE_STATUS devStatus;
+    INTR_STATE intrState;
+
+    if (!(EnableNetworking ^ m_netStackData.NetworkingEnabled))
+    {
+        // no change in state
+        return STATUS_ALREADY_INITIALIZED_HINT;
+    }
+
+    status = STATUS_SUCCESS;
+    pCurEntry = NULL;
+    memzero(&devStatus, sizeof(NETWORK_DEVICE_STATUS));
+
+    devStatus.RxEnabled = EnableNetworking;
+    devStatus.TxEnabled = EnableNetworking;
+
+    LOG_FUNC_START;
+
+    LOG("Will change networking state %u -> %u\n", 
+        m_netStackData.NetworkingEnabled, EnableNetworking );
+
+    // NetworkStackRescanDevices may insert devices concurrently => the list
+    // is walked on the RCU read side, which is left while the request is
+    // sent to each device: devices are never removed from the list so the
+    // current entry remains valid
+    ExRcuReadLock(&intrState);
+    pCurEntry = ExRcuListNext(&m_netStackData.NetworkDeviceList);
+    ExRcuReadUnlock(intrState);
+
+    while (pCurEntry != &m_netStackData.NetworkDeviceList)
+    {
+        PNETWORK_DEVICE pNetDevice = CONTAINING_RECORD(pCurEntry, NETWORK_DEVICE, NextDevice );
+
+        status = NetOpSetDeviceStatus(pNetDevice->PhysicalDevice,
+                                      &devStatus);
+        if (!SUCCEEDED(status))
+        {
+            LOG_FUNC_ERROR("NetOpSetDeviceStatus", status );
+            break;
+        }
+
+        ExRcuReadLock(&intrState);
+        pCurEntry = ExRcuListNext(pCurEntry);
+        ExRcuReadUnlock(intrState);
+    }
+
+
+    m_netStackData.NetworkingEnabled = EnableNetworking;
+
+    LOG_FUNC_END;
+
+    return status;
+}
+
+static
+STATUS
+_NetworkStackAddNewDevices(
+    IN  BOOLEAN     ApplyNetworkingState
+    )
+{
+    STATUS status;
     PDEVICE_OBJECT* pNetworkDevices;
     DWORD numberOfDevices;
     DWORD i;
     PNETWORK_DEVICE pNetDevice;
-
-    LOG_FUNC_START;
+    INTR_STATE intrState;
+    BOOLEAN bRegistered;
+    NETWORK_DEVICE_STATUS devStatus;
 
     status = STATUS_SUCCESS;
     pNetDevice = NULL;
@@ -67,6 +180,15 @@ NetworkStackInit(
     {
         for (i = 0; i < numberOfDevices; ++i)
         {
+            LockAcquire(&m_netStackData.DeviceLock, &intrState);
+            bRegistered = _NetworkStackIsDeviceRegistered(pNetworkDevices[i]);
+            LockRelease(&m_netStackData.DeviceLock, intrState);
+
+            if (bRegistered)
+            {
+                continue;
+            }
+
             if (NULL == pNetDevice)
             {
                 pNetDevice = ExAllocatePoolWithTag(PoolAllocateZeroMemory, sizeof(NETWORK_DEVICE), HEAP_NET_TAG, 0);
@@ -88,80 +210,80 @@ NetworkStackInit(
                 __leave;
             }
 
-            InsertTailList(&m_netStackData.NetworkDeviceList, &pNetDevice->NextDevice);
-            m_netStackData.NumberOfDevices++;
-            pNetDevice = NULL;
-        }
+            if (ApplyNetworkingState)
+            {
+                // devices added after initialization follow the state set
+                // for the others
+                devStatus.RxEnabled = m_netStackData.NetworkingEnabled;
+                devStatus.TxEnabled = m_netStackData.NetworkingEnabled;
 
-        status = NetworkStackSetState(EnableNetworking);
-        if (!SUCCEEDED(status))
-        {
-            LOG_FUNC_ERROR("NetworkStackSetState", status);
-            __leave;
+                status = NetOpSetDeviceStatus(pNetDevice->PhysicalDevice, &devStatus);
+                if (!SUCCEEDED(status))
+                {
+                    LOG_FUNC_ERROR("NetOpSetDeviceStatus", status);
+                    __leave;
+                }
+
+                pNetDevice->Info.DeviceStatus = devStatus;
+            }
+
+            // the devices are initialized outside the lock, another rescan
+            // may have added the same device in the meantime
+            LockAcquire(&m_netStackData.DeviceLock, &intrState);
+            bRegistered = _NetworkStackIsDeviceRegistered(pNetworkDevices[i]);
+            if (!bRegistered)
+            {
+                ExRcuInsertTailList(&m_netStackData.NetworkDeviceList, &pNetDevice->NextDevice);
+                m_netStackData.NumberOfDevices++;
+            }
+            LockRelease(&m_netStackData.DeviceLock, intrState);
+
+            if (!bRegistered)
+            {
+                pNetDevice = NULL;
+            }
         }
     }
     __finally
     {
+        if (NULL != pNetDevice)
+        {
+            ExFreePoolWithTag(pNetDevice, HEAP_NET_TAG);
+            pNetDevice = NULL;
+        }
+
         if (NULL != pNetworkDevices)
         {
             IoFreeTemporaryData(pNetworkDevices);
             pNetworkDevices = NULL;
         }
-
-        LOG_FUNC_END;
     }
 
     return status;
 }
 
-_No_competing_thread_
-STATUS
-NetworkStackSetState(
-    IN  BOOLEAN     EnableNetworking
+REQUIRES_EXCL_LOCK(m_netStackData.DeviceLock)
+static
+BOOLEAN
+_NetworkStackIsDeviceRegistered(
+    IN  PDEVICE_OBJECT  DeviceObject
     )
 {
-    STATUS status;
-    PLIST_ENTRY pCurEntry;
-    NETWORK_DEVICE_STATUS devStatus;
+    PLIST_ENTRY pEntry;
 
-    if (!(EnableNetworking ^ m_netStackData.NetworkingEnabled))
-    {
-        // no change in state
-        return STATUS_ALREADY_INITIALIZED_HINT;
-    }
+    ASSERT(NULL != DeviceObject);
 
-    status = STATUS_SUCCESS;
-    pCurEntry = NULL;
-    memzero(&devStatus, sizeof(NETWORK_DEVICE_STATUS));
-
-    devStatus.RxEnabled = EnableNetworking;
-    devStatus.TxEnabled = EnableNetworking;
-
-    LOG_FUNC_START;
-
-    LOG("Will change networking state %u -> %u\n", 
-        m_netStackData.NetworkingEnabled, EnableNetworking );
-
-    for (pCurEntry = m_netStackData.NetworkDeviceList.Flink;
-    pCurEntry != &m_netStackData.NetworkDeviceList;
-        pCurEntry = pCurEntry->Flink
-        )
+    for (pEntry = m_netStackData.NetworkDeviceList.Flink;
+         pEntry != &m_netStackData.NetworkDeviceList;
+         pEntry = pEntry->Flink)
     {
-        PNETWORK_DEVICE pNetDevice = CONTAINING_RECORD(pCurEntry, NETWORK_DEVICE, NextDevice );
+        PNETWORK_DEVICE pNetDevice = CONTAINING_RECORD(pEntry, NETWORK_DEVICE, NextDevice);
 
-        status = NetOpSetDeviceStatus(pNetDevice->PhysicalDevice,
-                                      &devStatus);
-        if (!SUCCEEDED(status))
+        if (pNetDevice->PhysicalDevice == DeviceObject)
         {
-            LOG_FUNC_ERROR("NetOpSetDeviceStatus", status );
-            break;
+            return TRUE;
         }
     }
 
-
-    m_netStackData.NetworkingEnabled = EnableNetworking;
-
-    LOG_FUNC_END;
-
-    return status;
+    return FALSE;
 }
\ No newline at end of file
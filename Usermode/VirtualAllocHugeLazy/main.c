@@ -5,6 +5,10 @@
 #define VALUE_TO_WRITE              0x37U
 #define LAZY_ALLOC_SIZE             (1 * GB_SIZE)
 
+// each page of this region is touched, the number of page faults needed
+// depends on how many pages the kernel maps around each faulting page
+#define LAZY_TOUCH_SIZE             (16 * MB_SIZE)
+
 STATUS
 __main(
     DWORD       argc,
@@ -44,6 +48,20 @@ __main(
         }
 
 
+        for (QWORD offset = PAGE_SIZE; offset < LAZY_TOUCH_SIZE; offset += PAGE_SIZE)
+        {
+            *PtrOffset(pAllocatedAddress, offset) = VALUE_TO_WRITE;
+        }
+
+        for (QWORD offset = 0; offset < LAZY_TOUCH_SIZE; offset += PAGE_SIZE)
+        {
+            if (*PtrOffset(pAllocatedAddress, offset) != VALUE_TO_WRITE)
+            {
+                LOG_ERROR("Value at offset 0x%X differs from the one written\n", offset);
+                __leave;
+            }
+        }
+
         *PtrOffset(pAllocatedAddress, LAZY_ALLOC_SIZE - 1) = VALUE_TO_WRITE;
         if (*PtrOffset(pAllocatedAddress, LAZY_ALLOC_SIZE - 1) != VALUE_TO_WRITE)
         {
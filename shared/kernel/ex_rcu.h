@@ -0,0 +1,80 @@
+#pragma once
+
+#include "list.h"
+
+// Read-copy-update for lists which are mostly read. The readers run with
+// interrupts disabled and don't write anything shared, so they never contend
+// with each other. The writers serialize among themselves, publish entries
+// only after they are fully initialized and may free an unlinked entry only
+// after ExRcuSynchronize returns. A CPU which took a timer interrupt or
+// switched threads since the unlink can't still hold a pointer to the entry.
+
+// Loads the next entry of a list changed concurrently by a writer
+#define ExRcuListNext(Entry)                (*(PLIST_ENTRY volatile*) &(Entry)->Flink)
+
+//******************************************************************************
+// Function:     ExRcuReadLock
+// Description:  Starts a read side critical section, the entries read until
+//               ExRcuReadUnlock will not be freed.
+// Returns:      void
+// Parameter:    OUT INTR_STATE* IntrState
+// NOTE:         The critical section must not block, sections may be nested.
+//******************************************************************************
+void
+ExRcuReadLock(
+    OUT     INTR_STATE*             IntrState
+    );
+
+//******************************************************************************
+// Function:     ExRcuReadUnlock
+// Description:  Ends a read side critical section.
+// Returns:      void
+// Parameter:    IN INTR_STATE IntrState - value returned by ExRcuReadLock
+//******************************************************************************
+void
+ExRcuReadUnlock(
+    IN      INTR_STATE              IntrState
+    );
+
+//******************************************************************************
+// Function:     ExRcuSynchronize
+// Description:  Waits until each CPU went through a quiescent state, i.e.
+//               until all the read side critical sections in progress when
+//               the function was called finished.
+// Returns:      void
+// Parameter:    void
+// NOTE:         Must be called with interrupts enabled.
+//******************************************************************************
+void
+ExRcuSynchronize(
+    void
+    );
+
+//******************************************************************************
+// Function:     ExRcuInsertTailList
+// Description:  Appends an entry to a list traversed by readers. The entry is
+//               visible to the readers only after its fields are written.
+// Returns:      void
+// Parameter:    INOUT PLIST_ENTRY ListHead
+// Parameter:    INOUT PLIST_ENTRY Entry
+// NOTE:         The writers must be serialized by the caller.
+//******************************************************************************
+void
+ExRcuInsertTailList(
+    INOUT   PLIST_ENTRY             ListHead,
+    INOUT   PLIST_ENTRY             Entry
+    );
+
+//******************************************************************************
+// Function:     ExRcuRemoveEntryList
+// Description:  Unlinks an entry from a list traversed by readers. The readers
+//               positioned on the entry may still advance through it, it can
+//               be freed only after ExRcuSynchronize.
+// Returns:      void
+// Parameter:    INOUT PLIST_ENTRY Entry
+// NOTE:         The writers must be serialized by the caller.
+//******************************************************************************
+void
+ExRcuRemoveEntryList(
+    INOUT   PLIST_ENTRY             Entry
+    );
\ No newline at end of file
@@ -38,7 +38,10 @@ typedef struct _FILE_OBJECT
 typedef struct _VPB_FLAGS
 {
     DWORD               Mounted     :    1;
-    DWORD               Reserved    :   31;
+
+    // the volume holds no files, it is used by the pager
+    DWORD               SwapSpace   :    1;
+    DWORD               Reserved    :   30;
 } VPB_FLAGS, *PVPB_FLAGS;
 
 // Provides an association between a logical volume
@@ -30,6 +30,8 @@
 #define HEAP_NET_TAG                    ':TEN'
 #define HEAP_ETH_TAG                    ':HTE'
 #define HEAP_PORT_TAG                   ':TRP'
+#define HEAP_LOOPBACK_TAG               ':POL'
 #define HEAP_EXECUTIVE_TAG              ':XE '
 #define HEAP_PROCESS_TAG                ':CRP'
+#define HEAP_SWAP_TAG                   ':PWS'
 #define HEAP_BOOT_TAG                   'TOOB'
\ No newline at end of file
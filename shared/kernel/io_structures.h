@@ -240,6 +240,10 @@ typedef struct _DRIVER_OBJECT
     DWORD                   NoOfDevices;
     LIST_ENTRY              DeviceList;
 
+    // set once DriverEntry succeeded, only then the devices of the driver
+    // become reachable through the driver list and the VPB list
+    BOOLEAN                 Installed;
+
     LIST_ENTRY              NextDriver;
 
     PFUNC_DriverDispatch    DispatchFunctions[IRP_MJ_MAX];
@@ -314,6 +318,16 @@ typedef struct _NET_GET_LINK_STATUS
 {
     BOOLEAN                 LinkUp;
 } NET_GET_LINK_STATUS, *PNET_GET_LINK_STATUS;
+
+typedef struct _NET_GET_DEVICE_STATISTICS
+{
+    NETWORK_DEVICE_STATS    Statistics;
+} NET_GET_DEVICE_STATISTICS, *PNET_GET_DEVICE_STATISTICS;
+
+typedef struct _NET_GET_SET_MTU
+{
+    DWORD                   Mtu;
+} NET_GET_SET_MTU, *PNET_GET_SET_MTU;
 #pragma warning(default:4200)
 
 #define IOCTL_DISK_GET_LENGTH_INFO          0x0
@@ -326,6 +340,9 @@ typedef struct _NET_GET_LINK_STATUS
 #define IOCTL_NET_GET_DEVICE_STATUS         0x7
 #define IOCTL_NET_SET_DEVICE_STATUS         0x8
 #define IOCTL_NET_GET_LINK_STATUS           0x9
+#define IOCTL_NET_GET_DEVICE_STATISTICS     0xA
+#define IOCTL_NET_GET_MTU                   0xB
+#define IOCTL_NET_SET_MTU                   0xC
 
 // end of common packing
 #pragma warning(default:4201)
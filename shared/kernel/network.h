@@ -41,4 +41,19 @@ STATUS
 NetGetNetworkDeviceStatistics(
     IN              DEVICE_ID                       DeviceId,
     OUT             PNETWORK_DEVICE_STATS           Statistics
+    );
+
+//******************************************************************************
+// Function:     NetSetDeviceMtu
+// Description:  Changes the maximum payload of the frames sent by the device.
+//               Values above ETHERNET_DEFAULT_MTU enable jumbo frames and are
+//               accepted only if the device supports them.
+// Returns:      STATUS
+// Parameter:    IN DEVICE_ID DeviceId
+// Parameter:    IN DWORD Mtu
+//******************************************************************************
+STATUS
+NetSetDeviceMtu(
+    IN              DEVICE_ID                       DeviceId,
+    IN              DWORD                           Mtu
     );
\ No newline at end of file
@@ -16,18 +16,50 @@ typedef struct _NETWORK_DEVICE_INFO
 
     NETWORK_DEVICE_STATUS   DeviceStatus;
     BOOLEAN                 LinkStatus;
+
+    // maximum payload of a frame, see ETHERNET_DEFAULT_MTU
+    DWORD                   Mtu;
 } NETWORK_DEVICE_INFO, *PNETWORK_DEVICE_INFO;
 
 typedef struct _NETWORK_FRAME_STATS
 {
     QWORD                   NumberOfFrames;
     QWORD                   TotalBytes;
+
+    // descriptors used by the frames transferred, a frame larger
+    // than BufferSize occupies multiple descriptors
+    QWORD                   NumberOfDescriptors;
     QWORD                   SmallestPacket;
     QWORD                   LargestPacket;
+
+    // frames discarded because the port queue was full, because
+    // no frame descriptor could be allocated or because the device
+    // had no free RX descriptor
+    QWORD                   DroppedFrames;
+
+    // number of frames currently waiting in the port queue
+    DWORD                   QueuedFrames;
+    DWORD                   QueueHighWaterMark;
+
+    // number of descriptors in the miniport ring and the
+    // maximum number of occupied descriptors at any point in
+    // time: received and not yet processed for RX, queued
+    // and not yet transmitted for TX
+    DWORD                   RingSize;
+    DWORD                   RingHighWaterMark;
+    DWORD                   BufferSize;
 } NETWORK_FRAME_STATS, *PNETWORK_FRAME_STATS;
 
 typedef struct _NETWORK_DEVICE_STATS
 {
     NETWORK_FRAME_STATS     RxStats;
     NETWORK_FRAME_STATS     TxStats;
+
+    // interrupts solved by the miniport driver
+    QWORD                   NumberOfInterrupts;
+
+    // interrupts during which at least one frame was received,
+    // RxStats.NumberOfFrames / NumberOfRxInterrupts gives the
+    // average number of frames processed per interrupt
+    QWORD                   NumberOfRxInterrupts;
 } NETWORK_DEVICE_STATS, *PNETWORK_DEVICE_STATS;
\ No newline at end of file
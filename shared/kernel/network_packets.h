@@ -49,6 +49,15 @@ typedef struct _IP6_ADDRESS
 #define ARP_PACKET_SIZE                     28
 #define IEEE_802_3_MINIMUM_FRAME_SIZE       64
 
+// maximum number of bytes which may follow the Ethernet header, IPv4
+// requires at least 68 bytes and devices supporting jumbo frames may
+// be configured up to ETHERNET_JUMBO_MTU
+#define ETHERNET_MINIMUM_MTU                68
+#define ETHERNET_DEFAULT_MTU                1500
+#define ETHERNET_JUMBO_MTU                  9000
+
+#define ETHERNET_MAXIMUM_FRAME_SIZE(Mtu)    (ETHERNET_FRAME_SIZE + (Mtu))
+
 typedef WORD        ETHERNET_FRAME_TYPE;
 
 #define ETHERNET_FRAME_TYPE_IP4         __pragma(warning(suppress: 4310)) ((WORD)0x0800ui16)
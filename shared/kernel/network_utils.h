@@ -16,4 +16,54 @@ char*
 NetUtilIp4AddressToText(
     IN                                                          IP4_ADDRESS         Address,
     OUT_WRITES_BYTES_ALL(TEXT_IP4_ADDRESS_CHARS_REQUIRED)       char*               Buffer
+    );
+
+//******************************************************************************
+// Function:     NetUtilIp4HeaderChecksum
+// Description:  Computes the checksum of an IPv4 header as it should be
+//               placed in its Checksum field. The current value of the field
+//               is ignored.
+// Returns:      WORD - Checksum in network byte order, 0 if the
+//               InternetHeaderLength is below the minimum of 5 DWORDs
+// Parameter:    IN PIP4_PACKET Header - Header of InternetHeaderLength DWORDs
+//******************************************************************************
+WORD
+NetUtilIp4HeaderChecksum(
+    IN                                                          PIP4_PACKET         Header
+    );
+
+//******************************************************************************
+// Function:     NetUtilIp4ParseHeader
+// Description:  Validates an IPv4 header received in a buffer of BufferSize
+//               bytes: version, header length, total length and checksum.
+// Returns:      STATUS
+// Parameter:    IN PIP4_PACKET Header
+// Parameter:    IN DWORD BufferSize - Bytes available starting at Header
+// Parameter:    OUT_OPT DWORD* HeaderLength - Size of the header in bytes
+// Parameter:    OUT_OPT DWORD* PayloadLength - Size of the data following the
+//               header in bytes
+//******************************************************************************
+STATUS
+NetUtilIp4ParseHeader(
+    IN_READS_BYTES(BufferSize)                                  PIP4_PACKET         Header,
+    IN                                                          DWORD               BufferSize,
+    OUT_OPT                                                     DWORD*              HeaderLength,
+    OUT_OPT                                                     DWORD*              PayloadLength
+    );
+
+//******************************************************************************
+// Function:     NetUtilUdpChecksum
+// Description:  Computes the checksum of an UDP datagram, including the IPv4
+//               pseudo-header. The current value of the Checksum field of the
+//               datagram is ignored.
+// Returns:      WORD - Checksum in network byte order
+// Parameter:    IN PIP4_PACKET Ip4Header - Header carrying the datagram
+// Parameter:    IN PUDP_DATAGRAM Datagram - Header followed by the payload
+// Parameter:    IN WORD DatagramLength - Header + payload size in bytes
+//******************************************************************************
+WORD
+NetUtilUdpChecksum(
+    IN                                                          PIP4_PACKET         Ip4Header,
+    IN_READS_BYTES(DatagramLength)                              PUDP_DATAGRAM       Datagram,
+    IN                                                          WORD                DatagramLength
     );
\ No newline at end of file